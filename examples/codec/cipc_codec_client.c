@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_codec.h"
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_stats.h"
+
+#define CLIENT_HOST "127.0.0.1"
+#define CLIENT_PORT 5558
+#define CLIENT_BUFFER_SIZE (64 * 1024)
+#define CLIENT_MESSAGES 32
+#define CLIENT_RECORDS_PER_MESSAGE 64
+
+static void
+client_free (cipc **client)
+{
+  if (client && *client)
+    {
+      cipc_free (*client);
+      *client = NULL;
+    }
+}
+
+// Connects over TCP, then hands the connection to a codec wrapper compressing every send.
+static int
+client_init (cipc **client, const cipc_tcp_config *tcp_config)
+{
+  cipc *tcp = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!tcp)
+    {
+      fprintf (stderr, "Failed to create TCP instance!\n");
+      return EXIT_FAILURE;
+    }
+
+  if (tcp->init (&tcp->context, tcp_config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize TCP instance!\n");
+      client_free (&tcp);
+      return EXIT_FAILURE;
+    }
+
+  cipc_codec_config config = {
+    .inner = tcp,
+    .codec = CIPC_CODEC_LZ,
+  };
+
+  *client = cipc_create (CIPC_PROTOCOL_CODEC);
+  if (!(*client) || (*client)->init (&(*client)->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize codec client!\n");
+      client_free (client);
+      client_free (&tcp);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+// A batch of JSON records, alike enough to compress the way service payloads do.
+static size_t
+make_message (char *buffer, size_t size, int batch)
+{
+  size_t length = 0;
+
+  length += (size_t)snprintf (buffer + length, size - length, "[");
+
+  for (int i = 0; i < CLIENT_RECORDS_PER_MESSAGE && length < size; i++)
+    {
+      int id = batch * CLIENT_RECORDS_PER_MESSAGE + i;
+
+      length += (size_t)snprintf (buffer + length, size - length,
+                                  "%s{\"id\":%d,\"name\":\"sensor-%d\",\"status\":\"%s\","
+                                  "\"reading\":%d.%02d}",
+                                  i ? "," : "", id, id % 97, id % 5 ? "ok" : "degraded",
+                                  (id * 37) % 1000, id % 100);
+    }
+
+  if (length < size)
+    length += (size_t)snprintf (buffer + length, size - length, "]");
+
+  return length < size ? length : size - 1;
+}
+
+int
+main (void)
+{
+  cipc_tcp_config config = {
+    .host = CLIENT_HOST,
+    .port = CLIENT_PORT,
+    .mode = CIPC_TCP_MODE_CONNECT,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 3,
+    .backlog = 0,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+  };
+
+  cipc *client = NULL;
+  static char message[CLIENT_BUFFER_SIZE];
+  static char reply[CLIENT_BUFFER_SIZE];
+  int result = EXIT_FAILURE;
+
+  if (client_init (&client, &config) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  size_t payload_bytes = 0;
+  int echoed = 0;
+
+  for (; echoed < CLIENT_MESSAGES; echoed++)
+    {
+      size_t length = make_message (message, sizeof (message), echoed);
+      size_t offset = 0;
+
+      if (client->send (client->context, message, length) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to send message!\n");
+          break;
+        }
+
+      if (client->recv (client->context, reply, sizeof (reply), &offset) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to receive reply!\n");
+          break;
+        }
+
+      if (offset != length || memcmp (message, reply, length) != 0)
+        {
+          fprintf (stderr, "Reply %d differs from its message!\n", echoed);
+          break;
+        }
+
+      payload_bytes += length;
+    }
+
+  // The counters are those of the TCP connection, so they count compressed bytes.
+  cipc_stats stats;
+
+  if (echoed == CLIENT_MESSAGES && cipc_stats_get (client, &stats) == CIPC_OK)
+    {
+      fprintf (stdout, "[Codec Client] Echoed %d messages: %zu payload bytes, %llu on the wire\n",
+               echoed, payload_bytes, (unsigned long long)stats.bytes_sent);
+
+      result = EXIT_SUCCESS;
+    }
+
+  client_free (&client);
+
+  return result;
+}
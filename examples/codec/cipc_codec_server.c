@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "backend/cipc_codec.h"
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+
+#define SERVER_HOST "127.0.0.1"
+#define SERVER_PORT 5558
+#define SERVER_BACKLOG 1
+
+static void
+server_free (cipc **server)
+{
+  if (server && *server)
+    {
+      cipc_free (*server);
+
+      *server = NULL;
+    }
+}
+
+// Accepts over TCP, then compresses everything sent back through a codec wrapper.
+static int
+server_init (cipc **server, const cipc_tcp_config *tcp_config)
+{
+  cipc *tcp = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!tcp)
+    {
+      fprintf (stderr, "Failed to create TCP instance!\n");
+
+      return EXIT_FAILURE;
+    }
+
+  if (tcp->init (&tcp->context, tcp_config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize TCP instance!\n");
+
+      server_free (&tcp);
+
+      return EXIT_FAILURE;
+    }
+
+  cipc_codec_config config = {
+    .inner = tcp,
+    .codec = CIPC_CODEC_LZ,
+  };
+
+  *server = cipc_create (CIPC_PROTOCOL_CODEC);
+  if (!(*server) || (*server)->init (&(*server)->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize codec server!\n");
+
+      server_free (server);
+      server_free (&tcp);
+
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+// Echoes every message; each reply is compressed again on the way out.
+static int
+server_loop (cipc *server)
+{
+  fprintf (stdout, "[Codec Server] Listening on %s:%d\n", SERVER_HOST, SERVER_PORT);
+
+  while (1)
+    {
+      cipc_msg msg;
+
+      cipc_err err = server->recv_msg (server->context, &msg);
+      if (err == CIPC_BAD_TCP_RECV)
+        return EXIT_SUCCESS;
+
+      if (err != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to receive message!\n");
+
+          return EXIT_FAILURE;
+        }
+
+      err = server->send (server->context, msg.data, msg.length);
+
+      server->release_msg (server->context, &msg);
+
+      if (err != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to send message!\n");
+
+          return EXIT_FAILURE;
+        }
+    }
+}
+
+int
+main (void)
+{
+  cipc_tcp_config config = {
+    .host = SERVER_HOST,
+    .port = SERVER_PORT,
+    .mode = CIPC_TCP_MODE_BIND,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 0,
+    .sockopt_retries = 3,
+    .backlog = SERVER_BACKLOG,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+  };
+
+  cipc *server = NULL;
+
+  if (server_init (&server, &config) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  int result = server_loop (server);
+
+  server_free (&server);
+
+  return result;
+}
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "cipc.hpp"
+
+// Answers example_tcp_client from a coroutine on a reactor.
+
+#define SERVER_HOST "127.0.0.1"
+#define SERVER_PORT 5555
+#define SERVER_BACKLOG 1
+#define SERVER_REPLY "Hello from C++ server!"
+
+static cipcpp::task<>
+serve (cipcpp::connection &server, cipcpp::reactor &loop, int &result)
+{
+  while (true)
+    {
+      cipcpp::result<cipcpp::message> msg = co_await server.async_recv_msg (loop);
+      if (!msg)
+        {
+          fprintf (stderr, "Failed to receive message: %s\n", cipcpp::error_name (msg.error ()));
+
+          co_return;
+        }
+
+      fprintf (stdout, "[C++ Server] Received: %.*s\n", (int)msg->size (), msg->data ());
+
+      cipcpp::result<void> sent = server.send (SERVER_REPLY);
+      if (!sent)
+        {
+          fprintf (stderr, "Failed to send message: %s\n", cipcpp::error_name (sent.error ()));
+
+          co_return;
+        }
+
+      result = EXIT_SUCCESS;
+    }
+}
+
+int
+main (void)
+{
+  cipc_tcp_config config = {};
+  config.host = SERVER_HOST;
+  config.port = SERVER_PORT;
+  config.mode = CIPC_TCP_MODE_BIND;
+  config.sockopt_sndtimeo = 5000;
+  config.sockopt_rcvtimeo = 5000;
+  config.sockopt_retries = 3;
+  config.backlog = SERVER_BACKLOG;
+  config.framing = CIPC_TCP_FRAMING_LENGTH_PREFIX;
+
+  fprintf (stdout, "[C++ Server] Listening on %s:%d\n", SERVER_HOST, SERVER_PORT);
+
+  cipcpp::result<cipcpp::connection> server = cipcpp::connection::open (config);
+  if (!server)
+    {
+      fprintf (stderr, "Failed to initialize server: %s\n", cipcpp::error_name (server.error ()));
+
+      return EXIT_FAILURE;
+    }
+
+  cipcpp::reactor loop;
+
+  int result = EXIT_FAILURE;
+
+  loop.spawn (serve (*server, loop, result));
+
+  if (!loop.run ())
+    return EXIT_FAILURE;
+
+  return result;
+}
@@ -0,0 +1,191 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_inproc.h"
+#include "cipc.h"
+#include "cipc_buf.h"
+
+// Hands frames from the main thread to a worker stage over an in-process endpoint; the frames
+// travel as cipc_buf references, so their bytes are never copied.
+
+#define PIPELINE_NAME "frames"
+#define PIPELINE_FRAMES 100000
+#define PIPELINE_FRAME_SIZE 256
+
+typedef struct
+{
+  uint64_t received;
+  uint64_t checksum;
+  int failed;
+} worker_state;
+
+static void
+pipeline_free (cipc **instance)
+{
+  if (instance && *instance)
+    {
+      cipc_free (*instance);
+      *instance = NULL;
+    }
+}
+
+static int
+pipeline_init (cipc **instance, const cipc_inproc_config *config)
+{
+  *instance = cipc_create (CIPC_PROTOCOL_INPROC);
+  if (!(*instance))
+    {
+      fprintf (stderr, "Failed to create in-process instance!\n");
+      return EXIT_FAILURE;
+    }
+
+  if ((*instance)->init (&(*instance)->context, config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize endpoint '%s'!\n", config->name);
+      pipeline_free (instance);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+// Sums the frames, then reports the totals back as one message.
+static void *
+worker_run (void *arg)
+{
+  worker_state *state = (worker_state *)arg;
+
+  cipc_inproc_config config = {
+    .name = PIPELINE_NAME,
+    .mode = CIPC_INPROC_MODE_CONNECT,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 3,
+  };
+
+  cipc *worker = NULL;
+
+  if (pipeline_init (&worker, &config) != EXIT_SUCCESS)
+    {
+      state->failed = 1;
+      return NULL;
+    }
+
+  while (state->received < PIPELINE_FRAMES)
+    {
+      cipc_buf *frame = NULL;
+
+      if (cipc_buf_recv (worker, &frame) != CIPC_OK)
+        {
+          fprintf (stderr, "Worker failed to receive frame %lu!\n",
+                   (unsigned long)state->received);
+          state->failed = 1;
+          break;
+        }
+
+      for (size_t i = 0; i < frame->length; i++)
+        state->checksum += (unsigned char)frame->data[i];
+
+      state->received++;
+
+      cipc_buf_unref (frame);
+    }
+
+  if (!state->failed
+      && worker->send (worker->context, (const char *)state, sizeof (*state)) != CIPC_OK)
+    state->failed = 1;
+
+  pipeline_free (&worker);
+
+  return NULL;
+}
+
+static int
+pipeline_loop (cipc *source)
+{
+  uint64_t checksum = 0;
+
+  for (int i = 0; i < PIPELINE_FRAMES; i++)
+    {
+      cipc_buf *frame = cipc_buf_alloc (PIPELINE_FRAME_SIZE);
+      if (!frame)
+        {
+          fprintf (stderr, "Failed to allocate frame %d!\n", i);
+          return EXIT_FAILURE;
+        }
+
+      memset (frame->data, i & 0xff, PIPELINE_FRAME_SIZE);
+      frame->length = PIPELINE_FRAME_SIZE;
+      checksum += (uint64_t)(i & 0xff) * PIPELINE_FRAME_SIZE;
+
+      cipc_err err = cipc_buf_send (source, frame);
+
+      // The worker holds its own reference until it is done with the frame.
+      cipc_buf_unref (frame);
+
+      if (err != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to send frame %d!\n", i);
+          return EXIT_FAILURE;
+        }
+    }
+
+  worker_state totals = { 0 };
+  char reply[sizeof (totals) + 1];
+  size_t received = 0;
+
+  if (source->recv (source->context, reply, sizeof (reply), &received) != CIPC_OK
+      || received != sizeof (totals))
+    {
+      fprintf (stderr, "Failed to receive totals!\n");
+      return EXIT_FAILURE;
+    }
+
+  memcpy (&totals, reply, sizeof (totals));
+
+  fprintf (stdout, "[In-process Pipeline] Worker got %lu of %d frames, checksum %s\n",
+           (unsigned long)totals.received, PIPELINE_FRAMES,
+           totals.checksum == checksum ? "ok" : "mismatch");
+
+  return totals.checksum == checksum ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int
+main (void)
+{
+  cipc_inproc_config config = {
+    .name = PIPELINE_NAME,
+    .mode = CIPC_INPROC_MODE_BIND,
+    .capacity = 256,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+  };
+
+  cipc *source = NULL;
+
+  if (pipeline_init (&source, &config) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  worker_state state = { 0 };
+  pthread_t worker;
+
+  if (pthread_create (&worker, NULL, worker_run, &state) != 0)
+    {
+      fprintf (stderr, "Failed to start worker!\n");
+      pipeline_free (&source);
+      return EXIT_FAILURE;
+    }
+
+  int result = pipeline_loop (source);
+
+  pthread_join (worker, NULL);
+
+  if (state.failed)
+    result = EXIT_FAILURE;
+
+  pipeline_free (&source);
+
+  return result;
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_pool.h"
+
+#define CLIENT_HOST "127.0.0.1"
+#define CLIENT_PORT 5555
+#define CLIENT_BUFFER_SIZE 1024
+#define CLIENT_CONNECTIONS 4
+#define CLIENT_REQUESTS 16
+
+// One request and its reply on a leased connection. The outcome goes back with the lease so a
+// broken connection is retired instead of being handed out again.
+static cipc_err
+client_request (cipc_pool *pool, int id)
+{
+  cipc_pool_lease lease;
+  cipc_err result = cipc_pool_acquire (pool, &lease);
+  if (result != CIPC_OK)
+    return result;
+
+  cipc *client = lease.instance;
+  char message[64];
+  char buffer[CLIENT_BUFFER_SIZE] = { 0 };
+  size_t length = 0;
+
+  int written = snprintf (message, sizeof (message), "Hello from request %d", id);
+
+  result = client->send (client->context, message, (size_t)written);
+  if (result == CIPC_OK)
+    result = client->recv (client->context, buffer, sizeof (buffer) - 1, &length);
+
+  if (result == CIPC_OK)
+    fprintf (stdout, "[Pool Client] Request %d: %.*s\n", id, (int)length, buffer);
+
+  cipc_pool_release (pool, &lease, result);
+
+  return result;
+}
+
+int
+main (void)
+{
+  cipc_tcp_config config = {
+    .host = CLIENT_HOST,
+    .port = CLIENT_PORT,
+    .mode = CIPC_TCP_MODE_CONNECT,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 3,
+    .backlog = 0,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+  };
+
+  cipc_pool_endpoint endpoint = {
+    .protocol = CIPC_PROTOCOL_TCP,
+    .config = &config,
+  };
+
+  cipc_pool_config pool_config = {
+    .endpoints = &endpoint,
+    .endpoint_count = 1,
+    .connections_per_endpoint = CLIENT_CONNECTIONS,
+    .strategy = CIPC_POOL_LEAST_OUTSTANDING,
+  };
+
+  cipc_pool *pool = NULL;
+  if (cipc_pool_create (&pool, &pool_config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to create connection pool!\n");
+      return EXIT_FAILURE;
+    }
+
+  int failed = 0;
+  for (int i = 0; i < CLIENT_REQUESTS; i++)
+    {
+      if (client_request (pool, i) != CIPC_OK)
+        {
+          fprintf (stderr, "Request %d failed!\n", i);
+          failed++;
+        }
+    }
+
+  fprintf (stdout, "[Pool Client] %d of %d requests succeeded, %zu connections available\n",
+           CLIENT_REQUESTS - failed, CLIENT_REQUESTS, cipc_pool_available (pool));
+
+  cipc_pool_free (pool);
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_pubsub.h"
+
+#define PUBLISHER_HOST "127.0.0.1"
+#define PUBLISHER_PORT 5559
+#define PUBLISHER_BACKLOG 16
+#define PUBLISHER_TICKS 1000
+#define PUBLISHER_TICK_US 10000
+
+static const char *const symbols[] = { "AAPL", "MSFT", "GOOG" };
+
+// Publishes a quote per symbol every tick; subscribers that fall behind only get the latest.
+int
+main (void)
+{
+  cipc_tcp_config config = {
+    .host = PUBLISHER_HOST,
+    .port = PUBLISHER_PORT,
+    .mode = CIPC_TCP_MODE_SERVER,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 0,
+    .sockopt_retries = 3,
+    .backlog = PUBLISHER_BACKLOG,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+    .max_pending_bytes = 64 * 1024,
+    .overflow = CIPC_TCP_OVERFLOW_CONFLATE,
+  };
+
+  cipc *transport = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!transport || transport->init (&transport->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize TCP server!\n");
+      cipc_free (transport);
+      return EXIT_FAILURE;
+    }
+
+  cipc_pub *pub = NULL;
+  if (cipc_pub_create (&pub, transport) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to create publisher!\n");
+      cipc_free (transport);
+      return EXIT_FAILURE;
+    }
+
+  fprintf (stdout, "[Publisher] Listening on %s:%d\n", PUBLISHER_HOST, PUBLISHER_PORT);
+
+  int result = EXIT_SUCCESS;
+
+  for (int tick = 0; tick < PUBLISHER_TICKS; tick++)
+    {
+      for (size_t i = 0; i < sizeof (symbols) / sizeof (symbols[0]); i++)
+        {
+          char topic[32];
+          char quote[64];
+
+          snprintf (topic, sizeof (topic), "md.%s", symbols[i]);
+          int length = snprintf (quote, sizeof (quote), "%d %d.%02d", tick,
+                                 100 + (tick * 7 + (int)i * 13) % 50, tick % 100);
+
+          if (cipc_publish (pub, topic, quote, (size_t)length + 1) != CIPC_OK)
+            {
+              fprintf (stderr, "Failed to publish on %s!\n", topic);
+              result = EXIT_FAILURE;
+              break;
+            }
+        }
+
+      if (result != EXIT_SUCCESS)
+        break;
+
+      if (tick % 100 == 0)
+        fprintf (stdout, "[Publisher] Tick %d, %zu subscribers\n", tick,
+                 cipc_pub_subscribers (pub));
+
+      usleep (PUBLISHER_TICK_US);
+    }
+
+  cipc_pub_free (pub);
+  cipc_free (transport);
+
+  return result;
+}
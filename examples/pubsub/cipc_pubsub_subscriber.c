@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_pubsub.h"
+
+#define SUBSCRIBER_HOST "127.0.0.1"
+#define SUBSCRIBER_PORT 5559
+
+// Prints the quotes of every topic starting with the prefix given, md.AAPL by default.
+int
+main (int argc, char **argv)
+{
+  const char *prefix = argc > 1 ? argv[1] : "md.AAPL";
+
+  cipc_tcp_config config = {
+    .host = SUBSCRIBER_HOST,
+    .port = SUBSCRIBER_PORT,
+    .mode = CIPC_TCP_MODE_CONNECT,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 3,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+  };
+
+  cipc *transport = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!transport || transport->init (&transport->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to connect to publisher!\n");
+      cipc_free (transport);
+      return EXIT_FAILURE;
+    }
+
+  cipc_sub *sub = NULL;
+  if (cipc_sub_create (&sub, transport) != CIPC_OK || cipc_subscribe (sub, prefix) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to subscribe to %s!\n", prefix);
+      cipc_sub_free (sub);
+      cipc_free (transport);
+      return EXIT_FAILURE;
+    }
+
+  fprintf (stdout, "[Subscriber] Subscribed to %s\n", prefix);
+
+  cipc_pubsub_msg msg;
+
+  // Stops once the publisher goes quiet for longer than the receive timeout.
+  while (cipc_sub_recv (sub, &msg) == CIPC_OK)
+    {
+      fprintf (stdout, "[Subscriber] %.*s: %.*s\n", (int)msg.topic_length, msg.topic,
+               (int)msg.length, msg.data);
+
+      cipc_sub_release (sub, &msg);
+    }
+
+  cipc_sub_free (sub);
+  cipc_free (transport);
+
+  return EXIT_SUCCESS;
+}
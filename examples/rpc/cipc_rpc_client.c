@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_zmq.h"
+#include "cipc.h"
+#include "cipc_rpc.h"
+
+#define CLIENT_ADDRESS "tcp://localhost:5557"
+#define CLIENT_CALLS 16
+
+static void
+client_free (cipc **client)
+{
+  if (client && *client)
+    {
+      cipc_free (*client);
+      *client = NULL;
+    }
+}
+
+static int
+client_init (cipc **client, const cipc_zmq_config *config)
+{
+  *client = cipc_create (CIPC_PROTOCOL_ZMQ);
+  if (!(*client))
+    {
+      fprintf (stderr, "Failed to create client instance!\n");
+
+      return EXIT_FAILURE;
+    }
+
+  if ((*client)->init (&(*client)->context, config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize client!\n");
+
+      client_free (client);
+
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+// Issues every call before waiting for any response, then collects them as they complete.
+static int
+client_run (cipc_rpc_client *rpc)
+{
+  char request[64];
+
+  for (int i = 0; i < CLIENT_CALLS; i++)
+    {
+      int length = snprintf (request, sizeof (request), "job %d", i);
+
+      cipc_rpc_handle handle;
+      if (cipc_rpc_call (rpc, request, (size_t)length, &handle) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to send request %d!\n", i);
+
+          return EXIT_FAILURE;
+        }
+    }
+
+  while (cipc_rpc_in_flight (rpc) > 0)
+    {
+      cipc_rpc_handle handle;
+      cipc_rpc_response response;
+
+      if (cipc_rpc_wait_any (rpc, &handle, &response) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to receive response!\n");
+
+          return EXIT_FAILURE;
+        }
+
+      fprintf (stdout, "[RPC Client] Call %llu: %.*s\n", (unsigned long long)handle,
+               (int)response.length, response.data);
+
+      cipc_rpc_release (rpc, &response);
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int
+main (void)
+{
+  cipc_zmq_config *config = cipc_zmq_config_dealer (CLIENT_ADDRESS);
+  if (!config)
+    {
+      fprintf (stderr, "Failed to create client config!\n");
+
+      return EXIT_FAILURE;
+    }
+
+  cipc *client = NULL;
+  cipc_rpc_client *rpc = NULL;
+  int result = EXIT_FAILURE;
+
+  if (client_init (&client, config) == EXIT_SUCCESS)
+    {
+      if (cipc_rpc_client_create (&rpc, client, 0) != CIPC_OK)
+        fprintf (stderr, "Failed to create RPC client!\n");
+      else
+        result = client_run (rpc);
+    }
+
+  cipc_rpc_client_free (rpc);
+  client_free (&client);
+  free (config);
+
+  return result;
+}
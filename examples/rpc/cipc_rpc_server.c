@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_zmq.h"
+#include "cipc.h"
+#include "cipc_rpc.h"
+
+#define SERVER_ADDRESS "tcp://*:5557"
+#define SERVER_REPLY_SIZE 1024
+
+static void
+server_free (cipc **server)
+{
+  if (server && *server)
+    {
+      cipc_free (*server);
+
+      *server = NULL;
+    }
+}
+
+static int
+server_init (cipc **server, const cipc_zmq_config *config)
+{
+  *server = cipc_create (CIPC_PROTOCOL_ZMQ);
+  if (!(*server))
+    {
+      fprintf (stderr, "Failed to create server instance!\n");
+
+      return EXIT_FAILURE;
+    }
+
+  if ((*server)->init (&(*server)->context, config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize server!\n");
+
+      server_free (server);
+
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+static int
+server_loop (cipc_rpc_server *rpc)
+{
+  char reply[SERVER_REPLY_SIZE];
+
+  fprintf (stdout, "[RPC Server] Listening on %s\n", SERVER_ADDRESS);
+
+  while (1)
+    {
+      cipc_rpc_request request;
+
+      if (cipc_rpc_recv_request (rpc, &request) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to receive request!\n");
+
+          return EXIT_FAILURE;
+        }
+
+      int length = snprintf (reply, sizeof (reply), "Done: %.*s", (int)request.length,
+                             request.data);
+
+      cipc_rpc_release_request (rpc, &request);
+
+      if (cipc_rpc_respond (rpc, &request, reply, (size_t)length) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to send response!\n");
+
+          return EXIT_FAILURE;
+        }
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int
+main (void)
+{
+  cipc_zmq_config *config = cipc_zmq_config_router (SERVER_ADDRESS);
+  if (!config)
+    {
+      fprintf (stderr, "Failed to fetch server config!\n");
+
+      return EXIT_FAILURE;
+    }
+
+  cipc_zmq_config_set_rcvtimeo (config, -1);
+
+  cipc *server = NULL;
+  cipc_rpc_server *rpc = NULL;
+  int result = EXIT_FAILURE;
+
+  if (server_init (&server, config) == EXIT_SUCCESS)
+    {
+      if (cipc_rpc_server_create (&rpc, server) != CIPC_OK)
+        fprintf (stderr, "Failed to create RPC server!\n");
+      else
+        result = server_loop (rpc);
+    }
+
+  cipc_rpc_server_free (rpc);
+  server_free (&server);
+  free (config);
+
+  return result;
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_shm.h"
+#include "cipc.h"
+
+#define CLIENT_NAME "/cipc-shm-example"
+#define CLIENT_BUFFER_SIZE 1024
+#define CLIENT_MESSAGE "Hello from SHM Client!"
+
+static void
+client_free (cipc **client)
+{
+  if (client && *client)
+    {
+      cipc_free (*client);
+      *client = NULL;
+    }
+}
+
+static int
+client_init (cipc **client, const cipc_shm_config *config)
+{
+  *client = cipc_create (CIPC_PROTOCOL_SHM);
+  if (!(*client))
+    {
+      fprintf (stderr, "Failed to create client instance!\n");
+      return EXIT_FAILURE;
+    }
+
+  if ((*client)->init (&(*client)->context, config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize client!\n");
+      client_free (client);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int
+main (void)
+{
+  cipc_shm_config config = {
+    .name = CLIENT_NAME,
+    .mode = CIPC_SHM_MODE_CONNECT,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 3,
+  };
+
+  cipc *client = NULL;
+  char buffer[CLIENT_BUFFER_SIZE] = { 0 };
+  int result = EXIT_FAILURE;
+
+  size_t offset = 0;
+
+  if (client_init (&client, &config) == EXIT_SUCCESS)
+    {
+      if (client->send (client->context, CLIENT_MESSAGE, strlen (CLIENT_MESSAGE)) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to send message: %s\n", CLIENT_MESSAGE);
+        }
+      else if (client->recv (client->context, buffer, sizeof (buffer), &offset) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to receive response!\n");
+        }
+      else
+        {
+          fprintf (stdout, "[SHM Client] Received: %s\n", buffer);
+
+          result = EXIT_SUCCESS;
+        }
+    }
+
+  client_free (&client);
+
+  return result;
+}
@@ -51,6 +51,7 @@ main (void)
     .sockopt_rcvtimeo = 5000,
     .sockopt_retries = 3,
     .backlog = 0,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
   };
 
   cipc *client = NULL;
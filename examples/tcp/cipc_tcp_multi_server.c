@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+
+#define SERVER_HOST "127.0.0.1"
+#define SERVER_PORT 5555
+#define SERVER_BACKLOG 128
+#define SERVER_BUFFER_SIZE 1024
+#define SERVER_REPLY "Hello from TCP multi-client server!"
+
+static void
+server_free (cipc **server)
+{
+  if (server && *server)
+    {
+      cipc_free (*server);
+
+      *server = NULL;
+    }
+}
+
+static int
+server_init (cipc **server, const cipc_tcp_config *config)
+{
+  *server = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!(*server))
+    {
+      fprintf (stderr, "Failed to create server instance!\n");
+
+      return EXIT_FAILURE;
+    }
+
+  if ((*server)->init (&(*server)->context, config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize server!\n");
+
+      server_free (server);
+
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+static int
+server_loop (cipc *server)
+{
+  char buffer[SERVER_BUFFER_SIZE] = { 0 };
+
+  size_t offset = 0;
+
+  cipc_peer_id peer = 0;
+
+  fprintf (stdout, "[TCP Multi Server] Listening on %s:%d\n", SERVER_HOST, SERVER_PORT);
+
+  while (1)
+    {
+      memset (buffer, 0, sizeof (buffer));
+
+      if (server->recv_from (server->context, &peer, buffer, sizeof (buffer) - 1, &offset)
+          != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to receive message!\n");
+
+          return EXIT_FAILURE;
+        }
+
+      fprintf (stdout, "[TCP Multi Server] Received from %llu: %s\n", (unsigned long long)peer,
+               buffer);
+
+      // A failed reply only affects that peer; keep serving the others.
+      if (server->send_to (server->context, peer, SERVER_REPLY, strlen (SERVER_REPLY)) != CIPC_OK)
+        fprintf (stderr, "Failed to send message to %llu!\n", (unsigned long long)peer);
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int
+main (void)
+{
+  cipc_tcp_config config = { .host = SERVER_HOST,
+                             .port = SERVER_PORT,
+                             .mode = CIPC_TCP_MODE_SERVER,
+                             .backlog = SERVER_BACKLOG,
+                             .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX };
+
+  cipc *server = NULL;
+
+  int result = EXIT_FAILURE;
+
+  if (server_init (&server, &config) == EXIT_SUCCESS)
+    result = server_loop (server);
+
+  server_free (&server);
+
+  return result;
+}
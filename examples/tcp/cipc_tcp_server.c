@@ -85,7 +85,8 @@ main (void)
                              .sockopt_sndtimeo = 5000,
                              .sockopt_rcvtimeo = 5000,
                              .sockopt_retries = 3,
-                             .backlog = SERVER_BACKLOG };
+                             .backlog = SERVER_BACKLOG,
+                             .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX };
 
   cipc *server = NULL;
 
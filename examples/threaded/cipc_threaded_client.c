@@ -0,0 +1,157 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "backend/cipc_threaded.h"
+#include "cipc.h"
+
+#define CLIENT_HOST "127.0.0.1"
+#define CLIENT_PORT 5555
+#define CLIENT_BUFFER_SIZE 1024
+#define CLIENT_THREADS 4
+#define CLIENT_MESSAGES_PER_THREAD 8
+
+typedef struct
+{
+  cipc *client;
+  int id;
+  int failed;
+} producer;
+
+static void
+client_free (cipc **client)
+{
+  if (client && *client)
+    {
+      cipc_free (*client);
+      *client = NULL;
+    }
+}
+
+// Connects over TCP, then hands the connection to a threaded wrapper shared by all producers.
+static int
+client_init (cipc **client, const cipc_tcp_config *tcp_config)
+{
+  cipc *tcp = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!tcp)
+    {
+      fprintf (stderr, "Failed to create TCP instance!\n");
+      return EXIT_FAILURE;
+    }
+
+  if (tcp->init (&tcp->context, tcp_config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize TCP instance!\n");
+      client_free (&tcp);
+      return EXIT_FAILURE;
+    }
+
+  cipc_threaded_config config = {
+    .inner = tcp,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+  };
+
+  *client = cipc_create (CIPC_PROTOCOL_THREADED);
+  if (!(*client) || (*client)->init (&(*client)->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize threaded client!\n");
+      client_free (client);
+      client_free (&tcp);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+static void *
+producer_run (void *arg)
+{
+  producer *p = (producer *)arg;
+  char message[64];
+
+  for (int i = 0; i < CLIENT_MESSAGES_PER_THREAD; i++)
+    {
+      int length = snprintf (message, sizeof (message), "Hello from thread %d (#%d)", p->id, i);
+
+      if (p->client->send (p->client->context, message, (size_t)length) != CIPC_OK)
+        {
+          fprintf (stderr, "Thread %d failed to send message %d\n", p->id, i);
+          p->failed = 1;
+          break;
+        }
+    }
+
+  return NULL;
+}
+
+int
+main (void)
+{
+  cipc_tcp_config config = {
+    .host = CLIENT_HOST,
+    .port = CLIENT_PORT,
+    .mode = CIPC_TCP_MODE_CONNECT,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 3,
+    .backlog = 0,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+  };
+
+  cipc *client = NULL;
+  char buffer[CLIENT_BUFFER_SIZE] = { 0 };
+  int result = EXIT_FAILURE;
+
+  if (client_init (&client, &config) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  pthread_t threads[CLIENT_THREADS];
+  producer producers[CLIENT_THREADS];
+  int started = 0;
+
+  for (int i = 0; i < CLIENT_THREADS; i++)
+    {
+      producers[i] = (producer){ .client = client, .id = i };
+
+      if (pthread_create (&threads[i], NULL, producer_run, &producers[i]) != 0)
+        break;
+
+      started++;
+    }
+
+  // Every message gets one reply; they are read here while the producers are still sending.
+  int expected = 0;
+  for (int i = 0; i < started; i++)
+    expected += CLIENT_MESSAGES_PER_THREAD;
+
+  int received = 0;
+  size_t offset = 0;
+
+  for (; received < expected; received++)
+    {
+      if (client->recv (client->context, buffer, sizeof (buffer), &offset) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to receive response!\n");
+          break;
+        }
+    }
+
+  int failed = started < CLIENT_THREADS;
+  for (int i = 0; i < started; i++)
+    {
+      pthread_join (threads[i], NULL);
+      failed |= producers[i].failed;
+    }
+
+  fprintf (stdout, "[Threaded Client] Received %d of %d replies\n", received, expected);
+
+  if (!failed && received == expected)
+    result = EXIT_SUCCESS;
+
+  client_free (&client);
+
+  return result;
+}
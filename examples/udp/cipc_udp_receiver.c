@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "backend/cipc_udp.h"
+#include "cipc.h"
+#include "cipc_stats.h"
+
+// Joins the group of cipc_udp_sender.c and counts the samples received and lost until none
+// arrive for a second.
+
+#define RECEIVER_GROUP "239.255.0.1"
+#define RECEIVER_PORT 5560
+#define RECEIVER_BATCH_SIZE 64
+#define RECEIVER_IDLE_TIMEOUT 1000
+#define RECEIVER_SOCKET_RCVBUF (4 * 1024 * 1024)
+
+static void
+receiver_free (cipc **receiver)
+{
+  if (receiver && *receiver)
+    {
+      cipc_free (*receiver);
+      *receiver = NULL;
+    }
+}
+
+static int
+receiver_init (cipc **receiver, const cipc_udp_config *config)
+{
+  *receiver = cipc_create (CIPC_PROTOCOL_UDP);
+  if (!(*receiver))
+    {
+      fprintf (stderr, "Failed to create receiver instance!\n");
+      return EXIT_FAILURE;
+    }
+
+  if ((*receiver)->init (&(*receiver)->context, config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize receiver!\n");
+      receiver_free (receiver);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+static int
+receiver_loop (cipc *receiver)
+{
+  cipc_msg batch[RECEIVER_BATCH_SIZE];
+  size_t received = 0;
+
+  fprintf (stdout, "[UDP Receiver] Listening on %s:%d\n", RECEIVER_GROUP, RECEIVER_PORT);
+
+  while (1)
+    {
+      size_t count = 0;
+
+      if (receiver->recv_batch (receiver->context, batch, RECEIVER_BATCH_SIZE, &count)
+          != CIPC_OK)
+        break;
+
+      if (received == 0)
+        fprintf (stdout, "[UDP Receiver] First sample: %s\n", batch[0].data);
+
+      for (size_t i = 0; i < count; i++)
+        receiver->release_msg (receiver->context, &batch[i]);
+
+      received += count;
+    }
+
+  cipc_stats stats;
+
+  if (cipc_stats_get (receiver, &stats) != CIPC_OK)
+    return EXIT_FAILURE;
+
+  fprintf (stdout, "[UDP Receiver] Received %zu samples, %llu lost, in %llu reads\n", received,
+           (unsigned long long)stats.msgs_lost, (unsigned long long)stats.recv_syscalls);
+
+  return received > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int
+main (void)
+{
+  cipc_udp_config config = {
+    .host = RECEIVER_GROUP,
+    .port = RECEIVER_PORT,
+    .mode = CIPC_UDP_MODE_BIND,
+    .sockopt_rcvtimeo = RECEIVER_IDLE_TIMEOUT,
+    .socket_rcvbuf = RECEIVER_SOCKET_RCVBUF,
+    .sequence = 1,
+  };
+
+  cipc *receiver = NULL;
+
+  int result = EXIT_FAILURE;
+
+  if (receiver_init (&receiver, &config) == EXIT_SUCCESS)
+    result = receiver_loop (receiver);
+
+  receiver_free (&receiver);
+
+  return result;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_udp.h"
+#include "cipc.h"
+
+// Sends batches of telemetry samples to a multicast group; see cipc_udp_receiver.c.
+
+#define SENDER_GROUP "239.255.0.1"
+#define SENDER_PORT 5560
+#define SENDER_BATCHES 100
+#define SENDER_BATCH_SIZE 32
+#define SENDER_SAMPLE_SIZE 64
+
+static void
+sender_free (cipc **sender)
+{
+  if (sender && *sender)
+    {
+      cipc_free (*sender);
+      *sender = NULL;
+    }
+}
+
+static int
+sender_init (cipc **sender, const cipc_udp_config *config)
+{
+  *sender = cipc_create (CIPC_PROTOCOL_UDP);
+  if (!(*sender))
+    {
+      fprintf (stderr, "Failed to create sender instance!\n");
+      return EXIT_FAILURE;
+    }
+
+  if ((*sender)->init (&(*sender)->context, config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to initialize sender!\n");
+      sender_free (sender);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+static int
+sender_loop (cipc *sender)
+{
+  char samples[SENDER_BATCH_SIZE][SENDER_SAMPLE_SIZE];
+  cipc_iovec batch[SENDER_BATCH_SIZE];
+
+  for (int i = 0; i < SENDER_BATCHES; i++)
+    {
+      // Equal sizes let the batch leave as one segmented send.
+      for (int j = 0; j < SENDER_BATCH_SIZE; j++)
+        {
+          memset (samples[j], 0, SENDER_SAMPLE_SIZE);
+          snprintf (samples[j], SENDER_SAMPLE_SIZE, "sample %d.%d", i, j);
+
+          batch[j].base = samples[j];
+          batch[j].length = SENDER_SAMPLE_SIZE;
+        }
+
+      size_t sent = 0;
+
+      if (sender->send_batch (sender->context, batch, SENDER_BATCH_SIZE, &sent) != CIPC_OK)
+        {
+          fprintf (stderr, "Failed to send batch %d after %zu samples!\n", i, sent);
+          return EXIT_FAILURE;
+        }
+    }
+
+  fprintf (stdout, "[UDP Sender] Sent %d samples to %s:%d\n", SENDER_BATCHES * SENDER_BATCH_SIZE,
+           SENDER_GROUP, SENDER_PORT);
+
+  return EXIT_SUCCESS;
+}
+
+int
+main (void)
+{
+  cipc_udp_config config = {
+    .host = SENDER_GROUP,
+    .port = SENDER_PORT,
+    .mode = CIPC_UDP_MODE_CONNECT,
+    .sockopt_sndtimeo = 5000,
+    .sequence = 1,
+  };
+
+  cipc *sender = NULL;
+
+  int result = EXIT_FAILURE;
+
+  if (sender_init (&sender, &config) == EXIT_SUCCESS)
+    result = sender_loop (sender);
+
+  sender_free (&sender);
+
+  return result;
+}
@@ -0,0 +1,73 @@
+#ifndef CIPC_CODEC_H
+#define CIPC_CODEC_H
+
+#include <stdint.h>
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CIPC_CODEC_DEFAULT_THRESHOLD 512
+#define CIPC_CODEC_DEFAULT_MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+
+// Codec ids carried by every message; custom codecs take ids from CIPC_CODEC_FIRST_CUSTOM up to
+// CIPC_CODEC_MAX_ID.
+#define CIPC_CODEC_RAW 0
+#define CIPC_CODEC_LZ 1
+#define CIPC_CODEC_FIRST_CUSTOM 16
+#define CIPC_CODEC_MAX_ID 255
+
+// Header preceding every payload of a codec instance: the decoded length and the codec id that
+// produced the body (CIPC_CODEC_RAW when sent unchanged). Both fields are sent in network byte
+// order.
+typedef struct
+{
+  uint32_t length;
+  uint32_t codec;
+} cipc_codec_header;
+
+typedef struct
+{
+  uint32_t id;
+
+  // Encodes length bytes into at most capacity bytes and returns the encoded size, or 0 when
+  // they do not fit; the message is then sent unchanged.
+  size_t (*encode) (void *arg, const char *src, size_t length, char *dst, size_t capacity);
+
+  // Decodes src into exactly length bytes; anything else must fail with CIPC_BAD_CODEC.
+  cipc_err (*decode) (void *arg, const char *src, size_t src_length, char *dst, size_t length);
+
+  void *arg;
+} cipc_codec;
+
+// Makes a codec known to every instance of the process, for sending and receiving. The codec is
+// used in place and must outlive them; an id may only be registered once.
+cipc_err cipc_codec_register (const cipc_codec *codec);
+
+// Compresses payloads on an initialized instance. Each message carries a cipc_codec_header, so
+// both ends must use the wrapper; a receiver decodes any registered codec regardless of its own
+// codec, and compressed and unchanged messages mix freely.
+typedef struct
+{
+  // Taken over by the wrapper on success and freed with it.
+  cipc *inner;
+
+  // Codec for sends; CIPC_CODEC_RAW sends everything unchanged.
+  uint32_t codec;
+
+  // Payloads shorter than this are sent unchanged, as are those the codec cannot shrink.
+  size_t threshold;
+
+  // Largest decoded length accepted from a peer.
+  size_t max_message_size;
+} cipc_codec_config;
+
+cipc *cipc_create_codec (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_CODEC_H
@@ -0,0 +1,55 @@
+#ifndef CIPC_INPROC_H
+#define CIPC_INPROC_H
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CIPC_INPROC_DEFAULT_CAPACITY 1024
+
+// Connects two instances of one process through a pair of bounded lock-free queues of message
+// pointers, so a send costs one copy into a pooled cipc_buf (none with cipc_buf_send) and no
+// syscall unless the receiver is asleep. Like a socket pair, each instance has one sending and
+// one receiving thread at a time; the two ends usually live on different threads. Freeing either
+// end closes the connection: the other end receives what was queued, then fails. Freeing the
+// bound end also releases the name, while a bound end whose peer left accepts the next connect
+// and fails only until then.
+typedef enum
+{
+  // Registers the name; init returns at once and sends queue until the peer reads them.
+  CIPC_INPROC_MODE_BIND,
+  // Attaches to the instance bound to the name; one connection at a time per bound instance.
+  CIPC_INPROC_MODE_CONNECT
+} cipc_inproc_mode;
+
+typedef struct
+{
+  // Endpoint name, unique among bound instances of the process.
+  const char *name;
+
+  cipc_inproc_mode mode;
+
+  // Messages queued per direction before send waits; rounded up to a power of two. Set by the
+  // bound end.
+  size_t capacity;
+
+  // Longest wait for queue room and for a message; 0 waits forever.
+  int sockopt_sndtimeo;
+  int sockopt_rcvtimeo;
+  // Connect mode: lookups of a name not bound yet, with backoff between them.
+  int sockopt_retries;
+
+  // Receives spin for up to spin_us microseconds before sleeping, adapting to how far apart
+  // messages arrive (see cipc_tcp_config); 0 always sleeps.
+  int spin_us;
+} cipc_inproc_config;
+
+cipc *cipc_create_inproc (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_INPROC_H
@@ -0,0 +1,48 @@
+#ifndef CIPC_SHM_H
+#define CIPC_SHM_H
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CIPC_SHM_DEFAULT_CAPACITY (1024 * 1024)
+#define CIPC_SHM_DEFAULT_SPIN_COUNT 2000
+
+typedef enum
+{
+  CIPC_SHM_MODE_BIND,
+  CIPC_SHM_MODE_CONNECT
+} cipc_shm_mode;
+
+typedef struct
+{
+  // POSIX shared memory object name, e.g. "/cipc-service".
+  const char *name;
+
+  cipc_shm_mode mode;
+
+  // Bytes per direction; rounded up to a power of two. Messages may use up to half of it.
+  size_t capacity;
+
+  int sockopt_sndtimeo;
+  int sockopt_rcvtimeo;
+  int sockopt_retries;
+
+  // Polls of an empty (or full) ring before sleeping on the futex.
+  int spin_count;
+
+  // Bind mode: removes a segment of the same name before creating the ring, for one left behind
+  // by an owner that crashed. Without it, bind fails while the name exists, since a running
+  // owner's segment would be taken over.
+  int unlink_stale;
+} cipc_shm_config;
+
+cipc *cipc_create_shm (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_SHM_H
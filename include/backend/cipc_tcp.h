@@ -1,14 +1,64 @@
 #ifndef CIPC_TCP_H
 #define CIPC_TCP_H
 
+#include <stdint.h>
+
 #include "cipc.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CIPC_TCP_FRAME_HEADER_SIZE 8
+#define CIPC_TCP_DEFAULT_RCVBUF_SIZE (64 * 1024)
+#define CIPC_TCP_DEFAULT_MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+#define CIPC_TCP_DEFAULT_MAX_PENDING_BYTES (16 * 1024 * 1024)
+
+// send_file and recv_file work in bind and connect modes; in server mode they fail with
+// CIPC_BAD_TCP_SEND and CIPC_BAD_TCP_RECV.
 typedef enum
 {
   CIPC_TCP_MODE_BIND,
-  CIPC_TCP_MODE_CONNECT
+  CIPC_TCP_MODE_CONNECT,
+  // Keeps the listener open and serves many clients; always length-prefixed.
+  CIPC_TCP_MODE_SERVER
 } cipc_tcp_mode;
 
+typedef enum
+{
+  CIPC_TCP_ENGINE_EPOLL,
+  // Server mode only: multishot accept and receive into a registered ring of kernel-provided
+  // buffers. Replies are held back while more received requests are waiting and then
+  // submitted together. Needs Linux 6.0.
+  CIPC_TCP_ENGINE_IO_URING
+} cipc_tcp_engine;
+
+// Server mode: what a send_to does when it would take a connection's unsent bytes past
+// max_pending_bytes, so one slow reader never holds up the others.
+typedef enum
+{
+  // Fails with CIPC_BAD_TCP_SEND; the message is not queued for that connection.
+  CIPC_TCP_OVERFLOW_REJECT,
+  // Queued messages the connection has not started to receive are replaced by the new one.
+  CIPC_TCP_OVERFLOW_CONFLATE,
+  // Closes the connection and fails with CIPC_BAD_TCP_SEND.
+  CIPC_TCP_OVERFLOW_DISCONNECT
+} cipc_tcp_overflow;
+
+typedef enum
+{
+  CIPC_TCP_FRAMING_NONE,
+  CIPC_TCP_FRAMING_LENGTH_PREFIX
+} cipc_tcp_framing;
+
+// Wire header preceding every payload in CIPC_TCP_FRAMING_LENGTH_PREFIX mode.
+// Both fields are sent in network byte order.
+typedef struct
+{
+  uint32_t length;
+  uint32_t flags;
+} cipc_tcp_frame_header;
+
 typedef struct
 {
   const char *host;
@@ -22,8 +72,55 @@ typedef struct
   int sockopt_retries;
 
   int backlog;
+
+  cipc_tcp_framing framing;
+
+  size_t rcvbuf_size;
+  size_t max_message_size;
+
+  // Server mode: unsent reply bytes allowed per connection before the overflow policy applies.
+  size_t max_pending_bytes;
+  cipc_tcp_overflow overflow;
+
+  // Socket tunings; each one left 0 comes from the profile. Flags take 1 to set and -1 to
+  // clear, sizes -1 for the kernel default.
+  cipc_profile profile;
+  // TCP_NODELAY, set by every profile.
+  int nodelay;
+  // TCP_QUICKACK, set again after every read since the kernel clears it; not with io_uring.
+  int quickack;
+  // SO_BUSY_POLL in microseconds; skipped when the process may not raise it.
+  int busy_poll_us;
+  // SO_SNDBUF and SO_RCVBUF in bytes, capped by net.core.wmem_max and rmem_max; setting them
+  // turns off kernel autotuning.
+  int socket_sndbuf;
+  int socket_rcvbuf;
+  // TCP_CORK around a send_batch that takes more than one write; not in server mode, which
+  // coalesces queued sends already.
+  int cork;
+
+  // Receives spin on non-blocking reads for up to spin_us microseconds before blocking, less
+  // or not at all when recent messages came further apart (see cipc_spin.h); 0 always blocks.
+  // Meant for consumers with a core to themselves.
+  int spin_us;
+
+  // Server mode: how connections are multiplexed.
+  cipc_tcp_engine engine;
+
+  // Connect mode: init returns at once and the connection is made, and remade whenever it
+  // breaks, by a background thread with non-blocking connects and backoff. sockopt_retries < 0
+  // retries forever; once retries run out, calls fail with CIPC_BAD_TCP_CONNECT.
+  int connect_async;
+
+  // connect_async: bytes of sends queued until connected. Sends beyond it, or with 0, fail with
+  // CIPC_NOT_CONNECTED.
+  size_t max_queued_bytes;
 } cipc_tcp_config;
 
 cipc *cipc_create_tcp (void);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // CIPC_TCP_H
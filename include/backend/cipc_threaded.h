@@ -0,0 +1,41 @@
+#ifndef CIPC_THREADED_H
+#define CIPC_THREADED_H
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CIPC_THREADED_DEFAULT_MAX_QUEUED_BYTES (16 * 1024 * 1024)
+#define CIPC_THREADED_DEFAULT_MAX_INBOUND 1024
+
+// Makes an initialized instance safe to share between threads. Sends are copied into a
+// lock-free queue and return at once; a dedicated I/O thread drains it in batches and also
+// receives on the instance's behalf, so every call on the inner instance is made by that one
+// thread. Transport failures are reported by the next call in the same direction.
+//
+// Peer addressing (send_to/recv_from) is not available through the wrapper.
+typedef struct
+{
+  // Taken over by the wrapper on success and freed with it.
+  cipc *inner;
+
+  // Bytes queued and not yet sent at which send waits for room.
+  size_t max_queued_bytes;
+
+  // Received messages held for recv before the I/O thread stops reading.
+  size_t max_inbound;
+
+  // Longest wait for queue room and for a message; 0 waits forever.
+  int sockopt_sndtimeo;
+  int sockopt_rcvtimeo;
+} cipc_threaded_config;
+
+cipc *cipc_create_threaded (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_THREADED_H
@@ -0,0 +1,76 @@
+#ifndef CIPC_UDP_H
+#define CIPC_UDP_H
+
+#include <stdint.h>
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest UDP payload over IPv4.
+#define CIPC_UDP_MAX_DATAGRAM_SIZE 65507
+#define CIPC_UDP_DEFAULT_BATCH_SIZE 16
+#define CIPC_UDP_SEQUENCE_HEADER_SIZE 8
+
+// Datagrams are sent and received whole, or not at all: nothing is retransmitted or reordered.
+// A receive reads up to batch_size datagrams with one recvmmsg and hands them out one by one;
+// send_batch goes out with sendmmsg, runs of equal-sized messages as single UDP_SEGMENT sends.
+// Peers are IPv4 senders, their id built from address and port, so recv_from and send_to work
+// in both modes.
+typedef enum
+{
+  // Receives from any sender; send replies to the last one.
+  CIPC_UDP_MODE_BIND,
+  // Sends to host and receives only from it.
+  CIPC_UDP_MODE_CONNECT
+} cipc_udp_mode;
+
+typedef struct
+{
+  // Bind mode: the local address, NULL for any, or a multicast group to join. Connect mode: the
+  // destination, which may be a multicast group.
+  const char *host;
+
+  int port;
+
+  cipc_udp_mode mode;
+
+  // Multicast: address of the interface used for the group, NULL for the kernel's choice.
+  const char *interface;
+  // Multicast senders: hop limit (0 for 1), and whether receivers on this host get the
+  // datagrams (1 yes, -1 no, 0 the kernel default, yes).
+  int multicast_ttl;
+  int multicast_loop;
+
+  int sockopt_sndtimeo;
+  int sockopt_rcvtimeo;
+
+  // SO_SNDBUF and SO_RCVBUF in bytes; 0 keeps the kernel default. Receivers of bursts want a
+  // large rcvbuf, since the kernel drops what does not fit.
+  int socket_sndbuf;
+  int socket_rcvbuf;
+
+  // Largest payload; 0 for as much as a datagram holds.
+  size_t max_message_size;
+  // Datagrams read per recvmmsg.
+  size_t batch_size;
+
+  // Prefixes each datagram with a sequence number counted per sender and destination, so that
+  // receivers count the gaps as msgs_lost in cipc_stats. Both ends must set it.
+  int sequence;
+
+  // UDP_SEGMENT for send_batch and UDP_GRO for receives: 0 uses them where the kernel can,
+  // -1 never.
+  int gso;
+  int gro;
+} cipc_udp_config;
+
+cipc *cipc_create_udp (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_UDP_H
@@ -0,0 +1,58 @@
+#ifndef CIPC_UNIX_H
+#define CIPC_UNIX_H
+
+#include <stdint.h>
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CIPC_UNIX_DEFAULT_RCVBUF_SIZE (64 * 1024)
+#define CIPC_UNIX_DEFAULT_MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+#define CIPC_UNIX_DEFAULT_FD_THRESHOLD (256 * 1024)
+#define CIPC_UNIX_FD_PASSING_DISABLED SIZE_MAX
+
+typedef enum
+{
+  CIPC_UNIX_MODE_BIND,
+  CIPC_UNIX_MODE_CONNECT
+} cipc_unix_mode;
+
+typedef enum
+{
+  CIPC_UNIX_SOCKET_STREAM,
+  CIPC_UNIX_SOCKET_SEQPACKET
+} cipc_unix_socket_type;
+
+typedef struct
+{
+  // Filesystem path, or "@name" for the Linux abstract namespace. Bind replaces a socket left at
+  // the path, but fails when any other kind of file is there.
+  const char *path;
+
+  cipc_unix_mode mode;
+  cipc_unix_socket_type socket_type;
+
+  int sockopt_sndtimeo;
+  int sockopt_rcvtimeo;
+  int sockopt_retries;
+
+  int backlog;
+
+  size_t rcvbuf_size;
+  size_t max_message_size;
+
+  // Payloads of at least this many bytes are passed as a sealed memfd over SCM_RIGHTS
+  // instead of being copied through the socket.
+  size_t fd_threshold;
+} cipc_unix_config;
+
+cipc *cipc_create_unix (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_UNIX_H
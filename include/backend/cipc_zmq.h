@@ -22,6 +22,35 @@ typedef struct
   int sockopt_sndtimeo;
   int sockopt_rcvtimeo;
   int sockopt_retries;
+
+  // Context selection: an explicit zmq_context (owned by the caller) wins, then the
+  // process-wide shared context, otherwise every instance creates its own.
+  void *zmq_context;
+  int shared_context;
+
+  // Applied only to contexts created by cipc, before their I/O threads start; for the shared
+  // context, the instance that creates it decides. 0 keeps the libzmq default.
+  int io_threads;
+  const int *io_thread_cpus;
+  size_t io_thread_cpu_count;
+
+  // Messages queued per peer before a PUB/XPUB socket drops further ones for it (other sockets
+  // block); 0 keeps the libzmq default. conflate keeps only the latest message instead.
+  int sndhwm;
+  int rcvhwm;
+  int conflate;
+
+  // Kernel buffer sizes of the underlying sockets in bytes; 0 keeps the libzmq default.
+  int sndbuf;
+  int rcvbuf;
+
+  // Fills in the high-water marks (low latency) or buffer sizes (bulk) left 0. libzmq sets
+  // TCP_NODELAY itself.
+  cipc_profile profile;
+
+  // Receives spin for up to spin_us microseconds before blocking, adapting to how far apart
+  // messages arrive (see cipc_tcp_config); 0 always blocks.
+  int spin_us;
 } cipc_zmq_config;
 
 cipc *cipc_create_zmq (void);
@@ -30,10 +59,27 @@ cipc_zmq_config *cipc_zmq_config_default (const char *address, int socket_type,
 
 cipc_zmq_config *cipc_zmq_config_req (const char *address);
 cipc_zmq_config *cipc_zmq_config_rep (const char *address);
+// Unlike REQ/REP, DEALER/ROUTER allow many requests in flight (see cipc_rpc.h). A ROUTER
+// instance reports senders through recv_from and answers them with send_to.
+cipc_zmq_config *cipc_zmq_config_dealer (const char *address);
+cipc_zmq_config *cipc_zmq_config_router (const char *address);
+// XPUB/XSUB for cipc_pub and cipc_sub (cipc_pubsub.h): subscriptions travel as messages and
+// the publisher filters per subscriber.
+cipc_zmq_config *cipc_zmq_config_pub (const char *address);
+cipc_zmq_config *cipc_zmq_config_sub (const char *address);
 
 void cipc_zmq_config_set_sndtimeo(cipc_zmq_config *config, int sndtimeo);
 void cipc_zmq_config_set_rcvtimeo(cipc_zmq_config *config, int rcvtimeo);
 void cipc_zmq_config_set_retries(cipc_zmq_config *config, int retries);
+void cipc_zmq_config_set_context(cipc_zmq_config *config, void *zmq_context);
+void cipc_zmq_config_set_shared_context(cipc_zmq_config *config, int shared);
+void cipc_zmq_config_set_io_threads(cipc_zmq_config *config, int io_threads);
+void cipc_zmq_config_set_io_thread_cpus(cipc_zmq_config *config, const int *cpus, size_t count);
+void cipc_zmq_config_set_hwm(cipc_zmq_config *config, int sndhwm, int rcvhwm);
+void cipc_zmq_config_set_conflate(cipc_zmq_config *config, int conflate);
+void cipc_zmq_config_set_buffers(cipc_zmq_config *config, int sndbuf, int rcvbuf);
+void cipc_zmq_config_set_profile(cipc_zmq_config *config, cipc_profile profile);
+void cipc_zmq_config_set_spin(cipc_zmq_config *config, int spin_us);
 
 #ifdef __cplusplus
 }
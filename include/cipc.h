@@ -1,6 +1,7 @@
 #ifndef CIPC_H
 #define CIPC_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
 
@@ -27,13 +28,120 @@ typedef enum
   CIPC_BAD_TCP_RECV,
   CIPC_BAD_TCP_SOCKET_OPT,
   CIPC_NULL_PTR,
+  CIPC_BAD_FRAME,
+  CIPC_BAD_BUFFER_SIZE,
+  CIPC_BAD_SHM_OPEN,
+  CIPC_BAD_SHM_MAP,
+  CIPC_BAD_SHM_SEND,
+  CIPC_BAD_SHM_RECV,
+  CIPC_BAD_UNIX_SOCKET,
+  CIPC_BAD_UNIX_BIND,
+  CIPC_BAD_UNIX_LISTEN,
+  CIPC_BAD_UNIX_ADDRESS,
+  CIPC_BAD_UNIX_CONNECT,
+  CIPC_BAD_UNIX_SEND,
+  CIPC_BAD_UNIX_RECV,
+  CIPC_BAD_UNIX_SOCKET_OPT,
+  CIPC_BAD_TCP_EPOLL,
+  CIPC_BAD_PEER,
+  CIPC_WOULD_BLOCK,
+  CIPC_BAD_POLL,
+  CIPC_BAD_THREADED_START,
+  CIPC_BAD_THREADED_SEND,
+  CIPC_BAD_THREADED_RECV,
+  CIPC_BAD_RPC_HANDLE,
+  CIPC_BAD_POOL_EMPTY,
+  CIPC_NOT_CONNECTED,
+  CIPC_BAD_TCP_URING,
+  CIPC_BAD_CODEC,
+  CIPC_BAD_UDP_SOCKET,
+  CIPC_BAD_UDP_BIND,
+  CIPC_BAD_UDP_ADDRESS,
+  CIPC_BAD_UDP_CONNECT,
+  CIPC_BAD_UDP_SEND,
+  CIPC_BAD_UDP_RECV,
+  CIPC_BAD_UDP_SOCKET_OPT,
+  CIPC_BAD_INPROC_BIND,
+  CIPC_BAD_INPROC_CONNECT,
+  CIPC_BAD_INPROC_SEND,
+  CIPC_BAD_INPROC_RECV,
 } cipc_err;
 
+typedef struct
+{
+  const void *base;
+  size_t length;
+} cipc_iovec;
+
+// Borrowed view of a received message, valid until passed to release_msg.
+typedef struct
+{
+  const char *data;
+  size_t length;
+
+  void *handle;
+} cipc_msg;
+
+// Named sets of socket tunings for the TCP and ZMQ configs; any tuning a config sets itself
+// overrides its profile.
+typedef enum
+{
+  // Only TCP_NODELAY.
+  CIPC_PROFILE_DEFAULT = 0,
+  // Small request/response pairs: immediate ACKs, busy polling and small ZMQ queues.
+  CIPC_PROFILE_LOW_LATENCY,
+  // Streaming: large socket buffers, and batches coalesced into full segments.
+  CIPC_PROFILE_BULK
+} cipc_profile;
+
+// Identifies one connection of a multi-client server, or the address of a UDP sender; 0 is never
+// a valid id.
+typedef uint64_t cipc_peer_id;
+
+// Live per-instance counters, read through cipc_stats_get (cipc_stats.h).
+typedef struct cipc_counters cipc_counters;
+
+// Reference-counted message buffer (cipc_buf.h).
+typedef struct cipc_buf cipc_buf;
+
 typedef struct cipc
 {
   cipc_err (*init) (void **context, const void *config);
   cipc_err (*send) (void *context, const char *data, size_t length);
+  cipc_err (*sendv) (void *context, const cipc_iovec *iov, size_t iovcnt);
+  // recv and recv_from copy the next message into buffer and always NUL-terminate it, so it may
+  // hold at most length - 1 bytes; *len_out excludes the terminator. A message that does not fit
+  // fails with CIPC_BAD_BUFFER_SIZE, and where messages are framed it stays queued with its size
+  // in *len_out. A length of 0 fails with CIPC_BAD_BUFFER_SIZE.
   cipc_err (*recv) (void *context, char *buffer, size_t length, size_t *len_out);
+  cipc_err (*recv_msg) (void *context, cipc_msg *msg);
+  void (*release_msg) (void *context, cipc_msg *msg);
+  // Peer addressing; NULL for backends with a single peer.
+  cipc_err (*send_to) (void *context, cipc_peer_id peer, const char *data, size_t length);
+  cipc_err (*recv_from) (void *context, cipc_peer_id *peer, char *buffer, size_t length,
+                         size_t *len_out);
+  // send_batch sends count messages, *sent counting those fully handed to the transport.
+  // recv_batch waits for one message, then adds those available without blocking, up to count;
+  // each view is returned with release_msg.
+  cipc_err (*send_batch) (void *context, const cipc_iovec *msgs, size_t count, size_t *sent);
+  cipc_err (*recv_batch) (void *context, cipc_msg *msgs, size_t count, size_t *received);
+  // Sends length bytes of a file descriptor from offset without copying them through userspace;
+  // recv_file writes the next message to fd at its file position. A file goes out in frames a
+  // plain receive gets one by one, so both mix with other messages. recv_file writes each frame
+  // as it arrives: when it fails, fd may already hold the start of the message and *len_out counts
+  // the frames written whole; the rest is left unread mid-message, so do not receive from that
+  // instance again. NULL where unsupported.
+  cipc_err (*send_file) (void *context, int fd, int64_t offset, size_t length);
+  cipc_err (*recv_file) (void *context, int fd, size_t *len_out);
+  // Pass a cipc_buf by pointer instead of copying its bytes: send_buf takes over the caller's
+  // reference, also when it fails, and recv_buf hands one out. NULL where the transport copies
+  // anyway; cipc_buf_send and cipc_buf_recv use them when present.
+  cipc_err (*send_buf) (void *context, cipc_buf *buf);
+  cipc_err (*recv_buf) (void *context, cipc_buf **buf);
+  // Readiness for cipc_poll: *fd becomes readable when recv may make progress (-1 if the
+  // backend has none) and *ready is set when a message is already waiting.
+  cipc_err (*get_fd) (void *context, int *fd, int *ready);
+  cipc_counters *(*counters) (void *context);
   void (*free) (void *context);
 
   void *context;
@@ -43,13 +151,29 @@ typedef enum
 {
   CIPC_PROTOCOL_ZMQ,
   CIPC_PROTOCOL_TCP,
-  CIPC_PROTOCOL_GRPC
+  CIPC_PROTOCOL_GRPC,
+  CIPC_PROTOCOL_SHM,
+  CIPC_PROTOCOL_UNIX,
+  // Wraps an initialized instance for use from many threads (backend/cipc_threaded.h).
+  CIPC_PROTOCOL_THREADED,
+  // Compresses payloads of an initialized instance (backend/cipc_codec.h).
+  CIPC_PROTOCOL_CODEC,
+  // Unreliable datagrams, unicast or multicast (backend/cipc_udp.h).
+  CIPC_PROTOCOL_UDP,
+  // Between threads of one process, by named endpoint (backend/cipc_inproc.h).
+  CIPC_PROTOCOL_INPROC
 } cipc_protocol;
 
 cipc *cipc_create (cipc_protocol protocol);
 
 void cipc_free (cipc *instance);
 
+// Waits until at least one instance has a message to receive or timeout_ms elapses (-1 waits
+// forever). ready[i] is set to 1 for every instance that can be received from without blocking
+// and *nready to their count, which is 0 on timeout. With no instances it returns at once.
+cipc_err cipc_poll (cipc *const *instances, size_t count, int timeout_ms, int *ready,
+                    size_t *nready);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,1045 @@
+#ifndef CIPC_HPP
+#define CIPC_HPP
+
+// Header-only C++20 layer over cipc.h. A connection owns its instance and frees it; calls return
+// a result holding either the value or the cipc_err, in the manner of std::expected; payloads
+// are passed as spans and string views, and received views are released by their destructor.
+//
+// A reactor drives coroutines on one thread: co_await on async_recv or async_recv_msg suspends
+// until the instance's descriptor (get_fd) reports a message, so one thread can serve many
+// connections. Each connection may have one receive pending at a time.
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "backend/cipc_codec.h"
+#include "backend/cipc_inproc.h"
+#include "backend/cipc_shm.h"
+#include "backend/cipc_tcp.h"
+#include "backend/cipc_threaded.h"
+#include "backend/cipc_udp.h"
+#include "backend/cipc_unix.h"
+#include "backend/cipc_zmq.h"
+#include "cipc.h"
+#include "cipc_stats.h"
+
+namespace cipcpp
+{
+
+inline const char *
+error_name (cipc_err err) noexcept
+{
+  switch (err)
+    {
+    case CIPC_OK: return "CIPC_OK";
+    case CIPC_BAD_ALLOC: return "CIPC_BAD_ALLOC";
+    case CIPC_BAD_ZMQ_CONTEXT: return "CIPC_BAD_ZMQ_CONTEXT";
+    case CIPC_BAD_ZMQ_SOCKET: return "CIPC_BAD_ZMQ_SOCKET";
+    case CIPC_BAD_ZMQ_BIND: return "CIPC_BAD_ZMQ_BIND";
+    case CIPC_BAD_ZMQ_CONNECT: return "CIPC_BAD_ZMQ_CONNECT";
+    case CIPC_BAD_ZMQ_SEND: return "CIPC_BAD_ZMQ_SEND";
+    case CIPC_BAD_ZMQ_RECV: return "CIPC_BAD_ZMQ_RECV";
+    case CIPC_BAD_TCP_SOCKET: return "CIPC_BAD_TCP_SOCKET";
+    case CIPC_BAD_TCP_BIND: return "CIPC_BAD_TCP_BIND";
+    case CIPC_BAD_TCP_LISTEN: return "CIPC_BAD_TCP_LISTEN";
+    case CIPC_BAD_TCP_ADDRESS: return "CIPC_BAD_TCP_ADDRESS";
+    case CIPC_BAD_TCP_CONNECT: return "CIPC_BAD_TCP_CONNECT";
+    case CIPC_BAD_TCP_SEND: return "CIPC_BAD_TCP_SEND";
+    case CIPC_BAD_TCP_RECV: return "CIPC_BAD_TCP_RECV";
+    case CIPC_BAD_TCP_SOCKET_OPT: return "CIPC_BAD_TCP_SOCKET_OPT";
+    case CIPC_NULL_PTR: return "CIPC_NULL_PTR";
+    case CIPC_BAD_FRAME: return "CIPC_BAD_FRAME";
+    case CIPC_BAD_BUFFER_SIZE: return "CIPC_BAD_BUFFER_SIZE";
+    case CIPC_BAD_SHM_OPEN: return "CIPC_BAD_SHM_OPEN";
+    case CIPC_BAD_SHM_MAP: return "CIPC_BAD_SHM_MAP";
+    case CIPC_BAD_SHM_SEND: return "CIPC_BAD_SHM_SEND";
+    case CIPC_BAD_SHM_RECV: return "CIPC_BAD_SHM_RECV";
+    case CIPC_BAD_UNIX_SOCKET: return "CIPC_BAD_UNIX_SOCKET";
+    case CIPC_BAD_UNIX_BIND: return "CIPC_BAD_UNIX_BIND";
+    case CIPC_BAD_UNIX_LISTEN: return "CIPC_BAD_UNIX_LISTEN";
+    case CIPC_BAD_UNIX_ADDRESS: return "CIPC_BAD_UNIX_ADDRESS";
+    case CIPC_BAD_UNIX_CONNECT: return "CIPC_BAD_UNIX_CONNECT";
+    case CIPC_BAD_UNIX_SEND: return "CIPC_BAD_UNIX_SEND";
+    case CIPC_BAD_UNIX_RECV: return "CIPC_BAD_UNIX_RECV";
+    case CIPC_BAD_UNIX_SOCKET_OPT: return "CIPC_BAD_UNIX_SOCKET_OPT";
+    case CIPC_BAD_TCP_EPOLL: return "CIPC_BAD_TCP_EPOLL";
+    case CIPC_BAD_PEER: return "CIPC_BAD_PEER";
+    case CIPC_WOULD_BLOCK: return "CIPC_WOULD_BLOCK";
+    case CIPC_BAD_POLL: return "CIPC_BAD_POLL";
+    case CIPC_BAD_THREADED_START: return "CIPC_BAD_THREADED_START";
+    case CIPC_BAD_THREADED_SEND: return "CIPC_BAD_THREADED_SEND";
+    case CIPC_BAD_THREADED_RECV: return "CIPC_BAD_THREADED_RECV";
+    case CIPC_BAD_RPC_HANDLE: return "CIPC_BAD_RPC_HANDLE";
+    case CIPC_BAD_POOL_EMPTY: return "CIPC_BAD_POOL_EMPTY";
+    case CIPC_NOT_CONNECTED: return "CIPC_NOT_CONNECTED";
+    case CIPC_BAD_TCP_URING: return "CIPC_BAD_TCP_URING";
+    case CIPC_BAD_CODEC: return "CIPC_BAD_CODEC";
+    case CIPC_BAD_UDP_SOCKET: return "CIPC_BAD_UDP_SOCKET";
+    case CIPC_BAD_UDP_BIND: return "CIPC_BAD_UDP_BIND";
+    case CIPC_BAD_UDP_ADDRESS: return "CIPC_BAD_UDP_ADDRESS";
+    case CIPC_BAD_UDP_CONNECT: return "CIPC_BAD_UDP_CONNECT";
+    case CIPC_BAD_UDP_SEND: return "CIPC_BAD_UDP_SEND";
+    case CIPC_BAD_UDP_RECV: return "CIPC_BAD_UDP_RECV";
+    case CIPC_BAD_UDP_SOCKET_OPT: return "CIPC_BAD_UDP_SOCKET_OPT";
+    case CIPC_BAD_INPROC_BIND: return "CIPC_BAD_INPROC_BIND";
+    case CIPC_BAD_INPROC_CONNECT: return "CIPC_BAD_INPROC_CONNECT";
+    case CIPC_BAD_INPROC_SEND: return "CIPC_BAD_INPROC_SEND";
+    case CIPC_BAD_INPROC_RECV: return "CIPC_BAD_INPROC_RECV";
+    }
+
+  return "CIPC_UNKNOWN";
+}
+
+// Thrown by result::value on a result holding an error.
+class bad_result_access : public std::exception
+{
+public:
+  explicit bad_result_access (cipc_err err) noexcept : err_ (err) {}
+
+  cipc_err
+  error () const noexcept
+  {
+    return err_;
+  }
+
+  const char *
+  what () const noexcept override
+  {
+    return error_name (err_);
+  }
+
+private:
+  cipc_err err_;
+};
+
+// The error alternative of a result, as std::unexpected.
+struct unexpected
+{
+  cipc_err err;
+};
+
+template <class T> class [[nodiscard]] result
+{
+public:
+  result (T value) : value_ (std::move (value)), err_ (CIPC_OK) {}
+  result (unexpected failure) : err_ (failure.err) {}
+
+  bool
+  has_value () const noexcept
+  {
+    return value_.has_value ();
+  }
+
+  explicit
+  operator bool () const noexcept
+  {
+    return has_value ();
+  }
+
+  cipc_err
+  error () const noexcept
+  {
+    return err_;
+  }
+
+  T &
+  value () &
+  {
+    if (!value_)
+      throw bad_result_access (err_);
+
+    return *value_;
+  }
+
+  T &&
+  value () &&
+  {
+    if (!value_)
+      throw bad_result_access (err_);
+
+    return std::move (*value_);
+  }
+
+  template <class U>
+  T
+  value_or (U &&fallback) const &
+  {
+    return value_ ? *value_ : static_cast<T> (std::forward<U> (fallback));
+  }
+
+  T &
+  operator* () & noexcept
+  {
+    return *value_;
+  }
+
+  T &&
+  operator* () && noexcept
+  {
+    return std::move (*value_);
+  }
+
+  T *
+  operator->() noexcept
+  {
+    return &*value_;
+  }
+
+private:
+  std::optional<T> value_;
+  cipc_err err_;
+};
+
+template <> class [[nodiscard]] result<void>
+{
+public:
+  result () noexcept : err_ (CIPC_OK) {}
+  result (unexpected failure) noexcept : err_ (failure.err) {}
+
+  bool
+  has_value () const noexcept
+  {
+    return err_ == CIPC_OK;
+  }
+
+  explicit
+  operator bool () const noexcept
+  {
+    return has_value ();
+  }
+
+  cipc_err
+  error () const noexcept
+  {
+    return err_;
+  }
+
+  void
+  value () const
+  {
+    if (err_ != CIPC_OK)
+      throw bad_result_access (err_);
+  }
+
+private:
+  cipc_err err_;
+};
+
+inline result<void>
+check (cipc_err err) noexcept
+{
+  if (err != CIPC_OK)
+    return unexpected{ err };
+
+  return {};
+}
+
+inline cipc_iovec
+iovec (std::string_view data) noexcept
+{
+  return { data.data (), data.size () };
+}
+
+inline cipc_iovec
+iovec (std::span<const std::byte> data) noexcept
+{
+  return { data.data (), data.size () };
+}
+
+// The protocol of each backend's config type, for connection::open.
+template <class Config> struct protocol_of;
+
+template <> struct protocol_of<cipc_zmq_config>
+{
+  static constexpr cipc_protocol value = CIPC_PROTOCOL_ZMQ;
+};
+
+template <> struct protocol_of<cipc_tcp_config>
+{
+  static constexpr cipc_protocol value = CIPC_PROTOCOL_TCP;
+};
+
+template <> struct protocol_of<cipc_shm_config>
+{
+  static constexpr cipc_protocol value = CIPC_PROTOCOL_SHM;
+};
+
+template <> struct protocol_of<cipc_unix_config>
+{
+  static constexpr cipc_protocol value = CIPC_PROTOCOL_UNIX;
+};
+
+template <> struct protocol_of<cipc_threaded_config>
+{
+  static constexpr cipc_protocol value = CIPC_PROTOCOL_THREADED;
+};
+
+template <> struct protocol_of<cipc_codec_config>
+{
+  static constexpr cipc_protocol value = CIPC_PROTOCOL_CODEC;
+};
+
+template <> struct protocol_of<cipc_udp_config>
+{
+  static constexpr cipc_protocol value = CIPC_PROTOCOL_UDP;
+};
+
+template <> struct protocol_of<cipc_inproc_config>
+{
+  static constexpr cipc_protocol value = CIPC_PROTOCOL_INPROC;
+};
+
+// The ZMQ config helpers allocate; this frees their result.
+struct zmq_config_deleter
+{
+  void
+  operator() (cipc_zmq_config *config) const noexcept
+  {
+    std::free (config);
+  }
+};
+
+using zmq_config = std::unique_ptr<cipc_zmq_config, zmq_config_deleter>;
+
+// A received message borrowed from its connection, released on destruction. It must not
+// outlive the connection.
+class message
+{
+public:
+  message () noexcept = default;
+  message (cipc *instance, const cipc_msg &msg) noexcept : instance_ (instance), msg_ (msg) {}
+
+  message (message &&other) noexcept
+      : instance_ (std::exchange (other.instance_, nullptr)), msg_ (other.msg_)
+  {
+  }
+
+  message &
+  operator= (message &&other) noexcept
+  {
+    if (this != &other)
+      {
+        reset ();
+        instance_ = std::exchange (other.instance_, nullptr);
+        msg_ = other.msg_;
+      }
+
+    return *this;
+  }
+
+  message (const message &) = delete;
+  message &operator= (const message &) = delete;
+
+  ~message () { reset (); }
+
+  const char *
+  data () const noexcept
+  {
+    return msg_.data;
+  }
+
+  std::size_t
+  size () const noexcept
+  {
+    return msg_.length;
+  }
+
+  std::string_view
+  view () const noexcept
+  {
+    return { msg_.data, msg_.length };
+  }
+
+  std::span<const std::byte>
+  bytes () const noexcept
+  {
+    return { reinterpret_cast<const std::byte *> (msg_.data), msg_.length };
+  }
+
+  void
+  reset () noexcept
+  {
+    if (instance_)
+      instance_->release_msg (instance_->context, &msg_);
+
+    instance_ = nullptr;
+  }
+
+private:
+  cipc *instance_ = nullptr;
+  cipc_msg msg_{};
+};
+
+class reactor;
+
+template <class T> class recv_awaitable;
+
+// An initialized instance, freed with the connection.
+class connection
+{
+public:
+  connection () noexcept = default;
+  explicit connection (cipc *instance) noexcept : instance_ (instance) {}
+
+  connection (connection &&other) noexcept : instance_ (std::exchange (other.instance_, nullptr))
+  {
+  }
+
+  connection &
+  operator= (connection &&other) noexcept
+  {
+    if (this != &other)
+      {
+        cipc_free (instance_);
+        instance_ = std::exchange (other.instance_, nullptr);
+      }
+
+    return *this;
+  }
+
+  connection (const connection &) = delete;
+  connection &operator= (const connection &) = delete;
+
+  ~connection () { cipc_free (instance_); }
+
+  static result<connection>
+  open (cipc_protocol protocol, const void *config)
+  {
+    cipc *instance = cipc_create (protocol);
+    if (!instance)
+      return unexpected{ CIPC_BAD_ALLOC };
+
+    cipc_err err = instance->init (&instance->context, config);
+    if (err != CIPC_OK)
+      {
+        cipc_free (instance);
+
+        return unexpected{ err };
+      }
+
+    return connection (instance);
+  }
+
+  template <class Config>
+  static result<connection>
+  open (const Config &config)
+  {
+    return open (protocol_of<Config>::value, &config);
+  }
+
+  static result<connection>
+  open (const zmq_config &config)
+  {
+    if (!config)
+      return unexpected{ CIPC_BAD_ALLOC };
+
+    return open (*config);
+  }
+
+  // Opens a wrapper (threaded, codec) around inner, which it takes over on success.
+  template <class Config>
+  static result<connection>
+  wrap (connection &&inner, Config config)
+  {
+    config.inner = inner.get ();
+
+    result<connection> wrapped = open (config);
+    if (wrapped)
+      inner.release ();
+
+    return wrapped;
+  }
+
+  cipc *
+  get () const noexcept
+  {
+    return instance_;
+  }
+
+  cipc *
+  release () noexcept
+  {
+    return std::exchange (instance_, nullptr);
+  }
+
+  explicit
+  operator bool () const noexcept
+  {
+    return instance_ != nullptr;
+  }
+
+  result<void>
+  send (std::string_view data)
+  {
+    return check (instance_->send (instance_->context, data.data (), data.size ()));
+  }
+
+  result<void>
+  send (std::span<const std::byte> data)
+  {
+    return check (instance_->send (instance_->context,
+                                   reinterpret_cast<const char *> (data.data ()), data.size ()));
+  }
+
+  result<void>
+  sendv (std::span<const cipc_iovec> iov)
+  {
+    return check (instance_->sendv (instance_->context, iov.data (), iov.size ()));
+  }
+
+  // The number of messages sent; on a failure part of the batch may have gone out.
+  result<std::size_t>
+  send_batch (std::span<const cipc_iovec> msgs)
+  {
+    std::size_t sent = 0;
+
+    cipc_err err = instance_->send_batch (instance_->context, msgs.data (), msgs.size (), &sent);
+    if (err != CIPC_OK)
+      return unexpected{ err };
+
+    return sent;
+  }
+
+  // The received length; one byte of buffer is kept for the terminator, and
+  // CIPC_BAD_BUFFER_SIZE keeps the message for a larger buffer.
+  result<std::size_t>
+  recv (std::span<char> buffer)
+  {
+    std::size_t length = 0;
+
+    cipc_err err = instance_->recv (instance_->context, buffer.data (), buffer.size (), &length);
+    if (err != CIPC_OK)
+      return unexpected{ err };
+
+    return length;
+  }
+
+  result<std::size_t>
+  recv (std::span<std::byte> buffer)
+  {
+    return recv (std::span<char> (reinterpret_cast<char *> (buffer.data ()), buffer.size ()));
+  }
+
+  result<message>
+  recv_msg ()
+  {
+    cipc_msg msg;
+
+    cipc_err err = instance_->recv_msg (instance_->context, &msg);
+    if (err != CIPC_OK)
+      return unexpected{ err };
+
+    return message (instance_, msg);
+  }
+
+  result<void>
+  send_to (cipc_peer_id peer, std::string_view data)
+  {
+    if (!instance_->send_to)
+      return unexpected{ CIPC_BAD_PEER };
+
+    return check (instance_->send_to (instance_->context, peer, data.data (), data.size ()));
+  }
+
+  struct received_from
+  {
+    cipc_peer_id peer;
+    std::size_t length;
+  };
+
+  result<received_from>
+  recv_from (std::span<char> buffer)
+  {
+    if (!instance_->recv_from)
+      return unexpected{ CIPC_BAD_PEER };
+
+    received_from from{};
+
+    cipc_err err = instance_->recv_from (instance_->context, &from.peer, buffer.data (),
+                                         buffer.size (), &from.length);
+    if (err != CIPC_OK)
+      return unexpected{ err };
+
+    return from;
+  }
+
+  result<void>
+  send_file (int fd, std::int64_t offset, std::size_t length)
+  {
+    if (!instance_->send_file)
+      return unexpected{ CIPC_NULL_PTR };
+
+    return check (instance_->send_file (instance_->context, fd, offset, length));
+  }
+
+  result<std::size_t>
+  recv_file (int fd)
+  {
+    if (!instance_->recv_file)
+      return unexpected{ CIPC_NULL_PTR };
+
+    std::size_t length = 0;
+
+    cipc_err err = instance_->recv_file (instance_->context, fd, &length);
+    if (err != CIPC_OK)
+      return unexpected{ err };
+
+    return length;
+  }
+
+  result<cipc_stats>
+  stats () const
+  {
+    cipc_stats stats;
+
+    cipc_err err = cipc_stats_get (instance_, &stats);
+    if (err != CIPC_OK)
+      return unexpected{ err };
+
+    return stats;
+  }
+
+  // Suspends until a message is waiting, then receives it.
+  recv_awaitable<message> async_recv_msg (reactor &loop);
+  recv_awaitable<std::size_t> async_recv (reactor &loop, std::span<char> buffer);
+
+  // Sends complete in the call: a backend only blocks on a full kernel or queue buffer, for at
+  // most its send timeout.
+  std::suspend_never
+  async_send (std::string_view data, result<void> &out)
+  {
+    out = send (data);
+
+    return {};
+  }
+
+private:
+  cipc *instance_ = nullptr;
+};
+
+template <class T = void> class task;
+
+namespace detail
+{
+
+template <class Promise> struct final_awaiter
+{
+  bool
+  await_ready () const noexcept
+  {
+    return false;
+  }
+
+  std::coroutine_handle<>
+  await_suspend (std::coroutine_handle<Promise> handle) const noexcept
+  {
+    std::coroutine_handle<> continuation = handle.promise ().continuation;
+
+    return continuation ? continuation : std::noop_coroutine ();
+  }
+
+  void
+  await_resume () const noexcept
+  {
+  }
+};
+
+struct promise_base
+{
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+
+  std::suspend_always
+  initial_suspend () const noexcept
+  {
+    return {};
+  }
+
+  void
+  unhandled_exception () noexcept
+  {
+    exception = std::current_exception ();
+  }
+};
+
+// Runs a spawned task to completion and tells the reactor.
+struct detached
+{
+  struct promise_type
+  {
+    detached
+    get_return_object () const noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never
+    initial_suspend () const noexcept
+    {
+      return {};
+    }
+
+    std::suspend_never
+    final_suspend () const noexcept
+    {
+      return {};
+    }
+
+    void
+    return_void () const noexcept
+    {
+    }
+
+    void
+    unhandled_exception () const noexcept
+    {
+      std::terminate ();
+    }
+  };
+};
+
+} // namespace detail
+
+// A lazily started coroutine returning T; it runs when awaited, or when spawned on a reactor.
+template <class T> class [[nodiscard]] task
+{
+public:
+  struct promise_type : detail::promise_base
+  {
+    std::optional<T> value;
+
+    task
+    get_return_object () noexcept
+    {
+      return task (std::coroutine_handle<promise_type>::from_promise (*this));
+    }
+
+    detail::final_awaiter<promise_type>
+    final_suspend () const noexcept
+    {
+      return {};
+    }
+
+    template <class U>
+    void
+    return_value (U &&result)
+    {
+      value.emplace (std::forward<U> (result));
+    }
+  };
+
+  task (task &&other) noexcept : handle_ (std::exchange (other.handle_, nullptr)) {}
+  task (const task &) = delete;
+  task &operator= (const task &) = delete;
+
+  ~task ()
+  {
+    if (handle_)
+      handle_.destroy ();
+  }
+
+  bool
+  await_ready () const noexcept
+  {
+    return false;
+  }
+
+  std::coroutine_handle<>
+  await_suspend (std::coroutine_handle<> awaiting) noexcept
+  {
+    handle_.promise ().continuation = awaiting;
+
+    return handle_;
+  }
+
+  T
+  await_resume ()
+  {
+    if (handle_.promise ().exception)
+      std::rethrow_exception (handle_.promise ().exception);
+
+    return std::move (*handle_.promise ().value);
+  }
+
+private:
+  explicit task (std::coroutine_handle<promise_type> handle) noexcept : handle_ (handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+template <> class [[nodiscard]] task<void>
+{
+public:
+  struct promise_type : detail::promise_base
+  {
+    task
+    get_return_object () noexcept
+    {
+      return task (std::coroutine_handle<promise_type>::from_promise (*this));
+    }
+
+    detail::final_awaiter<promise_type>
+    final_suspend () const noexcept
+    {
+      return {};
+    }
+
+    void
+    return_void () const noexcept
+    {
+    }
+  };
+
+  task (task &&other) noexcept : handle_ (std::exchange (other.handle_, nullptr)) {}
+  task (const task &) = delete;
+  task &operator= (const task &) = delete;
+
+  ~task ()
+  {
+    if (handle_)
+      handle_.destroy ();
+  }
+
+  bool
+  await_ready () const noexcept
+  {
+    return false;
+  }
+
+  std::coroutine_handle<>
+  await_suspend (std::coroutine_handle<> awaiting) noexcept
+  {
+    handle_.promise ().continuation = awaiting;
+
+    return handle_;
+  }
+
+  void
+  await_resume ()
+  {
+    if (handle_.promise ().exception)
+      std::rethrow_exception (handle_.promise ().exception);
+  }
+
+private:
+  explicit task (std::coroutine_handle<promise_type> handle) noexcept : handle_ (handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Single-threaded event loop resuming coroutines whose connections have a message waiting.
+// Instances without a descriptor (shared memory) are checked every millisecond instead.
+class reactor
+{
+public:
+  // A suspended receive; lives in the awaiting coroutine's frame.
+  struct waiter
+  {
+    cipc *instance;
+    std::coroutine_handle<> handle;
+    int fd;
+  };
+
+  reactor () : epoll_fd_ (epoll_create1 (EPOLL_CLOEXEC)) {}
+
+  reactor (const reactor &) = delete;
+  reactor &operator= (const reactor &) = delete;
+
+  ~reactor ()
+  {
+    if (epoll_fd_ >= 0)
+      close (epoll_fd_);
+  }
+
+  // Starts t at once; run returns after it and every other spawned task have finished.
+  void
+  spawn (task<void> t)
+  {
+    tasks_++;
+    drive (std::move (t));
+  }
+
+  result<void>
+  run ()
+  {
+    if (epoll_fd_ < 0)
+      return unexpected{ CIPC_BAD_POLL };
+
+    while (tasks_ > 0)
+      {
+        while (!ready_.empty ())
+          {
+            std::coroutine_handle<> handle = ready_.front ();
+            ready_.pop_front ();
+            handle.resume ();
+          }
+
+        if (tasks_ == 0)
+          break;
+
+        // Every remaining task waits on something other than this reactor.
+        if (watched_ == 0 && polled_.empty ())
+          return unexpected{ CIPC_BAD_POLL };
+
+        epoll_event events[64];
+
+        int n = epoll_wait (epoll_fd_, events, 64, polled_.empty () ? -1 : 1);
+        if (n < 0 && errno != EINTR)
+          return unexpected{ CIPC_BAD_POLL };
+
+        for (int i = 0; i < n; i++)
+          {
+            waiter *w = static_cast<waiter *> (events[i].data.ptr);
+
+            watched_--;
+
+            if (is_ready (w->instance))
+              ready_.push_back (w->handle);
+            else if (!watch (*w))
+              ready_.push_back (w->handle);
+          }
+
+        for (std::size_t i = 0; i < polled_.size ();)
+          {
+            if (is_ready (polled_[i]->instance))
+              {
+                ready_.push_back (polled_[i]->handle);
+                polled_[i] = polled_.back ();
+                polled_.pop_back ();
+              }
+            else
+              i++;
+          }
+      }
+
+    return {};
+  }
+
+  // Whether a receive on instance would not block; failures count as ready so that the
+  // receive reports them.
+  static bool
+  is_ready (cipc *instance) noexcept
+  {
+    int fd = -1;
+    int ready = 0;
+
+    if (!instance->get_fd || instance->get_fd (instance->context, &fd, &ready) != CIPC_OK)
+      return true;
+
+    return ready != 0;
+  }
+
+  // Arms w until its instance's descriptor fires; false if it cannot be watched.
+  bool
+  watch (waiter &w)
+  {
+    int ready = 0;
+
+    if (!w.instance->get_fd || w.instance->get_fd (w.instance->context, &w.fd, &ready) != CIPC_OK)
+      return false;
+
+    if (w.fd < 0)
+      {
+        polled_.push_back (&w);
+        return true;
+      }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = &w;
+
+    if (epoll_ctl (epoll_fd_, EPOLL_CTL_MOD, w.fd, &ev) < 0
+        && (errno != ENOENT || epoll_ctl (epoll_fd_, EPOLL_CTL_ADD, w.fd, &ev) < 0))
+      return false;
+
+    watched_++;
+
+    return true;
+  }
+
+private:
+  detail::detached
+  drive (task<void> t)
+  {
+    // A task that throws ends the process, as an exception escaping a thread would.
+    co_await std::move (t);
+    tasks_--;
+  }
+
+  int epoll_fd_;
+  std::size_t tasks_ = 0;
+  std::size_t watched_ = 0;
+  std::deque<std::coroutine_handle<>> ready_;
+  std::vector<waiter *> polled_;
+};
+
+template <class T> class [[nodiscard]] recv_awaitable
+{
+public:
+  recv_awaitable (reactor &loop, connection &conn, std::span<char> buffer = {}) noexcept
+      : loop_ (loop), conn_ (conn), buffer_ (buffer)
+  {
+  }
+
+  bool
+  await_ready () const noexcept
+  {
+    return reactor::is_ready (conn_.get ());
+  }
+
+  bool
+  await_suspend (std::coroutine_handle<> handle)
+  {
+    waiter_.instance = conn_.get ();
+    waiter_.handle = handle;
+
+    // Not watchable: receive at once, blocking if need be.
+    return loop_.watch (waiter_);
+  }
+
+  result<T>
+  await_resume ()
+  {
+    if constexpr (std::is_same_v<T, message>)
+      return conn_.recv_msg ();
+    else
+      return conn_.recv (buffer_);
+  }
+
+private:
+  reactor &loop_;
+  connection &conn_;
+  std::span<char> buffer_;
+  reactor::waiter waiter_{};
+};
+
+inline recv_awaitable<message>
+connection::async_recv_msg (reactor &loop)
+{
+  return recv_awaitable<message> (loop, *this);
+}
+
+inline recv_awaitable<std::size_t>
+connection::async_recv (reactor &loop, std::span<char> buffer)
+{
+  return recv_awaitable<std::size_t> (loop, *this, buffer);
+}
+
+} // namespace cipcpp
+
+#endif // CIPC_HPP
@@ -0,0 +1,49 @@
+#ifndef CIPC_BUF_H
+#define CIPC_BUF_H
+
+#include <stdint.h>
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reference-counted message buffers drawn from size-classed pools with per-thread caches, so
+// steady traffic allocates nothing. A buffer may be passed to another thread, or sent again,
+// while references to it are held; it returns to the pool with the last cipc_buf_unref, on any
+// thread. Contents must not change while another holder may be reading them.
+
+typedef struct cipc_buf
+{
+  char *data;
+  size_t length;
+  size_t capacity;
+
+  // Internal.
+  uint32_t refs;
+} cipc_buf;
+
+// A buffer with room for at least capacity bytes, length 0 and one reference; NULL when out of
+// memory.
+cipc_buf *cipc_buf_alloc (size_t capacity);
+cipc_buf *cipc_buf_ref (cipc_buf *buf);
+void cipc_buf_unref (cipc_buf *buf);
+
+// Sends length bytes of data. The buffer is only read, so the caller keeps its reference; an
+// in-process receiver gets the buffer itself rather than a copy.
+cipc_err cipc_buf_send (cipc *instance, const cipc_buf *buf);
+cipc_err cipc_buf_send_to (cipc *instance, cipc_peer_id peer, const cipc_buf *buf);
+
+// Receives the next message into a buffer sized for it, without a caller-side size limit. The
+// caller owns the returned reference.
+cipc_err cipc_buf_recv (cipc *instance, cipc_buf **buf);
+
+// Returns buffers pooled across threads to the system.
+void cipc_buf_trim (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_BUF_H
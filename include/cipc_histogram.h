@@ -0,0 +1,41 @@
+#ifndef CIPC_HISTOGRAM_H
+#define CIPC_HISTOGRAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Log-linear (HDR-style) histogram of 64-bit values: every power of two is split into
+// 2^CIPC_HISTOGRAM_SUB_BITS equal buckets, so recorded values keep about 3% relative precision
+// over the whole range.
+#define CIPC_HISTOGRAM_SUB_BITS 5
+#define CIPC_HISTOGRAM_BUCKETS ((64 - CIPC_HISTOGRAM_SUB_BITS + 1) << CIPC_HISTOGRAM_SUB_BITS)
+
+typedef struct
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+
+  uint64_t buckets[CIPC_HISTOGRAM_BUCKETS];
+} cipc_histogram;
+
+void cipc_histogram_reset (cipc_histogram *histogram);
+void cipc_histogram_record (cipc_histogram *histogram, uint64_t value);
+void cipc_histogram_merge (cipc_histogram *dst, const cipc_histogram *src);
+
+// Upper bound of the bucket holding the value at percentile (0-100), clamped to [min, max].
+uint64_t cipc_histogram_percentile (const cipc_histogram *histogram, double percentile);
+double cipc_histogram_mean (const cipc_histogram *histogram);
+
+size_t cipc_histogram_bucket_index (uint64_t value);
+uint64_t cipc_histogram_bucket_upper (size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_HISTOGRAM_H
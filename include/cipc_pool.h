@@ -0,0 +1,90 @@
+#ifndef CIPC_POOL_H
+#define CIPC_POOL_H
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Client-side pool of warm connections to several endpoints. Every use of a connection is a
+// lease: acquire picks one by the configured strategy, release returns it together with the
+// outcome. Connections whose lease ended in a transport error are rebuilt in the background;
+// an endpoint that cannot be connected to is ejected from rotation and retried with backoff.
+//
+// The pool itself may be used from any thread. A leased instance follows the usual rules, so a
+// connection is leased to one holder at a time and acquire waits while all of them are taken.
+// With threaded set, connections are shared between concurrent leases instead.
+
+#define CIPC_POOL_DEFAULT_CONNECTIONS 1
+#define CIPC_POOL_DEFAULT_RETRY_INTERVAL_MS 100
+#define CIPC_POOL_DEFAULT_MAX_RETRY_INTERVAL_MS 5000
+
+typedef enum
+{
+  CIPC_POOL_ROUND_ROBIN,
+  // The connection with the fewest active leases.
+  CIPC_POOL_LEAST_OUTSTANDING,
+  // The less loaded of two connections picked at random.
+  CIPC_POOL_POWER_OF_TWO
+} cipc_pool_strategy;
+
+typedef struct
+{
+  cipc_protocol protocol;
+
+  // Backend configuration in connect mode, e.g. a cipc_tcp_config; reused for every reconnect,
+  // so it must outlive the pool.
+  const void *config;
+} cipc_pool_endpoint;
+
+typedef struct
+{
+  const cipc_pool_endpoint *endpoints;
+  size_t endpoint_count;
+
+  size_t connections_per_endpoint;
+  cipc_pool_strategy strategy;
+
+  // Backoff between connection attempts to an ejected endpoint, doubling up to the maximum.
+  int retry_interval_ms;
+  int max_retry_interval_ms;
+
+  // Wraps every connection in CIPC_PROTOCOL_THREADED with default settings, so that several
+  // leases may share one.
+  int threaded;
+} cipc_pool_config;
+
+typedef struct cipc_pool cipc_pool;
+
+typedef struct
+{
+  cipc *instance;
+
+  // Internal: the pooled connection behind instance.
+  void *connection;
+} cipc_pool_lease;
+
+// Connects to every endpoint before returning; endpoints that are down are only ejected, so
+// creation succeeds as long as the configuration is valid.
+cipc_err cipc_pool_create (cipc_pool **pool, const cipc_pool_config *config);
+void cipc_pool_free (cipc_pool *pool);
+
+// Fails with CIPC_BAD_POOL_EMPTY while no endpoint is reachable. Without threaded, a thread that
+// already holds every connection waits on itself.
+cipc_err cipc_pool_acquire (cipc_pool *pool, cipc_pool_lease *lease);
+// result is the outcome of the last call made on the lease; transport errors retire the
+// connection.
+void cipc_pool_release (cipc_pool *pool, cipc_pool_lease *lease, cipc_err result);
+
+// One send on a connection picked by the strategy.
+cipc_err cipc_pool_send (cipc_pool *pool, const char *data, size_t length);
+
+// Connections currently in rotation.
+size_t cipc_pool_available (cipc_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_POOL_H
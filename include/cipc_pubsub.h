@@ -0,0 +1,76 @@
+#ifndef CIPC_PUBSUB_H
+#define CIPC_PUBSUB_H
+
+#include <stdint.h>
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Topic-based publish/subscribe over any instance. A message is its topic, a NUL byte, then the
+// payload; subscribers send 0x01 (subscribe) or 0x00 (unsubscribe) followed by a topic prefix,
+// the ZMQ XPUB/XSUB format. A subscription matches every topic it is a prefix of, and the empty
+// prefix matches all.
+//
+// A publisher on an instance with peers (TCP server mode) matches each message against every
+// subscriber's prefixes and writes it once into a buffer shared by all their sends; a
+// subscriber the TCP server cannot keep up with is handled by its overflow policy without
+// delaying the others. On a ZMQ XPUB instance (cipc_zmq_config_pub) libzmq does the fan-out,
+// with the high-water marks of the ZMQ config. Subscribers need an instance with a single
+// peer: TCP in connect mode or ZMQ XSUB (cipc_zmq_config_sub). Subscriptions over TCP do not
+// survive a reconnect; ZMQ replays them.
+//
+// The instance is borrowed and must outlive the publisher or subscriber; neither is
+// thread-safe.
+
+#define CIPC_PUBSUB_MAX_TOPIC 1024
+
+typedef struct cipc_pub cipc_pub;
+typedef struct cipc_sub cipc_sub;
+
+typedef struct
+{
+  const char *topic;
+  size_t topic_length;
+
+  const char *data;
+  size_t length;
+
+  // Storage behind topic and data, returned with cipc_sub_release.
+  cipc_msg view;
+} cipc_pubsub_msg;
+
+cipc_err cipc_pub_create (cipc_pub **pub, cipc *transport);
+void cipc_pub_free (cipc_pub *pub);
+
+// Applies the subscription changes received so far, without waiting; cipc_publish does so
+// first too.
+cipc_err cipc_pub_update (cipc_pub *pub);
+
+// Sends to every subscriber with a matching prefix. Subscribers that are gone are forgotten and
+// those over their high-water mark miss the message; neither fails the call.
+cipc_err cipc_publish (cipc_pub *pub, const char *topic, const char *data, size_t length);
+
+// Distinct subscribers with at least one subscription; behind a ZMQ XPUB instance they all count
+// as one.
+size_t cipc_pub_subscribers (cipc_pub *pub);
+
+cipc_err cipc_sub_create (cipc_sub **sub, cipc *transport);
+void cipc_sub_free (cipc_sub *sub);
+
+// Subscriptions are counted: a prefix subscribed twice needs two unsubscribes.
+cipc_err cipc_subscribe (cipc_sub *sub, const char *prefix);
+cipc_err cipc_unsubscribe (cipc_sub *sub, const char *prefix);
+
+// Waits for the next message matching a subscription; messages still in flight from a prefix
+// just unsubscribed are skipped. A message must be released before the next receive.
+cipc_err cipc_sub_recv (cipc_sub *sub, cipc_pubsub_msg *msg);
+void cipc_sub_release (cipc_sub *sub, cipc_pubsub_msg *msg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_PUBSUB_H
@@ -0,0 +1,89 @@
+#ifndef CIPC_RPC_H
+#define CIPC_RPC_H
+
+#include <stdint.h>
+
+#include "cipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pipelined request/response over any instance. Every message starts with a header carrying a
+// correlation id, so many requests can be in flight on one connection and their responses may
+// arrive in any order.
+//
+// Clients need an instance with a single peer: TCP or Unix in connect mode, shared memory or a
+// ZMQ DEALER. Servers answer through recv_from/send_to when the instance has peers (TCP server
+// mode, ZMQ ROUTER) and through recv/send otherwise. The instance is borrowed and must outlive
+// the client or server; neither is thread-safe.
+
+#define CIPC_RPC_HEADER_SIZE 16
+#define CIPC_RPC_DEFAULT_MAX_IN_FLIGHT 1024
+
+typedef uint64_t cipc_rpc_handle;
+
+typedef struct cipc_rpc_client cipc_rpc_client;
+typedef struct cipc_rpc_server cipc_rpc_server;
+
+typedef struct
+{
+  const char *data;
+  size_t length;
+
+  // Storage behind data, returned with cipc_rpc_release.
+  cipc_msg view;
+  void *copy;
+} cipc_rpc_response;
+
+typedef struct
+{
+  cipc_peer_id peer;
+  uint64_t id;
+
+  const char *data;
+  size_t length;
+
+  // Storage behind data, returned with cipc_rpc_release_request.
+  cipc_msg view;
+  void *copy;
+} cipc_rpc_request;
+
+// max_in_flight is rounded up to a power of two; 0 selects the default.
+cipc_err cipc_rpc_client_create (cipc_rpc_client **client, cipc *transport, size_t max_in_flight);
+void cipc_rpc_client_free (cipc_rpc_client *client);
+
+// Sends a request without waiting for its response. Fails with CIPC_WOULD_BLOCK while
+// max_in_flight calls are outstanding.
+cipc_err cipc_rpc_call (cipc_rpc_client *client, const char *data, size_t length,
+                        cipc_rpc_handle *handle);
+cipc_err cipc_rpc_callv (cipc_rpc_client *client, const cipc_iovec *iov, size_t iovcnt,
+                         cipc_rpc_handle *handle);
+
+// Receives until the response to handle arrives; responses to other calls found on the way are
+// kept for their own wait. wait_any returns the first response to any outstanding call. A
+// response must be released before the next wait on the same client.
+cipc_err cipc_rpc_wait (cipc_rpc_client *client, cipc_rpc_handle handle,
+                        cipc_rpc_response *response);
+cipc_err cipc_rpc_wait_any (cipc_rpc_client *client, cipc_rpc_handle *handle,
+                            cipc_rpc_response *response);
+void cipc_rpc_release (cipc_rpc_client *client, cipc_rpc_response *response);
+
+// Forgets a call; its response is dropped if it still arrives.
+void cipc_rpc_cancel (cipc_rpc_client *client, cipc_rpc_handle handle);
+size_t cipc_rpc_in_flight (const cipc_rpc_client *client);
+
+cipc_err cipc_rpc_server_create (cipc_rpc_server **server, cipc *transport);
+void cipc_rpc_server_free (cipc_rpc_server *server);
+
+// Requests may be answered in any order, also after they were released.
+cipc_err cipc_rpc_recv_request (cipc_rpc_server *server, cipc_rpc_request *request);
+cipc_err cipc_rpc_respond (cipc_rpc_server *server, const cipc_rpc_request *request,
+                           const char *data, size_t length);
+void cipc_rpc_release_request (cipc_rpc_server *server, cipc_rpc_request *request);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_RPC_H
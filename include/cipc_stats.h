@@ -0,0 +1,52 @@
+#ifndef CIPC_STATS_H
+#define CIPC_STATS_H
+
+#include <stdint.h>
+
+#include "cipc.h"
+#include "cipc_histogram.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Snapshot of an instance's counters. Errors count failed calls, including those that timed out.
+typedef struct
+{
+  uint64_t msgs_sent;
+  uint64_t bytes_sent;
+  uint64_t send_syscalls;
+  // Writes the kernel took only part of, forcing another syscall.
+  uint64_t short_writes;
+  uint64_t send_timeouts;
+  uint64_t send_errors;
+
+  uint64_t msgs_received;
+  uint64_t bytes_received;
+  uint64_t recv_syscalls;
+  // Reads that ended before the message they were reading was complete.
+  uint64_t short_reads;
+  uint64_t recv_timeouts;
+  uint64_t recv_errors;
+
+  // Connection attempts beyond the first.
+  uint64_t reconnects;
+
+  // Messages a gap in the sender's sequence numbers showed missing (UDP with sequence numbers).
+  uint64_t msgs_lost;
+
+  // Time spent in send and receive calls, in nanoseconds; empty unless latency is enabled.
+  int latency_enabled;
+  cipc_histogram send_latency;
+  cipc_histogram recv_latency;
+} cipc_stats;
+
+// Both calls may run on any thread while the instance is in use.
+cipc_err cipc_stats_get (const cipc *instance, cipc_stats *out);
+cipc_err cipc_stats_enable_latency (cipc *instance, int enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CIPC_STATS_H
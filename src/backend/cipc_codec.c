@@ -0,0 +1,753 @@
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend/cipc_codec.h"
+#include "cipc.h"
+#include "cipc_alloc.h"
+#include "cipc_lz.h"
+
+#define CIPC_CODEC_HEADER_SIZE sizeof (cipc_codec_header)
+#define CIPC_CODEC_SENDV_STACK_IOV 16
+// Messages encoded together for one send_batch call of the inner instance.
+#define CIPC_CODEC_BATCH 64
+
+// A message as handed out: a view into one of the inner instance, or a payload decoded here.
+typedef struct
+{
+  cipc_msg inner;
+  int borrowed;
+  char data[];
+} cipc_codec_rx;
+
+typedef struct
+{
+  cipc *inner;
+
+  const cipc_codec *codec;
+  size_t threshold;
+  size_t max_message_size;
+
+  // Gathered sendv input and encoded output, grown on demand.
+  char *flat;
+  size_t flat_cap;
+  char *out;
+  size_t out_cap;
+
+  // A message that did not fit the caller's buffer, served first by the next receive.
+  cipc_msg held;
+  cipc_peer_id held_peer;
+} cipc_codec_private;
+
+static size_t
+lz_encode (void *arg, const char *src, size_t length, char *dst, size_t capacity)
+{
+  (void)arg;
+
+  return cipc_lz_compress (src, length, dst, capacity);
+}
+
+static cipc_err
+lz_decode (void *arg, const char *src, size_t src_length, char *dst, size_t length)
+{
+  (void)arg;
+
+  return cipc_lz_decompress (src, src_length, dst, length);
+}
+
+static const cipc_codec lz_codec = {
+  .id = CIPC_CODEC_LZ,
+  .encode = lz_encode,
+  .decode = lz_decode,
+};
+
+static const cipc_codec *registry[CIPC_CODEC_MAX_ID + 1] = {
+  [CIPC_CODEC_LZ] = &lz_codec,
+};
+
+cipc_err
+cipc_codec_register (const cipc_codec *codec)
+{
+  if (!codec || !codec->encode || !codec->decode)
+    return CIPC_NULL_PTR;
+
+  if (codec->id < CIPC_CODEC_FIRST_CUSTOM || codec->id > CIPC_CODEC_MAX_ID)
+    return CIPC_BAD_CODEC;
+
+  const cipc_codec *expected = NULL;
+
+  if (!__atomic_compare_exchange_n (&registry[codec->id], &expected, codec, 0, __ATOMIC_RELEASE,
+                                    __ATOMIC_RELAXED))
+    return CIPC_BAD_CODEC;
+
+  return CIPC_OK;
+}
+
+static const cipc_codec *
+lookup (uint32_t id)
+{
+  if (id > CIPC_CODEC_MAX_ID)
+    return NULL;
+
+  return __atomic_load_n (&registry[id], __ATOMIC_ACQUIRE);
+}
+
+static cipc_err
+reserve (char **buffer, size_t *capacity, size_t size)
+{
+  if (*capacity >= size)
+    return CIPC_OK;
+
+  // The contents are never kept across calls.
+  char *grown = malloc (size);
+  if (!grown)
+    return CIPC_BAD_ALLOC;
+
+  free (*buffer);
+  *buffer = grown;
+  *capacity = size;
+
+  return CIPC_OK;
+}
+
+static void
+write_header (char *dst, size_t length, uint32_t codec)
+{
+  uint32_t header[2] = { htonl ((uint32_t)length), htonl (codec) };
+
+  memcpy (dst, header, sizeof (header));
+}
+
+// Encodes src behind a header at dst, which has room for the header and length bytes. Returns
+// the size of both, or 0 when the message is to be sent unchanged.
+static size_t
+encode_into (const cipc_codec_private *cctx, const char *src, size_t length, char *dst)
+{
+  if (!cctx->codec || length < cctx->threshold)
+    return 0;
+
+  // Only a body smaller than the payload is worth decoding.
+  size_t body = cctx->codec->encode (cctx->codec->arg, src, length, dst + CIPC_CODEC_HEADER_SIZE,
+                                     length - 1);
+  if (body == 0 || body >= length)
+    return 0;
+
+  write_header (dst, length, cctx->codec->id);
+
+  return CIPC_CODEC_HEADER_SIZE + body;
+}
+
+static size_t
+encode_or_copy (const cipc_codec_private *cctx, const char *src, size_t length, char *dst)
+{
+  size_t size = encode_into (cctx, src, length, dst);
+  if (size > 0)
+    return size;
+
+  write_header (dst, length, CIPC_CODEC_RAW);
+  memcpy (dst + CIPC_CODEC_HEADER_SIZE, src, length);
+
+  return CIPC_CODEC_HEADER_SIZE + length;
+}
+
+static cipc_err
+cipc_codec_sendv (void *context, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+  cipc *inner = cctx->inner;
+
+  size_t total = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    total += iov[i].length;
+
+  if (total > UINT32_MAX)
+    return CIPC_BAD_FRAME;
+
+  if (cctx->codec && total >= cctx->threshold)
+    {
+      const char *src = iov[0].base;
+
+      if (iovcnt > 1)
+        {
+          if (reserve (&cctx->flat, &cctx->flat_cap, total) != CIPC_OK)
+            return CIPC_BAD_ALLOC;
+
+          size_t offset = 0;
+          for (size_t i = 0; i < iovcnt; i++)
+            {
+              memcpy (cctx->flat + offset, iov[i].base, iov[i].length);
+              offset += iov[i].length;
+            }
+
+          src = cctx->flat;
+        }
+
+      if (reserve (&cctx->out, &cctx->out_cap, CIPC_CODEC_HEADER_SIZE + total) != CIPC_OK)
+        return CIPC_BAD_ALLOC;
+
+      size_t size = encode_into (cctx, src, total, cctx->out);
+      if (size > 0)
+        return inner->send (inner->context, cctx->out, size);
+    }
+
+  // Sent unchanged, the header goes out ahead of the caller's own parts.
+  char header[CIPC_CODEC_HEADER_SIZE];
+  write_header (header, total, CIPC_CODEC_RAW);
+
+  cipc_iovec stack_parts[CIPC_CODEC_SENDV_STACK_IOV];
+  cipc_iovec *parts = stack_parts;
+
+  if (iovcnt + 1 > CIPC_CODEC_SENDV_STACK_IOV)
+    {
+      parts = malloc ((iovcnt + 1) * sizeof (cipc_iovec));
+      if (!parts)
+        return CIPC_BAD_ALLOC;
+    }
+
+  parts[0] = (cipc_iovec){ .base = header, .length = sizeof (header) };
+  if (iovcnt > 0)
+    memcpy (parts + 1, iov, iovcnt * sizeof (cipc_iovec));
+
+  cipc_err err = inner->sendv (inner->context, parts, iovcnt + 1);
+
+  if (parts != stack_parts)
+    free (parts);
+
+  return err;
+}
+
+static cipc_err
+cipc_codec_send (void *context, const char *data, size_t length)
+{
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_codec_sendv (context, &iov, 1);
+}
+
+static cipc_err
+cipc_codec_send_to (void *context, cipc_peer_id peer, const char *data, size_t length)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+  cipc *inner = cctx->inner;
+
+  if (!inner->send_to)
+    return CIPC_BAD_PEER;
+
+  if (length > UINT32_MAX)
+    return CIPC_BAD_FRAME;
+
+  if (reserve (&cctx->out, &cctx->out_cap, CIPC_CODEC_HEADER_SIZE + length) != CIPC_OK)
+    return CIPC_BAD_ALLOC;
+
+  size_t size = encode_or_copy (cctx, data, length, cctx->out);
+
+  return inner->send_to (inner->context, peer, cctx->out, size);
+}
+
+static cipc_err
+cipc_codec_send_batch (void *context, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+  cipc *inner = cctx->inner;
+
+  cipc_err err = CIPC_OK;
+  size_t done = 0;
+
+  while (done < count)
+    {
+      size_t chunk = 0;
+      size_t room = 0;
+
+      for (; chunk < CIPC_CODEC_BATCH && done + chunk < count; chunk++)
+        {
+          if (msgs[done + chunk].length > UINT32_MAX)
+            break;
+
+          room += CIPC_CODEC_HEADER_SIZE + msgs[done + chunk].length;
+        }
+
+      if (chunk == 0)
+        {
+          err = CIPC_BAD_FRAME;
+          break;
+        }
+
+      if (reserve (&cctx->out, &cctx->out_cap, room) != CIPC_OK)
+        {
+          err = CIPC_BAD_ALLOC;
+          break;
+        }
+
+      // Every message of the chunk is encoded, one after the other, before any is sent.
+      cipc_iovec encoded[CIPC_CODEC_BATCH];
+      size_t offset = 0;
+
+      for (size_t i = 0; i < chunk; i++)
+        {
+          size_t size = encode_or_copy (cctx, msgs[done + i].base, msgs[done + i].length,
+                                        cctx->out + offset);
+
+          encoded[i] = (cipc_iovec){ .base = cctx->out + offset, .length = size };
+          offset += size;
+        }
+
+      size_t chunk_sent = 0;
+      err = inner->send_batch (inner->context, encoded, chunk, &chunk_sent);
+
+      done += chunk_sent;
+
+      if (err != CIPC_OK || chunk_sent < chunk)
+        break;
+    }
+
+  if (sent != NULL)
+    *sent = done;
+
+  return err;
+}
+
+// Checks the header of a received frame; *codec is left NULL for a body sent unchanged.
+static cipc_err
+parse_header (const cipc_codec_private *cctx, const char *data, size_t size, size_t *length,
+              const cipc_codec **codec)
+{
+  if (size < CIPC_CODEC_HEADER_SIZE)
+    return CIPC_BAD_FRAME;
+
+  uint32_t header[2];
+  memcpy (header, data, sizeof (header));
+
+  *length = ntohl (header[0]);
+  *codec = NULL;
+
+  uint32_t id = ntohl (header[1]);
+
+  if (id == CIPC_CODEC_RAW)
+    return *length == size - CIPC_CODEC_HEADER_SIZE ? CIPC_OK : CIPC_BAD_FRAME;
+
+  *codec = lookup (id);
+  if (!*codec)
+    {
+      fprintf (stderr, "Received message with unknown codec %u\n", id);
+      return CIPC_BAD_CODEC;
+    }
+
+  if (*length > cctx->max_message_size)
+    return CIPC_BAD_FRAME;
+
+  return CIPC_OK;
+}
+
+// Decodes the body of a checked frame into dst, which has room for length bytes.
+static cipc_err
+decode_body (const cipc_codec *codec, const char *body, size_t body_length, char *dst,
+             size_t length)
+{
+  if (!codec)
+    {
+      memcpy (dst, body, length);
+      return CIPC_OK;
+    }
+
+  if (codec->decode (codec->arg, body, body_length, dst, length) != CIPC_OK)
+    return CIPC_BAD_CODEC;
+
+  return CIPC_OK;
+}
+
+// Replaces a message of the inner instance by the payload it carries. On failure the inner
+// message is left to the caller.
+static cipc_err
+unwrap (cipc_codec_private *cctx, cipc_msg *msg)
+{
+  size_t length;
+  const cipc_codec *codec;
+
+  cipc_err err = parse_header (cctx, msg->data, msg->length, &length, &codec);
+  if (err != CIPC_OK)
+    return err;
+
+  const char *body = msg->data + CIPC_CODEC_HEADER_SIZE;
+
+  if (!codec)
+    {
+      cipc_codec_rx *rx = cipc_alloc (sizeof (cipc_codec_rx));
+      if (!rx)
+        return CIPC_BAD_ALLOC;
+
+      rx->inner = *msg;
+      rx->borrowed = 1;
+
+      msg->data = body;
+      msg->length = length;
+      msg->handle = rx;
+
+      return CIPC_OK;
+    }
+
+  cipc_codec_rx *rx = cipc_alloc (sizeof (cipc_codec_rx) + length);
+  if (!rx)
+    return CIPC_BAD_ALLOC;
+
+  err = decode_body (codec, body, msg->length - CIPC_CODEC_HEADER_SIZE, rx->data, length);
+  if (err != CIPC_OK)
+    {
+      cipc_dealloc (rx);
+      return err;
+    }
+
+  // The payload now lives here, so the inner message goes back at once.
+  cctx->inner->release_msg (cctx->inner->context, msg);
+
+  rx->borrowed = 0;
+
+  msg->data = rx->data;
+  msg->length = length;
+  msg->handle = rx;
+
+  return CIPC_OK;
+}
+
+static void
+cipc_codec_release_msg (void *context, cipc_msg *msg)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+
+  if (!msg || !msg->handle)
+    return;
+
+  cipc_codec_rx *rx = msg->handle;
+
+  if (rx->borrowed)
+    cctx->inner->release_msg (cctx->inner->context, &rx->inner);
+
+  cipc_dealloc (rx);
+
+  msg->data = NULL;
+  msg->length = 0;
+  msg->handle = NULL;
+}
+
+static int
+take_held (cipc_codec_private *cctx, cipc_msg *msg, cipc_peer_id *peer)
+{
+  if (!cctx->held.handle)
+    return 0;
+
+  *msg = cctx->held;
+
+  if (peer != NULL)
+    *peer = cctx->held_peer;
+
+  memset (&cctx->held, 0, sizeof (cipc_msg));
+
+  return 1;
+}
+
+static cipc_err
+cipc_codec_recv_msg (void *context, cipc_msg *msg)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+  cipc *inner = cctx->inner;
+
+  if (take_held (cctx, msg, NULL))
+    return CIPC_OK;
+
+  cipc_err err = inner->recv_msg (inner->context, msg);
+  if (err != CIPC_OK)
+    return err;
+
+  err = unwrap (cctx, msg);
+  if (err != CIPC_OK)
+    inner->release_msg (inner->context, msg);
+
+  return err;
+}
+
+// Copies a message out to the caller, or holds it when it does not fit.
+static cipc_err
+deliver (cipc_codec_private *cctx, cipc_msg *msg, cipc_peer_id peer, char *buffer, size_t length,
+         size_t *len_out)
+{
+  if (len_out != NULL)
+    *len_out = msg->length;
+
+  // Held so the caller can retry with a larger buffer; one byte is kept for the terminator.
+  if (msg->length >= length)
+    {
+      cctx->held = *msg;
+      cctx->held_peer = peer;
+
+      return CIPC_BAD_BUFFER_SIZE;
+    }
+
+  memcpy (buffer, msg->data, msg->length);
+  buffer[msg->length] = '\0';
+
+  cipc_codec_release_msg (cctx, msg);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_codec_recv (void *context, char *buffer, size_t length, size_t *len_out)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  cipc_msg msg;
+
+  cipc_err err = cipc_codec_recv_msg (cctx, &msg);
+  if (err != CIPC_OK)
+    return err;
+
+  return deliver (cctx, &msg, 0, buffer, length, len_out);
+}
+
+static cipc_err
+cipc_codec_recv_from (void *context, cipc_peer_id *peer, char *buffer, size_t length,
+                      size_t *len_out)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+  cipc *inner = cctx->inner;
+
+  if (!inner->recv_from)
+    return CIPC_BAD_PEER;
+
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  cipc_msg msg;
+  cipc_peer_id from = 0;
+
+  if (take_held (cctx, &msg, &from))
+    {
+      if (peer != NULL)
+        *peer = from;
+
+      return deliver (cctx, &msg, from, buffer, length, len_out);
+    }
+
+  // recv_from only copies, so the frame is staged whole and decoded from there.
+  if (reserve (&cctx->flat, &cctx->flat_cap, CIPC_CODEC_HEADER_SIZE + length) != CIPC_OK)
+    return CIPC_BAD_ALLOC;
+
+  size_t size = 0;
+
+  cipc_err err = inner->recv_from (inner->context, &from, cctx->flat, cctx->flat_cap, &size);
+  if (err == CIPC_BAD_BUFFER_SIZE)
+    {
+      if (reserve (&cctx->flat, &cctx->flat_cap, size + 1) != CIPC_OK)
+        return CIPC_BAD_ALLOC;
+
+      err = inner->recv_from (inner->context, &from, cctx->flat, cctx->flat_cap, &size);
+    }
+
+  if (err != CIPC_OK)
+    return err;
+
+  if (peer != NULL)
+    *peer = from;
+
+  size_t decoded;
+  const cipc_codec *codec;
+
+  err = parse_header (cctx, cctx->flat, size, &decoded, &codec);
+  if (err != CIPC_OK)
+    return err;
+
+  const char *body = cctx->flat + CIPC_CODEC_HEADER_SIZE;
+  size_t body_length = size - CIPC_CODEC_HEADER_SIZE;
+
+  if (decoded >= length)
+    {
+      cipc_codec_rx *rx = cipc_alloc (sizeof (cipc_codec_rx) + decoded);
+      if (!rx)
+        return CIPC_BAD_ALLOC;
+
+      rx->borrowed = 0;
+
+      err = decode_body (codec, body, body_length, rx->data, decoded);
+      if (err != CIPC_OK)
+        {
+          cipc_dealloc (rx);
+          return err;
+        }
+
+      msg = (cipc_msg){ .data = rx->data, .length = decoded, .handle = rx };
+
+      return deliver (cctx, &msg, from, buffer, length, len_out);
+    }
+
+  if (len_out != NULL)
+    *len_out = decoded;
+
+  err = decode_body (codec, body, body_length, buffer, decoded);
+  if (err != CIPC_OK)
+    return err;
+
+  buffer[decoded] = '\0';
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_codec_recv_batch (void *context, cipc_msg *msgs, size_t count, size_t *received)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+  cipc *inner = cctx->inner;
+
+  if (!received || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  *received = 0;
+
+  if (count == 0)
+    return CIPC_OK;
+
+  if (take_held (cctx, &msgs[0], NULL))
+    {
+      *received = 1;
+      return CIPC_OK;
+    }
+
+  size_t got = 0;
+
+  cipc_err err = inner->recv_batch (inner->context, msgs, count, &got);
+  if (err != CIPC_OK)
+    return err;
+
+  // A malformed message is dropped without holding back the others; its error is only reported
+  // when nothing else arrived.
+  cipc_err first_err = CIPC_OK;
+
+  for (size_t i = 0; i < got; i++)
+    {
+      cipc_msg msg = msgs[i];
+
+      err = unwrap (cctx, &msg);
+      if (err != CIPC_OK)
+        {
+          inner->release_msg (inner->context, &msg);
+
+          if (first_err == CIPC_OK)
+            first_err = err;
+
+          continue;
+        }
+
+      msgs[(*received)++] = msg;
+    }
+
+  return *received > 0 ? CIPC_OK : first_err;
+}
+
+static cipc_err
+cipc_codec_get_fd (void *context, int *fd, int *ready)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+  cipc *inner = cctx->inner;
+
+  cipc_err err = inner->get_fd (inner->context, fd, ready);
+
+  if (cctx->held.handle)
+    *ready = 1;
+
+  return err;
+}
+
+static cipc_counters *
+cipc_codec_counters (void *context)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+
+  return cctx->inner->counters (cctx->inner->context);
+}
+
+static cipc_err
+cipc_codec_init (void **context, const void *config)
+{
+  if (!context || !config)
+    return CIPC_NULL_PTR;
+
+  const cipc_codec_config *cfg = (const cipc_codec_config *)config;
+
+  cipc *inner = cfg->inner;
+  if (!inner || !inner->context || !inner->send || !inner->sendv || !inner->recv_msg
+      || !inner->release_msg || !inner->send_batch || !inner->recv_batch || !inner->get_fd
+      || !inner->counters)
+    return CIPC_NULL_PTR;
+
+  const cipc_codec *codec = NULL;
+
+  if (cfg->codec != CIPC_CODEC_RAW)
+    {
+      codec = lookup (cfg->codec);
+      if (!codec)
+        {
+          fprintf (stderr, "Codec %u is not registered\n", cfg->codec);
+          return CIPC_BAD_CODEC;
+        }
+    }
+
+  cipc_codec_private *cctx = calloc (1, sizeof (cipc_codec_private));
+  if (!cctx)
+    return CIPC_BAD_ALLOC;
+
+  cctx->inner = inner;
+  cctx->codec = codec;
+  cctx->threshold = cfg->threshold ? cfg->threshold : CIPC_CODEC_DEFAULT_THRESHOLD;
+  cctx->max_message_size
+      = cfg->max_message_size ? cfg->max_message_size : CIPC_CODEC_DEFAULT_MAX_MESSAGE_SIZE;
+
+  *context = cctx;
+
+  return CIPC_OK;
+}
+
+static void
+cipc_codec_free (void *context)
+{
+  cipc_codec_private *cctx = (cipc_codec_private *)context;
+  if (!cctx)
+    return;
+
+  cipc_codec_release_msg (cctx, &cctx->held);
+
+  cipc *inner = cctx->inner;
+
+  free (cctx->flat);
+  free (cctx->out);
+  free (cctx);
+
+  cipc_free (inner);
+}
+
+cipc *
+cipc_create_codec (void)
+{
+  cipc *instance = calloc (1, sizeof (cipc));
+  if (!instance)
+    return NULL;
+
+  instance->init = cipc_codec_init;
+  instance->send = cipc_codec_send;
+  instance->sendv = cipc_codec_sendv;
+  instance->recv = cipc_codec_recv;
+  instance->recv_msg = cipc_codec_recv_msg;
+  instance->release_msg = cipc_codec_release_msg;
+  instance->send_to = cipc_codec_send_to;
+  instance->recv_from = cipc_codec_recv_from;
+  instance->send_batch = cipc_codec_send_batch;
+  instance->recv_batch = cipc_codec_recv_batch;
+  instance->get_fd = cipc_codec_get_fd;
+  instance->counters = cipc_codec_counters;
+  instance->free = cipc_codec_free;
+  instance->context = NULL;
+
+  return instance;
+}
@@ -0,0 +1,853 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/cipc_inproc.h"
+#include "cipc.h"
+#include "cipc_buf.h"
+#include "cipc_counters.h"
+#include "cipc_internal.h"
+#include "cipc_spin.h"
+
+#define CIPC_INPROC_CACHE_LINE 64
+
+// Single-producer single-consumer queue of buffers. The waiting flags ask the other side to
+// write the eventfd next time it moves its index, as the futex words of a shared memory ring do;
+// data_fd is also what cipc_poll waits on.
+typedef struct
+{
+  alignas (CIPC_INPROC_CACHE_LINE) atomic_size_t tail;
+  alignas (CIPC_INPROC_CACHE_LINE) atomic_size_t head;
+
+  alignas (CIPC_INPROC_CACHE_LINE) atomic_uint data_waiting;
+  int data_fd;
+
+  alignas (CIPC_INPROC_CACHE_LINE) atomic_uint space_waiting;
+  int space_fd;
+
+  cipc_buf **slots;
+} cipc_inproc_ring;
+
+typedef struct cipc_inproc_channel cipc_inproc_channel;
+
+struct cipc_inproc_channel
+{
+  // Registry links, under registry_lock.
+  cipc_inproc_channel *next;
+  char *name;
+  int registered;
+  int connected;
+
+  atomic_int refs;
+  // Set by an end being freed; cleared when a new peer attaches to the bound end.
+  atomic_int closed;
+
+  size_t capacity;
+
+  // rings[0] carries bind -> connect traffic, rings[1] the opposite direction.
+  cipc_inproc_ring rings[2];
+};
+
+typedef struct
+{
+  cipc_inproc_channel *channel;
+
+  cipc_inproc_ring *tx;
+  cipc_inproc_ring *rx;
+  size_t mask;
+
+  // Last index seen of the other side, so that most calls touch only their own cache lines.
+  size_t tx_head_cache;
+  size_t rx_tail_cache;
+
+  // Receives spin before sleeping; see cipc_spin.h.
+  cipc_spin spin;
+  int sndtimeo;
+  int rcvtimeo;
+
+  cipc_counters counters;
+} cipc_inproc_private;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static cipc_inproc_channel *registry;
+
+static size_t
+round_up_pow2 (size_t value)
+{
+  size_t result = 1;
+  while (result < value)
+    result <<= 1;
+
+  return result;
+}
+
+static void
+channel_unref (cipc_inproc_channel *channel)
+{
+  if (atomic_fetch_sub (&channel->refs, 1) != 1)
+    return;
+
+  for (int i = 0; i < 2; i++)
+    {
+      cipc_inproc_ring *ring = &channel->rings[i];
+
+      if (ring->slots)
+        {
+          size_t head = atomic_load (&ring->head);
+          size_t tail = atomic_load (&ring->tail);
+
+          for (; head != tail; head++)
+            cipc_buf_unref (ring->slots[head & (channel->capacity - 1)]);
+        }
+
+      if (ring->data_fd >= 0)
+        close (ring->data_fd);
+
+      if (ring->space_fd >= 0)
+        close (ring->space_fd);
+
+      free (ring->slots);
+    }
+
+  free (channel->name);
+  free (channel);
+}
+
+static cipc_inproc_channel *
+channel_create (const char *name, size_t capacity)
+{
+  cipc_inproc_channel *channel = calloc (1, sizeof (cipc_inproc_channel));
+  if (!channel)
+    return NULL;
+
+  atomic_init (&channel->refs, 1);
+  channel->capacity = capacity;
+
+  for (int i = 0; i < 2; i++)
+    {
+      channel->rings[i].data_fd = -1;
+      channel->rings[i].space_fd = -1;
+    }
+
+  channel->name = strdup (name);
+  if (!channel->name)
+    {
+      channel_unref (channel);
+      return NULL;
+    }
+
+  for (int i = 0; i < 2; i++)
+    {
+      cipc_inproc_ring *ring = &channel->rings[i];
+
+      ring->slots = calloc (capacity, sizeof (cipc_buf *));
+      ring->data_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+      ring->space_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+      if (!ring->slots || ring->data_fd < 0 || ring->space_fd < 0)
+        {
+          channel_unref (channel);
+          return NULL;
+        }
+    }
+
+  return channel;
+}
+
+static void
+notify (atomic_uint *waiting, int fd, cipc_counter *syscalls)
+{
+  // Clearing the flag leaves one wakeup per sleep; the woken side sets it again if it must wait.
+  if (atomic_load (waiting) && atomic_exchange (waiting, 0))
+    {
+      cipc_signal_fd (fd);
+      cipc_counter_add (syscalls, 1);
+    }
+}
+
+static int
+is_closed (cipc_inproc_private *ictx)
+{
+  return atomic_load_explicit (&ictx->channel->closed, memory_order_acquire);
+}
+
+static int
+has_space (cipc_inproc_private *ictx)
+{
+  size_t tail = atomic_load_explicit (&ictx->tx->tail, memory_order_relaxed);
+
+  if (tail - ictx->tx_head_cache <= ictx->mask)
+    return 1;
+
+  ictx->tx_head_cache = atomic_load_explicit (&ictx->tx->head, memory_order_acquire);
+
+  return tail - ictx->tx_head_cache <= ictx->mask || is_closed (ictx);
+}
+
+static int
+has_data (cipc_inproc_private *ictx)
+{
+  size_t head = atomic_load_explicit (&ictx->rx->head, memory_order_relaxed);
+
+  if (head != ictx->rx_tail_cache)
+    return 1;
+
+  ictx->rx_tail_cache = atomic_load_explicit (&ictx->rx->tail, memory_order_acquire);
+
+  return head != ictx->rx_tail_cache || is_closed (ictx);
+}
+
+// Spins until spin_until (0 skips spinning), then sleeps on fd until ready() holds. Returns 0 on
+// timeout.
+static int
+wait_for (cipc_inproc_private *ictx, atomic_uint *waiting, int fd, int timeout_ms,
+          int64_t spin_until, int (*ready) (cipc_inproc_private *), cipc_counter *syscalls)
+{
+  while (spin_until)
+    {
+      if (ready (ictx))
+        return 1;
+
+      if (!cipc_spin_wait (spin_until))
+        spin_until = 0;
+    }
+
+  int64_t deadline = timeout_ms > 0 ? cipc_monotonic_ms () + timeout_ms : 0;
+
+  while (1)
+    {
+      atomic_store (waiting, 1);
+
+      if (ready (ictx))
+        {
+          atomic_store (waiting, 0);
+          return 1;
+        }
+
+      int left = -1;
+      if (timeout_ms > 0)
+        {
+          int64_t remaining = deadline - cipc_monotonic_ms ();
+          if (remaining <= 0)
+            {
+              atomic_store (waiting, 0);
+              return 0;
+            }
+
+          left = (int)remaining;
+        }
+
+      struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+      if (poll (&pfd, 1, left) > 0)
+        cipc_drain_fd (fd);
+
+      cipc_counter_add (syscalls, 1);
+
+      atomic_store (waiting, 0);
+
+      if (ready (ictx))
+        return 1;
+    }
+}
+
+// Queues buf without waking the receiver; the queue takes over its reference on success.
+static cipc_err
+put (cipc_inproc_private *ictx, cipc_buf *buf)
+{
+  if (is_closed (ictx))
+    return CIPC_BAD_INPROC_SEND;
+
+  if (!has_space (ictx))
+    {
+      // Messages queued without a wakeup may be what the receiver needs to make room.
+      notify (&ictx->tx->data_waiting, ictx->tx->data_fd, &ictx->counters.send_syscalls);
+
+      if (!wait_for (ictx, &ictx->tx->space_waiting, ictx->tx->space_fd, ictx->sndtimeo, 0,
+                     has_space, &ictx->counters.send_syscalls))
+        {
+          cipc_counter_add (&ictx->counters.send_timeouts, 1);
+          return CIPC_BAD_INPROC_SEND;
+        }
+
+      if (is_closed (ictx))
+        return CIPC_BAD_INPROC_SEND;
+    }
+
+  size_t tail = atomic_load_explicit (&ictx->tx->tail, memory_order_relaxed);
+
+  ictx->tx->slots[tail & ictx->mask] = buf;
+
+  // Ordered before the check of data_waiting in notify, so that a receiver going to sleep
+  // either sees the message or is woken.
+  atomic_store (&ictx->tx->tail, tail + 1);
+
+  return CIPC_OK;
+}
+
+static cipc_buf *
+copy_in (const cipc_iovec *iov, size_t iovcnt, size_t *length)
+{
+  *length = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    *length += iov[i].length;
+
+  cipc_buf *buf = cipc_buf_alloc (*length);
+  if (!buf)
+    return NULL;
+
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      memcpy (buf->data + buf->length, iov[i].base, iov[i].length);
+      buf->length += iov[i].length;
+    }
+
+  return buf;
+}
+
+static cipc_err
+cipc_inproc_sendv (void *context, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+  uint64_t start = cipc_counters_start (&ictx->counters);
+
+  size_t length;
+  cipc_err err = CIPC_BAD_ALLOC;
+
+  cipc_buf *buf = copy_in (iov, iovcnt, &length);
+  if (buf)
+    {
+      err = put (ictx, buf);
+      if (err == CIPC_OK)
+        notify (&ictx->tx->data_waiting, ictx->tx->data_fd, &ictx->counters.send_syscalls);
+      else
+        cipc_buf_unref (buf);
+    }
+
+  cipc_counters_sent (&ictx->counters, err, err == CIPC_OK, length, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_inproc_send (void *context, const char *data, size_t length)
+{
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_inproc_sendv (context, &iov, 1);
+}
+
+static cipc_err
+cipc_inproc_send_buf (void *context, cipc_buf *buf)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+
+  if (!buf)
+    return CIPC_NULL_PTR;
+
+  uint64_t start = cipc_counters_start (&ictx->counters);
+  size_t length = buf->length;
+
+  cipc_err err = put (ictx, buf);
+  if (err == CIPC_OK)
+    notify (&ictx->tx->data_waiting, ictx->tx->data_fd, &ictx->counters.send_syscalls);
+  else
+    cipc_buf_unref (buf);
+
+  cipc_counters_sent (&ictx->counters, err, err == CIPC_OK, length, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_inproc_send_batch (void *context, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+  uint64_t start = cipc_counters_start (&ictx->counters);
+
+  cipc_err err = CIPC_OK;
+  size_t done = 0;
+  uint64_t bytes = 0;
+
+  while (done < count)
+    {
+      size_t length;
+
+      cipc_buf *buf = copy_in (&msgs[done], 1, &length);
+      if (!buf)
+        {
+          err = CIPC_BAD_ALLOC;
+          break;
+        }
+
+      err = put (ictx, buf);
+      if (err != CIPC_OK)
+        {
+          cipc_buf_unref (buf);
+          break;
+        }
+
+      bytes += length;
+      done++;
+    }
+
+  // One wakeup covers the whole batch.
+  if (done > 0)
+    notify (&ictx->tx->data_waiting, ictx->tx->data_fd, &ictx->counters.send_syscalls);
+
+  cipc_counters_sent (&ictx->counters, err, done, bytes, start);
+
+  if (sent != NULL)
+    *sent = done;
+
+  return err;
+}
+
+// The oldest queued buffer, waiting for one if wait is set; it stays queued until take.
+static cipc_err
+peek (cipc_inproc_private *ictx, int wait, cipc_buf **buf)
+{
+  if (!has_data (ictx))
+    {
+      if (!wait)
+        return CIPC_WOULD_BLOCK;
+
+      if (!wait_for (ictx, &ictx->rx->data_waiting, ictx->rx->data_fd, ictx->rcvtimeo,
+                     cipc_spin_deadline (&ictx->spin), has_data, &ictx->counters.recv_syscalls))
+        {
+          cipc_counter_add (&ictx->counters.recv_timeouts, 1);
+          return CIPC_BAD_INPROC_RECV;
+        }
+    }
+
+  size_t head = atomic_load_explicit (&ictx->rx->head, memory_order_relaxed);
+
+  // Woken by the peer going away. Its last sends came before it closed, so a fresh look at the
+  // tail sees them.
+  if (head == ictx->rx_tail_cache)
+    {
+      ictx->rx_tail_cache = atomic_load_explicit (&ictx->rx->tail, memory_order_acquire);
+
+      if (head == ictx->rx_tail_cache)
+        return CIPC_BAD_INPROC_RECV;
+    }
+
+  *buf = ictx->rx->slots[head & ictx->mask];
+
+  cipc_spin_arrived (&ictx->spin);
+
+  return CIPC_OK;
+}
+
+// Dequeues the buffer peek returned; the caller takes over its reference.
+static void
+take (cipc_inproc_private *ictx)
+{
+  size_t head = atomic_load_explicit (&ictx->rx->head, memory_order_relaxed);
+
+  atomic_store (&ictx->rx->head, head + 1);
+
+  notify (&ictx->rx->space_waiting, ictx->rx->space_fd, &ictx->counters.recv_syscalls);
+}
+
+static cipc_err
+cipc_inproc_recv (void *context, char *buffer, size_t length, size_t *len_out)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+
+  if (!buffer || !len_out)
+    return CIPC_NULL_PTR;
+
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  uint64_t start = cipc_counters_start (&ictx->counters);
+
+  cipc_buf *buf = NULL;
+  cipc_err err = peek (ictx, 1, &buf);
+
+  // Too large for the message and its terminator: it stays queued for a larger buffer.
+  if (err == CIPC_OK && buf->length >= length)
+    {
+      *len_out = buf->length;
+      err = CIPC_BAD_BUFFER_SIZE;
+    }
+
+  if (err == CIPC_OK)
+    {
+      take (ictx);
+
+      memcpy (buffer, buf->data, buf->length);
+      buffer[buf->length] = '\0';
+      *len_out = buf->length;
+
+      cipc_buf_unref (buf);
+    }
+
+  cipc_counters_received (&ictx->counters, err, err == CIPC_OK, err == CIPC_OK ? *len_out : 0,
+                          start);
+
+  return err;
+}
+
+static cipc_err
+cipc_inproc_recv_buf (void *context, cipc_buf **buf)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+
+  if (!buf)
+    return CIPC_NULL_PTR;
+
+  uint64_t start = cipc_counters_start (&ictx->counters);
+
+  cipc_err err = peek (ictx, 1, buf);
+  if (err == CIPC_OK)
+    take (ictx);
+
+  cipc_counters_received (&ictx->counters, err, err == CIPC_OK,
+                          err == CIPC_OK ? (*buf)->length : 0, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_inproc_recv_msg (void *context, cipc_msg *msg)
+{
+  if (!msg)
+    return CIPC_NULL_PTR;
+
+  cipc_buf *buf;
+
+  cipc_err err = cipc_inproc_recv_buf (context, &buf);
+  if (err != CIPC_OK)
+    return err;
+
+  msg->data = buf->data;
+  msg->length = buf->length;
+  msg->handle = buf;
+
+  return CIPC_OK;
+}
+
+static void
+cipc_inproc_release_msg (void *context, cipc_msg *msg)
+{
+  (void)context;
+
+  if (msg && msg->handle)
+    {
+      cipc_buf_unref ((cipc_buf *)msg->handle);
+      msg->handle = NULL;
+    }
+}
+
+static cipc_err
+cipc_inproc_recv_batch (void *context, cipc_msg *msgs, size_t count, size_t *received)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+
+  if (!received || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  *received = 0;
+
+  uint64_t start = cipc_counters_start (&ictx->counters);
+
+  cipc_err err = CIPC_OK;
+  uint64_t bytes = 0;
+
+  while (*received < count)
+    {
+      cipc_buf *buf;
+
+      err = peek (ictx, *received == 0, &buf);
+      if (err != CIPC_OK)
+        break;
+
+      take (ictx);
+
+      msgs[*received] = (cipc_msg){ .data = buf->data, .length = buf->length, .handle = buf };
+      bytes += buf->length;
+      (*received)++;
+    }
+
+  if (*received > 0)
+    err = CIPC_OK;
+
+  cipc_counters_received (&ictx->counters, err, *received, bytes, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_inproc_get_fd (void *context, int *fd, int *ready)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+
+  *fd = ictx->rx->data_fd;
+
+  // Asks the sender to write the descriptor; a wakeup left over from an earlier sleep is
+  // cleared first so that the descriptor does not report a message already taken.
+  atomic_store (&ictx->rx->data_waiting, 1);
+
+  *ready = has_data (ictx);
+  if (!*ready)
+    {
+      cipc_drain_fd (*fd);
+      *ready = has_data (ictx);
+    }
+
+  return CIPC_OK;
+}
+
+static cipc_err
+attach_with_retries (cipc_inproc_private *ictx, const cipc_inproc_config *cfg)
+{
+  int retry_count = 0;
+  int retry_delay_ms = 1;
+
+  while (1)
+    {
+      pthread_mutex_lock (&registry_lock);
+
+      cipc_inproc_channel *channel = registry;
+      while (channel && strcmp (channel->name, cfg->name) != 0)
+        channel = channel->next;
+
+      int connected = channel && channel->connected;
+
+      if (channel && !connected)
+        {
+          channel->connected = 1;
+          atomic_fetch_add (&channel->refs, 1);
+
+          // A previous peer may have left; the bound end serves this one from here on.
+          atomic_store_explicit (&channel->closed, 0, memory_order_release);
+
+          ictx->channel = channel;
+        }
+
+      pthread_mutex_unlock (&registry_lock);
+
+      if (ictx->channel)
+        return CIPC_OK;
+
+      if (connected)
+        {
+          fprintf (stderr, "Endpoint %s already has a connection\n", cfg->name);
+          return CIPC_BAD_INPROC_CONNECT;
+        }
+
+      if (retry_count >= cfg->sockopt_retries)
+        {
+          fprintf (stderr, "Connect to %s failed after %d retries\n", cfg->name,
+                   cfg->sockopt_retries);
+          return CIPC_BAD_INPROC_CONNECT;
+        }
+
+      retry_count++;
+      cipc_counter_add (&ictx->counters.reconnects, 1);
+
+      usleep (retry_delay_ms * 1000);
+      retry_delay_ms = retry_delay_ms * 2 > 1000 ? 1000 : retry_delay_ms * 2;
+    }
+}
+
+static cipc_err
+bind_endpoint (cipc_inproc_private *ictx, const cipc_inproc_config *cfg)
+{
+  size_t capacity = round_up_pow2 (cfg->capacity ? cfg->capacity : CIPC_INPROC_DEFAULT_CAPACITY);
+
+  cipc_inproc_channel *channel = channel_create (cfg->name, capacity);
+  if (!channel)
+    return CIPC_BAD_ALLOC;
+
+  pthread_mutex_lock (&registry_lock);
+
+  cipc_inproc_channel *existing = registry;
+  while (existing && strcmp (existing->name, cfg->name) != 0)
+    existing = existing->next;
+
+  if (!existing)
+    {
+      channel->next = registry;
+      channel->registered = 1;
+      registry = channel;
+    }
+
+  pthread_mutex_unlock (&registry_lock);
+
+  if (existing)
+    {
+      fprintf (stderr, "Endpoint %s is already bound\n", cfg->name);
+      channel_unref (channel);
+      return CIPC_BAD_INPROC_BIND;
+    }
+
+  ictx->channel = channel;
+
+  return CIPC_OK;
+}
+
+static void
+unregister (cipc_inproc_channel *channel)
+{
+  pthread_mutex_lock (&registry_lock);
+
+  if (channel->registered)
+    {
+      cipc_inproc_channel **link = &registry;
+      while (*link != channel)
+        link = &(*link)->next;
+
+      *link = channel->next;
+      channel->registered = 0;
+    }
+
+  pthread_mutex_unlock (&registry_lock);
+}
+
+// Hands the bound end over to the next connect. Messages queued for this end are dropped, which
+// as their consumer it may do; those it sent stay for the bound end to read.
+static void
+detach (cipc_inproc_private *ictx)
+{
+  cipc_inproc_channel *channel = ictx->channel;
+
+  pthread_mutex_lock (&registry_lock);
+
+  // Set before the drain, so the bound end stops queueing for this peer.
+  atomic_store_explicit (&channel->closed, 1, memory_order_release);
+
+  size_t head = atomic_load_explicit (&ictx->rx->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit (&ictx->rx->tail, memory_order_acquire);
+
+  for (; head != tail; head++)
+    cipc_buf_unref (ictx->rx->slots[head & ictx->mask]);
+
+  atomic_store (&ictx->rx->head, head);
+
+  channel->connected = 0;
+
+  pthread_mutex_unlock (&registry_lock);
+}
+
+static cipc_err
+cipc_inproc_init (void **context, const void *config)
+{
+  if (!context || !config)
+    return CIPC_NULL_PTR;
+
+  const cipc_inproc_config *cfg = (const cipc_inproc_config *)config;
+  if (!cfg->name)
+    return CIPC_NULL_PTR;
+
+  cipc_inproc_private *ictx = calloc (1, sizeof (cipc_inproc_private));
+  if (!ictx)
+    return CIPC_BAD_ALLOC;
+
+  cipc_counters_init (&ictx->counters);
+
+  cipc_err err = cfg->mode == CIPC_INPROC_MODE_BIND ? bind_endpoint (ictx, cfg)
+                                                    : attach_with_retries (ictx, cfg);
+  if (err != CIPC_OK)
+    {
+      cipc_counters_destroy (&ictx->counters);
+      free (ictx);
+      return err;
+    }
+
+  int tx_index = cfg->mode == CIPC_INPROC_MODE_BIND ? 0 : 1;
+
+  ictx->tx = &ictx->channel->rings[tx_index];
+  ictx->rx = &ictx->channel->rings[1 - tx_index];
+  ictx->mask = ictx->channel->capacity - 1;
+
+  // A connect end may take over queues a previous peer used; their indices carry on from there.
+  ictx->tx_head_cache = atomic_load (&ictx->tx->head);
+  ictx->rx_tail_cache = atomic_load (&ictx->rx->head);
+
+  // Spinning cannot help when the peer has no other core to run on.
+  cipc_spin_init (&ictx->spin, sysconf (_SC_NPROCESSORS_ONLN) < 2 ? 0 : cfg->spin_us);
+
+  ictx->sndtimeo = cfg->sockopt_sndtimeo;
+  ictx->rcvtimeo = cfg->sockopt_rcvtimeo;
+
+  *context = ictx;
+
+  return CIPC_OK;
+}
+
+static cipc_counters *
+cipc_inproc_counters (void *context)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+
+  return &ictx->counters;
+}
+
+static void
+cipc_inproc_free (void *context)
+{
+  cipc_inproc_private *ictx = (cipc_inproc_private *)context;
+  if (!ictx)
+    return;
+
+  cipc_inproc_channel *channel = ictx->channel;
+
+  // Bound ends send on rings[0].
+  if (ictx->tx == &channel->rings[0])
+    {
+      unregister (channel);
+      atomic_store_explicit (&channel->closed, 1, memory_order_release);
+    }
+  else
+    detach (ictx);
+
+  // Wakes the peer wherever it sleeps; it sees the channel closed once its queue is drained.
+
+  for (int i = 0; i < 2; i++)
+    {
+      cipc_signal_fd (channel->rings[i].data_fd);
+      cipc_signal_fd (channel->rings[i].space_fd);
+    }
+
+  channel_unref (channel);
+
+  cipc_counters_destroy (&ictx->counters);
+  free (ictx);
+}
+
+cipc *
+cipc_create_inproc (void)
+{
+  cipc *instance = calloc (1, sizeof (cipc));
+  if (!instance)
+    return NULL;
+
+  instance->init = cipc_inproc_init;
+  instance->send = cipc_inproc_send;
+  instance->sendv = cipc_inproc_sendv;
+  instance->recv = cipc_inproc_recv;
+  instance->recv_msg = cipc_inproc_recv_msg;
+  instance->release_msg = cipc_inproc_release_msg;
+  instance->send_batch = cipc_inproc_send_batch;
+  instance->recv_batch = cipc_inproc_recv_batch;
+  instance->send_buf = cipc_inproc_send_buf;
+  instance->recv_buf = cipc_inproc_recv_buf;
+  instance->get_fd = cipc_inproc_get_fd;
+  instance->counters = cipc_inproc_counters;
+  instance->free = cipc_inproc_free;
+  instance->context = NULL;
+
+  return instance;
+}
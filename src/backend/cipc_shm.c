@@ -0,0 +1,760 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/cipc_shm.h"
+#include "cipc.h"
+#include "cipc_counters.h"
+#include "cipc_internal.h"
+
+#define CIPC_SHM_MAGIC 0x63697063u
+#define CIPC_SHM_CACHE_LINE 64
+#define CIPC_SHM_RECORD_HEADER_SIZE 8
+#define CIPC_SHM_RECORD_WRAP UINT32_MAX
+#define CIPC_SHM_INITIAL_VIEWS 64
+
+typedef struct
+{
+  alignas (CIPC_SHM_CACHE_LINE) atomic_uint_fast64_t tail;
+  alignas (CIPC_SHM_CACHE_LINE) atomic_uint_fast64_t head;
+
+  alignas (CIPC_SHM_CACHE_LINE) atomic_uint data_futex;
+  atomic_uint data_waiting;
+
+  alignas (CIPC_SHM_CACHE_LINE) atomic_uint space_futex;
+  atomic_uint space_waiting;
+} cipc_shm_ring;
+
+typedef struct
+{
+  alignas (CIPC_SHM_CACHE_LINE) atomic_uint magic;
+  uint64_t capacity;
+
+  // rings[0] carries bind -> connect traffic, rings[1] the opposite direction.
+  cipc_shm_ring rings[2];
+} cipc_shm_segment;
+
+// A view handed out by recv_msg: the end of its record, and whether it has been released.
+typedef struct
+{
+  uint64_t end;
+  int released;
+} cipc_shm_view;
+
+typedef struct
+{
+  char *name;
+  int is_owner;
+
+  cipc_shm_segment *segment;
+  size_t mapped_size;
+
+  cipc_shm_ring *tx;
+  char *tx_data;
+  cipc_shm_ring *rx;
+  char *rx_data;
+
+  uint64_t capacity;
+  int spin_count;
+  int sndtimeo;
+  int rcvtimeo;
+
+  // Consumer state: next record to parse, and the views not yet released, numbered in the order
+  // they were received. Entry n is views[n & (views_cap - 1)]. The ring is freed up to the
+  // oldest view still held, whatever order the others come back in.
+  uint64_t rx_read;
+  cipc_shm_view *views;
+  size_t views_cap;
+  uint64_t views_first;
+  uint64_t views_next;
+
+  cipc_counters counters;
+} cipc_shm_private;
+
+static int
+futex_wait (atomic_uint *addr, unsigned int expected, const struct timespec *timeout)
+{
+  return syscall (SYS_futex, addr, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static void
+futex_wake (atomic_uint *addr)
+{
+  syscall (SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static uint64_t
+record_size (size_t length)
+{
+  return (CIPC_SHM_RECORD_HEADER_SIZE + length + 7) & ~(uint64_t)7;
+}
+
+// Spins, then sleeps on the futex until ready() holds. Returns 0 on timeout.
+static int
+wait_for (cipc_shm_private *sctx, atomic_uint *futex, atomic_uint *waiting, int timeout_ms,
+          int (*ready) (cipc_shm_private *, uint64_t), uint64_t arg, cipc_counter *syscalls)
+{
+  for (int i = 0; i < sctx->spin_count; i++)
+    {
+      if (ready (sctx, arg))
+        return 1;
+
+      cipc_cpu_relax ();
+    }
+
+  int64_t deadline = timeout_ms > 0 ? cipc_monotonic_ms () + timeout_ms : 0;
+
+  while (1)
+    {
+      unsigned int seq = atomic_load (futex);
+
+      atomic_store (waiting, 1);
+
+      if (ready (sctx, arg))
+        {
+          atomic_store (waiting, 0);
+          return 1;
+        }
+
+      struct timespec ts, *tsp = NULL;
+      if (timeout_ms > 0)
+        {
+          int64_t left = deadline - cipc_monotonic_ms ();
+          if (left <= 0)
+            {
+              atomic_store (waiting, 0);
+              return 0;
+            }
+
+          ts.tv_sec = left / 1000;
+          ts.tv_nsec = (left % 1000) * 1000000;
+          tsp = &ts;
+        }
+
+      futex_wait (futex, seq, tsp);
+      cipc_counter_add (syscalls, 1);
+
+      atomic_store (waiting, 0);
+
+      if (ready (sctx, arg))
+        return 1;
+    }
+}
+
+static void
+notify (atomic_uint *futex, atomic_uint *waiting, cipc_counter *syscalls)
+{
+  // Clearing the flag leaves one wakeup per sleep; the woken side sets it again if it must wait.
+  if (atomic_load (waiting) && atomic_exchange (waiting, 0))
+    {
+      atomic_fetch_add (futex, 1);
+      futex_wake (futex);
+      cipc_counter_add (syscalls, 1);
+    }
+}
+
+static int
+has_space (cipc_shm_private *sctx, uint64_t needed)
+{
+  uint64_t tail = atomic_load_explicit (&sctx->tx->tail, memory_order_relaxed);
+  uint64_t head = atomic_load_explicit (&sctx->tx->head, memory_order_acquire);
+
+  return sctx->capacity - (tail - head) >= needed;
+}
+
+static int
+has_data (cipc_shm_private *sctx, uint64_t unused)
+{
+  (void)unused;
+
+  return atomic_load_explicit (&sctx->rx->tail, memory_order_acquire) != sctx->rx_read;
+}
+
+// Appends one record and publishes it without waking the consumer.
+static cipc_err
+put_record (cipc_shm_private *sctx, const cipc_iovec *iov, size_t iovcnt)
+{
+  size_t length = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    length += iov[i].length;
+
+  uint64_t rec = record_size (length);
+  if (rec > sctx->capacity / 2)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  uint64_t tail = atomic_load_explicit (&sctx->tx->tail, memory_order_relaxed);
+  uint64_t offset = tail & (sctx->capacity - 1);
+  uint64_t room = sctx->capacity - offset;
+
+  // Records never straddle the end of the ring; a wrap marker skips the remainder.
+  uint64_t needed = rec > room ? rec + room : rec;
+
+  if (!has_space (sctx, needed))
+    {
+      // Records published without a wakeup may be what the consumer needs to free space.
+      notify (&sctx->tx->data_futex, &sctx->tx->data_waiting, &sctx->counters.send_syscalls);
+
+      if (!wait_for (sctx, &sctx->tx->space_futex, &sctx->tx->space_waiting, sctx->sndtimeo,
+                     has_space, needed, &sctx->counters.send_syscalls))
+        {
+          cipc_counter_add (&sctx->counters.send_timeouts, 1);
+          return CIPC_BAD_SHM_SEND;
+        }
+    }
+
+  if (rec > room)
+    {
+      uint32_t wrap = CIPC_SHM_RECORD_WRAP;
+      memcpy (sctx->tx_data + offset, &wrap, sizeof (wrap));
+
+      tail += room;
+      offset = 0;
+    }
+
+  uint32_t header[2] = { (uint32_t)length, 0 };
+  memcpy (sctx->tx_data + offset, header, sizeof (header));
+
+  char *dst = sctx->tx_data + offset + CIPC_SHM_RECORD_HEADER_SIZE;
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      memcpy (dst, iov[i].base, iov[i].length);
+      dst += iov[i].length;
+    }
+
+  atomic_store (&sctx->tx->tail, tail + rec);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_shm_sendv (void *context, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_shm_private *sctx = (cipc_shm_private *)context;
+  uint64_t start = cipc_counters_start (&sctx->counters);
+
+  size_t length = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    length += iov[i].length;
+
+  cipc_err err = put_record (sctx, iov, iovcnt);
+  if (err == CIPC_OK)
+    notify (&sctx->tx->data_futex, &sctx->tx->data_waiting, &sctx->counters.send_syscalls);
+
+  cipc_counters_sent (&sctx->counters, err, err == CIPC_OK, length, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_shm_send_batch (void *context, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  cipc_shm_private *sctx = (cipc_shm_private *)context;
+  uint64_t start = cipc_counters_start (&sctx->counters);
+
+  cipc_err err = CIPC_OK;
+  size_t done = 0;
+  uint64_t bytes = 0;
+
+  while (done < count && (err = put_record (sctx, &msgs[done], 1)) == CIPC_OK)
+    bytes += msgs[done++].length;
+
+  // One wakeup covers the whole batch.
+  if (done > 0)
+    notify (&sctx->tx->data_futex, &sctx->tx->data_waiting, &sctx->counters.send_syscalls);
+
+  cipc_counters_sent (&sctx->counters, err, done, bytes, start);
+
+  if (sent != NULL)
+    *sent = done;
+
+  return err;
+}
+
+static cipc_err
+cipc_shm_send (void *context, const char *data, size_t length)
+{
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_shm_sendv (context, &iov, 1);
+}
+
+static cipc_err
+next_record (cipc_shm_private *sctx, const char **data, size_t *length, uint64_t *next)
+{
+  if (!has_data (sctx, 0)
+      && !wait_for (sctx, &sctx->rx->data_futex, &sctx->rx->data_waiting, sctx->rcvtimeo,
+                    has_data, 0, &sctx->counters.recv_syscalls))
+    {
+      cipc_counter_add (&sctx->counters.recv_timeouts, 1);
+      return CIPC_BAD_SHM_RECV;
+    }
+
+  uint64_t position = sctx->rx_read;
+  uint64_t offset = position & (sctx->capacity - 1);
+
+  uint32_t header[2];
+  memcpy (header, sctx->rx_data + offset, sizeof (header));
+
+  if (header[0] == CIPC_SHM_RECORD_WRAP)
+    {
+      position += sctx->capacity - offset;
+      offset = 0;
+
+      memcpy (header, sctx->rx_data, sizeof (header));
+    }
+
+  *data = sctx->rx_data + offset + CIPC_SHM_RECORD_HEADER_SIZE;
+  *length = header[0];
+  *next = position + record_size (header[0]);
+
+  return CIPC_OK;
+}
+
+static void
+release_to (cipc_shm_private *sctx, uint64_t position)
+{
+  atomic_store (&sctx->rx->head, position);
+
+  notify (&sctx->rx->space_futex, &sctx->rx->space_waiting, &sctx->counters.recv_syscalls);
+}
+
+static int
+has_views (const cipc_shm_private *sctx)
+{
+  return sctx->views_first != sctx->views_next;
+}
+
+// Makes room to record one more view.
+static cipc_err
+reserve_view (cipc_shm_private *sctx)
+{
+  if (sctx->views_next - sctx->views_first < sctx->views_cap)
+    return CIPC_OK;
+
+  size_t cap = sctx->views_cap ? sctx->views_cap * 2 : CIPC_SHM_INITIAL_VIEWS;
+
+  cipc_shm_view *views = malloc (cap * sizeof (cipc_shm_view));
+  if (!views)
+    return CIPC_BAD_ALLOC;
+
+  for (uint64_t n = sctx->views_first; n < sctx->views_next; n++)
+    views[n & (cap - 1)] = sctx->views[n & (sctx->views_cap - 1)];
+
+  free (sctx->views);
+  sctx->views = views;
+  sctx->views_cap = cap;
+
+  return CIPC_OK;
+}
+
+static cipc_err
+recv_copy (cipc_shm_private *sctx, char *buffer, size_t length, size_t *len_out)
+{
+  // No room for the terminator.
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  const char *data;
+  size_t msg_len;
+  uint64_t next;
+
+  cipc_err err = next_record (sctx, &data, &msg_len, &next);
+  if (err != CIPC_OK)
+    return err;
+
+  *len_out = msg_len;
+
+  if (msg_len > length - 1)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  memcpy (buffer, data, msg_len);
+  buffer[msg_len] = '\0';
+
+  sctx->rx_read = next;
+
+  if (!has_views (sctx))
+    release_to (sctx, next);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_shm_recv (void *context, char *buffer, size_t length, size_t *len_out)
+{
+  cipc_shm_private *sctx = (cipc_shm_private *)context;
+  uint64_t start = cipc_counters_start (&sctx->counters);
+
+  size_t msg_len = 0;
+  cipc_err err = recv_copy (sctx, buffer, length, &msg_len);
+
+  if (len_out != NULL)
+    *len_out = msg_len;
+
+  cipc_counters_received (&sctx->counters, err, err == CIPC_OK, msg_len, start);
+
+  return err;
+}
+
+static cipc_err
+recv_view (cipc_shm_private *sctx, cipc_msg *msg)
+{
+  const char *data;
+  size_t msg_len;
+  uint64_t next;
+
+  cipc_err err = reserve_view (sctx);
+  if (err != CIPC_OK)
+    return err;
+
+  err = next_record (sctx, &data, &msg_len, &next);
+  if (err != CIPC_OK)
+    return err;
+
+  sctx->rx_read = next;
+
+  uint64_t n = sctx->views_next++;
+  sctx->views[n & (sctx->views_cap - 1)] = (cipc_shm_view){ .end = next, .released = 0 };
+
+  msg->data = data;
+  msg->length = msg_len;
+  msg->handle = (void *)(uintptr_t)n;
+
+  return CIPC_OK;
+}
+
+// Views may be released in any order; each keeps its record, and those after it, in place.
+static cipc_err
+cipc_shm_recv_msg (void *context, cipc_msg *msg)
+{
+  cipc_shm_private *sctx = (cipc_shm_private *)context;
+  uint64_t start = cipc_counters_start (&sctx->counters);
+
+  cipc_err err = recv_view (sctx, msg);
+
+  cipc_counters_received (&sctx->counters, err, err == CIPC_OK,
+                          err == CIPC_OK ? msg->length : 0, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_shm_recv_batch (void *context, cipc_msg *msgs, size_t count, size_t *received)
+{
+  cipc_shm_private *sctx = (cipc_shm_private *)context;
+
+  if (!received || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  *received = 0;
+
+  if (count == 0)
+    return CIPC_OK;
+
+  uint64_t start = cipc_counters_start (&sctx->counters);
+
+  cipc_err err = recv_view (sctx, &msgs[0]);
+  if (err != CIPC_OK)
+    {
+      cipc_counters_received (&sctx->counters, err, 0, 0, start);
+      return err;
+    }
+
+  *received = 1;
+  uint64_t bytes = msgs[0].length;
+
+  while (*received < count && has_data (sctx, 0) && recv_view (sctx, &msgs[*received]) == CIPC_OK)
+    bytes += msgs[(*received)++].length;
+
+  cipc_counters_received (&sctx->counters, CIPC_OK, *received, bytes, start);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_shm_get_fd (void *context, int *fd, int *ready)
+{
+  cipc_shm_private *sctx = (cipc_shm_private *)context;
+
+  // The rings are signalled with futexes, so there is nothing to poll; cipc_poll rechecks.
+  *fd = -1;
+  *ready = has_data (sctx, 0);
+
+  return CIPC_OK;
+}
+
+static void
+cipc_shm_release_msg (void *context, cipc_msg *msg)
+{
+  cipc_shm_private *sctx = (cipc_shm_private *)context;
+
+  if (!msg || !msg->data)
+    return;
+
+  uint64_t n = (uint64_t)(uintptr_t)msg->handle;
+  sctx->views[n & (sctx->views_cap - 1)].released = 1;
+
+  // Only the oldest views free space; a later one stays recorded until those before it are back.
+  uint64_t first = sctx->views_first;
+  uint64_t head = 0;
+
+  while (sctx->views_first != sctx->views_next
+         && sctx->views[sctx->views_first & (sctx->views_cap - 1)].released)
+    head = sctx->views[sctx->views_first++ & (sctx->views_cap - 1)].end;
+
+  // Records copied out by recv after the last view are free as well.
+  if (!has_views (sctx))
+    release_to (sctx, sctx->rx_read);
+  else if (sctx->views_first != first)
+    release_to (sctx, head);
+
+  msg->data = NULL;
+  msg->length = 0;
+  msg->handle = NULL;
+}
+
+static uint64_t
+round_capacity (size_t capacity)
+{
+  uint64_t cap = 4096;
+  while (cap < capacity)
+    cap <<= 1;
+
+  return cap;
+}
+
+static void
+cipc_shm_private_free (cipc_shm_private *sctx)
+{
+  if (sctx->segment)
+    munmap (sctx->segment, sctx->mapped_size);
+
+  if (sctx->is_owner)
+    shm_unlink (sctx->name);
+
+  cipc_counters_destroy (&sctx->counters);
+  free (sctx->views);
+  free (sctx->name);
+  free (sctx);
+}
+
+static cipc_err
+map_segment (cipc_shm_private *sctx, int fd)
+{
+  void *addr = mmap (NULL, sctx->mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED)
+    {
+      fprintf (stderr, "mmap failed: %s\n", strerror (errno));
+      return CIPC_BAD_SHM_MAP;
+    }
+
+  sctx->segment = addr;
+
+  return CIPC_OK;
+}
+
+static cipc_err
+create_segment (cipc_shm_private *sctx, const cipc_shm_config *cfg)
+{
+  sctx->capacity = round_capacity (cfg->capacity ? cfg->capacity : CIPC_SHM_DEFAULT_CAPACITY);
+  sctx->mapped_size = sizeof (cipc_shm_segment) + 2 * sctx->capacity;
+
+  if (cfg->unlink_stale)
+    shm_unlink (cfg->name);
+
+  int fd = shm_open (cfg->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    {
+      if (errno == EEXIST)
+        fprintf (stderr, "shm_open failed: %s is already bound\n", cfg->name);
+      else
+        fprintf (stderr, "shm_open failed: %s\n", strerror (errno));
+
+      return CIPC_BAD_SHM_OPEN;
+    }
+
+  sctx->is_owner = 1;
+
+  if (ftruncate (fd, sctx->mapped_size) < 0)
+    {
+      fprintf (stderr, "ftruncate failed: %s\n", strerror (errno));
+      close (fd);
+      return CIPC_BAD_SHM_MAP;
+    }
+
+  cipc_err err = map_segment (sctx, fd);
+  close (fd);
+
+  if (err != CIPC_OK)
+    return err;
+
+  sctx->segment->capacity = sctx->capacity;
+
+  atomic_store (&sctx->segment->magic, CIPC_SHM_MAGIC);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+try_open_segment (cipc_shm_private *sctx, const char *name)
+{
+  int fd = shm_open (name, O_RDWR, 0600);
+  if (fd < 0)
+    return CIPC_BAD_SHM_OPEN;
+
+  struct stat st;
+  if (fstat (fd, &st) < 0 || (size_t)st.st_size < sizeof (cipc_shm_segment))
+    {
+      close (fd);
+      return CIPC_BAD_SHM_OPEN;
+    }
+
+  sctx->mapped_size = st.st_size;
+
+  cipc_err err = map_segment (sctx, fd);
+  close (fd);
+
+  if (err != CIPC_OK)
+    return err;
+
+  sctx->capacity = sctx->segment->capacity;
+
+  if (atomic_load (&sctx->segment->magic) != CIPC_SHM_MAGIC
+      || sizeof (cipc_shm_segment) + 2 * sctx->capacity > sctx->mapped_size)
+    {
+      munmap (sctx->segment, sctx->mapped_size);
+      sctx->segment = NULL;
+
+      return CIPC_BAD_SHM_OPEN;
+    }
+
+  return CIPC_OK;
+}
+
+static cipc_err
+open_segment_with_retries (cipc_shm_private *sctx, const cipc_shm_config *cfg)
+{
+  int retry_count = 0;
+  int retry_delay_ms = 10;
+
+  while (1)
+    {
+      if (try_open_segment (sctx, cfg->name) == CIPC_OK)
+        return CIPC_OK;
+
+      if (retry_count >= cfg->sockopt_retries)
+        {
+          fprintf (stderr, "Open of %s failed after %d retries\n", cfg->name,
+                   cfg->sockopt_retries);
+          return CIPC_BAD_SHM_OPEN;
+        }
+
+      retry_count++;
+      cipc_counter_add (&sctx->counters.reconnects, 1);
+
+      usleep (retry_delay_ms * 1000);
+      retry_delay_ms = retry_delay_ms * 2 > 1000 ? 1000 : retry_delay_ms * 2;
+    }
+}
+
+static cipc_err
+cipc_shm_init (void **context, const void *config)
+{
+  if (!context || !config)
+    return CIPC_NULL_PTR;
+
+  const cipc_shm_config *cfg = (const cipc_shm_config *)config;
+  if (!cfg->name)
+    return CIPC_NULL_PTR;
+
+  cipc_shm_private *sctx = calloc (1, sizeof (cipc_shm_private));
+  if (!sctx)
+    return CIPC_BAD_ALLOC;
+
+  cipc_counters_init (&sctx->counters);
+
+  sctx->name = strdup (cfg->name);
+  if (!sctx->name)
+    {
+      free (sctx);
+      return CIPC_BAD_ALLOC;
+    }
+
+  cipc_err err = (cfg->mode == CIPC_SHM_MODE_BIND) ? create_segment (sctx, cfg)
+                                                   : open_segment_with_retries (sctx, cfg);
+  if (err != CIPC_OK)
+    {
+      cipc_shm_private_free (sctx);
+      return err;
+    }
+
+  char *data = (char *)sctx->segment + sizeof (cipc_shm_segment);
+  int tx_index = cfg->mode == CIPC_SHM_MODE_BIND ? 0 : 1;
+
+  sctx->tx = &sctx->segment->rings[tx_index];
+  sctx->tx_data = data + tx_index * sctx->capacity;
+  sctx->rx = &sctx->segment->rings[1 - tx_index];
+  sctx->rx_data = data + (1 - tx_index) * sctx->capacity;
+
+  sctx->rx_read = atomic_load (&sctx->rx->head);
+
+  // Spinning cannot help when the peer has no other core to run on.
+  sctx->spin_count = cfg->spin_count ? cfg->spin_count : CIPC_SHM_DEFAULT_SPIN_COUNT;
+  if (sysconf (_SC_NPROCESSORS_ONLN) < 2)
+    sctx->spin_count = 0;
+
+  sctx->sndtimeo = cfg->sockopt_sndtimeo;
+  sctx->rcvtimeo = cfg->sockopt_rcvtimeo;
+
+  *context = sctx;
+
+  return CIPC_OK;
+}
+
+static cipc_counters *
+cipc_shm_counters (void *context)
+{
+  cipc_shm_private *sctx = (cipc_shm_private *)context;
+
+  return &sctx->counters;
+}
+
+static void
+cipc_shm_free (void *context)
+{
+  if (context)
+    cipc_shm_private_free ((cipc_shm_private *)context);
+}
+
+cipc *
+cipc_create_shm (void)
+{
+  cipc *instance = calloc (1, sizeof (cipc));
+  if (!instance)
+    return NULL;
+
+  instance->init = cipc_shm_init;
+  instance->send = cipc_shm_send;
+  instance->sendv = cipc_shm_sendv;
+  instance->recv = cipc_shm_recv;
+  instance->recv_msg = cipc_shm_recv_msg;
+  instance->release_msg = cipc_shm_release_msg;
+  instance->send_batch = cipc_shm_send_batch;
+  instance->recv_batch = cipc_shm_recv_batch;
+  instance->get_fd = cipc_shm_get_fd;
+  instance->counters = cipc_shm_counters;
+  instance->free = cipc_shm_free;
+  instance->context = NULL;
+
+  return instance;
+}
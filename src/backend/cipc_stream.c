@@ -0,0 +1,1514 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "backend/cipc_stream.h"
+#include "cipc.h"
+
+#define CIPC_STREAM_SENDV_STACK_IOV 16
+#define CIPC_STREAM_BATCH_IOV 512
+#define CIPC_STREAM_MAX_RX_FDS 16
+// Descriptors held for frames not read yet; a peer sending more than that gets the rest closed.
+#define CIPC_STREAM_MAX_QUEUED_FDS 64
+#define CIPC_STREAM_FILE_COPY_SIZE (64 * 1024)
+#define CIPC_STREAM_FILE_PIPE_SIZE (1024 * 1024)
+#define CIPC_STREAM_REQUIRED_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+// Every borrowed view's handle starts with its release function.
+typedef void (*cipc_stream_release_fn) (void *handle);
+
+// Receive buffer shared with the messages borrowed through recv_msg. Bytes before
+// rx_head may still be referenced, so a shared block is replaced rather than compacted.
+struct cipc_stream_rx_block
+{
+  cipc_stream_release_fn release;
+  atomic_size_t refcount;
+  size_t capacity;
+  char data[];
+};
+
+typedef struct
+{
+  cipc_stream_release_fn release;
+  void *addr;
+  size_t length;
+} cipc_stream_mapping;
+
+static void
+rx_block_unref (void *handle)
+{
+  cipc_stream_rx_block *block = handle;
+
+  if (block && atomic_fetch_sub_explicit (&block->refcount, 1, memory_order_acq_rel) == 1)
+    free (block);
+}
+
+static cipc_stream_rx_block *
+rx_block_new (size_t capacity)
+{
+  cipc_stream_rx_block *block = malloc (sizeof (cipc_stream_rx_block) + capacity);
+  if (!block)
+    return NULL;
+
+  block->release = rx_block_unref;
+  atomic_init (&block->refcount, 1);
+  block->capacity = capacity;
+
+  return block;
+}
+
+static void
+mapping_free (void *handle)
+{
+  cipc_stream_mapping *mapping = handle;
+
+  if (mapping->length > 0)
+    munmap (mapping->addr, mapping->length);
+
+  free (mapping);
+}
+
+// The kernel drops out of quick-ACK mode on its own, so the flag has to be renewed.
+static void
+rearm_quickack (cipc_stream *stream)
+{
+  int one = 1;
+
+  if (stream->quickack)
+    setsockopt (stream->fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof (one));
+}
+
+static void
+set_cork (cipc_stream *stream, int on)
+{
+  setsockopt (stream->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof (on));
+}
+
+void
+cipc_stream_init (cipc_stream *stream, int fd, int framed, size_t rcvbuf_size,
+                  size_t max_message_size, cipc_err send_err, cipc_err recv_err,
+                  cipc_counters *counters)
+{
+  memset (stream, 0, sizeof (cipc_stream));
+
+  stream->fd = fd;
+  stream->framed = framed;
+  stream->rx_initial_cap = rcvbuf_size;
+  stream->max_message_size = max_message_size;
+  stream->send_err = send_err;
+  stream->recv_err = recv_err;
+  stream->counters = counters;
+}
+
+void
+cipc_stream_destroy (cipc_stream *stream)
+{
+  if (stream->fd >= 0)
+    close (stream->fd);
+
+  for (size_t i = 0; i < stream->rx_fds_count; i++)
+    close (stream->rx_fds[i]);
+
+  free (stream->rx_fds);
+  rx_block_unref (stream->rx);
+
+  // A stream is reused for the next connection of a connector, so no partial frame or
+  // descriptor of this one may survive.
+  stream->fd = -1;
+  stream->rx = NULL;
+  stream->rx_head = 0;
+  stream->rx_tail = 0;
+  stream->rx_fds = NULL;
+  stream->rx_fds_count = 0;
+  stream->rx_fds_cap = 0;
+}
+
+void
+cipc_stream_encode_header (uint32_t header[2], size_t length, uint32_t flags)
+{
+  header[0] = htonl ((uint32_t)length);
+  header[1] = htonl (flags);
+}
+
+int
+cipc_stream_set_timeouts (int sockfd, int sndtimeo, int rcvtimeo)
+{
+  struct timeval tv_snd, tv_rcv;
+
+  tv_snd.tv_sec = sndtimeo / 1000;
+  tv_snd.tv_usec = (sndtimeo % 1000) * 1000;
+
+  tv_rcv.tv_sec = rcvtimeo / 1000;
+  tv_rcv.tv_usec = (rcvtimeo % 1000) * 1000;
+
+  if (setsockopt (sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv_snd, sizeof (tv_snd)) < 0)
+    return -1;
+
+  if (setsockopt (sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv_rcv, sizeof (tv_rcv)) < 0)
+    return -1;
+
+  return 0;
+}
+
+int
+cipc_stream_connect_with_retries (int sockfd, const struct sockaddr *addr, socklen_t addrlen,
+                                  int retries, cipc_counters *counters)
+{
+  int retry_count = 0;
+  int retry_delay_ms = 100;
+
+  while (1)
+    {
+      if (connect (sockfd, addr, addrlen) == 0)
+        {
+          return 0;
+        }
+
+      if (retry_count >= retries)
+        {
+          return -1;
+        }
+
+      retry_count++;
+      cipc_counter_add (&counters->reconnects, 1);
+
+      usleep (retry_delay_ms * 1000);
+      retry_delay_ms = retry_delay_ms * 2 > 5000 ? 5000 : retry_delay_ms * 2;
+    }
+}
+
+cipc_err
+cipc_stream_write (cipc_stream *stream, struct iovec *iov, size_t iovcnt, int pass_fd)
+{
+  struct msghdr msg;
+  memset (&msg, 0, sizeof (msg));
+
+  union
+  {
+    char buf[CMSG_SPACE (sizeof (int))];
+    struct cmsghdr align;
+  } control;
+
+  if (pass_fd >= 0)
+    {
+      msg.msg_control = control.buf;
+      msg.msg_controllen = sizeof (control.buf);
+
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN (sizeof (int));
+      memcpy (CMSG_DATA (cmsg), &pass_fd, sizeof (int));
+    }
+
+  while (iovcnt > 0)
+    {
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iovcnt > UIO_MAXIOV ? UIO_MAXIOV : iovcnt;
+
+      ssize_t sent = sendmsg (stream->fd, &msg, MSG_NOSIGNAL);
+      cipc_counter_add (&stream->counters->send_syscalls, 1);
+
+      if (sent < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          // SO_SNDTIMEO expired.
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            cipc_counter_add (&stream->counters->send_timeouts, 1);
+
+          fprintf (stderr, "Send failed: %s\n", strerror (errno));
+
+          return stream->send_err;
+        }
+
+      // The descriptor travels with the first chunk only.
+      msg.msg_control = NULL;
+      msg.msg_controllen = 0;
+
+      size_t submitted = msg.msg_iovlen;
+
+      while (iovcnt > 0 && (size_t)sent >= iov->iov_len)
+        {
+          sent -= iov->iov_len;
+          iov++;
+          iovcnt--;
+          submitted--;
+        }
+
+      if (iovcnt > 0 && submitted > 0)
+        cipc_counter_add (&stream->counters->short_writes, 1);
+
+      if (iovcnt > 0)
+        {
+          iov->iov_base = (char *)iov->iov_base + sent;
+          iov->iov_len -= sent;
+        }
+    }
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_stream_write_some (cipc_stream *stream, const struct iovec *iov, size_t iovcnt,
+                        size_t *written)
+{
+  struct msghdr msg;
+  memset (&msg, 0, sizeof (msg));
+
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_iovlen = iovcnt > UIO_MAXIOV ? UIO_MAXIOV : iovcnt;
+
+  *written = 0;
+
+  while (1)
+    {
+      ssize_t sent = sendmsg (stream->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+      cipc_counter_add (&stream->counters->send_syscalls, 1);
+
+      if (sent >= 0)
+        {
+          size_t total = 0;
+          for (size_t i = 0; i < msg.msg_iovlen; i++)
+            total += iov[i].iov_len;
+
+          if ((size_t)sent < total)
+            cipc_counter_add (&stream->counters->short_writes, 1);
+
+          *written = (size_t)sent;
+          return CIPC_OK;
+        }
+
+      if (errno == EINTR)
+        continue;
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return CIPC_OK;
+
+      return stream->send_err;
+    }
+}
+
+static cipc_err
+send_via_memfd (cipc_stream *stream, const cipc_iovec *iov, size_t iovcnt, size_t total)
+{
+  int memfd = memfd_create ("cipc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (memfd < 0)
+    return stream->send_err;
+
+  cipc_err err = CIPC_OK;
+
+  if (ftruncate (memfd, total) < 0)
+    err = stream->send_err;
+
+  off_t offset = 0;
+  for (size_t i = 0; i < iovcnt && err == CIPC_OK; i++)
+    {
+      size_t done = 0;
+      while (done < iov[i].length)
+        {
+          ssize_t n = pwrite (memfd, (const char *)iov[i].base + done, iov[i].length - done,
+                              offset);
+          if (n < 0)
+            {
+              if (errno == EINTR)
+                continue;
+
+              err = stream->send_err;
+              break;
+            }
+
+          done += n;
+          offset += n;
+        }
+    }
+
+  if (err == CIPC_OK
+      && fcntl (memfd, F_ADD_SEALS, CIPC_STREAM_REQUIRED_SEALS | F_SEAL_SEAL) < 0)
+    err = stream->send_err;
+
+  if (err == CIPC_OK)
+    {
+      uint64_t size = htobe64 (total);
+
+      uint32_t header[2];
+      cipc_stream_encode_header (header, sizeof (size), CIPC_STREAM_FLAG_FD);
+
+      struct iovec vec[2] = {
+        { .iov_base = header, .iov_len = sizeof (header) },
+        { .iov_base = &size, .iov_len = sizeof (size) },
+      };
+
+      err = cipc_stream_write (stream, vec, 2, memfd);
+    }
+
+  close (memfd);
+
+  return err;
+}
+
+static cipc_err
+write_message (cipc_stream *stream, const cipc_iovec *iov, size_t iovcnt, size_t total,
+               uint32_t flags)
+{
+  // The frame header holds the length in 32 bits, whatever max_message_size allows.
+  if (stream->framed && (total > UINT32_MAX || total > stream->max_message_size))
+    return CIPC_BAD_FRAME;
+
+  if (stream->framed && stream->fd_threshold > 0 && total >= stream->fd_threshold)
+    return send_via_memfd (stream, iov, iovcnt, total);
+
+  struct iovec stack_vec[CIPC_STREAM_SENDV_STACK_IOV];
+  struct iovec *vec = stack_vec;
+
+  if (iovcnt + 1 > CIPC_STREAM_SENDV_STACK_IOV)
+    {
+      vec = malloc ((iovcnt + 1) * sizeof (struct iovec));
+      if (!vec)
+        return CIPC_BAD_ALLOC;
+    }
+
+  uint32_t header[2];
+  cipc_stream_encode_header (header, total, flags);
+
+  size_t count = 0;
+
+  if (stream->framed)
+    {
+      vec[count].iov_base = header;
+      vec[count].iov_len = sizeof (header);
+      count++;
+    }
+
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      if (iov[i].length == 0)
+        continue;
+
+      vec[count].iov_base = (void *)iov[i].base;
+      vec[count].iov_len = iov[i].length;
+      count++;
+    }
+
+  cipc_err err = cipc_stream_write (stream, vec, count, -1);
+
+  if (vec != stack_vec)
+    free (vec);
+
+  return err;
+}
+
+cipc_err
+cipc_stream_sendv (cipc_stream *stream, const cipc_iovec *iov, size_t iovcnt, uint32_t flags)
+{
+  uint64_t start = cipc_counters_start (stream->counters);
+
+  size_t total = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    total += iov[i].length;
+
+  cipc_err err = write_message (stream, iov, iovcnt, total, flags);
+
+  cipc_counters_sent (stream->counters, err, err == CIPC_OK, total, start);
+
+  return err;
+}
+
+cipc_err
+cipc_stream_send_batch (cipc_stream *stream, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  struct iovec vec[CIPC_STREAM_BATCH_IOV];
+  uint32_t headers[CIPC_STREAM_BATCH_IOV / 2][2];
+
+  uint64_t start = cipc_counters_start (stream->counters);
+  size_t done = 0;
+  size_t bytes = 0;
+  cipc_err err = CIPC_OK;
+  int corked = 0;
+
+  if (sent != NULL)
+    *sent = 0;
+
+  while (done < count)
+    {
+      size_t n = 0;
+      size_t next = done;
+
+      // Coalesce header and payload of consecutive messages into one gather write.
+      while (next < count && n + 2 <= CIPC_STREAM_BATCH_IOV)
+        {
+          size_t length = msgs[next].length;
+
+          // Left to write_message, which rejects it.
+          if (stream->framed && (length > UINT32_MAX || length > stream->max_message_size))
+            break;
+
+          if (stream->framed && stream->fd_threshold > 0 && length >= stream->fd_threshold)
+            break;
+
+          if (stream->framed)
+            {
+              cipc_stream_encode_header (headers[n / 2], length, 0);
+
+              vec[n].iov_base = headers[n / 2];
+              vec[n].iov_len = CIPC_STREAM_FRAME_HEADER_SIZE;
+              n++;
+            }
+
+          vec[n].iov_base = (void *)msgs[next].base;
+          vec[n].iov_len = length;
+          n++;
+
+          next++;
+        }
+
+      // Segments stay full across writes; uncorking below pushes out the tail.
+      if (stream->cork && !corked && next < count)
+        {
+          set_cork (stream, 1);
+          corked = 1;
+        }
+
+      if (n > 0)
+        err = cipc_stream_write (stream, vec, n, -1);
+      else
+        {
+          err = write_message (stream, &msgs[next], 1, msgs[next].length, 0);
+          next++;
+        }
+
+      if (err != CIPC_OK)
+        break;
+
+      for (size_t i = done; i < next; i++)
+        bytes += msgs[i].length;
+
+      done = next;
+
+      if (sent != NULL)
+        *sent = done;
+    }
+
+  if (corked)
+    set_cork (stream, 0);
+
+  cipc_counters_sent (stream->counters, err, done, bytes, start);
+
+  return err;
+}
+
+// Writes a frame header held back with MSG_MORE, so it leaves in one segment with the body.
+static cipc_err
+write_header_more (cipc_stream *stream, const uint32_t header[2])
+{
+  const char *data = (const char *)header;
+  size_t left = CIPC_STREAM_FRAME_HEADER_SIZE;
+
+  while (left > 0)
+    {
+      ssize_t sent = send (stream->fd, data, left, MSG_NOSIGNAL | MSG_MORE);
+      cipc_counter_add (&stream->counters->send_syscalls, 1);
+
+      if (sent < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            cipc_counter_add (&stream->counters->send_timeouts, 1);
+
+          fprintf (stderr, "Send failed: %s\n", strerror (errno));
+
+          return stream->send_err;
+        }
+
+      data += sent;
+      left -= sent;
+    }
+
+  return CIPC_OK;
+}
+
+// For descriptors sendfile cannot read from.
+static cipc_err
+copy_range_out (cipc_stream *stream, int fd, off_t *pos, size_t length)
+{
+  char buffer[CIPC_STREAM_FILE_COPY_SIZE];
+
+  while (length > 0)
+    {
+      ssize_t n = pread (fd, buffer, length < sizeof (buffer) ? length : sizeof (buffer), *pos);
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+        {
+          fprintf (stderr, "File read failed: %s\n", n < 0 ? strerror (errno) : "end of file");
+
+          return stream->send_err;
+        }
+
+      struct iovec iov = { .iov_base = buffer, .iov_len = (size_t)n };
+
+      cipc_err err = cipc_stream_write (stream, &iov, 1, -1);
+      if (err != CIPC_OK)
+        return err;
+
+      *pos += n;
+      length -= n;
+    }
+
+  return CIPC_OK;
+}
+
+static cipc_err
+sendfile_range (cipc_stream *stream, int fd, off_t *pos, size_t length)
+{
+  while (length > 0)
+    {
+      ssize_t sent = sendfile (stream->fd, fd, pos, length);
+      cipc_counter_add (&stream->counters->send_syscalls, 1);
+
+      if (sent < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          if (errno == EINVAL || errno == ENOSYS)
+            return copy_range_out (stream, fd, pos, length);
+
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            cipc_counter_add (&stream->counters->send_timeouts, 1);
+
+          fprintf (stderr, "Sendfile failed: %s\n", strerror (errno));
+
+          return stream->send_err;
+        }
+
+      // The file shrank after the range was checked; the frame can no longer be completed.
+      if (sent == 0)
+        {
+          fprintf (stderr, "Sendfile failed: file ended early\n");
+
+          return stream->send_err;
+        }
+
+      length -= sent;
+    }
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_stream_send_file (cipc_stream *stream, int fd, int64_t offset, size_t length)
+{
+  struct stat st;
+
+  // Refused before anything is written; failing later leaves a frame short and the connection
+  // unusable.
+  if (offset < 0 || fstat (fd, &st) < 0
+      || (S_ISREG (st.st_mode) && (uint64_t)offset + length > (uint64_t)st.st_size))
+    {
+      fprintf (stderr, "Send file failed: range outside the file\n");
+
+      return CIPC_BAD_BUFFER_SIZE;
+    }
+
+  uint64_t start = cipc_counters_start (stream->counters);
+  off_t pos = offset;
+  size_t left = length;
+  cipc_err err = CIPC_OK;
+
+  do
+    {
+      size_t chunk = left < CIPC_STREAM_FILE_CHUNK ? left : CIPC_STREAM_FILE_CHUNK;
+
+      if (stream->framed)
+        {
+          uint32_t header[2];
+          cipc_stream_encode_header (header, chunk, chunk < left ? CIPC_STREAM_FLAG_MORE : 0);
+
+          err = write_header_more (stream, header);
+        }
+
+      if (err == CIPC_OK)
+        err = sendfile_range (stream, fd, &pos, chunk);
+
+      if (err != CIPC_OK)
+        break;
+
+      left -= chunk;
+    }
+  while (left > 0);
+
+  cipc_counters_sent (stream->counters, err, err == CIPC_OK, length, start);
+
+  return err;
+}
+
+static cipc_err
+reserve_rx_buffer (cipc_stream *stream, size_t needed)
+{
+  size_t pending = stream->rx_tail - stream->rx_head;
+
+  if (!stream->rx)
+    {
+      stream->rx
+          = rx_block_new (needed > stream->rx_initial_cap ? needed : stream->rx_initial_cap);
+      if (!stream->rx)
+        return CIPC_BAD_ALLOC;
+
+      stream->rx_head = stream->rx_tail = 0;
+
+      return CIPC_OK;
+    }
+
+  if (needed <= stream->rx->capacity - stream->rx_head)
+    return CIPC_OK;
+
+  if (atomic_load_explicit (&stream->rx->refcount, memory_order_acquire) == 1
+      && needed <= stream->rx->capacity)
+    {
+      memmove (stream->rx->data, stream->rx->data + stream->rx_head, pending);
+    }
+  else
+    {
+      size_t cap = stream->rx->capacity;
+      while (cap < needed)
+        cap *= 2;
+
+      cipc_stream_rx_block *block = rx_block_new (cap);
+      if (!block)
+        return CIPC_BAD_ALLOC;
+
+      memcpy (block->data, stream->rx->data + stream->rx_head, pending);
+
+      rx_block_unref (stream->rx);
+      stream->rx = block;
+    }
+
+  stream->rx_head = 0;
+  stream->rx_tail = pending;
+
+  return CIPC_OK;
+}
+
+static cipc_err
+queue_rx_fds (cipc_stream *stream, struct msghdr *msg)
+{
+  cipc_err err = CIPC_OK;
+
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (msg); cmsg; cmsg = CMSG_NXTHDR (msg, cmsg))
+    {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        continue;
+
+      size_t count = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+      int *fds = (int *)CMSG_DATA (cmsg);
+
+      for (size_t i = 0; i < count; i++)
+        {
+          if (stream->rx_fds_count >= CIPC_STREAM_MAX_QUEUED_FDS)
+            {
+              close (fds[i]);
+              continue;
+            }
+
+          if (err == CIPC_OK && stream->rx_fds_count == stream->rx_fds_cap)
+            {
+              size_t cap = stream->rx_fds_cap ? stream->rx_fds_cap * 2 : 4;
+              int *grown = realloc (stream->rx_fds, cap * sizeof (int));
+              if (!grown)
+                err = CIPC_BAD_ALLOC;
+              else
+                {
+                  stream->rx_fds = grown;
+                  stream->rx_fds_cap = cap;
+                }
+            }
+
+          if (err != CIPC_OK)
+            {
+              close (fds[i]);
+              continue;
+            }
+
+          stream->rx_fds[stream->rx_fds_count++] = fds[i];
+        }
+    }
+
+  if (msg->msg_flags & MSG_CTRUNC)
+    return stream->recv_err;
+
+  return err;
+}
+
+static cipc_err
+fill_rx_buffer (cipc_stream *stream, size_t needed)
+{
+  if (stream->fed)
+    return CIPC_WOULD_BLOCK;
+
+  if (stream->packet)
+    {
+      ssize_t size;
+      do
+        size = recv (stream->fd, NULL, 0,
+                     MSG_PEEK | MSG_TRUNC | (stream->nonblocking ? MSG_DONTWAIT : 0));
+      while (size < 0 && errno == EINTR);
+
+      cipc_counter_add (&stream->counters->recv_syscalls, 1);
+
+      if (size < 0 && stream->nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return CIPC_WOULD_BLOCK;
+
+      if (size <= 0)
+        return stream->recv_err;
+
+      size_t packet_needed = stream->rx_tail - stream->rx_head + (size_t)size;
+      if (packet_needed > needed)
+        needed = packet_needed;
+    }
+
+  cipc_err err = reserve_rx_buffer (stream, needed);
+  if (err != CIPC_OK)
+    return err;
+
+  struct iovec iov = { .iov_base = stream->rx->data + stream->rx_tail,
+                       .iov_len = stream->rx->capacity - stream->rx_tail };
+
+  union
+  {
+    char buf[CMSG_SPACE (CIPC_STREAM_MAX_RX_FDS * sizeof (int))];
+    struct cmsghdr align;
+  } control;
+
+  struct msghdr msg;
+  int64_t spin_until = stream->nonblocking ? 0 : cipc_spin_deadline (&stream->spin);
+
+  while (1)
+    {
+      memset (&msg, 0, sizeof (msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+
+      if (stream->pass_fds)
+        {
+          msg.msg_control = control.buf;
+          msg.msg_controllen = sizeof (control.buf);
+        }
+
+      ssize_t rcvd = recvmsg (stream->fd, &msg,
+                              MSG_CMSG_CLOEXEC
+                                  | (stream->nonblocking || spin_until ? MSG_DONTWAIT : 0));
+      cipc_counter_add (&stream->counters->recv_syscalls, 1);
+
+      if (rcvd < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          if (spin_until && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+              if (!cipc_spin_wait (spin_until))
+                spin_until = 0;
+
+              continue;
+            }
+
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+              if (stream->nonblocking)
+                return CIPC_WOULD_BLOCK;
+
+              // SO_RCVTIMEO expired.
+              cipc_counter_add (&stream->counters->recv_timeouts, 1);
+            }
+
+          fprintf (stderr, "Recv failed: %s\n", strerror (errno));
+
+          return stream->recv_err;
+        }
+
+      if (rcvd == 0)
+        return stream->recv_err;
+
+      stream->rx_tail += rcvd;
+      rearm_quickack (stream);
+      cipc_spin_arrived (&stream->spin);
+
+      if (stream->rx_tail - stream->rx_head < needed)
+        cipc_counter_add (&stream->counters->short_reads, 1);
+
+      if (stream->pass_fds && msg.msg_controllen > 0)
+        return queue_rx_fds (stream, &msg);
+
+      return CIPC_OK;
+    }
+}
+
+cipc_err
+cipc_stream_feed (cipc_stream *stream, const char *data, size_t length)
+{
+  cipc_err err = reserve_rx_buffer (stream, stream->rx_tail - stream->rx_head + length);
+  if (err != CIPC_OK)
+    return err;
+
+  memcpy (stream->rx->data + stream->rx_tail, data, length);
+  stream->rx_tail += length;
+
+  return CIPC_OK;
+}
+
+void
+cipc_stream_consume (cipc_stream *stream, size_t count)
+{
+  stream->rx_head += count;
+
+  if (stream->rx_head == stream->rx_tail
+      && atomic_load_explicit (&stream->rx->refcount, memory_order_acquire) == 1)
+    stream->rx_head = stream->rx_tail = 0;
+}
+
+// Reads whatever the socket holds without blocking and reports whether the next receive
+// can complete without waiting. Errors count as ready so that the receive surfaces them.
+int
+cipc_stream_poll_ready (cipc_stream *stream)
+{
+  if (!stream->framed)
+    {
+      if (stream->rx && stream->rx_tail > stream->rx_head)
+        return 1;
+
+      struct pollfd pfd = { .fd = stream->fd, .events = POLLIN };
+      cipc_counter_add (&stream->counters->recv_syscalls, 1);
+
+      return poll (&pfd, 1, 0) != 0;
+    }
+
+  int nonblocking = stream->nonblocking;
+  stream->nonblocking = 1;
+
+  cipc_stream_frame frame;
+  cipc_err err = cipc_stream_next_frame (stream, &frame);
+
+  stream->nonblocking = nonblocking;
+
+  return err != CIPC_WOULD_BLOCK;
+}
+
+cipc_err
+cipc_stream_next_frame (cipc_stream *stream, cipc_stream_frame *frame)
+{
+  while (1)
+    {
+      size_t pending = stream->rx_tail - stream->rx_head;
+      size_t needed = CIPC_STREAM_FRAME_HEADER_SIZE;
+
+      if (pending >= CIPC_STREAM_FRAME_HEADER_SIZE)
+        {
+          uint32_t header[2];
+          memcpy (header, stream->rx->data + stream->rx_head, sizeof (header));
+
+          frame->length = ntohl (header[0]);
+          frame->flags = ntohl (header[1]);
+
+          if (frame->length > stream->max_message_size)
+            return CIPC_BAD_FRAME;
+
+          needed += frame->length;
+
+          if (pending >= needed)
+            {
+              frame->data = stream->rx->data + stream->rx_head + CIPC_STREAM_FRAME_HEADER_SIZE;
+
+              return CIPC_OK;
+            }
+        }
+
+      cipc_err err = fill_rx_buffer (stream, needed);
+      if (err != CIPC_OK)
+        return err;
+    }
+}
+
+// Drops an out-of-band frame together with its descriptor, when one arrived.
+static void
+consume_fd_frame (cipc_stream *stream, const cipc_stream_frame *frame)
+{
+  if (stream->rx_fds_count > 0)
+    {
+      close (stream->rx_fds[0]);
+
+      stream->rx_fds_count--;
+      memmove (stream->rx_fds, stream->rx_fds + 1, stream->rx_fds_count * sizeof (int));
+    }
+
+  cipc_stream_consume (stream, CIPC_STREAM_FRAME_HEADER_SIZE + frame->length);
+}
+
+// Validates an out-of-band frame and returns its (not yet dequeued) memfd and size. An invalid
+// frame is dropped, so that the next receive moves on to the frame after it.
+static cipc_err
+peek_fd_payload (cipc_stream *stream, const cipc_stream_frame *frame, int *fd, size_t *size)
+{
+  uint64_t wire_size;
+  struct stat st;
+
+  if (!stream->pass_fds || frame->length != sizeof (wire_size) || stream->rx_fds_count == 0)
+    goto bad;
+
+  memcpy (&wire_size, frame->data, sizeof (wire_size));
+  *size = be64toh (wire_size);
+  *fd = stream->rx_fds[0];
+
+  int seals = fcntl (*fd, F_GET_SEALS);
+
+  if (seals < 0 || (seals & CIPC_STREAM_REQUIRED_SEALS) != CIPC_STREAM_REQUIRED_SEALS
+      || fstat (*fd, &st) < 0 || (uint64_t)st.st_size != *size
+      || *size > stream->max_message_size)
+    goto bad;
+
+  return CIPC_OK;
+
+bad:
+  consume_fd_frame (stream, frame);
+
+  return CIPC_BAD_FRAME;
+}
+
+static cipc_err
+read_fd_payload (int fd, char *buffer, size_t size)
+{
+  size_t done = 0;
+
+  while (done < size)
+    {
+      ssize_t n = pread (fd, buffer + done, size - done, done);
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+        return CIPC_BAD_FRAME;
+
+      done += n;
+    }
+
+  return CIPC_OK;
+}
+
+static cipc_err
+recv_copy (cipc_stream *stream, char *buffer, size_t length, size_t *len_out)
+{
+  // No room for the terminator.
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  if (!stream->framed)
+    {
+      int64_t spin_until = cipc_spin_deadline (&stream->spin);
+      ssize_t rcvd;
+
+      while (1)
+        {
+          rcvd = recv (stream->fd, buffer, length - 1, spin_until ? MSG_DONTWAIT : 0);
+          cipc_counter_add (&stream->counters->recv_syscalls, 1);
+
+          if (rcvd >= 0 || !spin_until || (errno != EAGAIN && errno != EWOULDBLOCK))
+            break;
+
+          if (!cipc_spin_wait (spin_until))
+            spin_until = 0;
+        }
+
+      if (rcvd < 0)
+        {
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            cipc_counter_add (&stream->counters->recv_timeouts, 1);
+
+          fprintf (stderr, "Recv failed: %s\n", strerror (errno));
+
+          return stream->recv_err;
+        }
+
+      if (rcvd == 0)
+        return stream->recv_err;
+
+      rearm_quickack (stream);
+      cipc_spin_arrived (&stream->spin);
+
+      buffer[rcvd] = '\0';
+
+      if (len_out != NULL)
+        *len_out = (size_t)rcvd;
+
+      return CIPC_OK;
+    }
+
+  cipc_stream_frame frame;
+
+  cipc_err err = cipc_stream_next_frame (stream, &frame);
+  if (err != CIPC_OK)
+    return err;
+
+  int fd = -1;
+  size_t msg_len = frame.length;
+
+  if (frame.flags & CIPC_STREAM_FLAG_FD)
+    {
+      err = peek_fd_payload (stream, &frame, &fd, &msg_len);
+      if (err != CIPC_OK)
+        return err;
+    }
+
+  if (len_out != NULL)
+    *len_out = msg_len;
+
+  // The frame stays queued so the caller can retry with a larger buffer.
+  if (msg_len >= length)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  if (fd >= 0)
+    {
+      err = read_fd_payload (fd, buffer, msg_len);
+
+      consume_fd_frame (stream, &frame);
+
+      if (err != CIPC_OK)
+        return err;
+    }
+  else
+    {
+      memcpy (buffer, frame.data, msg_len);
+
+      cipc_stream_consume (stream, CIPC_STREAM_FRAME_HEADER_SIZE + msg_len);
+    }
+
+  buffer[msg_len] = '\0';
+
+  return CIPC_OK;
+}
+
+static cipc_err
+map_fd_payload (cipc_stream *stream, const cipc_stream_frame *frame, cipc_msg *msg)
+{
+  int fd;
+  size_t size;
+
+  cipc_err err = peek_fd_payload (stream, frame, &fd, &size);
+  if (err != CIPC_OK)
+    return err;
+
+  cipc_stream_mapping *mapping = calloc (1, sizeof (cipc_stream_mapping));
+  if (!mapping)
+    return CIPC_BAD_ALLOC;
+
+  mapping->release = mapping_free;
+  mapping->length = size;
+
+  if (size > 0)
+    {
+      mapping->addr = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (mapping->addr == MAP_FAILED)
+        {
+          free (mapping);
+          consume_fd_frame (stream, frame);
+          return stream->recv_err;
+        }
+    }
+
+  consume_fd_frame (stream, frame);
+
+  msg->data = mapping->addr;
+  msg->length = size;
+  msg->handle = mapping;
+
+  return CIPC_OK;
+}
+
+static cipc_err
+recv_view (cipc_stream *stream, cipc_msg *msg)
+{
+  const char *data;
+  size_t msg_len;
+  size_t consumed;
+
+  if (stream->framed)
+    {
+      cipc_stream_frame frame;
+
+      cipc_err err = cipc_stream_next_frame (stream, &frame);
+      if (err != CIPC_OK)
+        return err;
+
+      if (frame.flags & CIPC_STREAM_FLAG_FD)
+        return map_fd_payload (stream, &frame, msg);
+
+      data = frame.data;
+      msg_len = frame.length;
+      consumed = CIPC_STREAM_FRAME_HEADER_SIZE + msg_len;
+    }
+  else
+    {
+      if (!stream->rx || stream->rx_tail == stream->rx_head)
+        {
+          cipc_err err = fill_rx_buffer (stream, 1);
+          if (err != CIPC_OK)
+            return err;
+        }
+
+      data = stream->rx->data + stream->rx_head;
+      msg_len = stream->rx_tail - stream->rx_head;
+      consumed = msg_len;
+    }
+
+  atomic_fetch_add_explicit (&stream->rx->refcount, 1, memory_order_relaxed);
+
+  msg->data = data;
+  msg->length = msg_len;
+  msg->handle = stream->rx;
+
+  cipc_stream_consume (stream, consumed);
+
+  return CIPC_OK;
+}
+
+void
+cipc_stream_release_msg (cipc_msg *msg)
+{
+  if (!msg || !msg->handle)
+    return;
+
+  cipc_stream_release_fn release = *(cipc_stream_release_fn *)msg->handle;
+  release (msg->handle);
+
+  msg->data = NULL;
+  msg->length = 0;
+  msg->handle = NULL;
+}
+
+cipc_err
+cipc_stream_recv_batch (cipc_stream *stream, cipc_msg *msgs, size_t count, size_t *received)
+{
+  if (!received || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  *received = 0;
+
+  if (count == 0)
+    return CIPC_OK;
+
+  uint64_t start = cipc_counters_start (stream->counters);
+
+  cipc_err err = recv_view (stream, &msgs[0]);
+  if (err != CIPC_OK)
+    {
+      cipc_counters_received (stream->counters, err, 0, 0, start);
+      return err;
+    }
+
+  *received = 1;
+
+  // The rest of the batch is what is buffered or can be read without waiting; an error past
+  // the first message is left for the next call to report.
+  int nonblocking = stream->nonblocking;
+  stream->nonblocking = 1;
+
+  while (*received < count && recv_view (stream, &msgs[*received]) == CIPC_OK)
+    (*received)++;
+
+  stream->nonblocking = nonblocking;
+
+  size_t bytes = 0;
+  for (size_t i = 0; i < *received; i++)
+    bytes += msgs[i].length;
+
+  cipc_counters_received (stream->counters, CIPC_OK, *received, bytes, start);
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_stream_recv (cipc_stream *stream, char *buffer, size_t length, size_t *len_out)
+{
+  uint64_t start = cipc_counters_start (stream->counters);
+  size_t msg_len = 0;
+
+  cipc_err err = recv_copy (stream, buffer, length, &msg_len);
+
+  if (len_out != NULL)
+    *len_out = msg_len;
+
+  cipc_counters_received (stream->counters, err, err == CIPC_OK, msg_len, start);
+
+  return err;
+}
+
+cipc_err
+cipc_stream_recv_msg (cipc_stream *stream, cipc_msg *msg)
+{
+  uint64_t start = cipc_counters_start (stream->counters);
+
+  cipc_err err = recv_view (stream, msg);
+
+  cipc_counters_received (stream->counters, err, err == CIPC_OK,
+                          err == CIPC_OK ? msg->length : 0, start);
+
+  return err;
+}
+
+static cipc_err
+write_file (cipc_stream *stream, int fd, const char *data, size_t length)
+{
+  while (length > 0)
+    {
+      ssize_t n = write (fd, data, length);
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0)
+        {
+          fprintf (stderr, "File write failed: %s\n", strerror (errno));
+
+          return stream->recv_err;
+        }
+
+      data += n;
+      length -= n;
+    }
+
+  return CIPC_OK;
+}
+
+// Moves length bytes from the pipe into fd, copying when fd does not take splices.
+static cipc_err
+drain_pipe (cipc_stream *stream, int pipe_fd, int fd, size_t length)
+{
+  while (length > 0)
+    {
+      ssize_t n = splice (pipe_fd, NULL, fd, NULL, length, SPLICE_F_MOVE);
+
+      if (n < 0 && errno == EINVAL)
+        {
+          char buffer[CIPC_STREAM_FILE_COPY_SIZE];
+
+          n = read (pipe_fd, buffer, length < sizeof (buffer) ? length : sizeof (buffer));
+          if (n > 0 && write_file (stream, fd, buffer, (size_t)n) != CIPC_OK)
+            return stream->recv_err;
+        }
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+        {
+          fprintf (stderr, "File write failed: %s\n", n < 0 ? strerror (errno) : "no progress");
+
+          return stream->recv_err;
+        }
+
+      length -= n;
+    }
+
+  return CIPC_OK;
+}
+
+// The rest of a frame body, spliced from the socket through a pipe without entering userspace.
+static cipc_err
+splice_range (cipc_stream *stream, int pipe_fds[2], size_t pipe_size, int fd, size_t length)
+{
+  while (length > 0)
+    {
+      ssize_t n = splice (stream->fd, NULL, pipe_fds[1], NULL,
+                          length < pipe_size ? length : pipe_size, SPLICE_F_MOVE | SPLICE_F_MORE);
+      cipc_counter_add (&stream->counters->recv_syscalls, 1);
+
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          // SO_RCVTIMEO expired.
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            cipc_counter_add (&stream->counters->recv_timeouts, 1);
+
+          fprintf (stderr, "Recv failed: %s\n", strerror (errno));
+
+          return stream->recv_err;
+        }
+
+      if (n == 0)
+        return stream->recv_err;
+
+      cipc_err err = drain_pipe (stream, pipe_fds[0], fd, (size_t)n);
+      if (err != CIPC_OK)
+        return err;
+
+      length -= n;
+    }
+
+  return CIPC_OK;
+}
+
+// Writes one frame body to fd: what the reader has buffered already, then the rest.
+static cipc_err
+recv_file_frame (cipc_stream *stream, int pipe_fds[2], size_t *pipe_size, int fd,
+                 size_t length)
+{
+  size_t pending = stream->rx_tail - stream->rx_head;
+  size_t buffered = pending < length ? pending : length;
+
+  if (buffered > 0)
+    {
+      cipc_err err = write_file (stream, fd, stream->rx->data + stream->rx_head, buffered);
+      if (err != CIPC_OK)
+        return err;
+
+      cipc_stream_consume (stream, buffered);
+    }
+
+  if (buffered == length)
+    return CIPC_OK;
+
+  if (pipe_fds[0] < 0)
+    {
+      if (pipe2 (pipe_fds, O_CLOEXEC) < 0)
+        {
+          fprintf (stderr, "Pipe failed: %s\n", strerror (errno));
+
+          return stream->recv_err;
+        }
+
+      int size = fcntl (pipe_fds[1], F_SETPIPE_SZ, CIPC_STREAM_FILE_PIPE_SIZE);
+      if (size < 0)
+        size = fcntl (pipe_fds[1], F_GETPIPE_SZ);
+
+      *pipe_size = size > 0 ? (size_t)size : 4096;
+    }
+
+  return splice_range (stream, pipe_fds, *pipe_size, fd, length - buffered);
+}
+
+// Copies a message that came as a memfd (see send_via_memfd) to fd, then drops its frame.
+static cipc_err
+recv_file_memfd (cipc_stream *stream, int fd, size_t *length)
+{
+  cipc_stream_frame frame;
+
+  cipc_err err = cipc_stream_next_frame (stream, &frame);
+  if (err != CIPC_OK)
+    return err;
+
+  int memfd;
+  size_t size;
+
+  err = peek_fd_payload (stream, &frame, &memfd, &size);
+  if (err != CIPC_OK)
+    return err;
+
+  char buffer[CIPC_STREAM_FILE_COPY_SIZE];
+  size_t done = 0;
+
+  while (err == CIPC_OK && done < size)
+    {
+      size_t left = size - done;
+
+      ssize_t n = pread (memfd, buffer, left < sizeof (buffer) ? left : sizeof (buffer), done);
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+        err = CIPC_BAD_FRAME;
+      else
+        err = write_file (stream, fd, buffer, (size_t)n);
+
+      done += n > 0 ? (size_t)n : 0;
+    }
+
+  consume_fd_frame (stream, &frame);
+
+  *length = size;
+
+  return err;
+}
+
+cipc_err
+cipc_stream_recv_file (cipc_stream *stream, int fd, size_t *len_out)
+{
+  if (len_out != NULL)
+    *len_out = 0;
+
+  if (!stream->framed)
+    return CIPC_BAD_FRAME;
+
+  uint64_t start = cipc_counters_start (stream->counters);
+  int pipe_fds[2] = { -1, -1 };
+  size_t pipe_size = 0;
+  size_t total = 0;
+  uint32_t flags;
+  cipc_err err = CIPC_OK;
+
+  do
+    {
+      while (stream->rx_tail - stream->rx_head < CIPC_STREAM_FRAME_HEADER_SIZE)
+        {
+          err = fill_rx_buffer (stream, CIPC_STREAM_FRAME_HEADER_SIZE);
+          if (err != CIPC_OK)
+            goto out;
+        }
+
+      uint32_t header[2];
+      memcpy (header, stream->rx->data + stream->rx_head, sizeof (header));
+
+      size_t length = ntohl (header[0]);
+      flags = ntohl (header[1]);
+
+      if (flags & CIPC_STREAM_FLAG_FD)
+        err = recv_file_memfd (stream, fd, &length);
+      else
+        {
+          // The body is written out as it arrives, so max_message_size does not apply.
+          cipc_stream_consume (stream, CIPC_STREAM_FRAME_HEADER_SIZE);
+
+          err = recv_file_frame (stream, pipe_fds, &pipe_size, fd, length);
+        }
+
+      if (err != CIPC_OK)
+        goto out;
+
+      total += length;
+    }
+  while (flags & CIPC_STREAM_FLAG_MORE);
+
+out:
+  if (pipe_fds[0] >= 0)
+    {
+      close (pipe_fds[0]);
+      close (pipe_fds[1]);
+    }
+
+  if (len_out != NULL)
+    *len_out = total;
+
+  cipc_counters_received (stream->counters, err, err == CIPC_OK, total, start);
+
+  return err;
+}
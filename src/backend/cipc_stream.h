@@ -0,0 +1,112 @@
+#ifndef CIPC_STREAM_H
+#define CIPC_STREAM_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "cipc.h"
+#include "cipc_counters.h"
+#include "cipc_spin.h"
+
+// Connection-oriented socket I/O shared by the TCP and Unix backends: full-message writes,
+// length-prefixed framing, a buffered reader and borrowed (zero-copy) receive views.
+
+#define CIPC_STREAM_FRAME_HEADER_SIZE 8
+
+// Frame flags carried in the wire header.
+#define CIPC_STREAM_FLAG_FD (1u << 0)
+// More frames of the same send_file follow.
+#define CIPC_STREAM_FLAG_MORE (1u << 1)
+
+// Largest frame of a send_file, so that each fits a receiver's default max_message_size.
+#define CIPC_STREAM_FILE_CHUNK (4 * 1024 * 1024)
+
+typedef struct cipc_stream_rx_block cipc_stream_rx_block;
+
+typedef struct
+{
+  int fd;
+
+  int framed;
+  // SOCK_SEQPACKET: every read must take a whole packet.
+  int packet;
+  // Reads report CIPC_WOULD_BLOCK instead of failing when the socket is drained.
+  int nonblocking;
+  // Bytes arrive through cipc_stream_feed instead of being read from fd.
+  int fed;
+  // Accept descriptors sent with SCM_RIGHTS and payloads sent out of band in them.
+  int pass_fds;
+  // Payloads at least this large are sent as a sealed memfd; 0 disables.
+  size_t fd_threshold;
+
+  size_t max_message_size;
+
+  // TCP only: TCP_QUICKACK is set again after every read, and send_batch corks the socket while
+  // it takes more than one write.
+  int quickack;
+  int cork;
+
+  // Blocking reads spin on non-blocking ones first; see cipc_spin.h.
+  cipc_spin spin;
+
+  cipc_err send_err;
+  cipc_err recv_err;
+
+  // Owned by the backend instance; syscalls, short I/O and timeouts are counted here.
+  cipc_counters *counters;
+
+  cipc_stream_rx_block *rx;
+  size_t rx_initial_cap;
+  size_t rx_head;
+  size_t rx_tail;
+
+  // Descriptors received but not yet matched to their frame, oldest first.
+  int *rx_fds;
+  size_t rx_fds_count;
+  size_t rx_fds_cap;
+} cipc_stream;
+
+typedef struct
+{
+  const char *data;
+  size_t length;
+  uint32_t flags;
+} cipc_stream_frame;
+
+void cipc_stream_init (cipc_stream *stream, int fd, int framed, size_t rcvbuf_size,
+                       size_t max_message_size, cipc_err send_err, cipc_err recv_err,
+                       cipc_counters *counters);
+void cipc_stream_destroy (cipc_stream *stream);
+
+void cipc_stream_encode_header (uint32_t header[2], size_t length, uint32_t flags);
+
+int cipc_stream_set_timeouts (int sockfd, int sndtimeo, int rcvtimeo);
+int cipc_stream_connect_with_retries (int sockfd, const struct sockaddr *addr, socklen_t addrlen,
+                                      int retries, cipc_counters *counters);
+
+cipc_err cipc_stream_write (cipc_stream *stream, struct iovec *iov, size_t iovcnt, int pass_fd);
+cipc_err cipc_stream_write_some (cipc_stream *stream, const struct iovec *iov, size_t iovcnt,
+                                 size_t *written);
+cipc_err cipc_stream_sendv (cipc_stream *stream, const cipc_iovec *iov, size_t iovcnt,
+                            uint32_t flags);
+cipc_err cipc_stream_send_batch (cipc_stream *stream, const cipc_iovec *msgs, size_t count,
+                                 size_t *sent);
+// Sends length bytes of fd from offset with sendfile, in frames of up to CIPC_STREAM_FILE_CHUNK
+// bytes; recv_file writes them back out with splice.
+cipc_err cipc_stream_send_file (cipc_stream *stream, int fd, int64_t offset, size_t length);
+
+int cipc_stream_poll_ready (cipc_stream *stream);
+cipc_err cipc_stream_next_frame (cipc_stream *stream, cipc_stream_frame *frame);
+void cipc_stream_consume (cipc_stream *stream, size_t count);
+// Appends bytes received elsewhere; for fed streams.
+cipc_err cipc_stream_feed (cipc_stream *stream, const char *data, size_t length);
+
+cipc_err cipc_stream_recv (cipc_stream *stream, char *buffer, size_t length, size_t *len_out);
+cipc_err cipc_stream_recv_msg (cipc_stream *stream, cipc_msg *msg);
+void cipc_stream_release_msg (cipc_msg *msg);
+cipc_err cipc_stream_recv_batch (cipc_stream *stream, cipc_msg *msgs, size_t count,
+                                 size_t *received);
+cipc_err cipc_stream_recv_file (cipc_stream *stream, int fd, size_t *len_out);
+
+#endif // CIPC_STREAM_H
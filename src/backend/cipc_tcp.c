@@ -1,66 +1,41 @@
 #include <arpa/inet.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <netinet/in.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
-#include <sys/time.h>
 #include <unistd.h>
 
+#include "backend/cipc_stream.h"
 #include "backend/cipc_tcp.h"
+#include "backend/cipc_tcp_connector.h"
+#include "backend/cipc_tcp_server.h"
+#include "backend/cipc_tcp_tuning.h"
 #include "cipc.h"
 
 typedef struct
 {
-  int sockfd;
+  cipc_stream stream;
   int is_server;
-} cipc_tcp_private;
-
-static cipc_err
-set_socket_timeouts (int sockfd, int sndtimeo, int rcvtimeo)
-{
-  struct timeval tv_snd, tv_rcv;
-
-  tv_snd.tv_sec = sndtimeo / 1000;
-  tv_snd.tv_usec = (sndtimeo % 1000) * 1000;
 
-  tv_rcv.tv_sec = rcvtimeo / 1000;
-  tv_rcv.tv_usec = (rcvtimeo % 1000) * 1000;
+  // Set in CIPC_TCP_MODE_SERVER; the stream is unused then.
+  cipc_tcp_server *server;
 
-  if (setsockopt (sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv_snd, sizeof (tv_snd)) < 0)
-    return CIPC_BAD_TCP_SOCKET_OPT;
+  // Set in CIPC_TCP_MODE_CONNECT with connect_async; every stream call goes through it then.
+  cipc_tcp_connector *connector;
 
-  if (setsockopt (sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv_rcv, sizeof (tv_rcv)) < 0)
-    return CIPC_BAD_TCP_SOCKET_OPT;
-
-  return CIPC_OK;
-}
+  cipc_counters counters;
+} cipc_tcp_private;
 
-static cipc_err
-connect_with_retries (int sockfd, const struct sockaddr *addr, socklen_t addrlen, int retries)
+static void
+cipc_tcp_private_free (cipc_tcp_private *tctx)
 {
-  int retry_count = 0;
-  int retry_delay_ms = 100;
-
-  while (1)
-    {
-      if (connect (sockfd, addr, addrlen) == 0)
-        {
-          return CIPC_OK;
-        }
-
-      if (retry_count >= retries)
-        {
-          return CIPC_BAD_TCP_CONNECT;
-        }
-
-      retry_count++;
-
-      usleep (retry_delay_ms * 1000);
-      retry_delay_ms = retry_delay_ms * 2 > 5000 ? 5000 : retry_delay_ms * 2;
-    }
+  cipc_tcp_connector_free (tctx->connector);
+  cipc_tcp_server_free (tctx->server);
+  cipc_stream_destroy (&tctx->stream);
+  cipc_counters_destroy (&tctx->counters);
+  free (tctx);
 }
 
 static cipc_err
@@ -70,23 +45,58 @@ cipc_tcp_init (void **context, const void *config)
     return CIPC_NULL_PTR;
 
   const cipc_tcp_config *cfg = (const cipc_tcp_config *)config;
-  cipc_tcp_private *tctx = malloc (sizeof (cipc_tcp_private));
+  cipc_tcp_private *tctx = calloc (1, sizeof (cipc_tcp_private));
   if (!tctx)
     return CIPC_BAD_ALLOC;
 
-  tctx->sockfd = socket (AF_INET, SOCK_STREAM, 0);
-  if (tctx->sockfd < 0)
+  cipc_counters_init (&tctx->counters);
+
+  // No socket yet, so the private free helper has nothing to close.
+  tctx->stream.fd = -1;
+
+  if (cfg->mode == CIPC_TCP_MODE_SERVER)
+    {
+      cipc_stream_init (&tctx->stream, -1, 1, 0, 0, CIPC_BAD_TCP_SEND, CIPC_BAD_TCP_RECV,
+                        &tctx->counters);
+
+      cipc_err err = cipc_tcp_server_create (&tctx->server, cfg, &tctx->counters);
+      if (err != CIPC_OK)
+        {
+          cipc_tcp_private_free (tctx);
+          return err;
+        }
+
+      tctx->is_server = 1;
+
+      *context = tctx;
+      return CIPC_OK;
+    }
+
+  int sockfd = socket (AF_INET, SOCK_STREAM, 0);
+  if (sockfd < 0)
     {
-      free (tctx);
+      cipc_tcp_private_free (tctx);
       return CIPC_BAD_TCP_SOCKET;
     }
 
-  cipc_err err = set_socket_timeouts (tctx->sockfd, cfg->sockopt_sndtimeo, cfg->sockopt_rcvtimeo);
-  if (err != CIPC_OK)
+  cipc_stream_init (&tctx->stream, sockfd, cfg->framing != CIPC_TCP_FRAMING_NONE,
+                    cfg->rcvbuf_size ? cfg->rcvbuf_size : CIPC_TCP_DEFAULT_RCVBUF_SIZE,
+                    cfg->max_message_size ? cfg->max_message_size
+                                          : CIPC_TCP_DEFAULT_MAX_MESSAGE_SIZE,
+                    CIPC_BAD_TCP_SEND, CIPC_BAD_TCP_RECV, &tctx->counters);
+
+  cipc_tcp_tuning tuning;
+  cipc_tcp_tuning_resolve (&tuning, cfg);
+
+  tctx->stream.quickack = tuning.quickack;
+  tctx->stream.cork = tuning.cork;
+  cipc_spin_init (&tctx->stream.spin, cfg->spin_us);
+
+  if (cipc_stream_set_timeouts (sockfd, cfg->sockopt_sndtimeo, cfg->sockopt_rcvtimeo) < 0
+      || cipc_tcp_tuning_apply (sockfd, &tuning) < 0)
     {
-      close (tctx->sockfd);
-      free (tctx);
-      return err;
+      cipc_tcp_private_free (tctx);
+      return CIPC_BAD_TCP_SOCKET_OPT;
     }
 
   struct sockaddr_in addr;
@@ -98,34 +108,37 @@ cipc_tcp_init (void **context, const void *config)
     {
       addr.sin_addr.s_addr = INADDR_ANY;
 
-      if (bind (tctx->sockfd, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+      if (bind (sockfd, (struct sockaddr *)&addr, sizeof (addr)) < 0)
         {
           fprintf (stderr, "Bind failed: %s\n", strerror (errno));
-          close (tctx->sockfd);
-          free (tctx);
+          cipc_tcp_private_free (tctx);
           return CIPC_BAD_TCP_BIND;
         }
 
-      if (listen (tctx->sockfd, cfg->backlog) < 0)
+      if (listen (sockfd, cfg->backlog) < 0)
         {
           fprintf (stderr, "Listen failed: %s\n", strerror (errno));
-          close (tctx->sockfd);
-          free (tctx);
+          cipc_tcp_private_free (tctx);
           return CIPC_BAD_TCP_LISTEN;
         }
 
-      int client_fd = accept (tctx->sockfd, NULL, NULL);
+      int client_fd = accept (sockfd, NULL, NULL);
       if (client_fd < 0)
         {
           fprintf (stderr, "Accept failed: %s\n", strerror (errno));
-          close (tctx->sockfd);
-          free (tctx);
+          cipc_tcp_private_free (tctx);
           return CIPC_BAD_TCP_SOCKET;
         }
 
-      close (tctx->sockfd);
+      close (sockfd);
+
+      tctx->stream.fd = client_fd;
 
-      tctx->sockfd = client_fd;
+      if (cipc_tcp_tuning_apply (client_fd, &tuning) < 0)
+        {
+          cipc_tcp_private_free (tctx);
+          return CIPC_BAD_TCP_SOCKET_OPT;
+        }
       tctx->is_server = 1;
     }
   else
@@ -133,23 +146,38 @@ cipc_tcp_init (void **context, const void *config)
       if (inet_pton (AF_INET, cfg->host, &addr.sin_addr) <= 0)
         {
           fprintf (stderr, "Invalid address: %s\n", cfg->host);
-          close (tctx->sockfd);
-          free (tctx);
+          cipc_tcp_private_free (tctx);
           return CIPC_BAD_TCP_ADDRESS;
         }
 
-      err = connect_with_retries (tctx->sockfd, (struct sockaddr *)&addr, sizeof (addr),
-                                  cfg->sockopt_retries);
-      if (err != CIPC_OK)
+      tctx->is_server = 0;
+
+      if (cfg->connect_async)
+        {
+          // The connector dials with sockets of its own.
+          close (sockfd);
+          tctx->stream.fd = -1;
+
+          cipc_err err = cipc_tcp_connector_create (&tctx->connector, &tctx->stream, &addr, cfg);
+          if (err != CIPC_OK)
+            {
+              cipc_tcp_private_free (tctx);
+              return err;
+            }
+
+          *context = tctx;
+          return CIPC_OK;
+        }
+
+      if (cipc_stream_connect_with_retries (sockfd, (struct sockaddr *)&addr, sizeof (addr),
+                                            cfg->sockopt_retries, &tctx->counters)
+          < 0)
         {
           fprintf (stderr, "Connect failed after %d retries: %s\n", cfg->sockopt_retries,
                    strerror (errno));
-          close (tctx->sockfd);
-          free (tctx);
-          return err;
+          cipc_tcp_private_free (tctx);
+          return CIPC_BAD_TCP_CONNECT;
         }
-
-      tctx->is_server = 0;
     }
 
   *context = tctx;
@@ -157,59 +185,205 @@ cipc_tcp_init (void **context, const void *config)
 }
 
 static cipc_err
-cipc_tcp_send (void *context, const char *data, size_t length, size_t *len_out)
+cipc_tcp_sendv (void *context, const cipc_iovec *iov, size_t iovcnt)
 {
   cipc_tcp_private *tctx = (cipc_tcp_private *)context;
 
-  // WARNING: len_out is deprecated!
-  if (len_out != NULL) *len_out = 0;
+  // In server mode a plain send answers the peer of the last received message.
+  if (tctx->server)
+    return cipc_tcp_server_sendv_to (tctx->server, cipc_tcp_server_last_peer (tctx->server), iov,
+                                     iovcnt);
 
-  ssize_t sent = send (tctx->sockfd, data, length, 0);
-  if (sent < 0)
-    {
-      fprintf (stderr, "Send failed: %s\n", strerror (errno));
+  if (tctx->connector)
+    return cipc_tcp_connector_sendv (tctx->connector, iov, iovcnt);
 
-      return CIPC_BAD_TCP_SEND;
-    }
-  
-  if ((size_t)sent != length)
-    return CIPC_BAD_TCP_SEND;
+  return cipc_stream_sendv (&tctx->stream, iov, iovcnt, 0);
+}
 
-  return CIPC_OK;
+static cipc_err
+cipc_tcp_send (void *context, const char *data, size_t length)
+{
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_tcp_sendv (context, &iov, 1);
+}
+
+static cipc_err
+cipc_tcp_recv (void *context, char *buffer, size_t length, size_t *len_out)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+
+  if (tctx->server)
+    return cipc_tcp_server_recv_from (tctx->server, NULL, buffer, length, len_out);
+
+  if (tctx->connector)
+    return cipc_tcp_connector_recv (tctx->connector, buffer, length, len_out);
+
+  return cipc_stream_recv (&tctx->stream, buffer, length, len_out);
+}
+
+static cipc_err
+cipc_tcp_recv_msg (void *context, cipc_msg *msg)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+
+  if (tctx->server)
+    return cipc_tcp_server_recv_msg_from (tctx->server, NULL, msg);
+
+  if (tctx->connector)
+    return cipc_tcp_connector_recv_msg (tctx->connector, msg);
+
+  return cipc_stream_recv_msg (&tctx->stream, msg);
+}
+
+static void
+cipc_tcp_release_msg (void *context, cipc_msg *msg)
+{
+  (void)context;
+
+  cipc_stream_release_msg (msg);
 }
 
 static cipc_err
-cipc_tcp_recv (void *context, char *buffer, size_t length)
+cipc_tcp_send_to (void *context, cipc_peer_id peer, const char *data, size_t length)
 {
   cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+  if (!tctx->server)
+    return CIPC_BAD_PEER;
 
-  ssize_t rcvd = recv (tctx->sockfd, buffer, length - 1, 0);
-  if (rcvd < 0)
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_tcp_server_sendv_to (tctx->server, peer, &iov, 1);
+}
+
+static cipc_err
+cipc_tcp_recv_from (void *context, cipc_peer_id *peer, char *buffer, size_t length,
+                    size_t *len_out)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+  if (!tctx->server)
+    return CIPC_BAD_PEER;
+
+  return cipc_tcp_server_recv_from (tctx->server, peer, buffer, length, len_out);
+}
+
+static cipc_err
+cipc_tcp_send_batch (void *context, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+
+  if (tctx->server)
     {
-      fprintf (stderr, "Recv failed: %s\n", strerror (errno));
+      cipc_peer_id peer = cipc_tcp_server_last_peer (tctx->server);
 
-      return CIPC_BAD_TCP_RECV;
+      if (sent != NULL)
+        *sent = 0;
+
+      for (size_t i = 0; i < count; i++)
+        {
+          cipc_err err = cipc_tcp_server_sendv_to (tctx->server, peer, &msgs[i], 1);
+          if (err != CIPC_OK)
+            return err;
+
+          if (sent != NULL)
+            *sent = i + 1;
+        }
+
+      return CIPC_OK;
     }
 
-  if (rcvd == 0)
+  if (tctx->connector)
+    return cipc_tcp_connector_send_batch (tctx->connector, msgs, count, sent);
+
+  return cipc_stream_send_batch (&tctx->stream, msgs, count, sent);
+}
+
+// Connections of a server are non-blocking and written from a queue, so files are not
+// streamed to them.
+static cipc_err
+cipc_tcp_send_file (void *context, int fd, int64_t offset, size_t length)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+
+  if (tctx->server)
+    return CIPC_BAD_TCP_SEND;
+
+  if (tctx->connector)
+    return cipc_tcp_connector_send_file (tctx->connector, fd, offset, length);
+
+  return cipc_stream_send_file (&tctx->stream, fd, offset, length);
+}
+
+static cipc_err
+cipc_tcp_recv_file (void *context, int fd, size_t *len_out)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+
+  if (tctx->server)
     return CIPC_BAD_TCP_RECV;
 
-  buffer[rcvd] = '\0';
+  if (tctx->connector)
+    return cipc_tcp_connector_recv_file (tctx->connector, fd, len_out);
+
+  return cipc_stream_recv_file (&tctx->stream, fd, len_out);
+}
+
+static cipc_err
+cipc_tcp_recv_batch (void *context, cipc_msg *msgs, size_t count, size_t *received)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+
+  if (!received || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  if (tctx->server)
+    return cipc_tcp_server_recv_batch (tctx->server, msgs, count, received);
+
+  if (tctx->connector)
+    return cipc_tcp_connector_recv_batch (tctx->connector, msgs, count, received);
+
+  return cipc_stream_recv_batch (&tctx->stream, msgs, count, received);
+}
+
+static cipc_err
+cipc_tcp_get_fd (void *context, int *fd, int *ready)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+
+  if (tctx->server)
+    return cipc_tcp_server_get_fd (tctx->server, fd, ready);
+
+  if (tctx->connector)
+    return cipc_tcp_connector_get_fd (tctx->connector, fd, ready);
+
+  *fd = tctx->stream.fd;
+  *ready = cipc_stream_poll_ready (&tctx->stream);
 
   return CIPC_OK;
 }
 
+static cipc_counters *
+cipc_tcp_counters (void *context)
+{
+  cipc_tcp_private *tctx = (cipc_tcp_private *)context;
+
+  return &tctx->counters;
+}
+
 static void
 cipc_tcp_free (void *context)
 {
   cipc_tcp_private *tctx = (cipc_tcp_private *)context;
   if (tctx)
     {
-      shutdown (tctx->sockfd, SHUT_RDWR);
+      // The connect thread may still be replacing the socket until it is stopped.
+      cipc_tcp_connector_free (tctx->connector);
+      tctx->connector = NULL;
 
-      close (tctx->sockfd);
+      if (tctx->stream.fd >= 0)
+        shutdown (tctx->stream.fd, SHUT_RDWR);
 
-      free (tctx);
+      cipc_tcp_private_free (tctx);
     }
 }
 
@@ -222,7 +396,20 @@ cipc_create_tcp (void)
 
   instance->init = cipc_tcp_init;
   instance->send = cipc_tcp_send;
+  instance->sendv = cipc_tcp_sendv;
   instance->recv = cipc_tcp_recv;
+  instance->recv_msg = cipc_tcp_recv_msg;
+  instance->release_msg = cipc_tcp_release_msg;
+  instance->send_to = cipc_tcp_send_to;
+  instance->recv_from = cipc_tcp_recv_from;
+  instance->send_batch = cipc_tcp_send_batch;
+  instance->recv_batch = cipc_tcp_recv_batch;
+  instance->send_file = cipc_tcp_send_file;
+  instance->recv_file = cipc_tcp_recv_file;
+  instance->send_buf = NULL;
+  instance->recv_buf = NULL;
+  instance->get_fd = cipc_tcp_get_fd;
+  instance->counters = cipc_tcp_counters;
   instance->free = cipc_tcp_free;
   instance->context = NULL;
 
@@ -0,0 +1,752 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/cipc_stream.h"
+#include "backend/cipc_tcp.h"
+#include "backend/cipc_tcp_connector.h"
+#include "backend/cipc_tcp_tuning.h"
+#include "cipc.h"
+#include "cipc_internal.h"
+
+#define CIPC_TCP_CONNECTOR_RETRY_INITIAL_MS 100
+#define CIPC_TCP_CONNECTOR_RETRY_MAX_MS 5000
+
+typedef enum
+{
+  CIPC_TCP_CONNECTOR_CONNECTING,
+  CIPC_TCP_CONNECTOR_CONNECTED,
+  // The link broke; the stream is torn down once the calls still using it have returned.
+  CIPC_TCP_CONNECTOR_DRAINING,
+  // Out of retries; the instance stays unusable.
+  CIPC_TCP_CONNECTOR_FAILED
+} cipc_tcp_connector_state;
+
+struct cipc_tcp_connector
+{
+  cipc_stream *stream;
+  struct sockaddr_in addr;
+
+  int sndtimeo;
+  int rcvtimeo;
+  int retries;
+  cipc_tcp_tuning tuning;
+
+  // Written under lock; read without it on the fast path.
+  atomic_int state;
+  atomic_int stopping;
+
+  // Calls using the stream, which is only torn down once none are left. The generation counts
+  // connections, so that a failure on an old one does not drop its successor.
+  atomic_int active;
+  atomic_uint generation;
+
+  pthread_mutex_t lock;
+  // Broadcast when the state leaves CONNECTING, and when the last call leaves a draining stream.
+  pthread_cond_t cond;
+
+  // Wakes the helper thread from a backoff sleep or connect wait.
+  int wake_fd;
+  pthread_t thread;
+
+  // Encoded frames waiting for the connection, guarded by lock, with the payload size of each.
+  char *queue;
+  size_t queued;
+  size_t queue_cap;
+  size_t max_queued_bytes;
+  size_t *sizes;
+  size_t sizes_count;
+  size_t sizes_cap;
+};
+
+static void
+set_state (cipc_tcp_connector *connector, cipc_tcp_connector_state state)
+{
+  atomic_store_explicit (&connector->state, state, memory_order_release);
+  pthread_cond_broadcast (&connector->cond);
+}
+
+// Begins a call on the connected stream; 0 when not connected. The increment comes before the
+// state check, so that a teardown either sees the call or the call sees the teardown.
+static int
+enter (cipc_tcp_connector *connector, unsigned *generation)
+{
+  atomic_fetch_add (&connector->active, 1);
+
+  if (atomic_load (&connector->state) == CIPC_TCP_CONNECTOR_CONNECTED)
+    {
+      *generation = atomic_load (&connector->generation);
+      return 1;
+    }
+
+  if (atomic_fetch_sub (&connector->active, 1) == 1)
+    {
+      pthread_mutex_lock (&connector->lock);
+      pthread_cond_broadcast (&connector->cond);
+      pthread_mutex_unlock (&connector->lock);
+    }
+
+  return 0;
+}
+
+static void
+leave (cipc_tcp_connector *connector)
+{
+  if (atomic_fetch_sub (&connector->active, 1) == 1
+      && atomic_load (&connector->state) == CIPC_TCP_CONNECTOR_DRAINING)
+    {
+      pthread_mutex_lock (&connector->lock);
+      pthread_cond_broadcast (&connector->cond);
+      pthread_mutex_unlock (&connector->lock);
+    }
+}
+
+// Sleeps up to timeout_ms (-1: indefinitely) or until woken.
+static void
+wait_wake (cipc_tcp_connector *connector, int timeout_ms)
+{
+  struct pollfd pfd = { .fd = connector->wake_fd, .events = POLLIN };
+
+  if (poll (&pfd, 1, timeout_ms) > 0)
+    cipc_drain_fd (connector->wake_fd);
+}
+
+// One non-blocking connect, bounded by the send timeout. Returns a blocking socket with the
+// configured timeouts, or -1 with errno set.
+static int
+dial (cipc_tcp_connector *connector)
+{
+  int fd = socket (AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  if (cipc_tcp_tuning_apply (fd, &connector->tuning) < 0)
+    goto fail;
+
+  if (connect (fd, (struct sockaddr *)&connector->addr, sizeof (connector->addr)) < 0)
+    {
+      if (errno != EINPROGRESS)
+        goto fail;
+
+      struct pollfd fds[2] = {
+        { .fd = fd, .events = POLLOUT },
+        { .fd = connector->wake_fd, .events = POLLIN },
+      };
+
+      while (1)
+        {
+          int rc = poll (fds, 2, connector->sndtimeo > 0 ? connector->sndtimeo : -1);
+          if (rc < 0 && errno == EINTR)
+            continue;
+
+          if (rc == 0)
+            errno = ETIMEDOUT;
+
+          if (rc <= 0)
+            goto fail;
+
+          if (fds[1].revents & POLLIN)
+            {
+              cipc_drain_fd (connector->wake_fd);
+
+              if (atomic_load (&connector->stopping))
+                {
+                  errno = ECANCELED;
+                  goto fail;
+                }
+            }
+
+          if (fds[0].revents)
+            break;
+        }
+
+      int so_error = 0;
+      socklen_t len = sizeof (so_error);
+      if (getsockopt (fd, SOL_SOCKET, SO_ERROR, &so_error, &len) < 0)
+        goto fail;
+
+      if (so_error != 0)
+        {
+          errno = so_error;
+          goto fail;
+        }
+    }
+
+  int flags = fcntl (fd, F_GETFL);
+  if (flags < 0 || fcntl (fd, F_SETFL, flags & ~O_NONBLOCK) < 0)
+    goto fail;
+
+  if (cipc_stream_set_timeouts (fd, connector->sndtimeo, connector->rcvtimeo) < 0)
+    goto fail;
+
+  return fd;
+
+fail:;
+  int saved = errno;
+  close (fd);
+  errno = saved;
+
+  return -1;
+}
+
+// Drops the queued messages, e.g. once connecting has failed for good. Called with lock held.
+static void
+clear_queue (cipc_tcp_connector *connector)
+{
+  cipc_counter_add (&connector->stream->counters->msgs_lost, connector->sizes_count);
+
+  connector->queued = 0;
+  connector->sizes_count = 0;
+}
+
+// Writes the queued frames ahead of anything sent once connected. Frames written whole leave the
+// queue and count as sent even when a later one fails; the first one cut short is sent again, in
+// full, on the next connection. Called with lock held.
+static cipc_err
+flush_queue (cipc_tcp_connector *connector)
+{
+  if (connector->queued == 0)
+    return CIPC_OK;
+
+  cipc_stream *stream = connector->stream;
+  struct iovec vec = { .iov_base = connector->queue, .iov_len = connector->queued };
+
+  cipc_err err = cipc_stream_write (stream, &vec, 1, -1);
+
+  // On failure vec is left at the first byte not written.
+  size_t written = err == CIPC_OK ? connector->queued : (size_t)((char *)vec.iov_base
+                                                                  - connector->queue);
+  size_t header = stream->framed ? CIPC_STREAM_FRAME_HEADER_SIZE : 0;
+  size_t offset = 0;
+  size_t done = 0;
+  uint64_t bytes = 0;
+
+  while (done < connector->sizes_count && offset + header + connector->sizes[done] <= written)
+    {
+      offset += header + connector->sizes[done];
+      bytes += connector->sizes[done];
+      done++;
+    }
+
+  cipc_counters_sent (stream->counters, CIPC_OK, done, bytes, 0);
+
+  connector->queued -= offset;
+  connector->sizes_count -= done;
+
+  memmove (connector->queue, connector->queue + offset, connector->queued);
+  memmove (connector->sizes, connector->sizes + done, connector->sizes_count * sizeof (size_t));
+
+  return err;
+}
+
+static void *
+connect_thread (void *arg)
+{
+  cipc_tcp_connector *connector = (cipc_tcp_connector *)arg;
+  cipc_counters *counters = connector->stream->counters;
+
+  int delay_ms = CIPC_TCP_CONNECTOR_RETRY_INITIAL_MS;
+  int attempts = 0;
+  int first = 1;
+
+  while (!atomic_load (&connector->stopping))
+    {
+      if (atomic_load_explicit (&connector->state, memory_order_acquire)
+          != CIPC_TCP_CONNECTOR_CONNECTING)
+        {
+          wait_wake (connector, -1);
+          continue;
+        }
+
+      if (!first)
+        cipc_counter_add (&counters->reconnects, 1);
+
+      first = 0;
+
+      int fd = dial (connector);
+      int saved = errno;
+
+      if (fd >= 0)
+        {
+          pthread_mutex_lock (&connector->lock);
+
+          connector->stream->fd = fd;
+
+          // Whatever flush_queue could not write whole is written again on the next connection.
+          if (flush_queue (connector) == CIPC_OK)
+            {
+              atomic_fetch_add (&connector->generation, 1);
+              set_state (connector, CIPC_TCP_CONNECTOR_CONNECTED);
+              pthread_mutex_unlock (&connector->lock);
+
+              attempts = 0;
+              delay_ms = CIPC_TCP_CONNECTOR_RETRY_INITIAL_MS;
+              continue;
+            }
+
+          saved = errno;
+          cipc_stream_destroy (connector->stream);
+          pthread_mutex_unlock (&connector->lock);
+        }
+
+      if (atomic_load (&connector->stopping))
+        break;
+
+      if (connector->retries >= 0 && attempts >= connector->retries)
+        {
+          fprintf (stderr, "Connect failed after %d retries: %s\n", connector->retries,
+                   strerror (saved));
+
+          pthread_mutex_lock (&connector->lock);
+          clear_queue (connector);
+          set_state (connector, CIPC_TCP_CONNECTOR_FAILED);
+          pthread_mutex_unlock (&connector->lock);
+          continue;
+        }
+
+      attempts++;
+
+      wait_wake (connector, delay_ms);
+      delay_ms = delay_ms * 2 > CIPC_TCP_CONNECTOR_RETRY_MAX_MS ? CIPC_TCP_CONNECTOR_RETRY_MAX_MS
+                                                                : delay_ms * 2;
+    }
+
+  return NULL;
+}
+
+// Drops a broken connection and hands reconnecting to the helper thread. The other direction may
+// still be inside a read or write of the stream: the shutdown makes it return, and the stream is
+// only reset once it has.
+static void
+reconnect (cipc_tcp_connector *connector, unsigned generation)
+{
+  pthread_mutex_lock (&connector->lock);
+
+  if (atomic_load (&connector->state) != CIPC_TCP_CONNECTOR_CONNECTED
+      || atomic_load (&connector->generation) != generation)
+    {
+      pthread_mutex_unlock (&connector->lock);
+      return;
+    }
+
+  atomic_store (&connector->state, CIPC_TCP_CONNECTOR_DRAINING);
+  shutdown (connector->stream->fd, SHUT_RDWR);
+
+  while (atomic_load (&connector->active) > 0)
+    pthread_cond_wait (&connector->cond, &connector->lock);
+
+  cipc_stream_destroy (connector->stream);
+  set_state (connector, CIPC_TCP_CONNECTOR_CONNECTING);
+  pthread_mutex_unlock (&connector->lock);
+
+  cipc_signal_fd (connector->wake_fd);
+}
+
+// Ends a call begun with enter and passes err through. A send or receive failure that was not a
+// timeout means the peer is gone.
+static cipc_err
+settle (cipc_tcp_connector *connector, unsigned generation, cipc_err err, cipc_err link_err,
+        const cipc_counter *timeouts, uint64_t timeouts_before)
+{
+  leave (connector);
+
+  if (err == link_err && atomic_load_explicit (timeouts, memory_order_relaxed) == timeouts_before)
+    reconnect (connector, generation);
+
+  return err;
+}
+
+// Appends one frame to the queue. Called with lock held while connecting.
+static cipc_err
+enqueue (cipc_tcp_connector *connector, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_stream *stream = connector->stream;
+
+  size_t total = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    total += iov[i].length;
+
+  if (stream->framed && (total > UINT32_MAX || total > stream->max_message_size))
+    return CIPC_BAD_FRAME;
+
+  size_t needed = total + (stream->framed ? CIPC_STREAM_FRAME_HEADER_SIZE : 0);
+  if (needed > connector->max_queued_bytes - connector->queued)
+    return CIPC_NOT_CONNECTED;
+
+  if (connector->queued + needed > connector->queue_cap)
+    {
+      size_t cap = connector->queue_cap ? connector->queue_cap : 4096;
+      while (cap < connector->queued + needed)
+        cap *= 2;
+
+      char *queue = realloc (connector->queue, cap);
+      if (!queue)
+        return CIPC_BAD_ALLOC;
+
+      connector->queue = queue;
+      connector->queue_cap = cap;
+    }
+
+  if (connector->sizes_count == connector->sizes_cap)
+    {
+      size_t cap = connector->sizes_cap ? connector->sizes_cap * 2 : 64;
+
+      size_t *sizes = realloc (connector->sizes, cap * sizeof (size_t));
+      if (!sizes)
+        return CIPC_BAD_ALLOC;
+
+      connector->sizes = sizes;
+      connector->sizes_cap = cap;
+    }
+
+  char *out = connector->queue + connector->queued;
+
+  if (stream->framed)
+    {
+      uint32_t header[2];
+      cipc_stream_encode_header (header, total, 0);
+
+      memcpy (out, header, sizeof (header));
+      out += sizeof (header);
+    }
+
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      if (iov[i].length > 0)
+        memcpy (out, iov[i].base, iov[i].length);
+
+      out += iov[i].length;
+    }
+
+  connector->queued += needed;
+  connector->sizes[connector->sizes_count++] = total;
+
+  return CIPC_OK;
+}
+
+// Blocks up to the receive timeout for the connection.
+static cipc_err
+wait_connected (cipc_tcp_connector *connector)
+{
+  struct timespec deadline;
+  if (connector->rcvtimeo > 0)
+    cipc_deadline_after (&deadline, connector->rcvtimeo);
+
+  int timed_out = 0;
+
+  pthread_mutex_lock (&connector->lock);
+
+  while (!timed_out
+         && (atomic_load (&connector->state) == CIPC_TCP_CONNECTOR_CONNECTING
+             || atomic_load (&connector->state) == CIPC_TCP_CONNECTOR_DRAINING))
+    {
+      if (connector->rcvtimeo > 0)
+        timed_out = pthread_cond_timedwait (&connector->cond, &connector->lock, &deadline)
+                    == ETIMEDOUT;
+      else
+        pthread_cond_wait (&connector->cond, &connector->lock);
+    }
+
+  int state = atomic_load (&connector->state);
+
+  pthread_mutex_unlock (&connector->lock);
+
+  if (state == CIPC_TCP_CONNECTOR_CONNECTED)
+    return CIPC_OK;
+
+  if (state == CIPC_TCP_CONNECTOR_FAILED)
+    return CIPC_BAD_TCP_CONNECT;
+
+  cipc_counter_add (&connector->stream->counters->recv_timeouts, 1);
+
+  return CIPC_NOT_CONNECTED;
+}
+
+// Begins a receive, waiting for the connection first.
+static cipc_err
+enter_recv (cipc_tcp_connector *connector, unsigned *generation)
+{
+  while (!enter (connector, generation))
+    {
+      cipc_err err = wait_connected (connector);
+      if (err != CIPC_OK)
+        return err;
+    }
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_tcp_connector_create (cipc_tcp_connector **out, cipc_stream *stream,
+                           const struct sockaddr_in *addr, const cipc_tcp_config *cfg)
+{
+  cipc_tcp_connector *connector = calloc (1, sizeof (cipc_tcp_connector));
+  if (!connector)
+    return CIPC_BAD_ALLOC;
+
+  connector->stream = stream;
+  connector->addr = *addr;
+  connector->sndtimeo = cfg->sockopt_sndtimeo;
+  connector->rcvtimeo = cfg->sockopt_rcvtimeo;
+  cipc_tcp_tuning_resolve (&connector->tuning, cfg);
+  connector->retries = cfg->sockopt_retries;
+  connector->max_queued_bytes = cfg->max_queued_bytes;
+
+  atomic_init (&connector->state, CIPC_TCP_CONNECTOR_CONNECTING);
+  atomic_init (&connector->stopping, 0);
+  atomic_init (&connector->active, 0);
+  atomic_init (&connector->generation, 0);
+
+  connector->wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (connector->wake_fd < 0)
+    {
+      free (connector);
+      return CIPC_BAD_TCP_SOCKET;
+    }
+
+  pthread_mutex_init (&connector->lock, NULL);
+  cipc_cond_init (&connector->cond);
+
+  if (pthread_create (&connector->thread, NULL, connect_thread, connector) != 0)
+    {
+      fprintf (stderr, "Failed to start connect thread\n");
+
+      pthread_cond_destroy (&connector->cond);
+      pthread_mutex_destroy (&connector->lock);
+      close (connector->wake_fd);
+      free (connector);
+
+      return CIPC_BAD_TCP_CONNECT;
+    }
+
+  *out = connector;
+  return CIPC_OK;
+}
+
+void
+cipc_tcp_connector_free (cipc_tcp_connector *connector)
+{
+  if (!connector)
+    return;
+
+  atomic_store (&connector->stopping, 1);
+  cipc_signal_fd (connector->wake_fd);
+
+  pthread_join (connector->thread, NULL);
+
+  pthread_cond_destroy (&connector->cond);
+  pthread_mutex_destroy (&connector->lock);
+  close (connector->wake_fd);
+  free (connector->queue);
+  free (connector->sizes);
+  free (connector);
+}
+
+cipc_err
+cipc_tcp_connector_get_fd (cipc_tcp_connector *connector, int *fd, int *ready)
+{
+  unsigned generation;
+
+  // Without a socket yet, cipc_poll falls back to polling recv in short slices.
+  if (!enter (connector, &generation))
+    {
+      *fd = -1;
+      *ready = 0;
+      return CIPC_OK;
+    }
+
+  *fd = connector->stream->fd;
+  *ready = cipc_stream_poll_ready (connector->stream);
+
+  leave (connector);
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_tcp_connector_sendv (cipc_tcp_connector *connector, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_counters *counters = connector->stream->counters;
+  unsigned generation;
+
+  while (!enter (connector, &generation))
+    {
+      pthread_mutex_lock (&connector->lock);
+
+      int state = atomic_load (&connector->state);
+      cipc_err err = CIPC_BAD_TCP_CONNECT;
+
+      if (state == CIPC_TCP_CONNECTOR_CONNECTING || state == CIPC_TCP_CONNECTOR_DRAINING)
+        {
+          // Counted as sent once flush_queue writes it.
+          err = enqueue (connector, iov, iovcnt);
+
+          cipc_counters_sent (counters, err, 0, 0, 0);
+        }
+
+      pthread_mutex_unlock (&connector->lock);
+
+      // Connected meanwhile; the queue has been written, so the message may go out directly.
+      if (state != CIPC_TCP_CONNECTOR_CONNECTED)
+        return err;
+    }
+
+  uint64_t timeouts = atomic_load_explicit (&counters->send_timeouts, memory_order_relaxed);
+  cipc_err err = cipc_stream_sendv (connector->stream, iov, iovcnt, 0);
+
+  return settle (connector, generation, err, connector->stream->send_err, &counters->send_timeouts,
+                 timeouts);
+}
+
+cipc_err
+cipc_tcp_connector_send_batch (cipc_tcp_connector *connector, const cipc_iovec *msgs,
+                               size_t count, size_t *sent)
+{
+  cipc_counters *counters = connector->stream->counters;
+  unsigned generation;
+
+  while (!enter (connector, &generation))
+    {
+      pthread_mutex_lock (&connector->lock);
+
+      int state = atomic_load (&connector->state);
+      cipc_err err = CIPC_BAD_TCP_CONNECT;
+      size_t done = 0;
+
+      if (state == CIPC_TCP_CONNECTOR_CONNECTING || state == CIPC_TCP_CONNECTOR_DRAINING)
+        {
+          for (err = CIPC_OK; done < count; done++)
+            {
+              err = enqueue (connector, &msgs[done], 1);
+              if (err != CIPC_OK)
+                break;
+            }
+
+          cipc_counters_sent (counters, err, 0, 0, 0);
+        }
+
+      pthread_mutex_unlock (&connector->lock);
+
+      if (state != CIPC_TCP_CONNECTOR_CONNECTED)
+        {
+          if (sent != NULL)
+            *sent = done;
+
+          return err;
+        }
+    }
+
+  uint64_t timeouts = atomic_load_explicit (&counters->send_timeouts, memory_order_relaxed);
+  cipc_err err = cipc_stream_send_batch (connector->stream, msgs, count, sent);
+
+  return settle (connector, generation, err, connector->stream->send_err, &counters->send_timeouts,
+                 timeouts);
+}
+
+cipc_err
+cipc_tcp_connector_send_file (cipc_tcp_connector *connector, int fd, int64_t offset,
+                              size_t length)
+{
+  unsigned generation;
+
+  if (!enter (connector, &generation))
+    return CIPC_NOT_CONNECTED;
+
+  cipc_counters *counters = connector->stream->counters;
+  uint64_t timeouts = atomic_load_explicit (&counters->send_timeouts, memory_order_relaxed);
+  cipc_err err = cipc_stream_send_file (connector->stream, fd, offset, length);
+
+  return settle (connector, generation, err, connector->stream->send_err, &counters->send_timeouts,
+                 timeouts);
+}
+
+cipc_err
+cipc_tcp_connector_recv (cipc_tcp_connector *connector, char *buffer, size_t length,
+                         size_t *len_out)
+{
+  unsigned generation;
+
+  cipc_err err = enter_recv (connector, &generation);
+  if (err != CIPC_OK)
+    return err;
+
+  cipc_counters *counters = connector->stream->counters;
+  uint64_t timeouts = atomic_load_explicit (&counters->recv_timeouts, memory_order_relaxed);
+
+  err = cipc_stream_recv (connector->stream, buffer, length, len_out);
+
+  return settle (connector, generation, err, connector->stream->recv_err, &counters->recv_timeouts,
+                 timeouts);
+}
+
+cipc_err
+cipc_tcp_connector_recv_msg (cipc_tcp_connector *connector, cipc_msg *msg)
+{
+  unsigned generation;
+
+  cipc_err err = enter_recv (connector, &generation);
+  if (err != CIPC_OK)
+    return err;
+
+  cipc_counters *counters = connector->stream->counters;
+  uint64_t timeouts = atomic_load_explicit (&counters->recv_timeouts, memory_order_relaxed);
+
+  err = cipc_stream_recv_msg (connector->stream, msg);
+
+  return settle (connector, generation, err, connector->stream->recv_err, &counters->recv_timeouts,
+                 timeouts);
+}
+
+cipc_err
+cipc_tcp_connector_recv_batch (cipc_tcp_connector *connector, cipc_msg *msgs, size_t count,
+                               size_t *received)
+{
+  unsigned generation;
+
+  cipc_err err = enter_recv (connector, &generation);
+  if (err != CIPC_OK)
+    {
+      if (received != NULL)
+        *received = 0;
+
+      return err;
+    }
+
+  cipc_counters *counters = connector->stream->counters;
+  uint64_t timeouts = atomic_load_explicit (&counters->recv_timeouts, memory_order_relaxed);
+
+  err = cipc_stream_recv_batch (connector->stream, msgs, count, received);
+
+  return settle (connector, generation, err, connector->stream->recv_err, &counters->recv_timeouts,
+                 timeouts);
+}
+
+cipc_err
+cipc_tcp_connector_recv_file (cipc_tcp_connector *connector, int fd, size_t *len_out)
+{
+  unsigned generation;
+
+  cipc_err err = enter_recv (connector, &generation);
+  if (err != CIPC_OK)
+    return err;
+
+  cipc_counters *counters = connector->stream->counters;
+  uint64_t timeouts = atomic_load_explicit (&counters->recv_timeouts, memory_order_relaxed);
+
+  err = cipc_stream_recv_file (connector->stream, fd, len_out);
+
+  return settle (connector, generation, err, connector->stream->recv_err, &counters->recv_timeouts,
+                 timeouts);
+}
@@ -0,0 +1,41 @@
+#ifndef CIPC_TCP_CONNECTOR_H
+#define CIPC_TCP_CONNECTOR_H
+
+#include <netinet/in.h>
+
+#include "backend/cipc_stream.h"
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+
+// Background connection of the TCP backend in connect mode with connect_async. A helper thread
+// makes the first connection, and a new one whenever the link breaks, with non-blocking connects
+// and backoff; sends made meanwhile are queued up to a limit and written once connected.
+//
+// The stream belongs to the backend instance. The helper thread only touches it while not
+// connected, and the caller only while connected. When the link breaks, the stream is reset for
+// the next connection only after calls in both directions have left it.
+
+typedef struct cipc_tcp_connector cipc_tcp_connector;
+
+cipc_err cipc_tcp_connector_create (cipc_tcp_connector **out, cipc_stream *stream,
+                                    const struct sockaddr_in *addr, const cipc_tcp_config *cfg);
+void cipc_tcp_connector_free (cipc_tcp_connector *connector);
+
+cipc_err cipc_tcp_connector_get_fd (cipc_tcp_connector *connector, int *fd, int *ready);
+
+cipc_err cipc_tcp_connector_sendv (cipc_tcp_connector *connector, const cipc_iovec *iov,
+                                   size_t iovcnt);
+cipc_err cipc_tcp_connector_send_batch (cipc_tcp_connector *connector, const cipc_iovec *msgs,
+                                        size_t count, size_t *sent);
+// Files are not queued: they fail with CIPC_NOT_CONNECTED until connected.
+cipc_err cipc_tcp_connector_send_file (cipc_tcp_connector *connector, int fd, int64_t offset,
+                                       size_t length);
+
+cipc_err cipc_tcp_connector_recv (cipc_tcp_connector *connector, char *buffer, size_t length,
+                                  size_t *len_out);
+cipc_err cipc_tcp_connector_recv_msg (cipc_tcp_connector *connector, cipc_msg *msg);
+cipc_err cipc_tcp_connector_recv_batch (cipc_tcp_connector *connector, cipc_msg *msgs,
+                                        size_t count, size_t *received);
+cipc_err cipc_tcp_connector_recv_file (cipc_tcp_connector *connector, int fd, size_t *len_out);
+
+#endif // CIPC_TCP_CONNECTOR_H
@@ -0,0 +1,1246 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/cipc_stream.h"
+#include "backend/cipc_tcp.h"
+#include "backend/cipc_tcp_server.h"
+#include "backend/cipc_tcp_tuning.h"
+#include "backend/cipc_uring.h"
+#include "cipc.h"
+#include "cipc_internal.h"
+#include "cipc_spin.h"
+
+#define CIPC_TCP_SERVER_MAX_EVENTS 64
+#define CIPC_TCP_SERVER_NONE UINT32_MAX
+#define CIPC_TCP_SERVER_LISTENER UINT64_MAX
+#define CIPC_TCP_SERVER_SENDV_STACK_IOV 16
+
+#define CIPC_TCP_SERVER_URING_ENTRIES 256
+#define CIPC_TCP_SERVER_URING_BUFFERS 256
+#define CIPC_TCP_SERVER_URING_BUFFER_SIZE (16 * 1024)
+#define CIPC_TCP_SERVER_URING_COMPLETIONS 64
+// Receiving pauses on a connection holding complete frames beyond this many rcvbuf_size.
+#define CIPC_TCP_SERVER_URING_RX_BUFFERS 4
+#define CIPC_TCP_SERVER_URING_DRAIN_MS 1000
+
+// io_uring operations carry their kind in the upper half of user_data and the slot below.
+#define CIPC_TCP_SERVER_OP_ACCEPT 1u
+#define CIPC_TCP_SERVER_OP_RECV 2u
+#define CIPC_TCP_SERVER_OP_SEND 3u
+#define CIPC_TCP_SERVER_OP_CANCEL 4u
+
+typedef struct
+{
+  cipc_stream stream;
+
+  uint32_t generation;
+  int active;
+
+  // Intrusive FIFO of connections that may have a frame to deliver.
+  int queued;
+  uint32_t next_ready;
+
+  // Bytes accepted by send_to but not yet taken by the kernel.
+  char *tx_buf;
+  size_t tx_off;
+  size_t tx_len;
+  size_t tx_cap;
+  // A frame boundary in tx_buf at or before tx_off, from which conflation finds the next one.
+  size_t tx_boundary;
+  int want_out;
+
+  // io_uring engine: the buffer owned by the send in flight, which tx_buf is swapped into, and
+  // the operations the kernel still holds. A closed slot is only reused once both are done.
+  char *tx_inflight;
+  size_t tx_inflight_off;
+  size_t tx_inflight_len;
+  size_t tx_inflight_cap;
+  int send_armed;
+  int recv_armed;
+  int recv_paused;
+  int eof;
+} cipc_tcp_conn;
+
+struct cipc_tcp_server
+{
+  int listen_fd;
+  int epoll_fd;
+
+  // Set with CIPC_TCP_ENGINE_IO_URING, which replaces epoll_fd.
+  cipc_uring *uring;
+
+  cipc_tcp_conn *conns;
+  uint32_t conn_cap;
+
+  uint32_t *free_slots;
+  uint32_t free_count;
+
+  uint32_t ready_head;
+  uint32_t ready_tail;
+
+  cipc_peer_id last_peer;
+  // Connection whose frame did not fit the caller buffer; served first on the next recv.
+  cipc_peer_id retry_peer;
+
+  int rcvtimeo;
+  size_t rcvbuf_size;
+  size_t max_message_size;
+  size_t max_pending_bytes;
+  cipc_tcp_overflow overflow;
+  cipc_tcp_tuning tuning;
+  cipc_spin spin;
+
+  cipc_counters *counters;
+};
+
+static cipc_peer_id
+conn_id (const cipc_tcp_server *server, uint32_t slot)
+{
+  return ((uint64_t)server->conns[slot].generation << 32) | slot;
+}
+
+static cipc_tcp_conn *
+conn_lookup (cipc_tcp_server *server, cipc_peer_id peer, uint32_t *slot_out)
+{
+  uint32_t slot = (uint32_t)peer;
+
+  if (slot >= server->conn_cap || !server->conns[slot].active
+      || server->conns[slot].generation != (uint32_t)(peer >> 32))
+    return NULL;
+
+  if (slot_out)
+    *slot_out = slot;
+
+  return &server->conns[slot];
+}
+
+static void
+ready_push (cipc_tcp_server *server, uint32_t slot)
+{
+  cipc_tcp_conn *conn = &server->conns[slot];
+  if (conn->queued)
+    return;
+
+  conn->queued = 1;
+  conn->next_ready = CIPC_TCP_SERVER_NONE;
+
+  if (server->ready_tail == CIPC_TCP_SERVER_NONE)
+    server->ready_head = slot;
+  else
+    server->conns[server->ready_tail].next_ready = slot;
+
+  server->ready_tail = slot;
+}
+
+static uint32_t
+ready_pop (cipc_tcp_server *server)
+{
+  uint32_t slot = server->ready_head;
+  if (slot == CIPC_TCP_SERVER_NONE)
+    return slot;
+
+  server->ready_head = server->conns[slot].next_ready;
+  if (server->ready_head == CIPC_TCP_SERVER_NONE)
+    server->ready_tail = CIPC_TCP_SERVER_NONE;
+
+  server->conns[slot].queued = 0;
+
+  return slot;
+}
+
+static cipc_err
+conn_alloc (cipc_tcp_server *server, uint32_t *slot_out)
+{
+  if (server->free_count == 0)
+    {
+      uint32_t cap = server->conn_cap ? server->conn_cap * 2 : 64;
+
+      cipc_tcp_conn *conns = realloc (server->conns, cap * sizeof (cipc_tcp_conn));
+      if (!conns)
+        return CIPC_BAD_ALLOC;
+      server->conns = conns;
+
+      uint32_t *free_slots = realloc (server->free_slots, cap * sizeof (uint32_t));
+      if (!free_slots)
+        return CIPC_BAD_ALLOC;
+      server->free_slots = free_slots;
+
+      for (uint32_t slot = cap; slot > server->conn_cap; slot--)
+        {
+          memset (&conns[slot - 1], 0, sizeof (cipc_tcp_conn));
+          conns[slot - 1].generation = 1;
+
+          free_slots[server->free_count++] = slot - 1;
+        }
+
+      server->conn_cap = cap;
+    }
+
+  *slot_out = server->free_slots[--server->free_count];
+
+  return CIPC_OK;
+}
+
+static void
+conn_close (cipc_tcp_server *server, uint32_t slot)
+{
+  cipc_tcp_conn *conn = &server->conns[slot];
+
+  // Shutting the socket down ends the kernel's operations; their completions release the slot.
+  if (conn->recv_armed || conn->send_armed)
+    {
+      if (conn->active)
+        {
+          conn->active = 0;
+          conn->generation++;
+          shutdown (conn->stream.fd, SHUT_RDWR);
+        }
+
+      return;
+    }
+
+  cipc_stream_destroy (&conn->stream);
+  free (conn->tx_buf);
+  free (conn->tx_inflight);
+
+  conn->tx_buf = NULL;
+  conn->tx_off = conn->tx_len = conn->tx_cap = conn->tx_boundary = 0;
+  conn->tx_inflight = NULL;
+  conn->tx_inflight_off = conn->tx_inflight_len = conn->tx_inflight_cap = 0;
+  conn->recv_paused = 0;
+  conn->eof = 0;
+  conn->want_out = 0;
+  conn->active = 0;
+  conn->generation++;
+
+  // A closed slot may still be linked in the ready list; ready_pop skips it.
+  server->free_slots[server->free_count++] = slot;
+}
+
+static int
+conn_watch (cipc_tcp_server *server, uint32_t slot, int op, int want_out)
+{
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof (ev));
+
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (want_out ? EPOLLOUT : 0);
+  ev.data.u64 = conn_id (server, slot);
+
+  return epoll_ctl (server->epoll_fd, op, server->conns[slot].stream.fd, &ev);
+}
+
+static void
+accept_all (cipc_tcp_server *server)
+{
+  while (1)
+    {
+      int fd = accept4 (server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          if (errno != EAGAIN && errno != EWOULDBLOCK)
+            fprintf (stderr, "Accept failed: %s\n", strerror (errno));
+
+          return;
+        }
+
+      uint32_t slot;
+      if (conn_alloc (server, &slot) != CIPC_OK)
+        {
+          close (fd);
+          continue;
+        }
+
+      cipc_tcp_conn *conn = &server->conns[slot];
+
+      cipc_stream_init (&conn->stream, fd, 1, server->rcvbuf_size, server->max_message_size,
+                        CIPC_BAD_TCP_SEND, CIPC_BAD_TCP_RECV, server->counters);
+      // Best effort: the connection works without its tunings.
+      cipc_tcp_tuning_apply (fd, &server->tuning);
+      conn->stream.nonblocking = 1;
+      conn->stream.quickack = server->tuning.quickack;
+      conn->active = 1;
+
+      if (conn_watch (server, slot, EPOLL_CTL_ADD, 0) < 0)
+        {
+          conn_close (server, slot);
+          continue;
+        }
+
+      // Data may have arrived before the socket was registered.
+      ready_push (server, slot);
+    }
+}
+
+static void
+flush_tx (cipc_tcp_server *server, uint32_t slot)
+{
+  cipc_tcp_conn *conn = &server->conns[slot];
+
+  while (conn->tx_off < conn->tx_len)
+    {
+      struct iovec iov = { .iov_base = conn->tx_buf + conn->tx_off,
+                           .iov_len = conn->tx_len - conn->tx_off };
+      size_t written;
+
+      if (cipc_stream_write_some (&conn->stream, &iov, 1, &written) != CIPC_OK)
+        {
+          conn_close (server, slot);
+          return;
+        }
+
+      if (written == 0)
+        break;
+
+      conn->tx_off += written;
+    }
+
+  if (conn->tx_off == conn->tx_len)
+    conn->tx_off = conn->tx_len = 0;
+
+  int want_out = conn->tx_len > 0;
+  if (want_out != conn->want_out)
+    {
+      conn->want_out = want_out;
+      conn_watch (server, slot, EPOLL_CTL_MOD, want_out);
+    }
+}
+
+static uint64_t
+uring_op (uint32_t op, uint32_t slot)
+{
+  return ((uint64_t)op << 32) | slot;
+}
+
+static size_t
+rx_pending (const cipc_tcp_conn *conn)
+{
+  return conn->stream.rx_tail - conn->stream.rx_head;
+}
+
+static void
+uring_arm_recv (cipc_tcp_server *server, uint32_t slot)
+{
+  cipc_tcp_conn *conn = &server->conns[slot];
+
+  if (cipc_uring_recv_multishot (server->uring, conn->stream.fd,
+                                 uring_op (CIPC_TCP_SERVER_OP_RECV, slot))
+      == 0)
+    {
+      conn->recv_armed = 1;
+      return;
+    }
+
+  // Surfaces on the next receive, which closes the connection.
+  conn->eof = 1;
+  ready_push (server, slot);
+}
+
+// Hands the next pending bytes to the kernel unless a send is already in flight.
+static cipc_err
+uring_send_next (cipc_tcp_server *server, uint32_t slot)
+{
+  cipc_tcp_conn *conn = &server->conns[slot];
+  if (conn->send_armed)
+    return CIPC_OK;
+
+  if (conn->tx_inflight_off == conn->tx_inflight_len)
+    {
+      if (conn->tx_len == 0)
+        return CIPC_OK;
+
+      char *buf = conn->tx_inflight;
+      size_t cap = conn->tx_inflight_cap;
+
+      conn->tx_inflight = conn->tx_buf;
+      conn->tx_inflight_cap = conn->tx_cap;
+      conn->tx_inflight_off = 0;
+      conn->tx_inflight_len = conn->tx_len;
+
+      conn->tx_buf = buf;
+      conn->tx_cap = cap;
+      conn->tx_off = conn->tx_len = 0;
+    }
+
+  if (cipc_uring_send (server->uring, conn->stream.fd, conn->tx_inflight + conn->tx_inflight_off,
+                       conn->tx_inflight_len - conn->tx_inflight_off,
+                       uring_op (CIPC_TCP_SERVER_OP_SEND, slot))
+      != 0)
+    return CIPC_BAD_TCP_SEND;
+
+  conn->send_armed = 1;
+
+  return CIPC_OK;
+}
+
+static void
+uring_accepted (cipc_tcp_server *server, int fd)
+{
+  uint32_t slot;
+  if (conn_alloc (server, &slot) != CIPC_OK)
+    {
+      close (fd);
+      return;
+    }
+
+  cipc_tcp_conn *conn = &server->conns[slot];
+
+  cipc_stream_init (&conn->stream, fd, 1, server->rcvbuf_size, server->max_message_size,
+                    CIPC_BAD_TCP_SEND, CIPC_BAD_TCP_RECV, server->counters);
+  cipc_tcp_tuning_apply (fd, &server->tuning);
+  conn->stream.nonblocking = 1;
+  conn->stream.fed = 1;
+  conn->active = 1;
+
+  uring_arm_recv (server, slot);
+}
+
+static void
+uring_received (cipc_tcp_server *server, uint32_t slot, const cipc_uring_completion *completion)
+{
+  cipc_tcp_conn *conn = &server->conns[slot];
+  const char *data = cipc_uring_completion_data (server->uring, completion);
+
+  if (conn->active && completion->res > 0 && data)
+    {
+      if (cipc_stream_feed (&conn->stream, data, (size_t)completion->res) != CIPC_OK)
+        conn->eof = 1;
+
+      ready_push (server, slot);
+    }
+
+  cipc_uring_recycle (server->uring, completion);
+
+  if (cipc_uring_completion_more (completion))
+    {
+      // Leaves the rest in the socket buffer, so TCP flow control holds back a fast sender.
+      cipc_stream_frame frame;
+      if (conn->active && !conn->recv_paused
+          && rx_pending (conn) > server->rcvbuf_size * CIPC_TCP_SERVER_URING_RX_BUFFERS
+          && cipc_stream_next_frame (&conn->stream, &frame) == CIPC_OK)
+        {
+          conn->recv_paused = 1;
+          cipc_uring_cancel (server->uring, uring_op (CIPC_TCP_SERVER_OP_RECV, slot),
+                             uring_op (CIPC_TCP_SERVER_OP_CANCEL, slot));
+        }
+
+      return;
+    }
+
+  conn->recv_armed = 0;
+
+  if (!conn->active)
+    return;
+
+  // Out of provided buffers or cancelled for a pause: the connection itself is fine.
+  if (completion->res == 0
+      || (completion->res < 0 && completion->res != -ENOBUFS && completion->res != -ECANCELED))
+    {
+      conn->eof = 1;
+      ready_push (server, slot);
+      return;
+    }
+
+  if (!conn->recv_paused)
+    uring_arm_recv (server, slot);
+}
+
+static void
+uring_sent (cipc_tcp_server *server, uint32_t slot, const cipc_uring_completion *completion)
+{
+  cipc_tcp_conn *conn = &server->conns[slot];
+
+  conn->send_armed = 0;
+
+  if (!conn->active)
+    return;
+
+  if (completion->res < 0)
+    {
+      conn_close (server, slot);
+      return;
+    }
+
+  if ((size_t)completion->res < conn->tx_inflight_len - conn->tx_inflight_off)
+    cipc_counter_add (&server->counters->short_writes, 1);
+
+  conn->tx_inflight_off += (size_t)completion->res;
+
+  if (uring_send_next (server, slot) != CIPC_OK)
+    conn_close (server, slot);
+}
+
+static void
+uring_complete (cipc_tcp_server *server, const cipc_uring_completion *completion)
+{
+  uint32_t op = (uint32_t)(completion->user_data >> 32);
+  uint32_t slot = (uint32_t)completion->user_data;
+
+  if (op == CIPC_TCP_SERVER_OP_ACCEPT)
+    {
+      if (completion->res >= 0)
+        uring_accepted (server, completion->res);
+      else if (completion->res != -ECANCELED)
+        fprintf (stderr, "Accept failed: %s\n", strerror (-completion->res));
+
+      if (!cipc_uring_completion_more (completion))
+        cipc_uring_accept_multishot (server->uring, server->listen_fd,
+                                     uring_op (CIPC_TCP_SERVER_OP_ACCEPT, 0));
+
+      return;
+    }
+
+  if (slot >= server->conn_cap)
+    return;
+
+  if (op == CIPC_TCP_SERVER_OP_RECV)
+    uring_received (server, slot, completion);
+  else if (op == CIPC_TCP_SERVER_OP_SEND)
+    uring_sent (server, slot, completion);
+  else
+    return;
+
+  cipc_tcp_conn *conn = &server->conns[slot];
+
+  // The last operation of a closed connection has completed; release the slot.
+  if (!conn->active && conn->stream.fd >= 0 && !conn->recv_armed && !conn->send_armed)
+    conn_close (server, slot);
+}
+
+// Whether a complete frame is already buffered on some connection, so the caller is expected
+// back for it soon.
+static int
+uring_frames_waiting (cipc_tcp_server *server)
+{
+  for (uint32_t slot = server->ready_head; slot != CIPC_TCP_SERVER_NONE;
+       slot = server->conns[slot].next_ready)
+    {
+      cipc_stream_frame frame;
+
+      if (server->conns[slot].active
+          && cipc_stream_next_frame (&server->conns[slot].stream, &frame) == CIPC_OK)
+        return 1;
+    }
+
+  return 0;
+}
+
+// Processes the completions already posted. Without any, queued sends are submitted and, unless
+// timeout_ms is 0, completions are waited for in the same system call. Returns 0 when nothing
+// happened.
+static int
+uring_poll_events (cipc_tcp_server *server, int timeout_ms)
+{
+  cipc_uring_completion completions[CIPC_TCP_SERVER_URING_COMPLETIONS];
+
+  size_t n = cipc_uring_reap (server->uring, completions, CIPC_TCP_SERVER_URING_COMPLETIONS);
+
+  if (n == 0 && timeout_ms != 0)
+    {
+      cipc_uring_submit (server->uring, 1, timeout_ms);
+      cipc_counter_add (&server->counters->recv_syscalls, 1);
+
+      n = cipc_uring_reap (server->uring, completions, CIPC_TCP_SERVER_URING_COMPLETIONS);
+    }
+
+  for (size_t i = 0; i < n; i++)
+    uring_complete (server, &completions[i]);
+
+  // Without waiting, sends queued meanwhile still need submitting.
+  if (n == 0 && cipc_uring_unsubmitted (server->uring) > 0)
+    {
+      cipc_uring_submit (server->uring, 0, 0);
+      cipc_counter_add (&server->counters->send_syscalls, 1);
+
+      return 1;
+    }
+
+  return n > 0;
+}
+
+// Applied to the outcome of reading a frame: resumes a paused receive once the backlog has
+// been worked off and turns a drained connection at end of stream into an error.
+static cipc_err
+uring_check_conn (cipc_tcp_server *server, uint32_t slot, cipc_err err)
+{
+  cipc_tcp_conn *conn = &server->conns[slot];
+
+  if (conn->recv_paused
+      && (err != CIPC_OK
+          || rx_pending (conn) <= server->rcvbuf_size * CIPC_TCP_SERVER_URING_RX_BUFFERS))
+    {
+      conn->recv_paused = 0;
+
+      if (!conn->recv_armed && !conn->eof)
+        uring_arm_recv (server, slot);
+    }
+
+  if (err == CIPC_WOULD_BLOCK && conn->eof)
+    return CIPC_BAD_TCP_RECV;
+
+  return err;
+}
+
+// Waits for socket events and updates the ready list. Returns 0 on timeout.
+static int
+poll_events (cipc_tcp_server *server, int timeout_ms)
+{
+  if (server->uring)
+    return uring_poll_events (server, timeout_ms);
+
+  struct epoll_event events[CIPC_TCP_SERVER_MAX_EVENTS];
+
+  int n;
+  do
+    n = epoll_wait (server->epoll_fd, events, CIPC_TCP_SERVER_MAX_EVENTS, timeout_ms);
+  while (n < 0 && errno == EINTR);
+
+  cipc_counter_add (&server->counters->recv_syscalls, 1);
+
+  if (n <= 0)
+    return 0;
+
+  for (int i = 0; i < n; i++)
+    {
+      if (events[i].data.u64 == CIPC_TCP_SERVER_LISTENER)
+        {
+          accept_all (server);
+          continue;
+        }
+
+      uint32_t slot;
+      cipc_tcp_conn *conn = conn_lookup (server, events[i].data.u64, &slot);
+      if (!conn)
+        continue;
+
+      if (events[i].events & EPOLLOUT)
+        flush_tx (server, slot);
+
+      if (conn->active && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+        ready_push (server, slot);
+    }
+
+  return 1;
+}
+
+// Polls for events without blocking until the spin deadline; returns 0 if none came.
+static int
+spin_events (cipc_tcp_server *server)
+{
+  int64_t spin_until = cipc_spin_deadline (&server->spin);
+
+  while (spin_until)
+    {
+      if (poll_events (server, 0))
+        return 1;
+
+      if (!cipc_spin_wait (spin_until))
+        break;
+    }
+
+  return 0;
+}
+
+// Finds a connection with a complete frame buffered and returns its slot. Without wait, only
+// already pending socket events are looked at and CIPC_WOULD_BLOCK is returned otherwise.
+static cipc_err
+next_ready_frame (cipc_tcp_server *server, int wait, uint32_t *slot_out)
+{
+  int polled = 0;
+  int64_t deadline = server->rcvtimeo > 0 ? cipc_monotonic_ms () + server->rcvtimeo : 0;
+
+  if (server->retry_peer)
+    {
+      uint32_t slot;
+      cipc_peer_id peer = server->retry_peer;
+
+      server->retry_peer = 0;
+
+      if (conn_lookup (server, peer, &slot))
+        {
+          *slot_out = slot;
+          server->last_peer = peer;
+
+          return CIPC_OK;
+        }
+    }
+
+  while (1)
+    {
+      uint32_t slot = ready_pop (server);
+
+      if (slot == CIPC_TCP_SERVER_NONE)
+        {
+          if (!wait)
+            {
+              if (polled || !poll_events (server, 0))
+                return CIPC_WOULD_BLOCK;
+
+              polled = 1;
+              continue;
+            }
+
+          int timeout = -1;
+          if (server->rcvtimeo > 0)
+            {
+              int64_t left = deadline - cipc_monotonic_ms ();
+              if (left <= 0)
+                {
+                  cipc_counter_add (&server->counters->recv_timeouts, 1);
+                  cipc_counter_add (&server->counters->recv_errors, 1);
+
+                  return CIPC_BAD_TCP_RECV;
+                }
+
+              timeout = (int)left;
+            }
+
+          if (spin_events (server) || poll_events (server, timeout))
+            cipc_spin_arrived (&server->spin);
+
+          continue;
+        }
+
+      cipc_tcp_conn *conn = &server->conns[slot];
+      if (!conn->active)
+        continue;
+
+      cipc_stream_frame frame;
+      cipc_err err = cipc_stream_next_frame (&conn->stream, &frame);
+
+      if (server->uring)
+        err = uring_check_conn (server, slot, err);
+
+      if (err == CIPC_OK)
+        {
+          // Requeue behind the other ready connections so one busy peer cannot starve them.
+          ready_push (server, slot);
+
+          *slot_out = slot;
+          server->last_peer = conn_id (server, slot);
+
+          return CIPC_OK;
+        }
+
+      if (err != CIPC_WOULD_BLOCK)
+        conn_close (server, slot);
+    }
+}
+
+cipc_err
+cipc_tcp_server_recv_from (cipc_tcp_server *server, cipc_peer_id *peer, char *buffer,
+                           size_t length, size_t *len_out)
+{
+  // No room for the terminator.
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  uint32_t slot;
+
+  cipc_err err = next_ready_frame (server, 1, &slot);
+  if (err != CIPC_OK)
+    return err;
+
+  if (peer != NULL)
+    *peer = server->last_peer;
+
+  err = cipc_stream_recv (&server->conns[slot].stream, buffer, length, len_out);
+  if (err == CIPC_BAD_BUFFER_SIZE)
+    server->retry_peer = server->last_peer;
+
+  return err;
+}
+
+cipc_err
+cipc_tcp_server_recv_msg_from (cipc_tcp_server *server, cipc_peer_id *peer, cipc_msg *msg)
+{
+  uint32_t slot;
+
+  cipc_err err = next_ready_frame (server, 1, &slot);
+  if (err != CIPC_OK)
+    return err;
+
+  if (peer != NULL)
+    *peer = server->last_peer;
+
+  return cipc_stream_recv_msg (&server->conns[slot].stream, msg);
+}
+
+cipc_err
+cipc_tcp_server_recv_batch (cipc_tcp_server *server, cipc_msg *msgs, size_t count,
+                            size_t *received)
+{
+  *received = 0;
+
+  while (*received < count)
+    {
+      uint32_t slot;
+
+      cipc_err err = next_ready_frame (server, *received == 0, &slot);
+      if (err == CIPC_WOULD_BLOCK)
+        break;
+
+      if (err == CIPC_OK)
+        err = cipc_stream_recv_msg (&server->conns[slot].stream, &msgs[*received]);
+
+      if (err != CIPC_OK)
+        return *received > 0 ? CIPC_OK : err;
+
+      (*received)++;
+    }
+
+  return CIPC_OK;
+}
+
+static cipc_err
+append_tx (cipc_tcp_conn *conn, const struct iovec *iov, size_t iovcnt, size_t skip)
+{
+  size_t total = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    total += iov[i].iov_len;
+
+  total -= skip;
+
+  if (conn->tx_len + total > conn->tx_cap)
+    {
+      size_t cap = conn->tx_cap ? conn->tx_cap : 4096;
+      while (cap < conn->tx_len + total)
+        cap *= 2;
+
+      char *buf = realloc (conn->tx_buf, cap);
+      if (!buf)
+        return CIPC_BAD_ALLOC;
+
+      conn->tx_buf = buf;
+      conn->tx_cap = cap;
+    }
+
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      size_t len = iov[i].iov_len;
+      const char *base = iov[i].iov_base;
+
+      if (skip >= len)
+        {
+          skip -= len;
+          continue;
+        }
+
+      memcpy (conn->tx_buf + conn->tx_len, base + skip, len - skip);
+      conn->tx_len += len - skip;
+      skip = 0;
+    }
+
+  return CIPC_OK;
+}
+
+// Drops the queued messages the kernel has not started on, keeping the one partly written.
+static void
+conflate_tx (cipc_tcp_conn *conn)
+{
+  size_t boundary = conn->tx_boundary;
+
+  while (boundary < conn->tx_off)
+    {
+      uint32_t length;
+      memcpy (&length, conn->tx_buf + boundary, sizeof (length));
+
+      boundary += CIPC_STREAM_FRAME_HEADER_SIZE + ntohl (length);
+    }
+
+  conn->tx_len = conn->tx_boundary = boundary;
+
+  if (conn->tx_off == conn->tx_len)
+    conn->tx_off = conn->tx_len = conn->tx_boundary = 0;
+}
+
+// Called when a message would take a connection past max_pending_bytes; CIPC_OK queues it.
+static cipc_err
+overflow (cipc_tcp_server *server, uint32_t slot)
+{
+  switch (server->overflow)
+    {
+    case CIPC_TCP_OVERFLOW_CONFLATE:
+      conflate_tx (&server->conns[slot]);
+      return CIPC_OK;
+    case CIPC_TCP_OVERFLOW_DISCONNECT:
+      conn_close (server, slot);
+      return CIPC_BAD_TCP_SEND;
+    case CIPC_TCP_OVERFLOW_REJECT:
+    default:
+      return CIPC_BAD_TCP_SEND;
+    }
+}
+
+static cipc_err
+queue_message (cipc_tcp_server *server, cipc_peer_id peer, const cipc_iovec *iov, size_t iovcnt,
+               size_t total)
+{
+  // Completions already posted may have finished the send in flight; no system call is made.
+  if (server->uring)
+    while (cipc_uring_unsubmitted (server->uring) == 0 && uring_poll_events (server, 0))
+      ;
+
+  uint32_t slot;
+  cipc_tcp_conn *conn = conn_lookup (server, peer, &slot);
+  if (!conn)
+    return CIPC_BAD_PEER;
+
+  if (total > server->max_message_size)
+    return CIPC_BAD_FRAME;
+
+  if (server->uring)
+    {
+      size_t pending = conn->tx_len + conn->tx_inflight_len - conn->tx_inflight_off;
+      if (pending > 0 && pending + total > server->max_pending_bytes)
+        {
+          cipc_err err = overflow (server, slot);
+          if (err != CIPC_OK)
+            return err;
+        }
+    }
+  else
+    {
+      if (conn->tx_len > 0)
+        {
+          flush_tx (server, slot);
+          if (!conn->active)
+            return CIPC_BAD_TCP_SEND;
+        }
+
+      if (conn->tx_len > 0 && conn->tx_len - conn->tx_off + total > server->max_pending_bytes)
+        {
+          cipc_err err = overflow (server, slot);
+          if (err != CIPC_OK)
+            return err;
+        }
+    }
+
+  struct iovec stack_vec[CIPC_TCP_SERVER_SENDV_STACK_IOV];
+  struct iovec *vec = stack_vec;
+
+  if (iovcnt + 1 > CIPC_TCP_SERVER_SENDV_STACK_IOV)
+    {
+      vec = malloc ((iovcnt + 1) * sizeof (struct iovec));
+      if (!vec)
+        return CIPC_BAD_ALLOC;
+    }
+
+  uint32_t header[2];
+  cipc_stream_encode_header (header, total, 0);
+
+  vec[0].iov_base = header;
+  vec[0].iov_len = sizeof (header);
+
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      vec[i + 1].iov_base = (void *)iov[i].base;
+      vec[i + 1].iov_len = iov[i].length;
+    }
+
+  size_t written = 0;
+  cipc_err err = CIPC_OK;
+
+  if (conn->tx_len == 0 && iovcnt + 1 <= UIO_MAXIOV && !server->uring)
+    err = cipc_stream_write_some (&conn->stream, vec, iovcnt + 1, &written);
+
+  if (err == CIPC_OK && written < sizeof (header) + total)
+    {
+      // A buffer that starts with the rest of a partly written frame has its first boundary
+      // right after it.
+      if (conn->tx_len == 0)
+        conn->tx_boundary = written > 0 ? sizeof (header) + total - written : 0;
+
+      err = append_tx (conn, vec, iovcnt + 1, written);
+      if (err == CIPC_OK && server->uring)
+        {
+          err = uring_send_next (server, slot);
+
+          // Replies to a burst of requests go out together once the burst has been read. Sends
+          // completing inline let replies queued behind them on the same connection follow.
+          if (err == CIPC_OK && !uring_frames_waiting (server))
+            while (uring_poll_events (server, 0))
+              ;
+        }
+      else if (err == CIPC_OK && !conn->want_out)
+        {
+          conn->want_out = 1;
+          conn_watch (server, slot, EPOLL_CTL_MOD, 1);
+        }
+    }
+
+  if (vec != stack_vec)
+    free (vec);
+
+  if (err != CIPC_OK && err != CIPC_BAD_ALLOC)
+    conn_close (server, slot);
+
+  return err;
+}
+
+cipc_err
+cipc_tcp_server_sendv_to (cipc_tcp_server *server, cipc_peer_id peer, const cipc_iovec *iov,
+                          size_t iovcnt)
+{
+  uint64_t start = cipc_counters_start (server->counters);
+
+  size_t total = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    total += iov[i].length;
+
+  cipc_err err = queue_message (server, peer, iov, iovcnt, total);
+
+  cipc_counters_sent (server->counters, err, err == CIPC_OK, total, start);
+
+  return err;
+}
+
+cipc_err
+cipc_tcp_server_get_fd (cipc_tcp_server *server, int *fd, int *ready)
+{
+  // The epoll descriptor is itself pollable: it turns readable when any connection does. So is
+  // the io_uring descriptor while completions are waiting.
+  *fd = server->uring ? cipc_uring_fd (server->uring) : server->epoll_fd;
+  *ready = 0;
+
+  if (server->retry_peer && conn_lookup (server, server->retry_peer, NULL))
+    {
+      *ready = 1;
+      return CIPC_OK;
+    }
+
+  // Drain pending events so the descriptor only fires again on new activity.
+  while (poll_events (server, 0))
+    ;
+
+  for (uint32_t slot = server->ready_head; slot != CIPC_TCP_SERVER_NONE;
+       slot = server->conns[slot].next_ready)
+    {
+      if (!server->conns[slot].active)
+        continue;
+
+      cipc_stream_frame frame;
+      cipc_err err = cipc_stream_next_frame (&server->conns[slot].stream, &frame);
+
+      if (server->uring)
+        err = uring_check_conn (server, slot, err);
+
+      if (err != CIPC_WOULD_BLOCK)
+        {
+          *ready = 1;
+          break;
+        }
+    }
+
+  return CIPC_OK;
+}
+
+// Lets queued replies reach their peers, then ends every operation still held by the kernel so
+// no buffer is freed under it.
+static void
+uring_drain (cipc_tcp_server *server)
+{
+  int64_t deadline = cipc_monotonic_ms () + CIPC_TCP_SERVER_URING_DRAIN_MS;
+  int closing = 0;
+
+  while (1)
+    {
+      int busy = 0;
+
+      for (uint32_t slot = 0; slot < server->conn_cap; slot++)
+        {
+          cipc_tcp_conn *conn = &server->conns[slot];
+
+          if (!closing && conn->active
+              && (conn->send_armed || conn->tx_len > 0))
+            busy = 1;
+          else if (closing && (conn->recv_armed || conn->send_armed))
+            busy = 1;
+        }
+
+      if (!busy && !closing)
+        {
+          for (uint32_t slot = 0; slot < server->conn_cap; slot++)
+            if (server->conns[slot].active)
+              conn_close (server, slot);
+
+          closing = 1;
+          continue;
+        }
+
+      int64_t left = deadline - cipc_monotonic_ms ();
+      if (!busy || left <= 0)
+        break;
+
+      uring_poll_events (server, (int)left);
+    }
+}
+
+cipc_peer_id
+cipc_tcp_server_last_peer (const cipc_tcp_server *server)
+{
+  return server->last_peer;
+}
+
+cipc_err
+cipc_tcp_server_create (cipc_tcp_server **out, const cipc_tcp_config *cfg,
+                        cipc_counters *counters)
+{
+  cipc_tcp_server *server = calloc (1, sizeof (cipc_tcp_server));
+  if (!server)
+    return CIPC_BAD_ALLOC;
+
+  server->ready_head = server->ready_tail = CIPC_TCP_SERVER_NONE;
+  server->counters = counters;
+  server->rcvtimeo = cfg->sockopt_rcvtimeo;
+  server->rcvbuf_size = cfg->rcvbuf_size ? cfg->rcvbuf_size : CIPC_TCP_DEFAULT_RCVBUF_SIZE;
+  server->max_message_size
+      = cfg->max_message_size ? cfg->max_message_size : CIPC_TCP_DEFAULT_MAX_MESSAGE_SIZE;
+  server->max_pending_bytes
+      = cfg->max_pending_bytes ? cfg->max_pending_bytes : CIPC_TCP_DEFAULT_MAX_PENDING_BYTES;
+  server->overflow = cfg->overflow;
+  cipc_tcp_tuning_resolve (&server->tuning, cfg);
+  cipc_spin_init (&server->spin, cfg->spin_us);
+
+  server->epoll_fd = -1;
+
+  if (cfg->engine != CIPC_TCP_ENGINE_IO_URING)
+    {
+      server->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+      if (server->epoll_fd < 0)
+        {
+          free (server);
+          return CIPC_BAD_TCP_EPOLL;
+        }
+    }
+
+  server->listen_fd = socket (AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (server->listen_fd < 0)
+    {
+      cipc_tcp_server_free (server);
+      return CIPC_BAD_TCP_SOCKET;
+    }
+
+  int one = 1;
+  setsockopt (server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+  // Socket buffers are only sized for the window scale when set before listen.
+  if (cipc_tcp_tuning_apply (server->listen_fd, &server->tuning) < 0)
+    {
+      fprintf (stderr, "Socket options failed: %s\n", strerror (errno));
+      cipc_tcp_server_free (server);
+      return CIPC_BAD_TCP_SOCKET_OPT;
+    }
+
+  struct sockaddr_in addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons (cfg->port);
+  addr.sin_addr.s_addr = INADDR_ANY;
+
+  if (cfg->host && inet_pton (AF_INET, cfg->host, &addr.sin_addr) <= 0)
+    {
+      fprintf (stderr, "Invalid address: %s\n", cfg->host);
+      cipc_tcp_server_free (server);
+      return CIPC_BAD_TCP_ADDRESS;
+    }
+
+  if (bind (server->listen_fd, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+    {
+      fprintf (stderr, "Bind failed: %s\n", strerror (errno));
+      cipc_tcp_server_free (server);
+      return CIPC_BAD_TCP_BIND;
+    }
+
+  if (listen (server->listen_fd, cfg->backlog > 0 ? cfg->backlog : SOMAXCONN) < 0)
+    {
+      fprintf (stderr, "Listen failed: %s\n", strerror (errno));
+      cipc_tcp_server_free (server);
+      return CIPC_BAD_TCP_LISTEN;
+    }
+
+  if (cfg->engine == CIPC_TCP_ENGINE_IO_URING)
+    {
+      int rc = cipc_uring_create (&server->uring, CIPC_TCP_SERVER_URING_ENTRIES,
+                                  CIPC_TCP_SERVER_URING_BUFFERS,
+                                  CIPC_TCP_SERVER_URING_BUFFER_SIZE);
+      if (rc < 0)
+        {
+          fprintf (stderr, "io_uring setup failed: %s\n", strerror (-rc));
+          cipc_tcp_server_free (server);
+          return CIPC_BAD_TCP_URING;
+        }
+
+      cipc_uring_accept_multishot (server->uring, server->listen_fd,
+                                   uring_op (CIPC_TCP_SERVER_OP_ACCEPT, 0));
+
+      *out = server;
+
+      return CIPC_OK;
+    }
+
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof (ev));
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.u64 = CIPC_TCP_SERVER_LISTENER;
+
+  if (epoll_ctl (server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &ev) < 0)
+    {
+      cipc_tcp_server_free (server);
+      return CIPC_BAD_TCP_EPOLL;
+    }
+
+  *out = server;
+
+  return CIPC_OK;
+}
+
+void
+cipc_tcp_server_free (cipc_tcp_server *server)
+{
+  if (!server)
+    return;
+
+  if (server->uring)
+    uring_drain (server);
+
+  for (uint32_t slot = 0; slot < server->conn_cap; slot++)
+    {
+      cipc_tcp_conn *conn = &server->conns[slot];
+
+      if (conn->active || conn->recv_armed || conn->send_armed)
+        {
+          cipc_stream_destroy (&conn->stream);
+          free (conn->tx_buf);
+
+          // Still referenced by a send the kernel did not give back in time.
+          if (!conn->send_armed)
+            free (conn->tx_inflight);
+        }
+    }
+
+  if (server->listen_fd >= 0)
+    close (server->listen_fd);
+
+  cipc_uring_free (server->uring);
+
+  if (server->epoll_fd >= 0)
+    close (server->epoll_fd);
+
+  free (server->conns);
+  free (server->free_slots);
+  free (server);
+}
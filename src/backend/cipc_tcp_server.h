@@ -0,0 +1,28 @@
+#ifndef CIPC_TCP_SERVER_H
+#define CIPC_TCP_SERVER_H
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+
+// Multi-client mode of the TCP backend: one listening socket and any number of
+// non-blocking connections multiplexed with edge-triggered epoll.
+
+typedef struct cipc_tcp_server cipc_tcp_server;
+
+cipc_err cipc_tcp_server_create (cipc_tcp_server **out, const cipc_tcp_config *cfg,
+                                 cipc_counters *counters);
+void cipc_tcp_server_free (cipc_tcp_server *server);
+
+cipc_peer_id cipc_tcp_server_last_peer (const cipc_tcp_server *server);
+cipc_err cipc_tcp_server_get_fd (cipc_tcp_server *server, int *fd, int *ready);
+
+cipc_err cipc_tcp_server_sendv_to (cipc_tcp_server *server, cipc_peer_id peer,
+                                   const cipc_iovec *iov, size_t iovcnt);
+cipc_err cipc_tcp_server_recv_from (cipc_tcp_server *server, cipc_peer_id *peer, char *buffer,
+                                    size_t length, size_t *len_out);
+cipc_err cipc_tcp_server_recv_msg_from (cipc_tcp_server *server, cipc_peer_id *peer,
+                                        cipc_msg *msg);
+cipc_err cipc_tcp_server_recv_batch (cipc_tcp_server *server, cipc_msg *msgs, size_t count,
+                                     size_t *received);
+
+#endif // CIPC_TCP_SERVER_H
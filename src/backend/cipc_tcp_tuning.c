@@ -0,0 +1,74 @@
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "backend/cipc_tcp.h"
+#include "backend/cipc_tcp_tuning.h"
+#include "cipc.h"
+
+// A config value wins unless 0; negative values clear the option.
+static int
+pick (int value, int profile_value)
+{
+  if (value == 0)
+    return profile_value;
+
+  return value > 0 ? value : 0;
+}
+
+void
+cipc_tcp_tuning_resolve (cipc_tcp_tuning *tuning, const cipc_tcp_config *cfg)
+{
+  cipc_tcp_tuning profile = { .nodelay = 1 };
+
+  switch (cfg->profile)
+    {
+    case CIPC_PROFILE_LOW_LATENCY:
+      profile.quickack = 1;
+      profile.busy_poll_us = CIPC_TCP_LOW_LATENCY_BUSY_POLL_US;
+      break;
+    case CIPC_PROFILE_BULK:
+      profile.sndbuf = CIPC_TCP_BULK_SOCKET_BUFFER;
+      profile.rcvbuf = CIPC_TCP_BULK_SOCKET_BUFFER;
+      profile.cork = 1;
+      break;
+    case CIPC_PROFILE_DEFAULT:
+    default:
+      break;
+    }
+
+  tuning->nodelay = pick (cfg->nodelay, profile.nodelay) != 0;
+  tuning->quickack = pick (cfg->quickack, profile.quickack) != 0;
+  tuning->busy_poll_us = pick (cfg->busy_poll_us, profile.busy_poll_us);
+  tuning->sndbuf = pick (cfg->socket_sndbuf, profile.sndbuf);
+  tuning->rcvbuf = pick (cfg->socket_rcvbuf, profile.rcvbuf);
+  tuning->cork = pick (cfg->cork, profile.cork) != 0;
+}
+
+int
+cipc_tcp_tuning_apply (int sockfd, const cipc_tcp_tuning *tuning)
+{
+  if (setsockopt (sockfd, IPPROTO_TCP, TCP_NODELAY, &tuning->nodelay, sizeof (int)) < 0)
+    return -1;
+
+  if (tuning->quickack
+      && setsockopt (sockfd, IPPROTO_TCP, TCP_QUICKACK, &tuning->quickack, sizeof (int)) < 0)
+    return -1;
+
+  // Raising it past net.core.busy_read needs CAP_NET_ADMIN; polling is only an optimization.
+  if (tuning->busy_poll_us > 0
+      && setsockopt (sockfd, SOL_SOCKET, SO_BUSY_POLL, &tuning->busy_poll_us, sizeof (int)) < 0
+      && errno != EPERM)
+    return -1;
+
+  if (tuning->sndbuf > 0
+      && setsockopt (sockfd, SOL_SOCKET, SO_SNDBUF, &tuning->sndbuf, sizeof (int)) < 0)
+    return -1;
+
+  if (tuning->rcvbuf > 0
+      && setsockopt (sockfd, SOL_SOCKET, SO_RCVBUF, &tuning->rcvbuf, sizeof (int)) < 0)
+    return -1;
+
+  return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef CIPC_TCP_TUNING_H
+#define CIPC_TCP_TUNING_H
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+
+// Socket options of a TCP config, with its profile's defaults filled in. Flags are 1 or 0,
+// sizes and busy_poll_us 0 when left to the kernel.
+
+#define CIPC_TCP_LOW_LATENCY_BUSY_POLL_US 50
+#define CIPC_TCP_BULK_SOCKET_BUFFER (4 * 1024 * 1024)
+
+typedef struct
+{
+  int nodelay;
+  int quickack;
+  int busy_poll_us;
+  int sndbuf;
+  int rcvbuf;
+  int cork;
+} cipc_tcp_tuning;
+
+void cipc_tcp_tuning_resolve (cipc_tcp_tuning *tuning, const cipc_tcp_config *cfg);
+
+// Sets every option on a socket; buffer sizes take effect on accepted sockets when set on the
+// listener, before listen. Returns -1 with errno set.
+int cipc_tcp_tuning_apply (int sockfd, const cipc_tcp_tuning *tuning);
+
+#endif // CIPC_TCP_TUNING_H
@@ -0,0 +1,791 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/cipc_threaded.h"
+#include "cipc.h"
+#include "cipc_alloc.h"
+#include "cipc_internal.h"
+
+#define CIPC_THREADED_CACHE_LINE 64
+// Messages handed to one send_batch/recv_batch call of the inner instance.
+#define CIPC_THREADED_BATCH 64
+// Longest sleep of the I/O thread while the inner instance has no descriptor (shared memory).
+#define CIPC_THREADED_NO_FD_SLICE_MS 1
+
+typedef struct cipc_threaded_node cipc_threaded_node;
+
+struct cipc_threaded_node
+{
+  _Atomic (cipc_threaded_node *) next;
+  size_t length;
+  char data[];
+};
+
+typedef struct
+{
+  cipc *inner;
+
+  size_t max_queued_bytes;
+  size_t max_inbound;
+  int sndtimeo;
+  int rcvtimeo;
+
+  pthread_t thread;
+
+  // Written to wake the I/O thread; rx_fd is readable while received messages are queued.
+  int wake_fd;
+  int rx_fd;
+
+  // Outbound queue (intrusive MPSC list): producers swap themselves in at tail, the I/O thread
+  // alone walks from head. stub keeps the list non-empty.
+  alignas (CIPC_THREADED_CACHE_LINE) _Atomic (cipc_threaded_node *) tail;
+  alignas (CIPC_THREADED_CACHE_LINE) cipc_threaded_node *head;
+  cipc_threaded_node *stub;
+
+  alignas (CIPC_THREADED_CACHE_LINE) atomic_size_t queued_bytes;
+  atomic_int io_sleeping;
+  atomic_int stopping;
+  // First send failure not yet reported to a caller.
+  atomic_int send_err;
+
+  // Producers waiting for queue room.
+  pthread_mutex_t room_lock;
+  pthread_cond_t room_cond;
+  atomic_int room_waiters;
+
+  // Inbound messages, oldest first, and the receive failure to report once they are taken.
+  pthread_mutex_t rx_lock;
+  pthread_cond_t rx_cond;
+  cipc_threaded_node *rx_head;
+  cipc_threaded_node *rx_tail;
+  size_t rx_count;
+  cipc_err recv_err;
+} cipc_threaded_private;
+
+static void
+queue_push (cipc_threaded_private *tctx, cipc_threaded_node *node)
+{
+  atomic_store_explicit (&node->next, NULL, memory_order_relaxed);
+
+  cipc_threaded_node *prev = atomic_exchange (&tctx->tail, node);
+  atomic_store_explicit (&prev->next, node, memory_order_release);
+}
+
+// Consumer side; NULL when the queue is empty or a producer is midway through a push.
+static cipc_threaded_node *
+queue_pop (cipc_threaded_private *tctx)
+{
+  cipc_threaded_node *head = tctx->head;
+  cipc_threaded_node *next = atomic_load_explicit (&head->next, memory_order_acquire);
+
+  if (head == tctx->stub)
+    {
+      if (!next)
+        return NULL;
+
+      tctx->head = next;
+      head = next;
+      next = atomic_load_explicit (&head->next, memory_order_acquire);
+    }
+
+  if (next)
+    {
+      tctx->head = next;
+      return head;
+    }
+
+  if (atomic_load (&tctx->tail) != head)
+    return NULL;
+
+  queue_push (tctx, tctx->stub);
+
+  next = atomic_load_explicit (&head->next, memory_order_acquire);
+  if (next)
+    {
+      tctx->head = next;
+      return head;
+    }
+
+  return NULL;
+}
+
+static int
+queue_empty (cipc_threaded_private *tctx)
+{
+  return atomic_load (&tctx->tail) == tctx->stub;
+}
+
+static void
+wake_io (cipc_threaded_private *tctx)
+{
+  if (atomic_load (&tctx->io_sleeping) && atomic_exchange (&tctx->io_sleeping, 0))
+    cipc_signal_fd (tctx->wake_fd);
+}
+
+static void
+send_pending (cipc_threaded_private *tctx)
+{
+  cipc_threaded_node *nodes[CIPC_THREADED_BATCH];
+  cipc_iovec msgs[CIPC_THREADED_BATCH];
+
+  while (1)
+    {
+      size_t count = 0;
+      size_t bytes = 0;
+
+      while (count < CIPC_THREADED_BATCH && (nodes[count] = queue_pop (tctx)) != NULL)
+        {
+          msgs[count].base = nodes[count]->data;
+          msgs[count].length = nodes[count]->length;
+          bytes += nodes[count]->length;
+          count++;
+        }
+
+      if (count == 0)
+        return;
+
+      size_t done = 0;
+      while (done < count)
+        {
+          size_t sent = 0;
+
+          cipc_err err = tctx->inner->send_batch (tctx->inner->context, &msgs[done],
+                                                  count - done, &sent);
+          done += sent;
+
+          // The failed message is dropped; the error reaches the next send.
+          if (err != CIPC_OK)
+            {
+              int expected = CIPC_OK;
+              atomic_compare_exchange_strong (&tctx->send_err, &expected, (int)err);
+
+              done++;
+            }
+        }
+
+      for (size_t i = 0; i < count; i++)
+        cipc_dealloc (nodes[i]);
+
+      atomic_fetch_sub (&tctx->queued_bytes, bytes);
+
+      if (atomic_load (&tctx->room_waiters))
+        {
+          pthread_mutex_lock (&tctx->room_lock);
+          pthread_cond_broadcast (&tctx->room_cond);
+          pthread_mutex_unlock (&tctx->room_lock);
+        }
+    }
+}
+
+static int
+can_receive (cipc_threaded_private *tctx)
+{
+  pthread_mutex_lock (&tctx->rx_lock);
+  int result = tctx->recv_err == CIPC_OK && tctx->rx_count < tctx->max_inbound;
+  pthread_mutex_unlock (&tctx->rx_lock);
+
+  return result;
+}
+
+static void
+post_received (cipc_threaded_private *tctx, cipc_threaded_node *first, cipc_threaded_node *last,
+               size_t count, cipc_err err)
+{
+  pthread_mutex_lock (&tctx->rx_lock);
+
+  int was_empty = tctx->rx_head == NULL && tctx->recv_err == CIPC_OK;
+
+  if (first)
+    {
+      if (tctx->rx_tail)
+        atomic_store_explicit (&tctx->rx_tail->next, first, memory_order_relaxed);
+      else
+        tctx->rx_head = first;
+
+      tctx->rx_tail = last;
+      tctx->rx_count += count;
+    }
+
+  if (err != CIPC_OK)
+    tctx->recv_err = err;
+
+  if (was_empty)
+    cipc_signal_fd (tctx->rx_fd);
+
+  pthread_cond_broadcast (&tctx->rx_cond);
+  pthread_mutex_unlock (&tctx->rx_lock);
+}
+
+// Copies out what the inner instance has ready so that its views are released on this thread.
+static void
+receive_ready (cipc_threaded_private *tctx)
+{
+  pthread_mutex_lock (&tctx->rx_lock);
+  size_t room = tctx->max_inbound - tctx->rx_count;
+  pthread_mutex_unlock (&tctx->rx_lock);
+
+  cipc_msg msgs[CIPC_THREADED_BATCH];
+  size_t received = 0;
+
+  cipc_err err = tctx->inner->recv_batch (tctx->inner->context, msgs,
+                                          room < CIPC_THREADED_BATCH ? room : CIPC_THREADED_BATCH,
+                                          &received);
+
+  cipc_threaded_node *first = NULL;
+  cipc_threaded_node *last = NULL;
+  size_t count = 0;
+
+  for (size_t i = 0; i < received; i++)
+    {
+      cipc_threaded_node *node = cipc_alloc (sizeof (cipc_threaded_node) + msgs[i].length);
+
+      if (node)
+        {
+          atomic_store_explicit (&node->next, NULL, memory_order_relaxed);
+          node->length = msgs[i].length;
+          memcpy (node->data, msgs[i].data, msgs[i].length);
+
+          if (last)
+            atomic_store_explicit (&last->next, node, memory_order_relaxed);
+          else
+            first = node;
+
+          last = node;
+          count++;
+        }
+      else if (err == CIPC_OK)
+        {
+          err = CIPC_BAD_ALLOC;
+        }
+
+      tctx->inner->release_msg (tctx->inner->context, &msgs[i]);
+    }
+
+  // A drained non-blocking inner instance is not a failure.
+  if (err == CIPC_WOULD_BLOCK)
+    err = CIPC_OK;
+
+  post_received (tctx, first, last, count, err);
+}
+
+static void *
+io_thread (void *arg)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)arg;
+
+  while (1)
+    {
+      send_pending (tctx);
+
+      if (atomic_load (&tctx->stopping) && queue_empty (tctx))
+        break;
+
+      int fd = -1;
+      int ready = 0;
+      int receiving = can_receive (tctx);
+
+      if (receiving)
+        {
+          cipc_err err = tctx->inner->get_fd (tctx->inner->context, &fd, &ready);
+          if (err != CIPC_OK)
+            {
+              post_received (tctx, NULL, NULL, 0, err);
+              continue;
+            }
+
+          if (ready)
+            {
+              receive_ready (tctx);
+              continue;
+            }
+        }
+
+      // A producer is linking a message in; it is about to become visible.
+      if (!queue_empty (tctx))
+        {
+          sched_yield ();
+          continue;
+        }
+
+      atomic_store (&tctx->io_sleeping, 1);
+
+      if (!queue_empty (tctx) || atomic_load (&tctx->stopping))
+        {
+          atomic_store (&tctx->io_sleeping, 0);
+          continue;
+        }
+
+      struct pollfd fds[2] = {
+        { .fd = tctx->wake_fd, .events = POLLIN },
+        { .fd = receiving ? fd : -1, .events = POLLIN },
+      };
+
+      int timeout = receiving && fd < 0 ? CIPC_THREADED_NO_FD_SLICE_MS : -1;
+
+      if (poll (fds, 2, timeout) < 0 && errno != EINTR)
+        {
+          fprintf (stderr, "I/O thread poll failed: %s\n", strerror (errno));
+          post_received (tctx, NULL, NULL, 0, CIPC_BAD_POLL);
+        }
+
+      atomic_store (&tctx->io_sleeping, 0);
+
+      if (fds[0].revents & POLLIN)
+        cipc_drain_fd (tctx->wake_fd);
+    }
+
+  return NULL;
+}
+
+static cipc_err
+wait_room (cipc_threaded_private *tctx, size_t length)
+{
+  size_t queued = atomic_load (&tctx->queued_bytes);
+
+  // A message larger than the limit still goes out once the queue is empty.
+  if (queued == 0 || queued + length <= tctx->max_queued_bytes)
+    return CIPC_OK;
+
+  wake_io (tctx);
+
+  struct timespec deadline;
+  if (tctx->sndtimeo > 0)
+    cipc_deadline_after (&deadline, tctx->sndtimeo);
+
+  cipc_err err = CIPC_OK;
+
+  pthread_mutex_lock (&tctx->room_lock);
+  atomic_fetch_add (&tctx->room_waiters, 1);
+
+  while (1)
+    {
+      queued = atomic_load (&tctx->queued_bytes);
+      if (queued == 0 || queued + length <= tctx->max_queued_bytes)
+        break;
+
+      if (tctx->sndtimeo <= 0)
+        pthread_cond_wait (&tctx->room_cond, &tctx->room_lock);
+      else if (pthread_cond_timedwait (&tctx->room_cond, &tctx->room_lock, &deadline)
+               == ETIMEDOUT)
+        {
+          err = CIPC_BAD_THREADED_SEND;
+          break;
+        }
+    }
+
+  atomic_fetch_sub (&tctx->room_waiters, 1);
+  pthread_mutex_unlock (&tctx->room_lock);
+
+  return err;
+}
+
+static cipc_err
+enqueue (cipc_threaded_private *tctx, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_err err = (cipc_err)atomic_exchange (&tctx->send_err, CIPC_OK);
+  if (err != CIPC_OK)
+    return err;
+
+  size_t length = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    length += iov[i].length;
+
+  err = wait_room (tctx, length);
+  if (err != CIPC_OK)
+    return err;
+
+  cipc_threaded_node *node = cipc_alloc (sizeof (cipc_threaded_node) + length);
+  if (!node)
+    return CIPC_BAD_ALLOC;
+
+  node->length = length;
+
+  char *dst = node->data;
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      memcpy (dst, iov[i].base, iov[i].length);
+      dst += iov[i].length;
+    }
+
+  atomic_fetch_add (&tctx->queued_bytes, length);
+  queue_push (tctx, node);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_threaded_sendv (void *context, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)context;
+
+  cipc_err err = enqueue (tctx, iov, iovcnt);
+  if (err == CIPC_OK)
+    wake_io (tctx);
+
+  return err;
+}
+
+static cipc_err
+cipc_threaded_send (void *context, const char *data, size_t length)
+{
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_threaded_sendv (context, &iov, 1);
+}
+
+static cipc_err
+cipc_threaded_send_batch (void *context, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)context;
+
+  cipc_err err = CIPC_OK;
+  size_t done = 0;
+
+  while (done < count && (err = enqueue (tctx, &msgs[done], 1)) == CIPC_OK)
+    done++;
+
+  if (done > 0)
+    wake_io (tctx);
+
+  if (sent != NULL)
+    *sent = done;
+
+  return err;
+}
+
+// Takes up to count messages, waiting for the first one. A message longer than limit stays
+// queued and is reported with CIPC_BAD_BUFFER_SIZE.
+static cipc_err
+take_received (cipc_threaded_private *tctx, size_t limit, cipc_threaded_node **nodes, size_t count,
+               size_t *taken, size_t *first_length)
+{
+  *taken = 0;
+
+  struct timespec deadline;
+  if (tctx->rcvtimeo > 0)
+    cipc_deadline_after (&deadline, tctx->rcvtimeo);
+
+  cipc_err err = CIPC_OK;
+  int woke_io = 0;
+
+  pthread_mutex_lock (&tctx->rx_lock);
+
+  while (!tctx->rx_head && tctx->recv_err == CIPC_OK)
+    {
+      if (tctx->rcvtimeo <= 0)
+        pthread_cond_wait (&tctx->rx_cond, &tctx->rx_lock);
+      else if (pthread_cond_timedwait (&tctx->rx_cond, &tctx->rx_lock, &deadline) == ETIMEDOUT)
+        {
+          pthread_mutex_unlock (&tctx->rx_lock);
+          return CIPC_BAD_THREADED_RECV;
+        }
+    }
+
+  if (!tctx->rx_head)
+    {
+      // Reported once; the I/O thread then tries the inner instance again.
+      err = tctx->recv_err;
+      tctx->recv_err = CIPC_OK;
+      woke_io = 1;
+    }
+  else if (tctx->rx_head->length > limit)
+    {
+      *first_length = tctx->rx_head->length;
+      err = CIPC_BAD_BUFFER_SIZE;
+    }
+  else
+    {
+      *first_length = tctx->rx_head->length;
+
+      woke_io = tctx->rx_count == tctx->max_inbound;
+
+      while (*taken < count && tctx->rx_head)
+        {
+          cipc_threaded_node *node = tctx->rx_head;
+
+          tctx->rx_head = atomic_load_explicit (&node->next, memory_order_relaxed);
+          if (!tctx->rx_head)
+            tctx->rx_tail = NULL;
+
+          tctx->rx_count--;
+          nodes[(*taken)++] = node;
+        }
+    }
+
+  pthread_mutex_unlock (&tctx->rx_lock);
+
+  if (woke_io)
+    wake_io (tctx);
+
+  return err;
+}
+
+static cipc_err
+cipc_threaded_recv (void *context, char *buffer, size_t length, size_t *len_out)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)context;
+
+  // No room for the terminator.
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  cipc_threaded_node *node;
+  size_t taken;
+  size_t msg_len = 0;
+
+  cipc_err err = take_received (tctx, length - 1, &node, 1, &taken, &msg_len);
+
+  if (len_out != NULL)
+    *len_out = msg_len;
+
+  if (err != CIPC_OK)
+    return err;
+
+  memcpy (buffer, node->data, node->length);
+  buffer[node->length] = '\0';
+
+  cipc_dealloc (node);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_threaded_recv_msg (void *context, cipc_msg *msg)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)context;
+
+  cipc_threaded_node *node;
+  size_t taken;
+  size_t msg_len;
+
+  cipc_err err = take_received (tctx, SIZE_MAX, &node, 1, &taken, &msg_len);
+  if (err != CIPC_OK)
+    return err;
+
+  msg->data = node->data;
+  msg->length = node->length;
+  msg->handle = node;
+
+  return CIPC_OK;
+}
+
+static void
+cipc_threaded_release_msg (void *context, cipc_msg *msg)
+{
+  (void)context;
+
+  if (!msg)
+    return;
+
+  cipc_dealloc (msg->handle);
+
+  msg->data = NULL;
+  msg->length = 0;
+  msg->handle = NULL;
+}
+
+static cipc_err
+cipc_threaded_recv_batch (void *context, cipc_msg *msgs, size_t count, size_t *received)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)context;
+
+  if (!received || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  *received = 0;
+
+  if (count == 0)
+    return CIPC_OK;
+
+  cipc_threaded_node *nodes[CIPC_THREADED_BATCH];
+  size_t msg_len;
+
+  cipc_err err = take_received (tctx, SIZE_MAX, nodes,
+                                count < CIPC_THREADED_BATCH ? count : CIPC_THREADED_BATCH,
+                                received, &msg_len);
+  if (err != CIPC_OK)
+    return err;
+
+  for (size_t i = 0; i < *received; i++)
+    {
+      msgs[i].data = nodes[i]->data;
+      msgs[i].length = nodes[i]->length;
+      msgs[i].handle = nodes[i];
+    }
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_threaded_get_fd (void *context, int *fd, int *ready)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)context;
+
+  pthread_mutex_lock (&tctx->rx_lock);
+
+  *fd = tctx->rx_fd;
+  *ready = tctx->rx_head != NULL || tctx->recv_err != CIPC_OK;
+
+  // The I/O thread signals under the same lock, so clearing here cannot lose a wakeup.
+  if (!*ready)
+    cipc_drain_fd (tctx->rx_fd);
+
+  pthread_mutex_unlock (&tctx->rx_lock);
+
+  return CIPC_OK;
+}
+
+static cipc_counters *
+cipc_threaded_counters (void *context)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)context;
+
+  // Only the I/O thread touches the inner instance, so its counters stay single-writer.
+  return tctx->inner->counters (tctx->inner->context);
+}
+
+static void
+free_list (cipc_threaded_node *node)
+{
+  while (node)
+    {
+      cipc_threaded_node *next = atomic_load_explicit (&node->next, memory_order_relaxed);
+
+      cipc_dealloc (node);
+      node = next;
+    }
+}
+
+static void
+cipc_threaded_private_free (cipc_threaded_private *tctx)
+{
+  cipc_threaded_node *node;
+  while (tctx->head && (node = queue_pop (tctx)) != NULL)
+    cipc_dealloc (node);
+
+  free_list (tctx->rx_head);
+  free (tctx->stub);
+
+  if (tctx->wake_fd >= 0)
+    close (tctx->wake_fd);
+
+  if (tctx->rx_fd >= 0)
+    close (tctx->rx_fd);
+
+  pthread_cond_destroy (&tctx->rx_cond);
+  pthread_mutex_destroy (&tctx->rx_lock);
+  pthread_cond_destroy (&tctx->room_cond);
+  pthread_mutex_destroy (&tctx->room_lock);
+
+  free (tctx);
+}
+
+static cipc_err
+cipc_threaded_init (void **context, const void *config)
+{
+  if (!context || !config)
+    return CIPC_NULL_PTR;
+
+  const cipc_threaded_config *cfg = (const cipc_threaded_config *)config;
+
+  cipc *inner = cfg->inner;
+  if (!inner || !inner->context || !inner->send_batch || !inner->recv_batch || !inner->get_fd
+      || !inner->counters)
+    return CIPC_NULL_PTR;
+
+  cipc_threaded_private *tctx = calloc (1, sizeof (cipc_threaded_private));
+  if (!tctx)
+    return CIPC_BAD_ALLOC;
+
+  tctx->max_queued_bytes
+      = cfg->max_queued_bytes ? cfg->max_queued_bytes : CIPC_THREADED_DEFAULT_MAX_QUEUED_BYTES;
+  tctx->max_inbound = cfg->max_inbound ? cfg->max_inbound : CIPC_THREADED_DEFAULT_MAX_INBOUND;
+  tctx->sndtimeo = cfg->sockopt_sndtimeo;
+  tctx->rcvtimeo = cfg->sockopt_rcvtimeo;
+
+  pthread_mutex_init (&tctx->room_lock, NULL);
+  pthread_mutex_init (&tctx->rx_lock, NULL);
+  cipc_cond_init (&tctx->room_cond);
+  cipc_cond_init (&tctx->rx_cond);
+
+  tctx->wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  tctx->rx_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  tctx->stub = calloc (1, sizeof (cipc_threaded_node));
+
+  if (tctx->wake_fd < 0 || tctx->rx_fd < 0 || !tctx->stub)
+    {
+      fprintf (stderr, "Threaded setup failed: %s\n", strerror (errno));
+      cipc_threaded_private_free (tctx);
+      return CIPC_BAD_THREADED_START;
+    }
+
+  tctx->head = tctx->stub;
+  atomic_store (&tctx->tail, tctx->stub);
+
+  tctx->inner = inner;
+
+  int rc = pthread_create (&tctx->thread, NULL, io_thread, tctx);
+  if (rc != 0)
+    {
+      fprintf (stderr, "I/O thread start failed: %s\n", strerror (rc));
+      cipc_threaded_private_free (tctx);
+      return CIPC_BAD_THREADED_START;
+    }
+
+  *context = tctx;
+
+  return CIPC_OK;
+}
+
+static void
+cipc_threaded_free (void *context)
+{
+  cipc_threaded_private *tctx = (cipc_threaded_private *)context;
+  if (!tctx)
+    return;
+
+  // Queued messages are still sent before the I/O thread exits.
+  atomic_store (&tctx->stopping, 1);
+  wake_io (tctx);
+
+  pthread_join (tctx->thread, NULL);
+
+  cipc *inner = tctx->inner;
+
+  cipc_threaded_private_free (tctx);
+  cipc_free (inner);
+}
+
+cipc *
+cipc_create_threaded (void)
+{
+  cipc *instance = calloc (1, sizeof (cipc));
+  if (!instance)
+    return NULL;
+
+  instance->init = cipc_threaded_init;
+  instance->send = cipc_threaded_send;
+  instance->sendv = cipc_threaded_sendv;
+  instance->recv = cipc_threaded_recv;
+  instance->recv_msg = cipc_threaded_recv_msg;
+  instance->release_msg = cipc_threaded_release_msg;
+  instance->send_batch = cipc_threaded_send_batch;
+  instance->recv_batch = cipc_threaded_recv_batch;
+  instance->get_fd = cipc_threaded_get_fd;
+  instance->counters = cipc_threaded_counters;
+  instance->free = cipc_threaded_free;
+  instance->context = NULL;
+
+  return instance;
+}
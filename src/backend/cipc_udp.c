@@ -0,0 +1,1121 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "backend/cipc_stream.h"
+#include "backend/cipc_udp.h"
+#include "cipc.h"
+#include "cipc_counters.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// Segments the kernel accepts in one UDP_SEGMENT send.
+#define CIPC_UDP_GSO_MAX_SEGMENTS 64
+// Messages handed to one sendmmsg.
+#define CIPC_UDP_SEND_CHUNK 64
+// Senders whose sequence numbers are followed; beyond it the oldest entry is reused.
+#define CIPC_UDP_MAX_PEERS 1024
+// GRO coalesces datagrams of one flow into up to this many bytes.
+#define CIPC_UDP_GRO_BUFFER_SIZE 65535
+
+// One datagram buffer. GRO may have filled it with several datagrams of segment bytes each,
+// which are handed out one at a time. Queued buffers and borrowed views each hold a reference.
+typedef struct cipc_udp_slot
+{
+  struct cipc_udp_slot *next;
+  size_t refs;
+
+  cipc_peer_id peer;
+  size_t length;
+  size_t segment;
+  size_t offset;
+
+  char data[];
+} cipc_udp_slot;
+
+typedef struct
+{
+  cipc_peer_id peer;
+  // Sending: the next sequence number. Receiving: the next one expected, 0 before the first
+  // datagram.
+  uint64_t seq;
+} cipc_udp_peer;
+
+// Sequence numbers by peer. Sending and receiving each have a table of their own, so that the
+// two threads allowed on an instance never share one.
+typedef struct
+{
+  cipc_udp_peer *entries;
+  size_t count;
+  size_t evict;
+  size_t last;
+} cipc_udp_peers;
+
+typedef struct
+{
+  int fd;
+  int connected;
+  int sequence;
+  int gso;
+
+  size_t max_message_size;
+  size_t batch_size;
+  size_t slot_size;
+
+  // Connect mode: the destination. Bind mode: the last sender, 0 before any; set by the receiving
+  // thread and read by the sending one.
+  _Atomic cipc_peer_id dest;
+
+  cipc_udp_peers tx_peers;
+  cipc_udp_peers rx_peers;
+
+  // Received datagrams not yet handed out, oldest at rx_head; allocated on the first receive.
+  cipc_udp_slot **rx;
+  size_t rx_head;
+  size_t rx_count;
+  cipc_udp_slot *free_slots;
+
+  cipc_udp_slot **rx_fill;
+  struct mmsghdr *rx_msgs;
+  struct iovec *rx_iov;
+  struct sockaddr_in *rx_addrs;
+  char *rx_control;
+
+  cipc_counters counters;
+} cipc_udp_private;
+
+#define CIPC_UDP_RX_CONTROL_SIZE CMSG_SPACE (sizeof (int))
+
+static cipc_peer_id
+peer_of (const struct sockaddr_in *addr)
+{
+  return ((cipc_peer_id)ntohl (addr->sin_addr.s_addr) << 16) | ntohs (addr->sin_port);
+}
+
+static void
+address_of (cipc_peer_id peer, struct sockaddr_in *addr)
+{
+  memset (addr, 0, sizeof (*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl ((uint32_t)(peer >> 16));
+  addr->sin_port = htons ((uint16_t)peer);
+}
+
+static cipc_udp_peer *
+peer_entry (cipc_udp_peers *peers, cipc_peer_id peer)
+{
+  if (peers->last < peers->count && peers->entries[peers->last].peer == peer)
+    return &peers->entries[peers->last];
+
+  for (size_t i = 0; i < peers->count; i++)
+    {
+      if (peers->entries[i].peer == peer)
+        {
+          peers->last = i;
+          return &peers->entries[i];
+        }
+    }
+
+  size_t index;
+
+  if (peers->count < CIPC_UDP_MAX_PEERS)
+    {
+      if (!peers->entries)
+        {
+          peers->entries = malloc (CIPC_UDP_MAX_PEERS * sizeof (cipc_udp_peer));
+          if (!peers->entries)
+            return NULL;
+        }
+
+      index = peers->count++;
+    }
+  else
+    {
+      index = peers->evict;
+      peers->evict = (peers->evict + 1) % CIPC_UDP_MAX_PEERS;
+    }
+
+  peers->entries[index] = (cipc_udp_peer){ .peer = peer };
+  peers->last = index;
+
+  return &peers->entries[index];
+}
+
+static void
+slot_unref (cipc_udp_private *uctx, cipc_udp_slot *slot)
+{
+  if (--slot->refs == 0)
+    {
+      slot->next = uctx->free_slots;
+      uctx->free_slots = slot;
+    }
+}
+
+static cipc_udp_slot *
+slot_get (cipc_udp_private *uctx)
+{
+  cipc_udp_slot *slot = uctx->free_slots;
+  if (slot)
+    {
+      uctx->free_slots = slot->next;
+      return slot;
+    }
+
+  return malloc (sizeof (cipc_udp_slot) + uctx->slot_size);
+}
+
+static void
+free_slot_list (cipc_udp_slot *slot)
+{
+  while (slot)
+    {
+      cipc_udp_slot *next = slot->next;
+      free (slot);
+      slot = next;
+    }
+}
+
+static void
+cipc_udp_private_free (cipc_udp_private *uctx)
+{
+  if (uctx->fd >= 0)
+    close (uctx->fd);
+
+  for (size_t i = 0; i < uctx->rx_count; i++)
+    free (uctx->rx[(uctx->rx_head + i) % uctx->batch_size]);
+
+  free_slot_list (uctx->free_slots);
+
+  free (uctx->rx);
+  free (uctx->rx_fill);
+  free (uctx->rx_msgs);
+  free (uctx->rx_iov);
+  free (uctx->rx_addrs);
+  free (uctx->rx_control);
+  free (uctx->tx_peers.entries);
+  free (uctx->rx_peers.entries);
+
+  cipc_counters_destroy (&uctx->counters);
+  free (uctx);
+}
+
+static cipc_err
+parse_address (const char *host, int port, struct sockaddr_in *addr)
+{
+  memset (addr, 0, sizeof (*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons ((uint16_t)port);
+  addr->sin_addr.s_addr = htonl (INADDR_ANY);
+
+  if (port <= 0 || port > 65535)
+    return CIPC_BAD_UDP_ADDRESS;
+
+  if (host && inet_pton (AF_INET, host, &addr->sin_addr) <= 0)
+    return CIPC_BAD_UDP_ADDRESS;
+
+  return CIPC_OK;
+}
+
+static int
+set_int_option (int fd, int level, int name, int value)
+{
+  return setsockopt (fd, level, name, &value, sizeof (value));
+}
+
+static cipc_err
+setup_multicast (int fd, const cipc_udp_config *cfg, const struct sockaddr_in *group)
+{
+  struct in_addr interface = { .s_addr = htonl (INADDR_ANY) };
+
+  if (cfg->interface && inet_pton (AF_INET, cfg->interface, &interface) <= 0)
+    {
+      fprintf (stderr, "Invalid multicast interface: %s\n", cfg->interface);
+      return CIPC_BAD_UDP_ADDRESS;
+    }
+
+  if (cfg->mode == CIPC_UDP_MODE_BIND)
+    {
+      struct ip_mreq mreq = { .imr_multiaddr = group->sin_addr, .imr_interface = interface };
+
+      if (setsockopt (fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof (mreq)) < 0)
+        {
+          fprintf (stderr, "Failed to join multicast group %s: %s\n", cfg->host,
+                   strerror (errno));
+          return CIPC_BAD_UDP_SOCKET_OPT;
+        }
+
+      return CIPC_OK;
+    }
+
+  int ttl = cfg->multicast_ttl ? cfg->multicast_ttl : 1;
+
+  if (set_int_option (fd, IPPROTO_IP, IP_MULTICAST_TTL, ttl) < 0)
+    return CIPC_BAD_UDP_SOCKET_OPT;
+
+  if (cfg->multicast_loop
+      && set_int_option (fd, IPPROTO_IP, IP_MULTICAST_LOOP, cfg->multicast_loop > 0) < 0)
+    return CIPC_BAD_UDP_SOCKET_OPT;
+
+  if (cfg->interface
+      && setsockopt (fd, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof (interface)) < 0)
+    return CIPC_BAD_UDP_SOCKET_OPT;
+
+  return CIPC_OK;
+}
+
+static cipc_err
+setup_socket (cipc_udp_private *uctx, const cipc_udp_config *cfg)
+{
+  if (cipc_stream_set_timeouts (uctx->fd, cfg->sockopt_sndtimeo, cfg->sockopt_rcvtimeo) < 0)
+    return CIPC_BAD_UDP_SOCKET_OPT;
+
+  if (cfg->socket_sndbuf > 0
+      && set_int_option (uctx->fd, SOL_SOCKET, SO_SNDBUF, cfg->socket_sndbuf) < 0)
+    return CIPC_BAD_UDP_SOCKET_OPT;
+
+  if (cfg->socket_rcvbuf > 0
+      && set_int_option (uctx->fd, SOL_SOCKET, SO_RCVBUF, cfg->socket_rcvbuf) < 0)
+    return CIPC_BAD_UDP_SOCKET_OPT;
+
+  // Kernels without GRO for UDP send and receive plain datagrams.
+  int gro = cfg->gro >= 0 && set_int_option (uctx->fd, IPPROTO_UDP, UDP_GRO, 1) == 0;
+
+  uctx->slot_size = uctx->max_message_size
+                    + (uctx->sequence ? CIPC_UDP_SEQUENCE_HEADER_SIZE : 0);
+
+  if (gro && uctx->slot_size < CIPC_UDP_GRO_BUFFER_SIZE)
+    uctx->slot_size = CIPC_UDP_GRO_BUFFER_SIZE;
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_udp_init (void **context, const void *config)
+{
+  if (!context || !config)
+    return CIPC_NULL_PTR;
+
+  const cipc_udp_config *cfg = (const cipc_udp_config *)config;
+  if (cfg->mode == CIPC_UDP_MODE_CONNECT && !cfg->host)
+    return CIPC_NULL_PTR;
+
+  struct sockaddr_in addr;
+
+  cipc_err err = parse_address (cfg->host, cfg->port, &addr);
+  if (err != CIPC_OK)
+    {
+      fprintf (stderr, "Invalid address: %s:%d\n", cfg->host ? cfg->host : "*", cfg->port);
+      return err;
+    }
+
+  size_t header = cfg->sequence ? CIPC_UDP_SEQUENCE_HEADER_SIZE : 0;
+
+  if (cfg->max_message_size > CIPC_UDP_MAX_DATAGRAM_SIZE - header)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  cipc_udp_private *uctx = calloc (1, sizeof (cipc_udp_private));
+  if (!uctx)
+    return CIPC_BAD_ALLOC;
+
+  cipc_counters_init (&uctx->counters);
+
+  uctx->sequence = cfg->sequence != 0;
+  uctx->gso = cfg->gso >= 0;
+  uctx->max_message_size = cfg->max_message_size ? cfg->max_message_size
+                                                  : CIPC_UDP_MAX_DATAGRAM_SIZE - header;
+  uctx->batch_size = cfg->batch_size ? cfg->batch_size : CIPC_UDP_DEFAULT_BATCH_SIZE;
+
+  uctx->fd = socket (AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (uctx->fd < 0)
+    {
+      cipc_udp_private_free (uctx);
+      return CIPC_BAD_UDP_SOCKET;
+    }
+
+  err = setup_socket (uctx, cfg);
+  if (err != CIPC_OK)
+    {
+      cipc_udp_private_free (uctx);
+      return err;
+    }
+
+  int multicast = IN_MULTICAST (ntohl (addr.sin_addr.s_addr));
+
+  if (multicast)
+    {
+      err = setup_multicast (uctx->fd, cfg, &addr);
+      if (err != CIPC_OK)
+        {
+          cipc_udp_private_free (uctx);
+          return err;
+        }
+    }
+
+  if (cfg->mode == CIPC_UDP_MODE_BIND)
+    {
+      // Several receivers on one host may share a group's port.
+      if (multicast && set_int_option (uctx->fd, SOL_SOCKET, SO_REUSEADDR, 1) < 0)
+        {
+          cipc_udp_private_free (uctx);
+          return CIPC_BAD_UDP_SOCKET_OPT;
+        }
+
+      if (bind (uctx->fd, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+        {
+          fprintf (stderr, "Bind failed: %s\n", strerror (errno));
+          cipc_udp_private_free (uctx);
+          return CIPC_BAD_UDP_BIND;
+        }
+    }
+  else
+    {
+      if (connect (uctx->fd, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+        {
+          fprintf (stderr, "Connect failed: %s\n", strerror (errno));
+          cipc_udp_private_free (uctx);
+          return CIPC_BAD_UDP_CONNECT;
+        }
+
+      uctx->connected = 1;
+      atomic_store_explicit (&uctx->dest, peer_of (&addr), memory_order_relaxed);
+    }
+
+  *context = uctx;
+  return CIPC_OK;
+}
+
+// Sends one datagram to dest, or to the connected address when dest is NULL.
+static cipc_err
+send_datagram (cipc_udp_private *uctx, const struct sockaddr_in *dest, cipc_peer_id peer,
+               const cipc_iovec *iov, size_t iovcnt)
+{
+  uint64_t start = cipc_counters_start (&uctx->counters);
+
+  struct iovec stack_iov[17];
+  struct iovec *vec = stack_iov;
+
+  if (iovcnt + 1 > sizeof (stack_iov) / sizeof (stack_iov[0]))
+    {
+      vec = malloc ((iovcnt + 1) * sizeof (struct iovec));
+      if (!vec)
+        return CIPC_BAD_ALLOC;
+    }
+
+  size_t count = 0;
+  size_t length = 0;
+  uint64_t header;
+  cipc_udp_peer *entry = NULL;
+
+  if (uctx->sequence)
+    {
+      entry = peer_entry (&uctx->tx_peers, peer);
+      if (!entry)
+        {
+          if (vec != stack_iov)
+            free (vec);
+
+          return CIPC_BAD_ALLOC;
+        }
+
+      header = htobe64 (entry->seq);
+      vec[count++] = (struct iovec){ .iov_base = &header, .iov_len = sizeof (header) };
+    }
+
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      vec[count++] = (struct iovec){ .iov_base = (void *)iov[i].base, .iov_len = iov[i].length };
+      length += iov[i].length;
+    }
+
+  cipc_err err = CIPC_OK;
+
+  if (length > uctx->max_message_size)
+    err = CIPC_BAD_BUFFER_SIZE;
+  else
+    {
+      struct msghdr msg = { .msg_name = (void *)dest,
+                            .msg_namelen = dest ? sizeof (*dest) : 0,
+                            .msg_iov = vec,
+                            .msg_iovlen = count };
+
+      int refused = 0;
+      ssize_t sent;
+
+      while (1)
+        {
+          sent = sendmsg (uctx->fd, &msg, MSG_NOSIGNAL);
+          cipc_counter_add (&uctx->counters.send_syscalls, 1);
+
+          // A refusal reports an earlier datagram that met no receiver, not this one.
+          if (sent < 0 && (errno == EINTR || (errno == ECONNREFUSED && !refused++)))
+            continue;
+
+          break;
+        }
+
+      if (sent < 0)
+        {
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            cipc_counter_add (&uctx->counters.send_timeouts, 1);
+
+          err = errno == EMSGSIZE ? CIPC_BAD_BUFFER_SIZE : CIPC_BAD_UDP_SEND;
+        }
+      else if (entry)
+        entry->seq++;
+    }
+
+  if (vec != stack_iov)
+    free (vec);
+
+  cipc_counters_sent (&uctx->counters, err, err == CIPC_OK, err == CIPC_OK ? length : 0, start);
+
+  return err;
+}
+
+// The destination of send and send_batch, read once so that address and sequence numbers agree.
+static cipc_err
+default_destination (cipc_udp_private *uctx, struct sockaddr_in *addr,
+                     const struct sockaddr_in **dest, cipc_peer_id *peer)
+{
+  *peer = atomic_load_explicit (&uctx->dest, memory_order_relaxed);
+
+  if (uctx->connected)
+    {
+      *dest = NULL;
+      return CIPC_OK;
+    }
+
+  if (!*peer)
+    return CIPC_BAD_PEER;
+
+  address_of (*peer, addr);
+  *dest = addr;
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_udp_sendv (void *context, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  struct sockaddr_in addr;
+  const struct sockaddr_in *dest;
+  cipc_peer_id peer;
+
+  cipc_err err = default_destination (uctx, &addr, &dest, &peer);
+  if (err != CIPC_OK)
+    return err;
+
+  return send_datagram (uctx, dest, peer, iov, iovcnt);
+}
+
+static cipc_err
+cipc_udp_send (void *context, const char *data, size_t length)
+{
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_udp_sendv (context, &iov, 1);
+}
+
+static cipc_err
+cipc_udp_send_to (void *context, cipc_peer_id peer, const char *data, size_t length)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  if (peer == 0)
+    return CIPC_BAD_PEER;
+
+  struct sockaddr_in addr;
+  address_of (peer, &addr);
+
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return send_datagram (uctx, &addr, peer, &iov, 1);
+}
+
+// Messages from first on that go out as one UDP_SEGMENT send: equal sizes, the last possibly
+// shorter, within one datagram's worth of bytes.
+static size_t
+gso_run (cipc_udp_private *uctx, const cipc_iovec *msgs, size_t first, size_t count)
+{
+  size_t header = uctx->sequence ? CIPC_UDP_SEQUENCE_HEADER_SIZE : 0;
+  size_t segment = msgs[first].length + header;
+  size_t total = segment;
+  size_t run = 1;
+
+  if (segment == 0)
+    return 1;
+
+  while (first + run < count && run < CIPC_UDP_GSO_MAX_SEGMENTS)
+    {
+      size_t next = msgs[first + run].length + header;
+      if (next > segment || next == 0 || total + next > CIPC_UDP_MAX_DATAGRAM_SIZE)
+        break;
+
+      total += next;
+      run++;
+
+      if (next < segment)
+        break;
+    }
+
+  return run;
+}
+
+static cipc_err
+cipc_udp_send_batch (void *context, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  if (!sent || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  *sent = 0;
+
+  struct sockaddr_in addr;
+  const struct sockaddr_in *dest;
+  cipc_peer_id peer;
+
+  cipc_err err = default_destination (uctx, &addr, &dest, &peer);
+  if (err != CIPC_OK)
+    return err;
+
+  cipc_udp_peer *entry = NULL;
+  if (uctx->sequence && !(entry = peer_entry (&uctx->tx_peers, peer)))
+    return CIPC_BAD_ALLOC;
+
+  for (size_t i = 0; i < count; i++)
+    if (msgs[i].length > uctx->max_message_size)
+      return CIPC_BAD_BUFFER_SIZE;
+
+  uint64_t start = cipc_counters_start (&uctx->counters);
+
+  struct mmsghdr mm[CIPC_UDP_SEND_CHUNK];
+  struct iovec iov[2 * CIPC_UDP_SEND_CHUNK];
+  uint64_t headers[CIPC_UDP_SEND_CHUNK];
+  char control[CIPC_UDP_SEND_CHUNK][CMSG_SPACE (sizeof (uint16_t))];
+  size_t firsts[CIPC_UDP_SEND_CHUNK + 1];
+
+  size_t done = 0;
+  size_t bytes = 0;
+  // Messages before it go out one datagram each, after a segmented send was refused.
+  size_t plain_until = 0;
+  int refused = 0;
+
+  while (done < count)
+    {
+      size_t nmm = 0;
+      size_t nmsg = 0;
+      size_t niov = 0;
+
+      while (done + nmsg < count && nmsg < CIPC_UDP_SEND_CHUNK)
+        {
+          size_t first = done + nmsg;
+          size_t run = 1;
+
+          if (uctx->gso && first >= plain_until)
+            run = gso_run (uctx, msgs, first, count);
+
+          if (nmsg + run > CIPC_UDP_SEND_CHUNK)
+            break;
+
+          struct mmsghdr *m = &mm[nmm];
+          memset (m, 0, sizeof (*m));
+
+          m->msg_hdr.msg_name = (void *)dest;
+          m->msg_hdr.msg_namelen = dest ? sizeof (*dest) : 0;
+          m->msg_hdr.msg_iov = &iov[niov];
+
+          for (size_t k = 0; k < run; k++)
+            {
+              if (entry)
+                {
+                  headers[nmsg + k] = htobe64 (entry->seq + nmsg + k);
+                  iov[niov++] = (struct iovec){ .iov_base = &headers[nmsg + k],
+                                                .iov_len = sizeof (uint64_t) };
+                }
+
+              iov[niov++] = (struct iovec){ .iov_base = (void *)msgs[first + k].base,
+                                            .iov_len = msgs[first + k].length };
+            }
+
+          m->msg_hdr.msg_iovlen = &iov[niov] - m->msg_hdr.msg_iov;
+
+          if (run > 1)
+            {
+              m->msg_hdr.msg_control = control[nmm];
+              m->msg_hdr.msg_controllen = sizeof (control[nmm]);
+
+              struct cmsghdr *cm = CMSG_FIRSTHDR (&m->msg_hdr);
+              cm->cmsg_level = SOL_UDP;
+              cm->cmsg_type = UDP_SEGMENT;
+              cm->cmsg_len = CMSG_LEN (sizeof (uint16_t));
+
+              uint16_t segment = (uint16_t)(msgs[first].length + (entry ? sizeof (uint64_t) : 0));
+              memcpy (CMSG_DATA (cm), &segment, sizeof (segment));
+            }
+
+          firsts[nmm++] = nmsg;
+          nmsg += run;
+        }
+
+      firsts[nmm] = nmsg;
+
+      int rc = sendmmsg (uctx->fd, mm, nmm, MSG_NOSIGNAL);
+      cipc_counter_add (&uctx->counters.send_syscalls, 1);
+
+      if (rc < 0)
+        {
+          if (errno == EINTR || (errno == ECONNREFUSED && !refused++))
+            continue;
+
+          // The kernel or device cannot segment this send; EIO means it never will.
+          if (firsts[1] > 1 && (errno == EINVAL || errno == EIO))
+            {
+              if (errno == EIO)
+                uctx->gso = 0;
+
+              plain_until = done + firsts[1];
+              continue;
+            }
+
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            cipc_counter_add (&uctx->counters.send_timeouts, 1);
+
+          err = errno == EMSGSIZE ? CIPC_BAD_BUFFER_SIZE : CIPC_BAD_UDP_SEND;
+          break;
+        }
+
+      size_t finished = firsts[rc];
+
+      if ((size_t)rc < nmm)
+        cipc_counter_add (&uctx->counters.short_writes, 1);
+
+      for (size_t k = 0; k < finished; k++)
+        bytes += msgs[done + k].length;
+
+      if (entry)
+        entry->seq += finished;
+
+      done += finished;
+    }
+
+  *sent = done;
+
+  cipc_counters_sent (&uctx->counters, err, done, bytes, start);
+
+  return err;
+}
+
+static cipc_err
+rx_alloc (cipc_udp_private *uctx)
+{
+  size_t n = uctx->batch_size;
+
+  uctx->rx = calloc (n, sizeof (cipc_udp_slot *));
+  uctx->rx_fill = calloc (n, sizeof (cipc_udp_slot *));
+  uctx->rx_msgs = calloc (n, sizeof (struct mmsghdr));
+  uctx->rx_iov = calloc (n, sizeof (struct iovec));
+  uctx->rx_addrs = calloc (n, sizeof (struct sockaddr_in));
+  uctx->rx_control = calloc (n, CIPC_UDP_RX_CONTROL_SIZE);
+
+  if (!uctx->rx || !uctx->rx_fill || !uctx->rx_msgs || !uctx->rx_iov || !uctx->rx_addrs
+      || !uctx->rx_control)
+    return CIPC_BAD_ALLOC;
+
+  return CIPC_OK;
+}
+
+// Reads the datagrams waiting into the empty queue, waiting for the first unless flags has
+// MSG_DONTWAIT.
+static cipc_err
+rx_fill (cipc_udp_private *uctx, int flags)
+{
+  if (!uctx->rx && rx_alloc (uctx) != CIPC_OK)
+    return CIPC_BAD_ALLOC;
+
+  cipc_udp_slot **slots = uctx->rx_fill;
+  size_t n = 0;
+
+  for (; n < uctx->batch_size; n++)
+    {
+      slots[n] = slot_get (uctx);
+      if (!slots[n])
+        break;
+
+      uctx->rx_iov[n] = (struct iovec){ .iov_base = slots[n]->data, .iov_len = uctx->slot_size };
+
+      struct msghdr *hdr = &uctx->rx_msgs[n].msg_hdr;
+      memset (hdr, 0, sizeof (*hdr));
+      hdr->msg_name = &uctx->rx_addrs[n];
+      hdr->msg_namelen = sizeof (struct sockaddr_in);
+      hdr->msg_iov = &uctx->rx_iov[n];
+      hdr->msg_iovlen = 1;
+      hdr->msg_control = uctx->rx_control + n * CIPC_UDP_RX_CONTROL_SIZE;
+      hdr->msg_controllen = CIPC_UDP_RX_CONTROL_SIZE;
+    }
+
+  if (n == 0)
+    return CIPC_BAD_ALLOC;
+
+  int rc;
+
+  do
+    {
+      rc = recvmmsg (uctx->fd, uctx->rx_msgs, n, flags | MSG_WAITFORONE, NULL);
+      cipc_counter_add (&uctx->counters.recv_syscalls, 1);
+    }
+  // A refusal on a connected socket reports an earlier send that met no receiver.
+  while (rc < 0 && (errno == EINTR || errno == ECONNREFUSED));
+
+  cipc_err err = CIPC_OK;
+
+  if (rc < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        err = CIPC_BAD_UDP_RECV;
+      else if (flags & MSG_DONTWAIT)
+        err = CIPC_WOULD_BLOCK;
+      else
+        {
+          cipc_counter_add (&uctx->counters.recv_timeouts, 1);
+          err = CIPC_BAD_UDP_RECV;
+        }
+
+      rc = 0;
+    }
+
+  for (size_t i = 0; i < (size_t)rc; i++)
+    {
+      struct msghdr *hdr = &uctx->rx_msgs[i].msg_hdr;
+      cipc_udp_slot *slot = slots[i];
+
+      slot->refs = 1;
+      slot->offset = 0;
+      slot->length = uctx->rx_msgs[i].msg_len;
+      slot->segment = slot->length;
+      slot->peer = peer_of (&uctx->rx_addrs[i]);
+
+      // Longer than any message this instance accepts.
+      if (hdr->msg_flags & MSG_TRUNC)
+        {
+          cipc_counter_add (&uctx->counters.short_reads, 1);
+          slot_unref (uctx, slot);
+          continue;
+        }
+
+      for (struct cmsghdr *cm = CMSG_FIRSTHDR (hdr); cm; cm = CMSG_NXTHDR (hdr, cm))
+        {
+          if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+            {
+              int segment;
+              memcpy (&segment, CMSG_DATA (cm), sizeof (segment));
+
+              if (segment > 0)
+                slot->segment = (size_t)segment;
+            }
+        }
+
+      uctx->rx[(uctx->rx_head + uctx->rx_count++) % uctx->batch_size] = slot;
+    }
+
+  for (size_t i = (size_t)rc; i < n; i++)
+    {
+      slots[i]->refs = 1;
+      slot_unref (uctx, slots[i]);
+    }
+
+  return err;
+}
+
+// Counts the messages that the sequence number at data, from peer, shows were missed.
+static void
+track_sequence (cipc_udp_private *uctx, cipc_peer_id peer, const char *data)
+{
+  uint64_t seq;
+  memcpy (&seq, data, sizeof (seq));
+  seq = be64toh (seq);
+
+  cipc_udp_peer *entry = peer_entry (&uctx->rx_peers, peer);
+  if (!entry)
+    return;
+
+  // A first datagram, or a sender that restarted, starts the count afresh; late datagrams are
+  // already counted as lost.
+  if (entry->seq > 0 && seq > entry->seq)
+    cipc_counter_add (&uctx->counters.msgs_lost, seq - entry->seq);
+
+  if (seq >= entry->seq || seq == 0)
+    entry->seq = seq + 1;
+}
+
+// Finds the next message, reading when none is queued; it stays queued until rx_consume.
+static cipc_err
+rx_next (cipc_udp_private *uctx, int flags, cipc_udp_slot **slot, const char **data,
+         size_t *length)
+{
+  size_t header = uctx->sequence ? CIPC_UDP_SEQUENCE_HEADER_SIZE : 0;
+
+  while (1)
+    {
+      while (uctx->rx_count > 0)
+        {
+          cipc_udp_slot *s = uctx->rx[uctx->rx_head];
+          size_t remaining = s->length - s->offset;
+          size_t segment = remaining < s->segment ? remaining : s->segment;
+
+          // Too short to carry a sequence number, so not from a cipc sender; or longer than
+          // this instance accepts, which GRO buffers are large enough to hold.
+          if (segment < header || segment - header > uctx->max_message_size)
+            {
+              if (segment >= header)
+                cipc_counter_add (&uctx->counters.short_reads, 1);
+
+              s->offset += segment;
+
+              if (s->offset == s->length)
+                {
+                  uctx->rx_head = (uctx->rx_head + 1) % uctx->batch_size;
+                  uctx->rx_count--;
+                  slot_unref (uctx, s);
+                }
+
+              continue;
+            }
+
+          *slot = s;
+          *data = s->data + s->offset + header;
+          *length = segment - header;
+
+          return CIPC_OK;
+        }
+
+      cipc_err err = rx_fill (uctx, flags);
+      if (err != CIPC_OK)
+        return err;
+    }
+}
+
+static void
+rx_consume (cipc_udp_private *uctx, cipc_udp_slot *slot, size_t length)
+{
+  size_t header = uctx->sequence ? CIPC_UDP_SEQUENCE_HEADER_SIZE : 0;
+
+  if (header)
+    track_sequence (uctx, slot->peer, slot->data + slot->offset);
+
+  if (!uctx->connected)
+    atomic_store_explicit (&uctx->dest, slot->peer, memory_order_relaxed);
+
+  slot->offset += header + length;
+
+  cipc_counter_add (&uctx->counters.msgs_received, 1);
+  cipc_counter_add (&uctx->counters.bytes_received, length);
+
+  if (slot->offset == slot->length)
+    {
+      uctx->rx_head = (uctx->rx_head + 1) % uctx->batch_size;
+      uctx->rx_count--;
+      slot_unref (uctx, slot);
+    }
+}
+
+static cipc_err
+cipc_udp_recv_from (void *context, cipc_peer_id *peer, char *buffer, size_t length,
+                    size_t *len_out)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  if (!buffer || !len_out)
+    return CIPC_NULL_PTR;
+
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  uint64_t start = cipc_counters_start (&uctx->counters);
+
+  cipc_udp_slot *slot;
+  const char *data;
+  size_t size;
+
+  cipc_err err = rx_next (uctx, 0, &slot, &data, &size);
+
+  // The datagram stays queued for a larger buffer, which also holds the terminator.
+  if (err == CIPC_OK && size >= length)
+    {
+      *len_out = size;
+      err = CIPC_BAD_BUFFER_SIZE;
+    }
+
+  if (err == CIPC_OK)
+    {
+      memcpy (buffer, data, size);
+      buffer[size] = '\0';
+      *len_out = size;
+
+      if (peer)
+        *peer = slot->peer;
+
+      rx_consume (uctx, slot, size);
+    }
+
+  cipc_counters_received (&uctx->counters, err, 0, 0, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_udp_recv (void *context, char *buffer, size_t length, size_t *len_out)
+{
+  return cipc_udp_recv_from (context, NULL, buffer, length, len_out);
+}
+
+static cipc_err
+recv_view (cipc_udp_private *uctx, int flags, cipc_msg *msg)
+{
+  cipc_udp_slot *slot;
+  const char *data;
+  size_t size;
+
+  cipc_err err = rx_next (uctx, flags, &slot, &data, &size);
+  if (err != CIPC_OK)
+    return err;
+
+  slot->refs++;
+
+  msg->data = data;
+  msg->length = size;
+  msg->handle = slot;
+
+  rx_consume (uctx, slot, size);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_udp_recv_msg (void *context, cipc_msg *msg)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  if (!msg)
+    return CIPC_NULL_PTR;
+
+  uint64_t start = cipc_counters_start (&uctx->counters);
+
+  cipc_err err = recv_view (uctx, 0, msg);
+
+  cipc_counters_received (&uctx->counters, err, 0, 0, start);
+
+  return err;
+}
+
+static void
+cipc_udp_release_msg (void *context, cipc_msg *msg)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  if (!msg || !msg->handle)
+    return;
+
+  slot_unref (uctx, (cipc_udp_slot *)msg->handle);
+
+  msg->handle = NULL;
+}
+
+static cipc_err
+cipc_udp_recv_batch (void *context, cipc_msg *msgs, size_t count, size_t *received)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  if (!received || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  *received = 0;
+
+  if (count == 0)
+    return CIPC_OK;
+
+  uint64_t start = cipc_counters_start (&uctx->counters);
+
+  cipc_err err = recv_view (uctx, 0, &msgs[0]);
+
+  if (err == CIPC_OK)
+    {
+      *received = 1;
+
+      while (*received < count && recv_view (uctx, MSG_DONTWAIT, &msgs[*received]) == CIPC_OK)
+        (*received)++;
+    }
+
+  cipc_counters_received (&uctx->counters, err, 0, 0, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_udp_get_fd (void *context, int *fd, int *ready)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  *fd = uctx->fd;
+  *ready = uctx->rx_count > 0;
+
+  return CIPC_OK;
+}
+
+static cipc_counters *
+cipc_udp_counters (void *context)
+{
+  cipc_udp_private *uctx = (cipc_udp_private *)context;
+
+  return &uctx->counters;
+}
+
+static void
+cipc_udp_free (void *context)
+{
+  if (context)
+    cipc_udp_private_free ((cipc_udp_private *)context);
+}
+
+cipc *
+cipc_create_udp (void)
+{
+  cipc *instance = calloc (1, sizeof (cipc));
+  if (!instance)
+    return NULL;
+
+  instance->init = cipc_udp_init;
+  instance->send = cipc_udp_send;
+  instance->sendv = cipc_udp_sendv;
+  instance->recv = cipc_udp_recv;
+  instance->recv_msg = cipc_udp_recv_msg;
+  instance->release_msg = cipc_udp_release_msg;
+  instance->send_to = cipc_udp_send_to;
+  instance->recv_from = cipc_udp_recv_from;
+  instance->send_batch = cipc_udp_send_batch;
+  instance->recv_batch = cipc_udp_recv_batch;
+  instance->get_fd = cipc_udp_get_fd;
+  instance->counters = cipc_udp_counters;
+  instance->free = cipc_udp_free;
+  instance->context = NULL;
+
+  return instance;
+}
@@ -0,0 +1,296 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "backend/cipc_stream.h"
+#include "backend/cipc_unix.h"
+#include "cipc.h"
+
+typedef struct
+{
+  cipc_stream stream;
+  int is_server;
+
+  cipc_counters counters;
+} cipc_unix_private;
+
+static void
+cipc_unix_private_free (cipc_unix_private *uctx)
+{
+  cipc_stream_destroy (&uctx->stream);
+  cipc_counters_destroy (&uctx->counters);
+  free (uctx);
+}
+
+// Removes a socket left at path; anything else there is not ours to delete. Returns -1 when the
+// path holds another kind of file.
+static int
+unlink_socket (const char *path)
+{
+  struct stat st;
+
+  if (lstat (path, &st) < 0)
+    return errno == ENOENT ? 0 : -1;
+
+  if (!S_ISSOCK (st.st_mode))
+    {
+      errno = EEXIST;
+      return -1;
+    }
+
+  return unlink (path) < 0 && errno != ENOENT ? -1 : 0;
+}
+
+static cipc_err
+fill_address (const char *path, struct sockaddr_un *addr, socklen_t *addrlen)
+{
+  size_t len = strlen (path);
+  if (len == 0 || len >= sizeof (addr->sun_path))
+    return CIPC_BAD_UNIX_ADDRESS;
+
+  memset (addr, 0, sizeof (*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy (addr->sun_path, path, len);
+
+  // A leading '@' selects the abstract namespace, which has no filesystem entry.
+  if (path[0] == '@')
+    addr->sun_path[0] = '\0';
+
+  *addrlen = offsetof (struct sockaddr_un, sun_path) + len + (path[0] == '@' ? 0 : 1);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_unix_init (void **context, const void *config)
+{
+  if (!context || !config)
+    return CIPC_NULL_PTR;
+
+  const cipc_unix_config *cfg = (const cipc_unix_config *)config;
+  if (!cfg->path)
+    return CIPC_NULL_PTR;
+
+  struct sockaddr_un addr;
+  socklen_t addrlen;
+
+  cipc_err err = fill_address (cfg->path, &addr, &addrlen);
+  if (err != CIPC_OK)
+    {
+      fprintf (stderr, "Invalid address: %s\n", cfg->path);
+      return err;
+    }
+
+  cipc_unix_private *uctx = calloc (1, sizeof (cipc_unix_private));
+  if (!uctx)
+    return CIPC_BAD_ALLOC;
+
+  cipc_counters_init (&uctx->counters);
+
+  // Keeps cipc_unix_private_free from closing descriptor 0 before the socket exists.
+  uctx->stream.fd = -1;
+
+  int type = cfg->socket_type == CIPC_UNIX_SOCKET_SEQPACKET ? SOCK_SEQPACKET : SOCK_STREAM;
+
+  int sockfd = socket (AF_UNIX, type | SOCK_CLOEXEC, 0);
+  if (sockfd < 0)
+    {
+      cipc_unix_private_free (uctx);
+      return CIPC_BAD_UNIX_SOCKET;
+    }
+
+  cipc_stream_init (&uctx->stream, sockfd, 1,
+                    cfg->rcvbuf_size ? cfg->rcvbuf_size : CIPC_UNIX_DEFAULT_RCVBUF_SIZE,
+                    cfg->max_message_size ? cfg->max_message_size
+                                          : CIPC_UNIX_DEFAULT_MAX_MESSAGE_SIZE,
+                    CIPC_BAD_UNIX_SEND, CIPC_BAD_UNIX_RECV, &uctx->counters);
+
+  uctx->stream.packet = type == SOCK_SEQPACKET;
+  uctx->stream.pass_fds = 1;
+
+  if (cfg->fd_threshold != CIPC_UNIX_FD_PASSING_DISABLED)
+    uctx->stream.fd_threshold = cfg->fd_threshold ? cfg->fd_threshold
+                                                  : CIPC_UNIX_DEFAULT_FD_THRESHOLD;
+
+  if (cipc_stream_set_timeouts (sockfd, cfg->sockopt_sndtimeo, cfg->sockopt_rcvtimeo) < 0)
+    {
+      cipc_unix_private_free (uctx);
+      return CIPC_BAD_UNIX_SOCKET_OPT;
+    }
+
+  if (cfg->mode == CIPC_UNIX_MODE_BIND)
+    {
+      if (cfg->path[0] != '@' && unlink_socket (cfg->path) < 0)
+        {
+          fprintf (stderr, "Bind failed: %s: %s\n", cfg->path, strerror (errno));
+          cipc_unix_private_free (uctx);
+          return CIPC_BAD_UNIX_BIND;
+        }
+
+      if (bind (sockfd, (struct sockaddr *)&addr, addrlen) < 0)
+        {
+          fprintf (stderr, "Bind failed: %s\n", strerror (errno));
+          cipc_unix_private_free (uctx);
+          return CIPC_BAD_UNIX_BIND;
+        }
+
+      if (listen (sockfd, cfg->backlog) < 0)
+        {
+          fprintf (stderr, "Listen failed: %s\n", strerror (errno));
+          cipc_unix_private_free (uctx);
+          return CIPC_BAD_UNIX_LISTEN;
+        }
+
+      int client_fd = accept4 (sockfd, NULL, NULL, SOCK_CLOEXEC);
+
+      if (cfg->path[0] != '@')
+        unlink_socket (cfg->path);
+
+      if (client_fd < 0)
+        {
+          fprintf (stderr, "Accept failed: %s\n", strerror (errno));
+          cipc_unix_private_free (uctx);
+          return CIPC_BAD_UNIX_SOCKET;
+        }
+
+      close (sockfd);
+
+      uctx->stream.fd = client_fd;
+      uctx->is_server = 1;
+    }
+  else
+    {
+      if (cipc_stream_connect_with_retries (sockfd, (struct sockaddr *)&addr, addrlen,
+                                            cfg->sockopt_retries, &uctx->counters)
+          < 0)
+        {
+          fprintf (stderr, "Connect failed after %d retries: %s\n", cfg->sockopt_retries,
+                   strerror (errno));
+          cipc_unix_private_free (uctx);
+          return CIPC_BAD_UNIX_CONNECT;
+        }
+
+      uctx->is_server = 0;
+    }
+
+  *context = uctx;
+  return CIPC_OK;
+}
+
+static cipc_err
+cipc_unix_sendv (void *context, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_unix_private *uctx = (cipc_unix_private *)context;
+
+  return cipc_stream_sendv (&uctx->stream, iov, iovcnt, 0);
+}
+
+static cipc_err
+cipc_unix_send (void *context, const char *data, size_t length)
+{
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_unix_sendv (context, &iov, 1);
+}
+
+static cipc_err
+cipc_unix_recv (void *context, char *buffer, size_t length, size_t *len_out)
+{
+  cipc_unix_private *uctx = (cipc_unix_private *)context;
+
+  return cipc_stream_recv (&uctx->stream, buffer, length, len_out);
+}
+
+static cipc_err
+cipc_unix_recv_msg (void *context, cipc_msg *msg)
+{
+  cipc_unix_private *uctx = (cipc_unix_private *)context;
+
+  return cipc_stream_recv_msg (&uctx->stream, msg);
+}
+
+static void
+cipc_unix_release_msg (void *context, cipc_msg *msg)
+{
+  (void)context;
+
+  cipc_stream_release_msg (msg);
+}
+
+static cipc_err
+cipc_unix_send_batch (void *context, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  cipc_unix_private *uctx = (cipc_unix_private *)context;
+
+  return cipc_stream_send_batch (&uctx->stream, msgs, count, sent);
+}
+
+static cipc_err
+cipc_unix_recv_batch (void *context, cipc_msg *msgs, size_t count, size_t *received)
+{
+  cipc_unix_private *uctx = (cipc_unix_private *)context;
+
+  return cipc_stream_recv_batch (&uctx->stream, msgs, count, received);
+}
+
+static cipc_err
+cipc_unix_get_fd (void *context, int *fd, int *ready)
+{
+  cipc_unix_private *uctx = (cipc_unix_private *)context;
+
+  *fd = uctx->stream.fd;
+  *ready = cipc_stream_poll_ready (&uctx->stream);
+
+  return CIPC_OK;
+}
+
+static cipc_counters *
+cipc_unix_counters (void *context)
+{
+  cipc_unix_private *uctx = (cipc_unix_private *)context;
+
+  return &uctx->counters;
+}
+
+static void
+cipc_unix_free (void *context)
+{
+  cipc_unix_private *uctx = (cipc_unix_private *)context;
+  if (uctx)
+    {
+      shutdown (uctx->stream.fd, SHUT_RDWR);
+
+      cipc_unix_private_free (uctx);
+    }
+}
+
+cipc *
+cipc_create_unix (void)
+{
+  cipc *instance = calloc (1, sizeof (cipc));
+  if (!instance)
+    return NULL;
+
+  instance->init = cipc_unix_init;
+  instance->send = cipc_unix_send;
+  instance->sendv = cipc_unix_sendv;
+  instance->recv = cipc_unix_recv;
+  instance->recv_msg = cipc_unix_recv_msg;
+  instance->release_msg = cipc_unix_release_msg;
+  instance->send_batch = cipc_unix_send_batch;
+  instance->recv_batch = cipc_unix_recv_batch;
+  instance->get_fd = cipc_unix_get_fd;
+  instance->counters = cipc_unix_counters;
+  instance->free = cipc_unix_free;
+  instance->context = NULL;
+
+  return instance;
+}
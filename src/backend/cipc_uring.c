@@ -0,0 +1,584 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend/cipc_uring.h"
+
+#if defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+// Multishot receive with provided buffer rings needs the Linux 6.0 uapi.
+#if defined(__NR_io_uring_setup) && defined(IORING_RECV_MULTISHOT)
+
+#define CIPC_URING_BUFFER_GROUP 0
+
+struct cipc_uring
+{
+  int fd;
+  unsigned features;
+
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+
+  _Atomic unsigned *sq_head;
+  _Atomic unsigned *sq_tail;
+  _Atomic unsigned *sq_flags;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  // Next free submission slot; published to the kernel by cipc_uring_submit.
+  unsigned sqe_tail;
+
+  _Atomic unsigned *cq_head;
+  _Atomic unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+
+  struct io_uring_buf_ring *buf_ring;
+  size_t buf_ring_size;
+  char *bufs;
+  size_t bufs_size;
+  unsigned buf_count;
+  unsigned buf_size;
+  uint16_t buf_tail;
+};
+
+static int
+sys_setup (unsigned entries, struct io_uring_params *params)
+{
+  return (int)syscall (__NR_io_uring_setup, entries, params);
+}
+
+static int
+sys_enter (int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg,
+           size_t argsz)
+{
+  return (int)syscall (__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int
+sys_register (int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+  return (int)syscall (__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void
+buf_ring_add (cipc_uring *ring, uint16_t bid)
+{
+  struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (ring->buf_count - 1)];
+
+  buf->addr = (uint64_t)(uintptr_t)(ring->bufs + (size_t)bid * ring->buf_size);
+  buf->len = ring->buf_size;
+  buf->bid = bid;
+
+  ring->buf_tail++;
+}
+
+static void
+buf_ring_publish (cipc_uring *ring)
+{
+  __atomic_store_n (&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static int
+map_rings (cipc_uring *ring, const struct io_uring_params *p)
+{
+  ring->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof (unsigned);
+  ring->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof (struct io_uring_cqe);
+
+  if (ring->features & IORING_FEAT_SINGLE_MMAP)
+    {
+      if (ring->cq_ring_size > ring->sq_ring_size)
+        ring->sq_ring_size = ring->cq_ring_size;
+
+      ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+  ring->sq_ring = mmap (NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED)
+    {
+      ring->sq_ring = NULL;
+      return -errno;
+    }
+
+  if (ring->features & IORING_FEAT_SINGLE_MMAP)
+    ring->cq_ring = ring->sq_ring;
+  else
+    {
+      ring->cq_ring = mmap (NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+      if (ring->cq_ring == MAP_FAILED)
+        {
+          ring->cq_ring = NULL;
+          return -errno;
+        }
+    }
+
+  ring->sqes_size = p->sq_entries * sizeof (struct io_uring_sqe);
+  ring->sqes = mmap (NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED)
+    {
+      ring->sqes = NULL;
+      return -errno;
+    }
+
+  char *sq = ring->sq_ring;
+  char *cq = ring->cq_ring;
+
+  ring->sq_head = (_Atomic unsigned *)(sq + p->sq_off.head);
+  ring->sq_tail = (_Atomic unsigned *)(sq + p->sq_off.tail);
+  ring->sq_flags = (_Atomic unsigned *)(sq + p->sq_off.flags);
+  ring->sq_mask = *(unsigned *)(sq + p->sq_off.ring_mask);
+  ring->sq_entries = p->sq_entries;
+
+  // Submission slots map one to one onto sqes.
+  unsigned *array = (unsigned *)(sq + p->sq_off.array);
+  for (unsigned i = 0; i < p->sq_entries; i++)
+    array[i] = i;
+
+  ring->cq_head = (_Atomic unsigned *)(cq + p->cq_off.head);
+  ring->cq_tail = (_Atomic unsigned *)(cq + p->cq_off.tail);
+  ring->cq_mask = *(unsigned *)(cq + p->cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+
+  ring->sqe_tail = atomic_load_explicit (ring->sq_tail, memory_order_relaxed);
+
+  return 0;
+}
+
+static int
+register_buffers (cipc_uring *ring, unsigned buf_count, unsigned buf_size)
+{
+  unsigned count = 1;
+  while (count < buf_count)
+    count <<= 1;
+
+  ring->buf_count = count;
+  ring->buf_size = buf_size;
+
+  ring->buf_ring_size = count * sizeof (struct io_uring_buf);
+  ring->buf_ring = mmap (NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring->buf_ring == MAP_FAILED)
+    {
+      ring->buf_ring = NULL;
+      return -errno;
+    }
+
+  ring->bufs_size = (size_t)count * buf_size;
+  ring->bufs = mmap (NULL, ring->bufs_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+  if (ring->bufs == MAP_FAILED)
+    {
+      ring->bufs = NULL;
+      return -errno;
+    }
+
+  struct io_uring_buf_reg reg;
+  memset (&reg, 0, sizeof (reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+  reg.ring_entries = count;
+  reg.bgid = CIPC_URING_BUFFER_GROUP;
+
+  if (sys_register (ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    return -errno;
+
+  for (unsigned i = 0; i < count; i++)
+    buf_ring_add (ring, (uint16_t)i);
+
+  buf_ring_publish (ring);
+
+  return 0;
+}
+
+int
+cipc_uring_create (cipc_uring **out, unsigned entries, unsigned buf_count, unsigned buf_size)
+{
+  cipc_uring *ring = calloc (1, sizeof (cipc_uring));
+  if (!ring)
+    return -ENOMEM;
+
+  struct io_uring_params p;
+  memset (&p, 0, sizeof (p));
+
+  // Multishot operations complete many times per submission, so the completion ring is sized
+  // well above the submission ring.
+  p.flags = IORING_SETUP_CLAMP | IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+  p.cq_entries = entries * 8;
+
+  ring->fd = sys_setup (entries, &p);
+  if (ring->fd < 0)
+    {
+      int err = -errno;
+      free (ring);
+      return err;
+    }
+
+  ring->features = p.features;
+
+  int err = map_rings (ring, &p);
+  if (err == 0)
+    err = register_buffers (ring, buf_count, buf_size);
+
+  if (err != 0)
+    {
+      cipc_uring_free (ring);
+      return err;
+    }
+
+  *out = ring;
+  return 0;
+}
+
+void
+cipc_uring_free (cipc_uring *ring)
+{
+  if (!ring)
+    return;
+
+  // Closing the ring cancels whatever is still in flight before the buffers go away.
+  if (ring->fd >= 0)
+    close (ring->fd);
+
+  if (ring->bufs)
+    munmap (ring->bufs, ring->bufs_size);
+
+  if (ring->buf_ring)
+    munmap (ring->buf_ring, ring->buf_ring_size);
+
+  if (ring->sqes)
+    munmap (ring->sqes, ring->sqes_size);
+
+  if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    munmap (ring->cq_ring, ring->cq_ring_size);
+
+  if (ring->sq_ring)
+    munmap (ring->sq_ring, ring->sq_ring_size);
+
+  free (ring);
+}
+
+int
+cipc_uring_fd (const cipc_uring *ring)
+{
+  return ring->fd;
+}
+
+unsigned
+cipc_uring_unsubmitted (const cipc_uring *ring)
+{
+  return ring->sqe_tail - atomic_load_explicit (ring->sq_head, memory_order_acquire);
+}
+
+static struct io_uring_sqe *
+get_sqe (cipc_uring *ring)
+{
+  if (cipc_uring_unsubmitted (ring) >= ring->sq_entries)
+    {
+      cipc_uring_submit (ring, 0, 0);
+
+      if (cipc_uring_unsubmitted (ring) >= ring->sq_entries)
+        return NULL;
+    }
+
+  struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+  memset (sqe, 0, sizeof (*sqe));
+
+  ring->sqe_tail++;
+
+  return sqe;
+}
+
+int
+cipc_uring_accept_multishot (cipc_uring *ring, int listen_fd, uint64_t user_data)
+{
+  struct io_uring_sqe *sqe = get_sqe (ring);
+  if (!sqe)
+    return -EBUSY;
+
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listen_fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  sqe->user_data = user_data;
+
+  return 0;
+}
+
+int
+cipc_uring_recv_multishot (cipc_uring *ring, int fd, uint64_t user_data)
+{
+  struct io_uring_sqe *sqe = get_sqe (ring);
+  if (!sqe)
+    return -EBUSY;
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = CIPC_URING_BUFFER_GROUP;
+  sqe->user_data = user_data;
+
+  return 0;
+}
+
+int
+cipc_uring_send (cipc_uring *ring, int fd, const void *data, size_t length, uint64_t user_data)
+{
+  struct io_uring_sqe *sqe = get_sqe (ring);
+  if (!sqe)
+    return -EBUSY;
+
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)data;
+  sqe->len = length > UINT32_MAX ? UINT32_MAX : (uint32_t)length;
+  sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+  sqe->user_data = user_data;
+
+  return 0;
+}
+
+int
+cipc_uring_cancel (cipc_uring *ring, uint64_t target, uint64_t user_data)
+{
+  struct io_uring_sqe *sqe = get_sqe (ring);
+  if (!sqe)
+    return -EBUSY;
+
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = target;
+  sqe->user_data = user_data;
+
+  return 0;
+}
+
+int
+cipc_uring_submit (cipc_uring *ring, int wait, int timeout_ms)
+{
+  atomic_store_explicit (ring->sq_tail, ring->sqe_tail, memory_order_release);
+
+  unsigned to_submit = cipc_uring_unsubmitted (ring);
+  unsigned flags = 0;
+  struct timespec ts;
+  struct io_uring_getevents_arg arg;
+  void *argp = NULL;
+  size_t argsz = 0;
+
+  // Completions held back after a ring overflow are only flushed by a GETEVENTS entry.
+  if (wait || (atomic_load_explicit (ring->sq_flags, memory_order_relaxed) & IORING_SQ_CQ_OVERFLOW))
+    flags |= IORING_ENTER_GETEVENTS;
+
+  if (wait && timeout_ms >= 0)
+    {
+      ts.tv_sec = timeout_ms / 1000;
+      ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+
+      memset (&arg, 0, sizeof (arg));
+      arg.ts = (uint64_t)(uintptr_t)&ts;
+
+      flags |= IORING_ENTER_EXT_ARG;
+      argp = &arg;
+      argsz = sizeof (arg);
+    }
+
+  if (to_submit == 0 && flags == 0)
+    return 0;
+
+  int rc;
+  do
+    rc = sys_enter (ring->fd, to_submit, wait ? 1 : 0, flags, argp, argsz);
+  while (rc < 0 && errno == EINTR && !wait);
+
+  return rc < 0 ? -errno : 0;
+}
+
+size_t
+cipc_uring_reap (cipc_uring *ring, cipc_uring_completion *out, size_t max)
+{
+  unsigned head = atomic_load_explicit (ring->cq_head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit (ring->cq_tail, memory_order_acquire);
+  size_t count = 0;
+
+  while (head != tail && count < max)
+    {
+      const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+
+      out[count].user_data = cqe->user_data;
+      out[count].res = cqe->res;
+      out[count].flags = cqe->flags;
+
+      count++;
+      head++;
+    }
+
+  atomic_store_explicit (ring->cq_head, head, memory_order_release);
+
+  return count;
+}
+
+int
+cipc_uring_completion_more (const cipc_uring_completion *completion)
+{
+  return (completion->flags & IORING_CQE_F_MORE) != 0;
+}
+
+const char *
+cipc_uring_completion_data (const cipc_uring *ring, const cipc_uring_completion *completion)
+{
+  if (!(completion->flags & IORING_CQE_F_BUFFER))
+    return NULL;
+
+  uint16_t bid = (uint16_t)(completion->flags >> IORING_CQE_BUFFER_SHIFT);
+
+  return ring->bufs + (size_t)bid * ring->buf_size;
+}
+
+void
+cipc_uring_recycle (cipc_uring *ring, const cipc_uring_completion *completion)
+{
+  if (!(completion->flags & IORING_CQE_F_BUFFER))
+    return;
+
+  buf_ring_add (ring, (uint16_t)(completion->flags >> IORING_CQE_BUFFER_SHIFT));
+  buf_ring_publish (ring);
+}
+
+#else
+
+int
+cipc_uring_create (cipc_uring **out, unsigned entries, unsigned buf_count, unsigned buf_size)
+{
+  (void)out;
+  (void)entries;
+  (void)buf_count;
+  (void)buf_size;
+
+  return -ENOSYS;
+}
+
+void
+cipc_uring_free (cipc_uring *ring)
+{
+  (void)ring;
+}
+
+int
+cipc_uring_fd (const cipc_uring *ring)
+{
+  (void)ring;
+
+  return -1;
+}
+
+int
+cipc_uring_accept_multishot (cipc_uring *ring, int listen_fd, uint64_t user_data)
+{
+  (void)ring;
+  (void)listen_fd;
+  (void)user_data;
+
+  return -ENOSYS;
+}
+
+int
+cipc_uring_recv_multishot (cipc_uring *ring, int fd, uint64_t user_data)
+{
+  (void)ring;
+  (void)fd;
+  (void)user_data;
+
+  return -ENOSYS;
+}
+
+int
+cipc_uring_send (cipc_uring *ring, int fd, const void *data, size_t length, uint64_t user_data)
+{
+  (void)ring;
+  (void)fd;
+  (void)data;
+  (void)length;
+  (void)user_data;
+
+  return -ENOSYS;
+}
+
+int
+cipc_uring_cancel (cipc_uring *ring, uint64_t target, uint64_t user_data)
+{
+  (void)ring;
+  (void)target;
+  (void)user_data;
+
+  return -ENOSYS;
+}
+
+unsigned
+cipc_uring_unsubmitted (const cipc_uring *ring)
+{
+  (void)ring;
+
+  return 0;
+}
+
+int
+cipc_uring_submit (cipc_uring *ring, int wait, int timeout_ms)
+{
+  (void)ring;
+  (void)wait;
+  (void)timeout_ms;
+
+  return -ENOSYS;
+}
+
+size_t
+cipc_uring_reap (cipc_uring *ring, cipc_uring_completion *out, size_t max)
+{
+  (void)ring;
+  (void)out;
+  (void)max;
+
+  return 0;
+}
+
+int
+cipc_uring_completion_more (const cipc_uring_completion *completion)
+{
+  (void)completion;
+
+  return 0;
+}
+
+const char *
+cipc_uring_completion_data (const cipc_uring *ring, const cipc_uring_completion *completion)
+{
+  (void)ring;
+  (void)completion;
+
+  return NULL;
+}
+
+void
+cipc_uring_recycle (cipc_uring *ring, const cipc_uring_completion *completion)
+{
+  (void)ring;
+  (void)completion;
+}
+
+#endif
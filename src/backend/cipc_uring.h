@@ -0,0 +1,52 @@
+#ifndef CIPC_URING_H
+#define CIPC_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal io_uring driver over the raw system calls: one submission/completion ring pair and a
+// registered ring of provided receive buffers. Functions return 0 or a negative errno; all of
+// them fail with -ENOSYS when the system headers predate io_uring.
+
+typedef struct cipc_uring cipc_uring;
+
+typedef struct
+{
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+} cipc_uring_completion;
+
+// buf_count is rounded up to a power of two; every receive lands in one buffer of buf_size.
+int cipc_uring_create (cipc_uring **out, unsigned entries, unsigned buf_count, unsigned buf_size);
+void cipc_uring_free (cipc_uring *ring);
+
+// Readable while completions are waiting.
+int cipc_uring_fd (const cipc_uring *ring);
+
+// Queued until the next cipc_uring_submit; a full submission ring is submitted first.
+int cipc_uring_accept_multishot (cipc_uring *ring, int listen_fd, uint64_t user_data);
+int cipc_uring_recv_multishot (cipc_uring *ring, int fd, uint64_t user_data);
+int cipc_uring_send (cipc_uring *ring, int fd, const void *data, size_t length,
+                     uint64_t user_data);
+int cipc_uring_cancel (cipc_uring *ring, uint64_t target, uint64_t user_data);
+
+unsigned cipc_uring_unsubmitted (const cipc_uring *ring);
+
+// Submits everything queued and, with wait, blocks until a completion arrives or timeout_ms
+// (-1: no limit) passes, all in one system call. Returns -ETIME on timeout.
+int cipc_uring_submit (cipc_uring *ring, int wait, int timeout_ms);
+
+// Copies out up to max completions.
+size_t cipc_uring_reap (cipc_uring *ring, cipc_uring_completion *out, size_t max);
+
+// The operation stays armed and will complete again.
+int cipc_uring_completion_more (const cipc_uring_completion *completion);
+
+// Data of a multishot receive, or NULL without a selected buffer. The buffer goes back to the
+// kernel with cipc_uring_recycle once the data has been consumed.
+const char *cipc_uring_completion_data (const cipc_uring *ring,
+                                        const cipc_uring_completion *completion);
+void cipc_uring_recycle (cipc_uring *ring, const cipc_uring_completion *completion);
+
+#endif // CIPC_URING_H
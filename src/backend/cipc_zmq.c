@@ -1,20 +1,466 @@
+#include <errno.h>
+#include <pthread.h>
 #include <string.h>
 #include <zmq.h>
 
 #include "backend/cipc_zmq.h"
 #include "cipc.h"
+#include "cipc_counters.h"
+#include "cipc_spin.h"
 
 #define CIPC_ZMQ_CONFIG_DEFAULT_SNDTIMEO_MS 5000
 #define CIPC_ZMQ_CONFIG_DEFAULT_RCVTIMEO_MS 5000
 #define CIPC_ZMQ_CONFIG_DEFAULT_RETRY_INTERVAL_MS 10
 #define CIPC_ZMQ_CONFIG_DEFAULT_RETRIES 3
+#define CIPC_ZMQ_LOW_LATENCY_HWM 100
+#define CIPC_ZMQ_BULK_SOCKET_BUFFER (4 * 1024 * 1024)
+
+typedef struct
+{
+  zmq_msg_t part;
+
+  // Set when the message had several parts and they were joined into one buffer.
+  char *joined;
+  size_t length;
+
+  // Sender, for messages received on a ROUTER socket.
+  cipc_peer_id peer;
+} cipc_zmq_msg;
+
+typedef enum
+{
+  CIPC_ZMQ_CONTEXT_OWNED,
+  CIPC_ZMQ_CONTEXT_SHARED,
+  CIPC_ZMQ_CONTEXT_EXTERNAL
+} cipc_zmq_context_kind;
 
 typedef struct
 {
   void *zmq_context;
+  cipc_zmq_context_kind context_kind;
   void *zmq_socket;
+
+  // Message that did not fit the caller buffer, kept for the next recv.
+  cipc_zmq_msg *pending;
+
+  // ROUTER sockets prefix every message with the peer's routing id; plain sends go to the peer
+  // of the last received message.
+  int routed;
+  cipc_peer_id last_peer;
+
+  cipc_spin spin;
+
+  // libzmq does the socket I/O and reconnects on its own threads, so syscalls, short I/O and
+  // reconnects stay at zero here.
+  cipc_counters counters;
 } cipc_zmq_private;
 
+// Process-wide context handed to instances with shared_context set; it lives while any of them
+// does, so inproc:// endpoints are visible between them.
+static pthread_mutex_t shared_context_lock = PTHREAD_MUTEX_INITIALIZER;
+static void *shared_context;
+static size_t shared_context_refs;
+
+static const char *
+helper_msg_payload (cipc_zmq_msg *msg)
+{
+  return msg->joined ? msg->joined : (const char *)zmq_msg_data (&msg->part);
+}
+
+static void
+helper_msg_free (cipc_zmq_msg *msg)
+{
+  if (!msg)
+    return;
+
+  zmq_msg_close (&msg->part);
+  free (msg->joined);
+  free (msg);
+}
+
+static void
+helper_discard_parts (void *socket)
+{
+  int more = 1;
+
+  while (more)
+    {
+      zmq_msg_t part;
+      zmq_msg_init (&part);
+
+      if (zmq_msg_recv (&part, socket, 0) < 0)
+        more = 0;
+      else
+        more = zmq_msg_more (&part);
+
+      zmq_msg_close (&part);
+    }
+}
+
+// Leaves no part of the message queued, even when joining fails.
+static cipc_err
+helper_msg_join_parts (void *socket, cipc_zmq_msg *msg)
+{
+  size_t capacity = zmq_msg_size (&msg->part) * 2;
+  if (capacity < 256)
+    capacity = 256;
+
+  msg->joined = malloc (capacity);
+  if (!msg->joined)
+    {
+      helper_discard_parts (socket);
+      return CIPC_BAD_ALLOC;
+    }
+
+  memcpy (msg->joined, zmq_msg_data (&msg->part), zmq_msg_size (&msg->part));
+  msg->length = zmq_msg_size (&msg->part);
+
+  int more = 1;
+
+  while (more)
+    {
+      zmq_msg_t part;
+      zmq_msg_init (&part);
+
+      if (zmq_msg_recv (&part, socket, 0) < 0)
+        {
+          zmq_msg_close (&part);
+          return CIPC_BAD_ZMQ_RECV;
+        }
+
+      size_t part_len = zmq_msg_size (&part);
+
+      if (msg->length + part_len > capacity)
+        {
+          while (msg->length + part_len > capacity)
+            capacity *= 2;
+
+          char *joined = realloc (msg->joined, capacity);
+          if (!joined)
+            {
+              more = zmq_msg_more (&part);
+              zmq_msg_close (&part);
+
+              if (more)
+                helper_discard_parts (socket);
+
+              return CIPC_BAD_ALLOC;
+            }
+
+          msg->joined = joined;
+        }
+
+      memcpy (msg->joined + msg->length, zmq_msg_data (&part), part_len);
+      msg->length += part_len;
+
+      more = zmq_msg_more (&part);
+      zmq_msg_close (&part);
+    }
+
+  return CIPC_OK;
+}
+
+// Routing ids of up to 7 bytes (libzmq generates 5) are packed into the peer id together with
+// their length, so no table is needed and 0 stays invalid.
+static cipc_peer_id
+helper_peer_encode (const unsigned char *routing_id, size_t length)
+{
+  if (length == 0 || length > 7)
+    return 0;
+
+  cipc_peer_id peer = (cipc_peer_id)length << 56;
+  for (size_t i = 0; i < length; i++)
+    peer |= (cipc_peer_id)routing_id[i] << (8 * (6 - i));
+
+  return peer;
+}
+
+static size_t
+helper_peer_decode (cipc_peer_id peer, unsigned char routing_id[7])
+{
+  size_t length = peer >> 56;
+  if (length == 0 || length > 7)
+    return 0;
+
+  for (size_t i = 0; i < length; i++)
+    routing_id[i] = (unsigned char)(peer >> (8 * (6 - i)));
+
+  return length;
+}
+
+static cipc_err
+helper_recv_peer (cipc_zmq_private *zctx, int flags, cipc_peer_id *peer)
+{
+  zmq_msg_t routing_id;
+  zmq_msg_init (&routing_id);
+
+  if (zmq_msg_recv (&routing_id, zctx->zmq_socket, flags) < 0)
+    {
+      int would_block = zmq_errno () == EAGAIN;
+
+      zmq_msg_close (&routing_id);
+
+      if (would_block && (flags & ZMQ_DONTWAIT))
+        return CIPC_WOULD_BLOCK;
+
+      if (would_block)
+        cipc_counter_add (&zctx->counters.recv_timeouts, 1);
+
+      return CIPC_BAD_ZMQ_RECV;
+    }
+
+  *peer = helper_peer_encode (zmq_msg_data (&routing_id), zmq_msg_size (&routing_id));
+
+  int more = zmq_msg_more (&routing_id);
+  zmq_msg_close (&routing_id);
+
+  if (*peer == 0)
+    {
+      fprintf (stderr, "ZMQ routing id longer than 7 bytes, message dropped\n");
+
+      if (more)
+        helper_discard_parts (zctx->zmq_socket);
+
+      return CIPC_BAD_PEER;
+    }
+
+  return CIPC_OK;
+}
+
+// Spins on ZMQ_EVENTS, which also runs the socket's pending commands, until a message is in or
+// the spin deadline passes; the blocking receive that follows does the rest.
+static void
+helper_spin (cipc_zmq_private *zctx)
+{
+  int64_t spin_until = cipc_spin_deadline (&zctx->spin);
+
+  while (spin_until)
+    {
+      int events = 0;
+      size_t size = sizeof (events);
+
+      if (zmq_getsockopt (zctx->zmq_socket, ZMQ_EVENTS, &events, &size) < 0
+          || (events & ZMQ_POLLIN))
+        return;
+
+      if (!cipc_spin_wait (spin_until))
+        return;
+    }
+}
+
+static cipc_err
+helper_next_msg (cipc_zmq_private *zctx, int flags, cipc_zmq_msg **out)
+{
+  if (zctx->pending)
+    {
+      *out = zctx->pending;
+      zctx->pending = NULL;
+      zctx->last_peer = (*out)->peer;
+
+      return CIPC_OK;
+    }
+
+  if (!(flags & ZMQ_DONTWAIT))
+    helper_spin (zctx);
+
+  cipc_peer_id peer = 0;
+
+  if (zctx->routed)
+    {
+      cipc_err err = helper_recv_peer (zctx, flags, &peer);
+      if (err != CIPC_OK)
+        return err;
+
+      // The remaining parts arrive together with the routing id.
+      flags &= ~ZMQ_DONTWAIT;
+    }
+
+  cipc_zmq_msg *msg = calloc (1, sizeof (cipc_zmq_msg));
+  if (!msg)
+    {
+      if (zctx->routed)
+        helper_discard_parts (zctx->zmq_socket);
+
+      return CIPC_BAD_ALLOC;
+    }
+
+  msg->peer = peer;
+
+  zmq_msg_init (&msg->part);
+
+  if (zmq_msg_recv (&msg->part, zctx->zmq_socket, flags) < 0)
+    {
+      int would_block = zmq_errno () == EAGAIN;
+
+      helper_msg_free (msg);
+
+      if (would_block && (flags & ZMQ_DONTWAIT))
+        return CIPC_WOULD_BLOCK;
+
+      if (would_block)
+        cipc_counter_add (&zctx->counters.recv_timeouts, 1);
+
+      return CIPC_BAD_ZMQ_RECV;
+    }
+
+  msg->length = zmq_msg_size (&msg->part);
+
+  // Multipart messages (e.g. from a plain ZMQ peer) are reassembled into one payload.
+  if (zmq_msg_more (&msg->part))
+    {
+      cipc_err err = helper_msg_join_parts (zctx->zmq_socket, msg);
+      if (err != CIPC_OK)
+        {
+          helper_msg_free (msg);
+          return err;
+        }
+    }
+
+  *out = msg;
+
+  if (zctx->routed)
+    zctx->last_peer = msg->peer;
+
+  cipc_spin_arrived (&zctx->spin);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+helper_send (cipc_zmq_private *zctx, const void *data, size_t length, int flags)
+{
+  if (zmq_send (zctx->zmq_socket, data, length, flags) >= 0)
+    return CIPC_OK;
+
+  if (zmq_errno () == EAGAIN)
+    cipc_counter_add (&zctx->counters.send_timeouts, 1);
+
+  return CIPC_BAD_ZMQ_SEND;
+}
+
+// Addresses the next message on a ROUTER socket; a no-op on other socket types.
+static cipc_err
+helper_send_peer (cipc_zmq_private *zctx, cipc_peer_id peer)
+{
+  if (!zctx->routed)
+    return CIPC_OK;
+
+  unsigned char routing_id[7];
+  size_t length = helper_peer_decode (peer, routing_id);
+  if (length == 0)
+    return CIPC_BAD_PEER;
+
+  if (zmq_send (zctx->zmq_socket, routing_id, length, ZMQ_SNDMORE) >= 0)
+    return CIPC_OK;
+
+  // ZMQ_ROUTER_MANDATORY reports peers that are gone instead of dropping silently.
+  if (zmq_errno () == EHOSTUNREACH)
+    return CIPC_BAD_PEER;
+
+  if (zmq_errno () == EAGAIN)
+    cipc_counter_add (&zctx->counters.send_timeouts, 1);
+
+  return CIPC_BAD_ZMQ_SEND;
+}
+
+static void *
+helper_context_new (const cipc_zmq_config *config)
+{
+  void *context = zmq_ctx_new ();
+  if (!context)
+    return NULL;
+
+  int rc = 0;
+
+  if (config->io_threads > 0)
+    rc = zmq_ctx_set (context, ZMQ_IO_THREADS, config->io_threads);
+
+  for (size_t i = 0; rc == 0 && i < config->io_thread_cpu_count; i++)
+    {
+#ifdef ZMQ_THREAD_AFFINITY_CPU_ADD
+      rc = zmq_ctx_set (context, ZMQ_THREAD_AFFINITY_CPU_ADD, config->io_thread_cpus[i]);
+#else
+      errno = ENOTSUP;
+      rc = -1;
+#endif
+    }
+
+  if (rc != 0)
+    {
+      fprintf (stderr, "ZMQ context setup failed: %s\n", zmq_strerror (zmq_errno ()));
+
+      zmq_ctx_destroy (context);
+
+      return NULL;
+    }
+
+  return context;
+}
+
+static cipc_err
+helper_context_acquire (cipc_zmq_private *zctx, const cipc_zmq_config *config)
+{
+  if (config->zmq_context)
+    {
+      zctx->zmq_context = config->zmq_context;
+      zctx->context_kind = CIPC_ZMQ_CONTEXT_EXTERNAL;
+
+      return CIPC_OK;
+    }
+
+  if (!config->shared_context)
+    {
+      zctx->zmq_context = helper_context_new (config);
+      zctx->context_kind = CIPC_ZMQ_CONTEXT_OWNED;
+
+      return zctx->zmq_context ? CIPC_OK : CIPC_BAD_ZMQ_CONTEXT;
+    }
+
+  pthread_mutex_lock (&shared_context_lock);
+
+  if (!shared_context)
+    shared_context = helper_context_new (config);
+
+  if (shared_context)
+    shared_context_refs++;
+
+  zctx->zmq_context = shared_context;
+  zctx->context_kind = CIPC_ZMQ_CONTEXT_SHARED;
+
+  pthread_mutex_unlock (&shared_context_lock);
+
+  return zctx->zmq_context ? CIPC_OK : CIPC_BAD_ZMQ_CONTEXT;
+}
+
+static void
+helper_context_release (cipc_zmq_private *zctx)
+{
+  if (!zctx->zmq_context)
+    return;
+
+  switch (zctx->context_kind)
+    {
+    case CIPC_ZMQ_CONTEXT_OWNED:
+      zmq_ctx_destroy (zctx->zmq_context);
+      break;
+    case CIPC_ZMQ_CONTEXT_SHARED:
+      pthread_mutex_lock (&shared_context_lock);
+
+      if (--shared_context_refs == 0)
+        {
+          zmq_ctx_destroy (shared_context);
+          shared_context = NULL;
+        }
+
+      pthread_mutex_unlock (&shared_context_lock);
+      break;
+    case CIPC_ZMQ_CONTEXT_EXTERNAL:
+      break;
+    }
+
+  zctx->zmq_context = NULL;
+}
+
 static cipc_err
 helper_set_sockopts (void *socket, const cipc_zmq_config *config)
 {
@@ -28,6 +474,43 @@ helper_set_sockopts (void *socket, const cipc_zmq_config *config)
   zmq_setsockopt (socket, ZMQ_RECONNECT_IVL, &retry_interval, sizeof (int));
   zmq_setsockopt (socket, ZMQ_RECONNECT_IVL_MAX, &config->sockopt_retries, sizeof (int));
 
+  if (config->socket_type == ZMQ_ROUTER)
+    {
+      int mandatory = 1;
+      zmq_setsockopt (socket, ZMQ_ROUTER_MANDATORY, &mandatory, sizeof (int));
+    }
+
+  int sndhwm = config->sndhwm;
+  int rcvhwm = config->rcvhwm;
+  int sndbuf = config->sndbuf;
+  int rcvbuf = config->rcvbuf;
+
+  if (config->profile == CIPC_PROFILE_LOW_LATENCY)
+    {
+      sndhwm = sndhwm ? sndhwm : CIPC_ZMQ_LOW_LATENCY_HWM;
+      rcvhwm = rcvhwm ? rcvhwm : CIPC_ZMQ_LOW_LATENCY_HWM;
+    }
+  else if (config->profile == CIPC_PROFILE_BULK)
+    {
+      sndbuf = sndbuf ? sndbuf : CIPC_ZMQ_BULK_SOCKET_BUFFER;
+      rcvbuf = rcvbuf ? rcvbuf : CIPC_ZMQ_BULK_SOCKET_BUFFER;
+    }
+
+  if (sndhwm > 0)
+    zmq_setsockopt (socket, ZMQ_SNDHWM, &sndhwm, sizeof (int));
+
+  if (rcvhwm > 0)
+    zmq_setsockopt (socket, ZMQ_RCVHWM, &rcvhwm, sizeof (int));
+
+  if (sndbuf > 0)
+    zmq_setsockopt (socket, ZMQ_SNDBUF, &sndbuf, sizeof (int));
+
+  if (rcvbuf > 0)
+    zmq_setsockopt (socket, ZMQ_RCVBUF, &rcvbuf, sizeof (int));
+
+  if (config->conflate)
+    zmq_setsockopt (socket, ZMQ_CONFLATE, &config->conflate, sizeof (int));
+
   return CIPC_OK;
 }
 
@@ -39,33 +522,39 @@ cipc_zmq_init (void **context, const void *config)
 
   const cipc_zmq_config *cfg = (const cipc_zmq_config *)config;
 
-  cipc_zmq_private *zctx = malloc (sizeof (cipc_zmq_private));
+  cipc_zmq_private *zctx = calloc (1, sizeof (cipc_zmq_private));
   if (!zctx)
     return CIPC_BAD_ALLOC;
 
-  zctx->zmq_context = zmq_ctx_new ();
-  if (!zctx->zmq_context)
+  cipc_counters_init (&zctx->counters);
+
+  cipc_err err = helper_context_acquire (zctx, cfg);
+  if (err != CIPC_OK)
     {
       free (zctx);
 
-      return CIPC_BAD_ZMQ_CONTEXT;
+      return err;
     }
 
   zctx->zmq_socket = zmq_socket (zctx->zmq_context, cfg->socket_type);
   if (!zctx->zmq_socket)
     {
-      zmq_ctx_destroy (zctx->zmq_context);
+      helper_context_release (zctx);
 
       free (zctx);
 
       return CIPC_BAD_ZMQ_SOCKET;
     }
 
-  cipc_err err = helper_set_sockopts (zctx->zmq_socket, cfg);
+  zctx->routed = cfg->socket_type == ZMQ_ROUTER;
+
+  cipc_spin_init (&zctx->spin, cfg->spin_us);
+
+  err = helper_set_sockopts (zctx->zmq_socket, cfg);
   if (err != CIPC_OK)
     {
       zmq_close (zctx->zmq_socket);
-      zmq_ctx_destroy (zctx->zmq_context);
+      helper_context_release (zctx);
 
       free (zctx);
 
@@ -81,7 +570,7 @@ cipc_zmq_init (void **context, const void *config)
                zmq_strerror (zmq_errno ()));
 
       zmq_close (zctx->zmq_socket);
-      zmq_ctx_destroy (zctx->zmq_context);
+      helper_context_release (zctx);
 
       free (zctx);
 
@@ -97,30 +586,265 @@ static cipc_err
 cipc_zmq_send (void *context, const char *data, size_t length)
 {
   cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+  uint64_t start = cipc_counters_start (&zctx->counters);
+
+  cipc_err err = helper_send_peer (zctx, zctx->last_peer);
+  if (err == CIPC_OK)
+    err = helper_send (zctx, data, length, 0);
+
+  cipc_counters_sent (&zctx->counters, err, err == CIPC_OK, length, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_zmq_sendv (void *context, const cipc_iovec *iov, size_t iovcnt)
+{
+  cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+
+  if (iovcnt == 0)
+    return cipc_zmq_send (context, NULL, 0);
+
+  uint64_t start = cipc_counters_start (&zctx->counters);
+
+  size_t length = 0;
+  for (size_t i = 0; i < iovcnt; i++)
+    length += iov[i].length;
+
+  // Gathered into a single part, so a failed send cannot leave the message half queued.
+  zmq_msg_t part;
+  if (zmq_msg_init_size (&part, length) != 0)
+    return CIPC_BAD_ALLOC;
+
+  char *data = zmq_msg_data (&part);
+  for (size_t i = 0; i < iovcnt; i++)
+    {
+      memcpy (data, iov[i].base, iov[i].length);
+      data += iov[i].length;
+    }
+
+  cipc_err err = helper_send_peer (zctx, zctx->last_peer);
+  if (err == CIPC_OK && zmq_msg_send (&part, zctx->zmq_socket, 0) < 0)
+    {
+      if (zmq_errno () == EAGAIN)
+        cipc_counter_add (&zctx->counters.send_timeouts, 1);
+
+      err = CIPC_BAD_ZMQ_SEND;
+    }
 
-  int rc = zmq_send (zctx->zmq_socket, data, length, 0);
+  // zmq_msg_send takes over the part only when it succeeds.
+  if (err != CIPC_OK)
+    zmq_msg_close (&part);
+
+  cipc_counters_sent (&zctx->counters, err, err == CIPC_OK, length, start);
+
+  return err;
+}
+
+static cipc_err
+recv_copy (cipc_zmq_private *zctx, char *buffer, size_t length, size_t *len_out)
+{
+  // No room for the terminator.
+  if (length == 0)
+    return CIPC_BAD_BUFFER_SIZE;
+
+  cipc_zmq_msg *msg;
+
+  cipc_err err = helper_next_msg (zctx, 0, &msg);
+  if (err != CIPC_OK)
+    return err;
+
+  *len_out = msg->length;
+
+  if (msg->length > length - 1)
+    {
+      zctx->pending = msg;
 
-  return (rc >= 0) ? CIPC_OK : CIPC_BAD_ZMQ_SEND;
+      return CIPC_BAD_BUFFER_SIZE;
+    }
+
+  memcpy (buffer, helper_msg_payload (msg), msg->length);
+  buffer[msg->length] = '\0';
+
+  helper_msg_free (msg);
+
+  return CIPC_OK;
 }
 
 static cipc_err
 cipc_zmq_recv (void *context, char *buffer, size_t length, size_t *len_out)
 {
   cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+  uint64_t start = cipc_counters_start (&zctx->counters);
+
+  size_t msg_len = 0;
+  cipc_err err = recv_copy (zctx, buffer, length, &msg_len);
+
+  if (len_out != NULL)
+    *len_out = msg_len;
 
-  int rc = zmq_recv (zctx->zmq_socket, buffer, length - 1, 0);
+  cipc_counters_received (&zctx->counters, err, err == CIPC_OK, msg_len, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_zmq_recv_msg (void *context, cipc_msg *msg)
+{
+  cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+  uint64_t start = cipc_counters_start (&zctx->counters);
 
-  if (rc >= 0)
+  cipc_zmq_msg *zmsg;
+
+  cipc_err err = helper_next_msg (zctx, 0, &zmsg);
+  if (err != CIPC_OK)
     {
-      buffer[rc] = '\0';
+      cipc_counters_received (&zctx->counters, err, 0, 0, start);
+      return err;
+    }
 
-      if (len_out != NULL)
-        *len_out = (size_t)rc;
+  msg->data = helper_msg_payload (zmsg);
+  msg->length = zmsg->length;
+  msg->handle = zmsg;
 
-      return CIPC_OK;
+  cipc_counters_received (&zctx->counters, CIPC_OK, 1, zmsg->length, start);
+
+  return CIPC_OK;
+}
+
+static void
+cipc_zmq_release_msg (void *context, cipc_msg *msg)
+{
+  (void)context;
+
+  if (!msg)
+    return;
+
+  helper_msg_free (msg->handle);
+
+  msg->data = NULL;
+  msg->length = 0;
+  msg->handle = NULL;
+}
+
+static cipc_err
+cipc_zmq_send_batch (void *context, const cipc_iovec *msgs, size_t count, size_t *sent)
+{
+  cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+  uint64_t start = cipc_counters_start (&zctx->counters);
+
+  cipc_err err = CIPC_OK;
+  size_t done = 0;
+  uint64_t bytes = 0;
+
+  while (done < count && (err = helper_send_peer (zctx, zctx->last_peer)) == CIPC_OK
+         && (err = helper_send (zctx, msgs[done].base, msgs[done].length, 0)) == CIPC_OK)
+    bytes += msgs[done++].length;
+
+  cipc_counters_sent (&zctx->counters, err, done, bytes, start);
+
+  if (sent != NULL)
+    *sent = done;
+
+  return err;
+}
+
+static cipc_err
+cipc_zmq_recv_batch (void *context, cipc_msg *msgs, size_t count, size_t *received)
+{
+  cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+
+  if (!received || (count > 0 && !msgs))
+    return CIPC_NULL_PTR;
+
+  uint64_t start = cipc_counters_start (&zctx->counters);
+
+  cipc_err err = CIPC_OK;
+  uint64_t bytes = 0;
+
+  *received = 0;
+
+  // Block for the first message only, then drain what is already queued.
+  while (*received < count)
+    {
+      cipc_zmq_msg *zmsg;
+
+      err = helper_next_msg (zctx, *received == 0 ? 0 : ZMQ_DONTWAIT, &zmsg);
+      if (err != CIPC_OK)
+        {
+          if (*received > 0)
+            err = CIPC_OK;
+
+          break;
+        }
+
+      msgs[*received].data = helper_msg_payload (zmsg);
+      msgs[*received].length = zmsg->length;
+      msgs[*received].handle = zmsg;
+
+      bytes += zmsg->length;
+      (*received)++;
     }
 
-  return CIPC_BAD_ZMQ_RECV;
+  cipc_counters_received (&zctx->counters, err, *received, bytes, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_zmq_send_to (void *context, cipc_peer_id peer, const char *data, size_t length)
+{
+  cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+  if (!zctx->routed)
+    return CIPC_BAD_PEER;
+
+  uint64_t start = cipc_counters_start (&zctx->counters);
+
+  cipc_err err = helper_send_peer (zctx, peer);
+  if (err == CIPC_OK)
+    err = helper_send (zctx, data, length, 0);
+
+  cipc_counters_sent (&zctx->counters, err, err == CIPC_OK, length, start);
+
+  return err;
+}
+
+static cipc_err
+cipc_zmq_recv_from (void *context, cipc_peer_id *peer, char *buffer, size_t length,
+                    size_t *len_out)
+{
+  cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+  if (!zctx->routed)
+    return CIPC_BAD_PEER;
+
+  cipc_err err = cipc_zmq_recv (context, buffer, length, len_out);
+
+  // A message kept for a larger buffer still reports its sender.
+  if (peer != NULL && (err == CIPC_OK || err == CIPC_BAD_BUFFER_SIZE))
+    *peer = zctx->last_peer;
+
+  return err;
+}
+
+static cipc_err
+cipc_zmq_get_fd (void *context, int *fd, int *ready)
+{
+  cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+
+  size_t fd_len = sizeof (*fd);
+  if (zmq_getsockopt (zctx->zmq_socket, ZMQ_FD, fd, &fd_len) != 0)
+    return CIPC_BAD_ZMQ_SOCKET;
+
+  // ZMQ_FD only signals that socket state changed; ZMQ_EVENTS tells whether a message is
+  // queued and re-arms the descriptor.
+  int events = 0;
+  size_t events_len = sizeof (events);
+  if (zmq_getsockopt (zctx->zmq_socket, ZMQ_EVENTS, &events, &events_len) != 0)
+    return CIPC_BAD_ZMQ_SOCKET;
+
+  *ready = zctx->pending != NULL || (events & ZMQ_POLLIN);
+
+  return CIPC_OK;
 }
 
 void
@@ -131,15 +855,25 @@ cipc_zmq_free (void *context)
 
   cipc_zmq_private *zctx = (cipc_zmq_private *)context;
 
+  helper_msg_free (zctx->pending);
+
   if (zctx->zmq_socket)
     zmq_close (zctx->zmq_socket);
 
-  if (zctx->zmq_context)
-    zmq_ctx_destroy (zctx->zmq_context);
+  helper_context_release (zctx);
 
+  cipc_counters_destroy (&zctx->counters);
   free (zctx);
 }
 
+static cipc_counters *
+cipc_zmq_counters (void *context)
+{
+  cipc_zmq_private *zctx = (cipc_zmq_private *)context;
+
+  return &zctx->counters;
+}
+
 cipc *
 cipc_create_zmq (void)
 {
@@ -151,7 +885,20 @@ cipc_create_zmq (void)
 
   instance->init = cipc_zmq_init;
   instance->send = cipc_zmq_send;
+  instance->sendv = cipc_zmq_sendv;
   instance->recv = cipc_zmq_recv;
+  instance->recv_msg = cipc_zmq_recv_msg;
+  instance->release_msg = cipc_zmq_release_msg;
+  instance->send_to = cipc_zmq_send_to;
+  instance->recv_from = cipc_zmq_recv_from;
+  instance->send_batch = cipc_zmq_send_batch;
+  instance->recv_batch = cipc_zmq_recv_batch;
+  instance->send_file = NULL;
+  instance->recv_file = NULL;
+  instance->send_buf = NULL;
+  instance->recv_buf = NULL;
+  instance->get_fd = cipc_zmq_get_fd;
+  instance->counters = cipc_zmq_counters;
   instance->free = cipc_zmq_free;
   instance->context = NULL;
 
@@ -188,6 +935,30 @@ cipc_zmq_config_rep (const char *address)
   return cipc_zmq_config_default (address, ZMQ_REP, CIPC_ZMQ_MODE_BIND);
 }
 
+cipc_zmq_config *
+cipc_zmq_config_dealer (const char *address)
+{
+  return cipc_zmq_config_default (address, ZMQ_DEALER, CIPC_ZMQ_MODE_CONNECT);
+}
+
+cipc_zmq_config *
+cipc_zmq_config_router (const char *address)
+{
+  return cipc_zmq_config_default (address, ZMQ_ROUTER, CIPC_ZMQ_MODE_BIND);
+}
+
+cipc_zmq_config *
+cipc_zmq_config_pub (const char *address)
+{
+  return cipc_zmq_config_default (address, ZMQ_XPUB, CIPC_ZMQ_MODE_BIND);
+}
+
+cipc_zmq_config *
+cipc_zmq_config_sub (const char *address)
+{
+  return cipc_zmq_config_default (address, ZMQ_XSUB, CIPC_ZMQ_MODE_CONNECT);
+}
+
 void
 cipc_zmq_config_set_sndtimeo (cipc_zmq_config *config, int sndtimeo)
 {
@@ -214,3 +985,87 @@ cipc_zmq_config_set_retries (cipc_zmq_config *config, int retries)
 
   config->sockopt_retries = retries;
 }
+
+void
+cipc_zmq_config_set_context (cipc_zmq_config *config, void *zmq_context)
+{
+  if (!config)
+    return;
+
+  config->zmq_context = zmq_context;
+}
+
+void
+cipc_zmq_config_set_shared_context (cipc_zmq_config *config, int shared)
+{
+  if (!config)
+    return;
+
+  config->shared_context = shared;
+}
+
+void
+cipc_zmq_config_set_io_threads (cipc_zmq_config *config, int io_threads)
+{
+  if (!config)
+    return;
+
+  config->io_threads = io_threads;
+}
+
+void
+cipc_zmq_config_set_io_thread_cpus (cipc_zmq_config *config, const int *cpus, size_t count)
+{
+  if (!config)
+    return;
+
+  config->io_thread_cpus = cpus;
+  config->io_thread_cpu_count = count;
+}
+
+void
+cipc_zmq_config_set_hwm (cipc_zmq_config *config, int sndhwm, int rcvhwm)
+{
+  if (!config)
+    return;
+
+  config->sndhwm = sndhwm;
+  config->rcvhwm = rcvhwm;
+}
+
+void
+cipc_zmq_config_set_conflate (cipc_zmq_config *config, int conflate)
+{
+  if (!config)
+    return;
+
+  config->conflate = conflate;
+}
+
+void
+cipc_zmq_config_set_buffers (cipc_zmq_config *config, int sndbuf, int rcvbuf)
+{
+  if (!config)
+    return;
+
+  config->sndbuf = sndbuf;
+  config->rcvbuf = rcvbuf;
+}
+
+void
+cipc_zmq_config_set_profile (cipc_zmq_config *config, cipc_profile profile)
+{
+  if (!config)
+    return;
+
+  config->profile = profile;
+}
+
+void
+cipc_zmq_config_set_spin (cipc_zmq_config *config, int spin_us)
+{
+  if (!config)
+    return;
+
+  config->spin_us = spin_us;
+}
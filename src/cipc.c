@@ -1,8 +1,23 @@
 #include "cipc.h"
 #include "backend/cipc_zmq.h"
 #include "backend/cipc_tcp.h"
+#include "backend/cipc_shm.h"
+#include "backend/cipc_unix.h"
+#include "backend/cipc_threaded.h"
+#include "backend/cipc_codec.h"
+#include "backend/cipc_udp.h"
+#include "backend/cipc_inproc.h"
+#include "cipc_internal.h"
 
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define CIPC_POLL_STACK_FDS 16
+// Longest single wait while an instance without a descriptor (shared memory) is polled.
+#define CIPC_POLL_NO_FD_SLICE_MS 1
 
 cipc *
 cipc_create (cipc_protocol protocol)
@@ -13,6 +28,18 @@ cipc_create (cipc_protocol protocol)
       return cipc_create_zmq ();
     case CIPC_PROTOCOL_TCP:
       return cipc_create_tcp ();
+    case CIPC_PROTOCOL_SHM:
+      return cipc_create_shm ();
+    case CIPC_PROTOCOL_UNIX:
+      return cipc_create_unix ();
+    case CIPC_PROTOCOL_THREADED:
+      return cipc_create_threaded ();
+    case CIPC_PROTOCOL_CODEC:
+      return cipc_create_codec ();
+    case CIPC_PROTOCOL_UDP:
+      return cipc_create_udp ();
+    case CIPC_PROTOCOL_INPROC:
+      return cipc_create_inproc ();
     case CIPC_PROTOCOL_GRPC:
     default:
       return NULL;
@@ -31,3 +58,100 @@ cipc_free (cipc *instance)
       free (instance);
     }
 }
+
+static cipc_err
+collect_ready (cipc *const *instances, size_t count, struct pollfd *fds, int *ready,
+               size_t *nready, int *has_no_fd)
+{
+  *nready = 0;
+  *has_no_fd = 0;
+
+  for (size_t i = 0; i < count; i++)
+    {
+      if (!instances[i] || !instances[i]->get_fd)
+        return CIPC_NULL_PTR;
+
+      int fd = -1;
+      int is_ready = 0;
+
+      cipc_err err = instances[i]->get_fd (instances[i]->context, &fd, &is_ready);
+      if (err != CIPC_OK)
+        return err;
+
+      ready[i] = is_ready != 0;
+      *nready += ready[i];
+
+      // poll ignores negative descriptors.
+      fds[i].fd = fd;
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+
+      if (fd < 0)
+        *has_no_fd = 1;
+    }
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_poll (cipc *const *instances, size_t count, int timeout_ms, int *ready, size_t *nready)
+{
+  if (!instances || !ready || !nready)
+    return CIPC_NULL_PTR;
+
+  // Nothing could ever become ready, so do not wait for it.
+  *nready = 0;
+
+  if (count == 0)
+    return CIPC_OK;
+
+  struct pollfd stack_fds[CIPC_POLL_STACK_FDS];
+  struct pollfd *fds = stack_fds;
+
+  if (count > CIPC_POLL_STACK_FDS)
+    {
+      fds = malloc (count * sizeof (struct pollfd));
+      if (!fds)
+        return CIPC_BAD_ALLOC;
+    }
+
+  int64_t deadline = timeout_ms > 0 ? cipc_monotonic_ms () + timeout_ms : 0;
+  cipc_err err;
+
+  while (1)
+    {
+      int has_no_fd;
+
+      err = collect_ready (instances, count, fds, ready, nready, &has_no_fd);
+      if (err != CIPC_OK || *nready > 0)
+        break;
+
+      int wait_ms = timeout_ms;
+      if (timeout_ms > 0)
+        {
+          int64_t left = deadline - cipc_monotonic_ms ();
+          if (left <= 0)
+            break;
+
+          wait_ms = (int)left;
+        }
+      else if (timeout_ms == 0)
+        break;
+
+      if (has_no_fd && (wait_ms < 0 || wait_ms > CIPC_POLL_NO_FD_SLICE_MS))
+        wait_ms = CIPC_POLL_NO_FD_SLICE_MS;
+
+      // A wakeup only means readiness may have changed; the next pass asks every backend.
+      if (poll (fds, count, wait_ms) < 0 && errno != EINTR)
+        {
+          fprintf (stderr, "Poll failed: %s\n", strerror (errno));
+          err = CIPC_BAD_POLL;
+          break;
+        }
+    }
+
+  if (fds != stack_fds)
+    free (fds);
+
+  return err;
+}
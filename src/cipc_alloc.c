@@ -0,0 +1,283 @@
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cipc_alloc.h"
+
+#define CIPC_ALLOC_MIN_SHIFT 6
+#define CIPC_ALLOC_MAX_SHIFT 20
+#define CIPC_ALLOC_CLASSES (CIPC_ALLOC_MAX_SHIFT - CIPC_ALLOC_MIN_SHIFT + 1)
+#define CIPC_ALLOC_LARGE CIPC_ALLOC_CLASSES
+
+// Bytes a thread keeps per class, and the shared free list per class, before handing blocks on.
+#define CIPC_ALLOC_CACHE_BYTES (256 * 1024)
+#define CIPC_ALLOC_SHARED_BYTES (8 * 1024 * 1024)
+
+typedef struct
+{
+  alignas (16) size_t size;
+  uint32_t size_class;
+} cipc_alloc_header;
+
+// Overlays the payload of a free block.
+typedef struct cipc_alloc_free
+{
+  struct cipc_alloc_free *next;
+} cipc_alloc_free;
+
+typedef struct
+{
+  cipc_alloc_free *head;
+  size_t count;
+} cipc_alloc_bin;
+
+typedef struct
+{
+  cipc_alloc_bin bins[CIPC_ALLOC_CLASSES];
+  int registered;
+} cipc_alloc_cache;
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  cipc_alloc_free *head;
+  size_t count;
+} cipc_alloc_shared;
+
+static _Thread_local cipc_alloc_cache thread_cache;
+
+static cipc_alloc_shared shared[CIPC_ALLOC_CLASSES];
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+
+static size_t
+clamp (size_t value, size_t lo, size_t hi)
+{
+  return value < lo ? lo : value > hi ? hi : value;
+}
+
+static size_t
+cache_cap (uint32_t size_class)
+{
+  return clamp (CIPC_ALLOC_CACHE_BYTES >> (size_class + CIPC_ALLOC_MIN_SHIFT), 4, 256);
+}
+
+static size_t
+shared_cap (uint32_t size_class)
+{
+  return clamp (CIPC_ALLOC_SHARED_BYTES >> (size_class + CIPC_ALLOC_MIN_SHIFT), 16, 4096);
+}
+
+static uint32_t
+class_of (size_t size)
+{
+  if (size > CIPC_ALLOC_MAX_POOLED)
+    return CIPC_ALLOC_LARGE;
+
+  if (size <= ((size_t)1 << CIPC_ALLOC_MIN_SHIFT))
+    return 0;
+
+  return (uint32_t)(64 - __builtin_clzll ((unsigned long long)size - 1)) - CIPC_ALLOC_MIN_SHIFT;
+}
+
+static void
+block_free (cipc_alloc_free *block)
+{
+  free ((cipc_alloc_header *)block - 1);
+}
+
+// Moves up to count blocks of a thread bin to the shared list; what does not fit there is freed.
+static void
+spill (cipc_alloc_bin *bin, uint32_t size_class, size_t count)
+{
+  cipc_alloc_shared *list = &shared[size_class];
+  size_t cap = shared_cap (size_class);
+
+  pthread_mutex_lock (&list->lock);
+
+  for (; count > 0 && bin->head; count--)
+    {
+      cipc_alloc_free *block = bin->head;
+
+      bin->head = block->next;
+      bin->count--;
+
+      if (list->count >= cap)
+        {
+          block_free (block);
+          continue;
+        }
+
+      block->next = list->head;
+      list->head = block;
+      list->count++;
+    }
+
+  pthread_mutex_unlock (&list->lock);
+}
+
+static void
+refill (cipc_alloc_bin *bin, uint32_t size_class)
+{
+  cipc_alloc_shared *list = &shared[size_class];
+  size_t want = cache_cap (size_class) / 2;
+
+  pthread_mutex_lock (&list->lock);
+
+  for (; want > 0 && list->head; want--)
+    {
+      cipc_alloc_free *block = list->head;
+
+      list->head = block->next;
+      list->count--;
+
+      block->next = bin->head;
+      bin->head = block;
+      bin->count++;
+    }
+
+  pthread_mutex_unlock (&list->lock);
+}
+
+// A thread leaving hands its cache to the others.
+static void
+cache_release (void *arg)
+{
+  cipc_alloc_cache *cache = arg;
+
+  for (uint32_t size_class = 0; size_class < CIPC_ALLOC_CLASSES; size_class++)
+    spill (&cache->bins[size_class], size_class, SIZE_MAX);
+
+  cache->registered = 0;
+}
+
+static void
+init_shared (void)
+{
+  for (uint32_t size_class = 0; size_class < CIPC_ALLOC_CLASSES; size_class++)
+    pthread_mutex_init (&shared[size_class].lock, NULL);
+
+  pthread_key_create (&cache_key, cache_release);
+}
+
+static cipc_alloc_cache *
+cache_get (void)
+{
+  cipc_alloc_cache *cache = &thread_cache;
+
+  if (!cache->registered)
+    {
+      pthread_once (&init_once, init_shared);
+      pthread_setspecific (cache_key, cache);
+
+      cache->registered = 1;
+    }
+
+  return cache;
+}
+
+void *
+cipc_alloc (size_t size)
+{
+  uint32_t size_class = class_of (size);
+
+  if (size_class == CIPC_ALLOC_LARGE)
+    {
+      cipc_alloc_header *header = malloc (sizeof (cipc_alloc_header) + size);
+      if (!header)
+        return NULL;
+
+      header->size = size;
+      header->size_class = CIPC_ALLOC_LARGE;
+
+      return header + 1;
+    }
+
+  cipc_alloc_bin *bin = &cache_get ()->bins[size_class];
+
+  if (!bin->head)
+    refill (bin, size_class);
+
+  if (bin->head)
+    {
+      cipc_alloc_free *block = bin->head;
+
+      bin->head = block->next;
+      bin->count--;
+
+      return block;
+    }
+
+  size_t block_size = (size_t)1 << (size_class + CIPC_ALLOC_MIN_SHIFT);
+
+  cipc_alloc_header *header = malloc (sizeof (cipc_alloc_header) + block_size);
+  if (!header)
+    return NULL;
+
+  header->size = block_size;
+  header->size_class = size_class;
+
+  return header + 1;
+}
+
+void
+cipc_dealloc (void *ptr)
+{
+  if (!ptr)
+    return;
+
+  cipc_alloc_header *header = (cipc_alloc_header *)ptr - 1;
+
+  if (header->size_class == CIPC_ALLOC_LARGE)
+    {
+      free (header);
+      return;
+    }
+
+  uint32_t size_class = header->size_class;
+  cipc_alloc_bin *bin = &cache_get ()->bins[size_class];
+  cipc_alloc_free *block = ptr;
+
+  block->next = bin->head;
+  bin->head = block;
+  bin->count++;
+
+  if (bin->count > cache_cap (size_class))
+    spill (bin, size_class, bin->count / 2);
+}
+
+size_t
+cipc_alloc_usable (const void *ptr)
+{
+  return ((const cipc_alloc_header *)ptr - 1)->size;
+}
+
+void
+cipc_alloc_trim (void)
+{
+  pthread_once (&init_once, init_shared);
+
+  for (uint32_t size_class = 0; size_class < CIPC_ALLOC_CLASSES; size_class++)
+    {
+      cipc_alloc_shared *list = &shared[size_class];
+
+      pthread_mutex_lock (&list->lock);
+
+      cipc_alloc_free *block = list->head;
+
+      list->head = NULL;
+      list->count = 0;
+
+      pthread_mutex_unlock (&list->lock);
+
+      while (block)
+        {
+          cipc_alloc_free *next = block->next;
+
+          block_free (block);
+          block = next;
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef CIPC_ALLOC_H
+#define CIPC_ALLOC_H
+
+#include <stddef.h>
+
+// Size-classed allocator behind cipc_buf and the library's per-message allocations. Blocks of
+// up to CIPC_ALLOC_MAX_POOLED bytes are recycled through a per-thread cache, refilled from and
+// spilled to a locked free list per class; larger ones go straight to malloc. A block may be
+// freed on any thread.
+
+#define CIPC_ALLOC_MAX_POOLED (1024 * 1024)
+
+void *cipc_alloc (size_t size);
+void cipc_dealloc (void *ptr);
+
+// Usable size of a block, at least the size it was allocated with.
+size_t cipc_alloc_usable (const void *ptr);
+
+// Frees the blocks held in the shared free lists.
+void cipc_alloc_trim (void);
+
+#endif // CIPC_ALLOC_H
@@ -0,0 +1,550 @@
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zmq.h>
+
+#include "backend/cipc_shm.h"
+#include "backend/cipc_tcp.h"
+#include "backend/cipc_unix.h"
+#include "backend/cipc_zmq.h"
+#include "cipc.h"
+#include "cipc_histogram.h"
+
+#define BENCH_DEFAULT_MIN_SIZE 16
+#define BENCH_DEFAULT_MAX_SIZE (16 * 1024 * 1024)
+#define BENCH_DEFAULT_ITERATIONS 10000
+#define BENCH_DEFAULT_MESSAGES 100000
+#define BENCH_DEFAULT_PORT 7100
+#define BENCH_SIZE_STEP 4
+#define BENCH_TIMEOUT_MS 30000
+#define BENCH_CONNECT_RETRIES 10
+
+// Per-size byte budgets keep large messages from running for minutes; counts never drop below
+// BENCH_MIN_COUNT.
+#define BENCH_LATENCY_BUDGET (256ull * 1024 * 1024)
+#define BENCH_THROUGHPUT_BUDGET (1024ull * 1024 * 1024)
+#define BENCH_MIN_COUNT 20
+
+typedef enum
+{
+  BENCH_TEST_LATENCY,
+  BENCH_TEST_THROUGHPUT
+} bench_test;
+
+typedef struct
+{
+  union
+  {
+    cipc_zmq_config zmq;
+    cipc_tcp_config tcp;
+    cipc_shm_config shm;
+    cipc_unix_config unix_socket;
+  } cfg;
+
+  char address[64];
+} bench_config;
+
+typedef struct
+{
+  const char *name;
+  cipc_protocol protocol;
+
+  // Describes one side of a link; the server side is initialized first.
+  void (*configure) (bench_config *config, int server, bench_test test, size_t size, int port);
+} bench_backend;
+
+typedef struct
+{
+  const bench_backend *backend;
+  bench_test test;
+  size_t size;
+  size_t count;
+  size_t warmup;
+  int port;
+
+  cipc_err err;
+} bench_run;
+
+typedef struct
+{
+  const char *backend;
+  bench_test test;
+  size_t size;
+  size_t count;
+
+  double seconds;
+  cipc_histogram histogram;
+} bench_result;
+
+static void
+configure_zmq (bench_config *config, int server, bench_test test, size_t size, int port)
+{
+  (void)size;
+
+  snprintf (config->address, sizeof (config->address), "tcp://127.0.0.1:%d", port);
+
+  cipc_zmq_config *cfg = &config->cfg.zmq;
+  cfg->address = config->address;
+  cfg->mode = server ? CIPC_ZMQ_MODE_BIND : CIPC_ZMQ_MODE_CONNECT;
+
+  if (test == BENCH_TEST_LATENCY)
+    cfg->socket_type = server ? ZMQ_REP : ZMQ_REQ;
+  else
+    cfg->socket_type = ZMQ_PAIR;
+
+  cfg->sockopt_sndtimeo = BENCH_TIMEOUT_MS;
+  cfg->sockopt_rcvtimeo = BENCH_TIMEOUT_MS;
+  cfg->sockopt_retries = BENCH_CONNECT_RETRIES;
+}
+
+static void
+configure_tcp (bench_config *config, int server, bench_test test, size_t size, int port)
+{
+  (void)test;
+  (void)size;
+
+  cipc_tcp_config *cfg = &config->cfg.tcp;
+  cfg->host = "127.0.0.1";
+  cfg->port = port;
+  cfg->mode = server ? CIPC_TCP_MODE_BIND : CIPC_TCP_MODE_CONNECT;
+  cfg->backlog = 1;
+  cfg->framing = CIPC_TCP_FRAMING_LENGTH_PREFIX;
+  cfg->sockopt_sndtimeo = BENCH_TIMEOUT_MS;
+  cfg->sockopt_rcvtimeo = BENCH_TIMEOUT_MS;
+  cfg->sockopt_retries = BENCH_CONNECT_RETRIES;
+}
+
+static void
+configure_shm (bench_config *config, int server, bench_test test, size_t size, int port)
+{
+  (void)test;
+
+  snprintf (config->address, sizeof (config->address), "/cipc-bench-%d-%d", (int)getpid (), port);
+
+  cipc_shm_config *cfg = &config->cfg.shm;
+  cfg->name = config->address;
+  cfg->mode = server ? CIPC_SHM_MODE_BIND : CIPC_SHM_MODE_CONNECT;
+  // A message may use at most half of the ring; leave room to pipeline a few.
+  cfg->capacity = size * 4 > CIPC_SHM_DEFAULT_CAPACITY ? size * 4 : CIPC_SHM_DEFAULT_CAPACITY;
+  cfg->sockopt_sndtimeo = BENCH_TIMEOUT_MS;
+  cfg->sockopt_rcvtimeo = BENCH_TIMEOUT_MS;
+  cfg->sockopt_retries = BENCH_CONNECT_RETRIES;
+}
+
+static void
+configure_unix (bench_config *config, int server, bench_test test, size_t size, int port)
+{
+  (void)test;
+  (void)size;
+
+  snprintf (config->address, sizeof (config->address), "@cipc-bench-%d-%d", (int)getpid (), port);
+
+  cipc_unix_config *cfg = &config->cfg.unix_socket;
+  cfg->path = config->address;
+  cfg->mode = server ? CIPC_UNIX_MODE_BIND : CIPC_UNIX_MODE_CONNECT;
+  cfg->backlog = 1;
+  cfg->sockopt_sndtimeo = BENCH_TIMEOUT_MS;
+  cfg->sockopt_rcvtimeo = BENCH_TIMEOUT_MS;
+  cfg->sockopt_retries = BENCH_CONNECT_RETRIES;
+}
+
+static const bench_backend bench_backends[] = {
+  { "zmq", CIPC_PROTOCOL_ZMQ, configure_zmq },
+  { "tcp", CIPC_PROTOCOL_TCP, configure_tcp },
+  { "shm", CIPC_PROTOCOL_SHM, configure_shm },
+  { "unix", CIPC_PROTOCOL_UNIX, configure_unix },
+};
+
+#define BENCH_BACKEND_COUNT (sizeof (bench_backends) / sizeof (bench_backends[0]))
+
+static uint64_t
+now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static cipc_err
+bench_open (const bench_run *run, int server, cipc **out)
+{
+  bench_config config;
+  memset (&config, 0, sizeof (config));
+
+  run->backend->configure (&config, server, run->test, run->size, run->port);
+
+  cipc *instance = cipc_create (run->backend->protocol);
+  if (!instance)
+    return CIPC_BAD_ALLOC;
+
+  cipc_err err = instance->init (&instance->context, &config.cfg);
+  if (err != CIPC_OK)
+    {
+      instance->context = NULL;
+      cipc_free (instance);
+
+      return err;
+    }
+
+  *out = instance;
+
+  return CIPC_OK;
+}
+
+// Echo peer for latency runs, sink for throughput runs.
+static void *
+bench_server (void *arg)
+{
+  bench_run *run = arg;
+  cipc *server = NULL;
+
+  run->err = bench_open (run, 1, &server);
+  if (run->err != CIPC_OK)
+    return NULL;
+
+  // recv appends a terminating NUL, so leave room for it.
+  char *buffer = malloc (run->size + 1);
+  if (!buffer)
+    {
+      run->err = CIPC_BAD_ALLOC;
+      cipc_free (server);
+
+      return NULL;
+    }
+
+  size_t total = run->count + run->warmup;
+  size_t length;
+
+  for (size_t i = 0; i < total && run->err == CIPC_OK; i++)
+    {
+      run->err = server->recv (server->context, buffer, run->size + 1, &length);
+
+      if (run->err == CIPC_OK && run->test == BENCH_TEST_LATENCY)
+        run->err = server->send (server->context, buffer, length);
+    }
+
+  if (run->err == CIPC_OK && run->test == BENCH_TEST_THROUGHPUT)
+    run->err = server->send (server->context, "", 1);
+
+  free (buffer);
+  cipc_free (server);
+
+  return NULL;
+}
+
+static cipc_err
+bench_client (const bench_run *run, bench_result *result)
+{
+  cipc *client = NULL;
+
+  cipc_err err = bench_open (run, 0, &client);
+  if (err != CIPC_OK)
+    return err;
+
+  char *buffer = malloc (run->size + 1);
+  if (!buffer)
+    {
+      cipc_free (client);
+      return CIPC_BAD_ALLOC;
+    }
+
+  memset (buffer, 'x', run->size);
+
+  size_t length;
+  uint64_t start = 0;
+
+  for (size_t i = 0; i < run->warmup + run->count && err == CIPC_OK; i++)
+    {
+      if (i == run->warmup)
+        start = now_ns ();
+
+      uint64_t t0 = now_ns ();
+
+      err = client->send (client->context, buffer, run->size);
+
+      if (err == CIPC_OK && run->test == BENCH_TEST_LATENCY)
+        err = client->recv (client->context, buffer, run->size + 1, &length);
+
+      if (i >= run->warmup)
+        cipc_histogram_record (&result->histogram, now_ns () - t0);
+    }
+
+  // The sink acknowledges once everything has been received.
+  if (err == CIPC_OK && run->test == BENCH_TEST_THROUGHPUT)
+    err = client->recv (client->context, buffer, run->size + 1, &length);
+
+  result->seconds = (double)(now_ns () - start) / 1e9;
+
+  free (buffer);
+  cipc_free (client);
+
+  return err;
+}
+
+static cipc_err
+bench_execute (bench_run *run, bench_result *result)
+{
+  pthread_t thread;
+
+  run->err = CIPC_OK;
+
+  if (pthread_create (&thread, NULL, bench_server, run) != 0)
+    return CIPC_BAD_ALLOC;
+
+  cipc_err err = bench_client (run, result);
+
+  pthread_join (thread, NULL);
+
+  return err != CIPC_OK ? err : run->err;
+}
+
+static void
+print_result (const bench_result *result, int json, int first)
+{
+  const cipc_histogram *h = &result->histogram;
+
+  double msgs_per_sec = result->seconds > 0 ? (double)result->count / result->seconds : 0.0;
+  // A round trip carries the payload twice.
+  double bytes = (double)result->size * (double)result->count
+                 * (result->test == BENCH_TEST_LATENCY ? 2.0 : 1.0);
+  double gb_per_sec = result->seconds > 0 ? bytes / result->seconds / 1e9 : 0.0;
+
+  const char *test = result->test == BENCH_TEST_LATENCY ? "latency" : "throughput";
+
+  if (json)
+    {
+      printf ("%s\n    {\"backend\": \"%s\", \"test\": \"%s\", \"size\": %zu, \"count\": %zu, "
+              "\"seconds\": %.6f, \"min_ns\": %llu, \"mean_ns\": %.1f, \"p50_ns\": %llu, "
+              "\"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu, \"msgs_per_sec\": %.1f, "
+              "\"gb_per_sec\": %.6f}",
+              first ? "" : ",", result->backend, test, result->size, result->count,
+              result->seconds, (unsigned long long)h->min, cipc_histogram_mean (h),
+              (unsigned long long)cipc_histogram_percentile (h, 50.0),
+              (unsigned long long)cipc_histogram_percentile (h, 99.0),
+              (unsigned long long)cipc_histogram_percentile (h, 99.9),
+              (unsigned long long)h->max, msgs_per_sec, gb_per_sec);
+      return;
+    }
+
+  printf ("%-6s %-10s %10zu %8zu %10.2f %10.2f %10.2f %10.2f %12.0f %8.3f\n", result->backend, test,
+          result->size, result->count, cipc_histogram_percentile (h, 50.0) / 1e3,
+          cipc_histogram_percentile (h, 99.0) / 1e3, cipc_histogram_percentile (h, 99.9) / 1e3,
+          h->max / 1e3, msgs_per_sec, gb_per_sec);
+}
+
+static size_t
+parse_size (const char *text)
+{
+  char *end;
+  unsigned long long value = strtoull (text, &end, 10);
+
+  switch (*end)
+    {
+    case 'k':
+    case 'K':
+      value *= 1024;
+      break;
+    case 'm':
+    case 'M':
+      value *= 1024 * 1024;
+      break;
+    case 'g':
+    case 'G':
+      value *= 1024 * 1024 * 1024;
+      break;
+    default:
+      break;
+    }
+
+  return (size_t)value;
+}
+
+static size_t
+scaled_count (size_t requested, size_t size, unsigned long long budget)
+{
+  size_t limit = (size_t)(budget / size);
+  if (limit < BENCH_MIN_COUNT)
+    limit = BENCH_MIN_COUNT;
+
+  return requested < limit ? requested : limit;
+}
+
+static void
+usage (const char *program)
+{
+  fprintf (stderr,
+           "Usage: %s [options]\n"
+           "\n"
+           "Ping-pong latency and one-way streaming throughput for every cipc backend.\n"
+           "Latency percentiles are per round trip; throughput percentiles are per send call.\n"
+           "\n"
+           "  -b, --backend NAME     backend to run, repeatable (zmq, tcp, shm, unix; default all)\n"
+           "  -t, --test NAME        latency, throughput or all (default all)\n"
+           "  -s, --min-size BYTES   smallest message size, K/M/G suffixes allowed (default 16)\n"
+           "  -S, --max-size BYTES   largest message size (default 16M); sizes step by x%d\n"
+           "  -n, --iterations N     round trips per latency run (default %d)\n"
+           "  -m, --messages N       messages per throughput run (default %d)\n"
+           "  -p, --port PORT        first port for socket backends (default %d)\n"
+           "  -j, --json             print results as JSON\n"
+           "  -h, --help             show this help\n",
+           program, BENCH_SIZE_STEP, BENCH_DEFAULT_ITERATIONS, BENCH_DEFAULT_MESSAGES,
+           BENCH_DEFAULT_PORT);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const struct option options[] = {
+    { "backend", required_argument, NULL, 'b' },  { "test", required_argument, NULL, 't' },
+    { "min-size", required_argument, NULL, 's' }, { "max-size", required_argument, NULL, 'S' },
+    { "iterations", required_argument, NULL, 'n' }, { "messages", required_argument, NULL, 'm' },
+    { "port", required_argument, NULL, 'p' },     { "json", no_argument, NULL, 'j' },
+    { "help", no_argument, NULL, 'h' },           { NULL, 0, NULL, 0 }
+  };
+
+  int selected[BENCH_BACKEND_COUNT] = { 0 };
+  int any_selected = 0;
+  int run_latency = 1;
+  int run_throughput = 1;
+  size_t min_size = BENCH_DEFAULT_MIN_SIZE;
+  size_t max_size = BENCH_DEFAULT_MAX_SIZE;
+  size_t iterations = BENCH_DEFAULT_ITERATIONS;
+  size_t messages = BENCH_DEFAULT_MESSAGES;
+  int port = BENCH_DEFAULT_PORT;
+  int json = 0;
+
+  int opt;
+  while ((opt = getopt_long (argc, argv, "b:t:s:S:n:m:p:jh", options, NULL)) != -1)
+    {
+      switch (opt)
+        {
+        case 'b':
+          {
+            size_t i;
+            for (i = 0; i < BENCH_BACKEND_COUNT; i++)
+              if (strcmp (optarg, bench_backends[i].name) == 0)
+                break;
+
+            if (i == BENCH_BACKEND_COUNT)
+              {
+                fprintf (stderr, "Unknown backend: %s\n", optarg);
+                return EXIT_FAILURE;
+              }
+
+            selected[i] = 1;
+            any_selected = 1;
+            break;
+          }
+        case 't':
+          run_latency = strcmp (optarg, "throughput") != 0;
+          run_throughput = strcmp (optarg, "latency") != 0;
+          break;
+        case 's':
+          min_size = parse_size (optarg);
+          break;
+        case 'S':
+          max_size = parse_size (optarg);
+          break;
+        case 'n':
+          iterations = parse_size (optarg);
+          break;
+        case 'm':
+          messages = parse_size (optarg);
+          break;
+        case 'p':
+          port = atoi (optarg);
+          break;
+        case 'j':
+          json = 1;
+          break;
+        case 'h':
+          usage (argv[0]);
+          return EXIT_SUCCESS;
+        default:
+          usage (argv[0]);
+          return EXIT_FAILURE;
+        }
+    }
+
+  if (min_size == 0 || max_size < min_size || iterations == 0 || messages == 0)
+    {
+      usage (argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  bench_result *result = malloc (sizeof (bench_result));
+  if (!result)
+    return EXIT_FAILURE;
+
+  if (json)
+    printf ("{\n  \"results\": [");
+  else
+    printf ("%-6s %-10s %10s %8s %10s %10s %10s %10s %12s %8s\n", "bknd", "test", "size", "count",
+            "p50_us", "p99_us", "p99.9_us", "max_us", "msgs/s", "GB/s");
+
+  int failures = 0;
+  int first = 1;
+
+  for (size_t b = 0; b < BENCH_BACKEND_COUNT; b++)
+    {
+      if (any_selected && !selected[b])
+        continue;
+
+      for (int t = 0; t < 2; t++)
+        {
+          bench_test test = t == 0 ? BENCH_TEST_LATENCY : BENCH_TEST_THROUGHPUT;
+          if ((test == BENCH_TEST_LATENCY && !run_latency)
+              || (test == BENCH_TEST_THROUGHPUT && !run_throughput))
+            continue;
+
+          for (size_t size = min_size; size <= max_size; size *= BENCH_SIZE_STEP)
+            {
+              bench_run run = { .backend = &bench_backends[b], .test = test, .size = size };
+
+              if (test == BENCH_TEST_LATENCY)
+                run.count = scaled_count (iterations, size, BENCH_LATENCY_BUDGET);
+              else
+                run.count = scaled_count (messages, size, BENCH_THROUGHPUT_BUDGET);
+
+              run.warmup = run.count / 10;
+              // Every link gets a fresh port so sockets in TIME_WAIT never collide.
+              run.port = port++;
+
+              memset (result, 0, sizeof (bench_result));
+              cipc_histogram_reset (&result->histogram);
+
+              result->backend = run.backend->name;
+              result->test = test;
+              result->size = size;
+              result->count = run.count;
+
+              cipc_err err = bench_execute (&run, result);
+              if (err != CIPC_OK)
+                {
+                  fprintf (stderr, "%s %s %zu bytes failed: error %d\n", run.backend->name,
+                           test == BENCH_TEST_LATENCY ? "latency" : "throughput", size, err);
+                  failures++;
+                  continue;
+                }
+
+              print_result (result, json, first);
+              fflush (stdout);
+
+              first = 0;
+            }
+        }
+    }
+
+  if (json)
+    printf ("\n  ],\n  \"failures\": %d\n}\n", failures);
+
+  free (result);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
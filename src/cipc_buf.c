@@ -0,0 +1,97 @@
+#include <string.h>
+
+#include "cipc.h"
+#include "cipc_alloc.h"
+#include "cipc_buf.h"
+
+cipc_buf *
+cipc_buf_alloc (size_t capacity)
+{
+  cipc_buf *buf = cipc_alloc (sizeof (cipc_buf) + capacity);
+  if (!buf)
+    return NULL;
+
+  buf->data = (char *)(buf + 1);
+  buf->length = 0;
+  // The size class usually leaves room to spare; it is handed out rather than wasted.
+  buf->capacity = cipc_alloc_usable (buf) - sizeof (cipc_buf);
+  buf->refs = 1;
+
+  return buf;
+}
+
+cipc_buf *
+cipc_buf_ref (cipc_buf *buf)
+{
+  __atomic_fetch_add (&buf->refs, 1, __ATOMIC_RELAXED);
+
+  return buf;
+}
+
+void
+cipc_buf_unref (cipc_buf *buf)
+{
+  if (buf && __atomic_fetch_sub (&buf->refs, 1, __ATOMIC_ACQ_REL) == 1)
+    cipc_dealloc (buf);
+}
+
+cipc_err
+cipc_buf_send (cipc *instance, const cipc_buf *buf)
+{
+  if (!instance || !buf)
+    return CIPC_NULL_PTR;
+
+  // The receiver gets this very buffer, with a reference of its own.
+  if (instance->send_buf)
+    return instance->send_buf (instance->context, cipc_buf_ref ((cipc_buf *)buf));
+
+  return instance->send (instance->context, buf->data, buf->length);
+}
+
+cipc_err
+cipc_buf_send_to (cipc *instance, cipc_peer_id peer, const cipc_buf *buf)
+{
+  if (!instance || !buf)
+    return CIPC_NULL_PTR;
+
+  if (!instance->send_to)
+    return CIPC_BAD_PEER;
+
+  return instance->send_to (instance->context, peer, buf->data, buf->length);
+}
+
+cipc_err
+cipc_buf_recv (cipc *instance, cipc_buf **buf)
+{
+  if (!instance || !buf)
+    return CIPC_NULL_PTR;
+
+  if (instance->recv_buf)
+    return instance->recv_buf (instance->context, buf);
+
+  // The borrowed view gives the exact size before anything is copied.
+  cipc_msg msg;
+  cipc_err err = instance->recv_msg (instance->context, &msg);
+  if (err != CIPC_OK)
+    return err;
+
+  *buf = cipc_buf_alloc (msg.length);
+  if (!*buf)
+    {
+      instance->release_msg (instance->context, &msg);
+      return CIPC_BAD_ALLOC;
+    }
+
+  memcpy ((*buf)->data, msg.data, msg.length);
+  (*buf)->length = msg.length;
+
+  instance->release_msg (instance->context, &msg);
+
+  return CIPC_OK;
+}
+
+void
+cipc_buf_trim (void)
+{
+  cipc_alloc_trim ();
+}
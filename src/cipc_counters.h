@@ -0,0 +1,105 @@
+#ifndef CIPC_COUNTERS_H
+#define CIPC_COUNTERS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "cipc.h"
+#include "cipc_histogram.h"
+#include "cipc_internal.h"
+#include "cipc_stats.h"
+
+// Live counters behind cipc_stats. Every backend embeds one per instance. The send side and the
+// receive side each have a single writer at a time (the same rule as for the instance), so
+// updates are plain relaxed load/store pairs rather than locked read-modify-writes; readers on
+// other threads see each value untorn.
+
+typedef _Atomic uint64_t cipc_counter;
+
+struct cipc_counters
+{
+  cipc_counter msgs_sent;
+  cipc_counter bytes_sent;
+  cipc_counter send_syscalls;
+  cipc_counter short_writes;
+  cipc_counter send_timeouts;
+  cipc_counter send_errors;
+
+  cipc_counter msgs_received;
+  cipc_counter bytes_received;
+  cipc_counter recv_syscalls;
+  cipc_counter short_reads;
+  cipc_counter recv_timeouts;
+  cipc_counter recv_errors;
+
+  cipc_counter reconnects;
+  cipc_counter msgs_lost;
+
+  // Allocated on first enable and kept until destroy, so a writer never sees them freed.
+  atomic_int latency_enabled;
+  _Atomic (cipc_histogram *) send_latency;
+  _Atomic (cipc_histogram *) recv_latency;
+};
+
+void cipc_counters_init (cipc_counters *counters);
+void cipc_counters_destroy (cipc_counters *counters);
+
+cipc_err cipc_counters_enable_latency (cipc_counters *counters, int enable);
+void cipc_counters_snapshot (const cipc_counters *counters, cipc_stats *out);
+
+void cipc_counters_record_latency (_Atomic (cipc_histogram *) *histogram, uint64_t start);
+
+static inline void
+cipc_counter_add (cipc_counter *counter, uint64_t value)
+{
+  atomic_store_explicit (counter, atomic_load_explicit (counter, memory_order_relaxed) + value,
+                         memory_order_relaxed);
+}
+
+// Start of a timed call; 0 when latency is not being recorded.
+static inline uint64_t
+cipc_counters_start (const cipc_counters *counters)
+{
+  if (!atomic_load_explicit (&counters->latency_enabled, memory_order_relaxed))
+    return 0;
+
+  return (uint64_t)cipc_monotonic_ns ();
+}
+
+// Accounts for the outcome of a send call that started at start.
+static inline void
+cipc_counters_sent (cipc_counters *counters, cipc_err err, uint64_t msgs, uint64_t bytes,
+                    uint64_t start)
+{
+  if (msgs > 0)
+    {
+      cipc_counter_add (&counters->msgs_sent, msgs);
+      cipc_counter_add (&counters->bytes_sent, bytes);
+    }
+
+  if (err != CIPC_OK)
+    cipc_counter_add (&counters->send_errors, 1);
+
+  if (start)
+    cipc_counters_record_latency (&counters->send_latency, start);
+}
+
+static inline void
+cipc_counters_received (cipc_counters *counters, cipc_err err, uint64_t msgs, uint64_t bytes,
+                        uint64_t start)
+{
+  if (msgs > 0)
+    {
+      cipc_counter_add (&counters->msgs_received, msgs);
+      cipc_counter_add (&counters->bytes_received, bytes);
+    }
+
+  // A frame left queued for a larger buffer is not a failure of the link.
+  if (err != CIPC_OK && err != CIPC_BAD_BUFFER_SIZE && err != CIPC_WOULD_BLOCK)
+    cipc_counter_add (&counters->recv_errors, 1);
+
+  if (start)
+    cipc_counters_record_latency (&counters->recv_latency, start);
+}
+
+#endif // CIPC_COUNTERS_H
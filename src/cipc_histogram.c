@@ -0,0 +1,112 @@
+#include <string.h>
+
+#include "cipc_histogram.h"
+
+#define CIPC_HISTOGRAM_SUB_COUNT (1u << CIPC_HISTOGRAM_SUB_BITS)
+
+void
+cipc_histogram_reset (cipc_histogram *histogram)
+{
+  memset (histogram, 0, sizeof (cipc_histogram));
+
+  histogram->min = UINT64_MAX;
+}
+
+size_t
+cipc_histogram_bucket_index (uint64_t value)
+{
+  if (value < CIPC_HISTOGRAM_SUB_COUNT)
+    return (size_t)value;
+
+  unsigned int exponent = 63 - __builtin_clzll (value);
+  unsigned int shift = exponent - CIPC_HISTOGRAM_SUB_BITS;
+
+  return ((size_t)(shift + 1) << CIPC_HISTOGRAM_SUB_BITS)
+         + (size_t)((value >> shift) - CIPC_HISTOGRAM_SUB_COUNT);
+}
+
+uint64_t
+cipc_histogram_bucket_upper (size_t index)
+{
+  if (index < CIPC_HISTOGRAM_SUB_COUNT)
+    return index;
+
+  unsigned int shift = (unsigned int)(index >> CIPC_HISTOGRAM_SUB_BITS) - 1;
+  uint64_t sub = CIPC_HISTOGRAM_SUB_COUNT + (index & (CIPC_HISTOGRAM_SUB_COUNT - 1));
+
+  // Highest value that maps to this bucket; the top bucket ends at UINT64_MAX.
+  if (shift + CIPC_HISTOGRAM_SUB_BITS >= 63 && sub == 2 * CIPC_HISTOGRAM_SUB_COUNT - 1)
+    return UINT64_MAX;
+
+  return ((sub + 1) << shift) - 1;
+}
+
+void
+cipc_histogram_record (cipc_histogram *histogram, uint64_t value)
+{
+  histogram->buckets[cipc_histogram_bucket_index (value)]++;
+  histogram->count++;
+  histogram->sum += value;
+
+  if (value < histogram->min)
+    histogram->min = value;
+
+  if (value > histogram->max)
+    histogram->max = value;
+}
+
+void
+cipc_histogram_merge (cipc_histogram *dst, const cipc_histogram *src)
+{
+  for (size_t i = 0; i < CIPC_HISTOGRAM_BUCKETS; i++)
+    dst->buckets[i] += src->buckets[i];
+
+  dst->count += src->count;
+  dst->sum += src->sum;
+
+  if (src->min < dst->min)
+    dst->min = src->min;
+
+  if (src->max > dst->max)
+    dst->max = src->max;
+}
+
+uint64_t
+cipc_histogram_percentile (const cipc_histogram *histogram, double percentile)
+{
+  if (histogram->count == 0)
+    return 0;
+
+  if (percentile >= 100.0)
+    return histogram->max;
+
+  uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->count);
+  if (rank < 1)
+    rank = 1;
+
+  uint64_t seen = 0;
+
+  for (size_t i = 0; i < CIPC_HISTOGRAM_BUCKETS; i++)
+    {
+      seen += histogram->buckets[i];
+
+      if (seen >= rank)
+        {
+          uint64_t upper = cipc_histogram_bucket_upper (i);
+
+          // Bucket bounds may overshoot the extremes that were actually seen.
+          if (upper > histogram->max)
+            upper = histogram->max;
+
+          return upper < histogram->min ? histogram->min : upper;
+        }
+    }
+
+  return histogram->max;
+}
+
+double
+cipc_histogram_mean (const cipc_histogram *histogram)
+{
+  return histogram->count ? (double)histogram->sum / (double)histogram->count : 0.0;
+}
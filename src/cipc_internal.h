@@ -0,0 +1,110 @@
+#ifndef CIPC_INTERNAL_H
+#define CIPC_INTERNAL_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Small helpers shared by the backends: clocks, CPU pauses for spin loops, eventfd wakeups and
+// condition variables timed on CLOCK_MONOTONIC.
+
+static inline int64_t
+cipc_monotonic_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline int64_t
+cipc_monotonic_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static inline void
+cipc_cpu_relax (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause ();
+#elif defined(__aarch64__)
+  __asm__ volatile ("yield");
+#endif
+}
+
+// Adds one to an eventfd. A full counter (EAGAIN) already means a pending wakeup.
+static inline void
+cipc_signal_fd (int fd)
+{
+  uint64_t one = 1;
+
+  while (write (fd, &one, sizeof (one)) < 0)
+    {
+      if (errno != EINTR)
+        {
+          if (errno != EAGAIN)
+            fprintf (stderr, "eventfd write failed: %s\n", strerror (errno));
+
+          break;
+        }
+    }
+}
+
+// Resets a non-blocking eventfd; EAGAIN means it was not signalled.
+static inline void
+cipc_drain_fd (int fd)
+{
+  uint64_t value;
+
+  while (read (fd, &value, sizeof (value)) < 0)
+    {
+      if (errno != EINTR)
+        {
+          if (errno != EAGAIN)
+            fprintf (stderr, "eventfd read failed: %s\n", strerror (errno));
+
+          break;
+        }
+    }
+}
+
+// The CLOCK_MONOTONIC time timeout_ms from now, for a condition from cipc_cond_init.
+static inline void
+cipc_deadline_after (struct timespec *ts, int timeout_ms)
+{
+  clock_gettime (CLOCK_MONOTONIC, ts);
+
+  ts->tv_sec += timeout_ms / 1000;
+  ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+
+  if (ts->tv_nsec >= 1000000000)
+    {
+      ts->tv_sec++;
+      ts->tv_nsec -= 1000000000;
+    }
+}
+
+// A condition variable whose timed waits use CLOCK_MONOTONIC.
+static inline int
+cipc_cond_init (pthread_cond_t *cond)
+{
+  pthread_condattr_t attr;
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+
+  int rc = pthread_cond_init (cond, &attr);
+
+  pthread_condattr_destroy (&attr);
+
+  return rc;
+}
+
+#endif // CIPC_INTERNAL_H
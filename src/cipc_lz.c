@@ -0,0 +1,260 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "cipc_lz.h"
+
+#define CIPC_LZ_HASH_BITS 12
+#define CIPC_LZ_MIN_MATCH 4
+#define CIPC_LZ_MAX_OFFSET 65535
+// Bytes at the end of the input always emitted as literals, so a match search never reads past it.
+#define CIPC_LZ_LAST_LITERALS 5
+// Token nibble value announcing a length continuation.
+#define CIPC_LZ_RUN_MASK 15
+
+static uint32_t
+read32 (const unsigned char *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof (v));
+
+  return v;
+}
+
+static uint64_t
+read64 (const unsigned char *p)
+{
+  uint64_t v;
+  memcpy (&v, p, sizeof (v));
+
+  return v;
+}
+
+// Length of the common prefix of a and b, no longer than limit - b.
+static size_t
+common_length (const unsigned char *a, const unsigned char *b, const unsigned char *limit)
+{
+  const unsigned char *start = b;
+
+  while (limit - b >= 8)
+    {
+      uint64_t diff = read64 (a) ^ read64 (b);
+      if (diff)
+        return (size_t)(b - start)
+               + (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? __builtin_ctzll (diff)
+                                                             : __builtin_clzll (diff))
+                     / 8;
+
+      a += 8;
+      b += 8;
+    }
+
+  while (b < limit && *a == *b)
+    {
+      a++;
+      b++;
+    }
+
+  return (size_t)(b - start);
+}
+
+static uint32_t
+hash32 (uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - CIPC_LZ_HASH_BITS);
+}
+
+// A length continuation is a run of 255s closed by a smaller byte.
+static unsigned char *
+put_length (unsigned char *op, const unsigned char *oend, size_t n)
+{
+  for (; n >= 255; n -= 255)
+    {
+      if (op >= oend)
+        return NULL;
+
+      *op++ = 255;
+    }
+
+  if (op >= oend)
+    return NULL;
+
+  *op++ = (unsigned char)n;
+
+  return op;
+}
+
+// Emits one sequence; match_len 0 closes the block with literals only.
+static unsigned char *
+put_sequence (unsigned char *op, const unsigned char *oend, const unsigned char *literals,
+              size_t lit_len, size_t offset, size_t match_len)
+{
+  if (op >= oend)
+    return NULL;
+
+  unsigned char *token = op++;
+  *token = (unsigned char)((lit_len < CIPC_LZ_RUN_MASK ? lit_len : CIPC_LZ_RUN_MASK) << 4);
+
+  if (lit_len >= CIPC_LZ_RUN_MASK && !(op = put_length (op, oend, lit_len - CIPC_LZ_RUN_MASK)))
+    return NULL;
+
+  if ((size_t)(oend - op) < lit_len)
+    return NULL;
+
+  memcpy (op, literals, lit_len);
+  op += lit_len;
+
+  if (match_len == 0)
+    return op;
+
+  if (oend - op < 2)
+    return NULL;
+
+  *op++ = (unsigned char)(offset & 0xff);
+  *op++ = (unsigned char)(offset >> 8);
+
+  size_t extra = match_len - CIPC_LZ_MIN_MATCH;
+  *token |= (unsigned char)(extra < CIPC_LZ_RUN_MASK ? extra : CIPC_LZ_RUN_MASK);
+
+  if (extra >= CIPC_LZ_RUN_MASK && !(op = put_length (op, oend, extra - CIPC_LZ_RUN_MASK)))
+    return NULL;
+
+  return op;
+}
+
+size_t
+cipc_lz_compress (const char *src, size_t length, char *dst, size_t capacity)
+{
+  const unsigned char *in = (const unsigned char *)src;
+  unsigned char *op = (unsigned char *)dst;
+  const unsigned char *oend = op + capacity;
+
+  size_t anchor = 0;
+
+  if (length > CIPC_LZ_LAST_LITERALS + CIPC_LZ_MIN_MATCH)
+    {
+      // Positions last seen per hash; a stale or colliding entry is caught by the compare.
+      uint32_t table[1 << CIPC_LZ_HASH_BITS] = { 0 };
+      size_t limit = length - CIPC_LZ_LAST_LITERALS;
+      size_t ip = 0;
+
+      while (ip + CIPC_LZ_MIN_MATCH <= limit)
+        {
+          uint32_t v = read32 (in + ip);
+          uint32_t h = hash32 (v);
+          size_t ref = table[h];
+
+          table[h] = (uint32_t)ip;
+
+          if (ref >= ip || ip - ref > CIPC_LZ_MAX_OFFSET || read32 (in + ref) != v)
+            {
+              // Incompressible stretches are skipped faster the longer they run.
+              ip += 1 + ((ip - anchor) >> 6);
+              continue;
+            }
+
+          size_t match_len
+              = CIPC_LZ_MIN_MATCH
+                + common_length (in + ref + CIPC_LZ_MIN_MATCH, in + ip + CIPC_LZ_MIN_MATCH,
+                                 in + limit);
+
+          while (ip > anchor && ref > 0 && in[ip - 1] == in[ref - 1])
+            {
+              ip--;
+              ref--;
+              match_len++;
+            }
+
+          op = put_sequence (op, oend, in + anchor, ip - anchor, ip - ref, match_len);
+          if (!op)
+            return 0;
+
+          ip += match_len;
+          anchor = ip;
+
+          table[hash32 (read32 (in + ip - 2))] = (uint32_t)(ip - 2);
+        }
+    }
+
+  op = put_sequence (op, oend, in + anchor, length - anchor, 0, 0);
+  if (!op)
+    return 0;
+
+  return (size_t)(op - (unsigned char *)dst);
+}
+
+static cipc_err
+get_length (const unsigned char **ip, const unsigned char *iend, size_t *length)
+{
+  unsigned char b;
+
+  do
+    {
+      if (*ip >= iend)
+        return CIPC_BAD_CODEC;
+
+      b = *(*ip)++;
+      *length += b;
+    }
+  while (b == 255);
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_lz_decompress (const char *src, size_t src_length, char *dst, size_t length)
+{
+  const unsigned char *ip = (const unsigned char *)src;
+  const unsigned char *iend = ip + src_length;
+  unsigned char *op = (unsigned char *)dst;
+  unsigned char *oend = op + length;
+
+  while (ip < iend)
+    {
+      unsigned token = *ip++;
+
+      size_t lit_len = token >> 4;
+      if (lit_len == CIPC_LZ_RUN_MASK && get_length (&ip, iend, &lit_len) != CIPC_OK)
+        return CIPC_BAD_CODEC;
+
+      if (lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op))
+        return CIPC_BAD_CODEC;
+
+      memcpy (op, ip, lit_len);
+      ip += lit_len;
+      op += lit_len;
+
+      if (ip == iend)
+        break;
+
+      if (iend - ip < 2)
+        return CIPC_BAD_CODEC;
+
+      size_t offset = ip[0] | (size_t)ip[1] << 8;
+      ip += 2;
+
+      if (offset == 0 || offset > (size_t)(op - (unsigned char *)dst))
+        return CIPC_BAD_CODEC;
+
+      size_t match_len = token & CIPC_LZ_RUN_MASK;
+      if (match_len == CIPC_LZ_RUN_MASK && get_length (&ip, iend, &match_len) != CIPC_OK)
+        return CIPC_BAD_CODEC;
+
+      match_len += CIPC_LZ_MIN_MATCH;
+
+      if (match_len > (size_t)(oend - op))
+        return CIPC_BAD_CODEC;
+
+      const unsigned char *ref = op - offset;
+
+      // An offset shorter than the match repeats the bytes being written.
+      if (offset >= match_len)
+        memcpy (op, ref, match_len);
+      else
+        for (size_t i = 0; i < match_len; i++)
+          op[i] = ref[i];
+
+      op += match_len;
+    }
+
+  return op == oend ? CIPC_OK : CIPC_BAD_CODEC;
+}
@@ -0,0 +1,18 @@
+#ifndef CIPC_LZ_H
+#define CIPC_LZ_H
+
+#include <stddef.h>
+
+#include "cipc.h"
+
+// Byte-oriented LZ77 in the LZ4 block layout: each sequence is a token (literal count, match
+// length - 4), the literals, then a 16-bit little-endian match offset; the last sequence has
+// literals only. Greedy matching through a hash of the next four bytes.
+
+// Returns the compressed size, or 0 when the result would not fit in capacity.
+size_t cipc_lz_compress (const char *src, size_t length, char *dst, size_t capacity);
+
+// Fails with CIPC_BAD_CODEC unless src decodes to exactly length bytes.
+cipc_err cipc_lz_decompress (const char *src, size_t src_length, char *dst, size_t length);
+
+#endif // CIPC_LZ_H
@@ -0,0 +1,546 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "backend/cipc_threaded.h"
+#include "cipc.h"
+#include "cipc_internal.h"
+#include "cipc_pool.h"
+
+typedef enum
+{
+  CIPC_POOL_CONN_DOWN,
+  CIPC_POOL_CONN_CONNECTING,
+  CIPC_POOL_CONN_UP,
+  // Failed while leased; closed once the last lease is returned.
+  CIPC_POOL_CONN_BROKEN
+} cipc_pool_conn_state;
+
+typedef struct
+{
+  cipc *instance;
+  size_t endpoint;
+
+  cipc_pool_conn_state state;
+  size_t outstanding;
+} cipc_pool_conn;
+
+typedef struct
+{
+  cipc_pool_endpoint endpoint;
+
+  int ejected;
+  int backoff_ms;
+  int64_t retry_at_ms;
+} cipc_pool_endpoint_state;
+
+struct cipc_pool
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  // Broadcast when a connection may have become free to lease.
+  pthread_cond_t idle;
+  pthread_t thread;
+  int stopping;
+
+  cipc_pool_endpoint_state *endpoints;
+  size_t endpoint_count;
+
+  // Interleaved by endpoint (conns[i] belongs to endpoint i % endpoint_count), so round-robin
+  // alternates between endpoints.
+  cipc_pool_conn *conns;
+  size_t conn_count;
+
+  cipc_pool_strategy strategy;
+  size_t cursor;
+  uint64_t rng;
+
+  int retry_interval_ms;
+  int max_retry_interval_ms;
+  int threaded;
+};
+
+static uint64_t
+next_random (cipc_pool *pool)
+{
+  // xorshift64
+  pool->rng ^= pool->rng << 13;
+  pool->rng ^= pool->rng >> 7;
+  pool->rng ^= pool->rng << 17;
+
+  return pool->rng;
+}
+
+static int
+is_transport_error (cipc_err err)
+{
+  switch (err)
+    {
+    case CIPC_OK:
+    case CIPC_BAD_ALLOC:
+    case CIPC_NULL_PTR:
+    case CIPC_BAD_BUFFER_SIZE:
+    case CIPC_BAD_PEER:
+    case CIPC_WOULD_BLOCK:
+    case CIPC_BAD_RPC_HANDLE:
+      return 0;
+    default:
+      return 1;
+    }
+}
+
+static cipc *
+connect_endpoint (const cipc_pool *pool, const cipc_pool_endpoint *endpoint)
+{
+  cipc *instance = cipc_create (endpoint->protocol);
+  if (!instance)
+    return NULL;
+
+  if (instance->init (&instance->context, endpoint->config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  if (!pool->threaded)
+    return instance;
+
+  cipc_threaded_config config = { .inner = instance };
+
+  cipc *wrapper = cipc_create (CIPC_PROTOCOL_THREADED);
+  if (!wrapper || wrapper->init (&wrapper->context, &config) != CIPC_OK)
+    {
+      cipc_free (wrapper);
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return wrapper;
+}
+
+static int
+in_rotation (const cipc_pool *pool, const cipc_pool_conn *conn)
+{
+  return conn->state == CIPC_POOL_CONN_UP && !pool->endpoints[conn->endpoint].ejected;
+}
+
+// Without the threaded wrapper, an instance is not safe to share, so a lease is exclusive.
+static int
+leasable (const cipc_pool *pool, const cipc_pool_conn *conn)
+{
+  return in_rotation (pool, conn) && (pool->threaded || conn->outstanding == 0);
+}
+
+static void
+mark_connected (cipc_pool *pool, cipc_pool_conn *conn, cipc *instance)
+{
+  cipc_pool_endpoint_state *ep = &pool->endpoints[conn->endpoint];
+
+  conn->instance = instance;
+  conn->state = CIPC_POOL_CONN_UP;
+
+  if (ep->ejected)
+    fprintf (stderr, "Pool endpoint %zu is back\n", conn->endpoint);
+
+  ep->ejected = 0;
+  ep->backoff_ms = pool->retry_interval_ms;
+  ep->retry_at_ms = 0;
+
+  pthread_cond_broadcast (&pool->idle);
+}
+
+static void
+mark_unreachable (cipc_pool *pool, cipc_pool_conn *conn, int64_t now)
+{
+  cipc_pool_endpoint_state *ep = &pool->endpoints[conn->endpoint];
+
+  conn->state = CIPC_POOL_CONN_DOWN;
+
+  if (!ep->ejected)
+    fprintf (stderr, "Pool endpoint %zu ejected\n", conn->endpoint);
+  else if (now < ep->retry_at_ms)
+    return;
+
+  ep->ejected = 1;
+  ep->retry_at_ms = now + ep->backoff_ms;
+
+  ep->backoff_ms *= 2;
+  if (ep->backoff_ms > pool->max_retry_interval_ms)
+    ep->backoff_ms = pool->max_retry_interval_ms;
+}
+
+// Closes retired connections and reconnects those that are due; called with the lock held.
+// Returns the time of the next attempt, or -1 when nothing is waiting.
+static int64_t
+repair (cipc_pool *pool)
+{
+  int64_t next = -1;
+
+  for (size_t i = 0; i < pool->conn_count && !pool->stopping; i++)
+    {
+      cipc_pool_conn *conn = &pool->conns[i];
+
+      if (conn->state == CIPC_POOL_CONN_BROKEN && conn->outstanding == 0)
+        {
+          cipc *instance = conn->instance;
+
+          conn->instance = NULL;
+          conn->state = CIPC_POOL_CONN_DOWN;
+
+          pthread_mutex_unlock (&pool->lock);
+          cipc_free (instance);
+          pthread_mutex_lock (&pool->lock);
+        }
+
+      if (conn->state != CIPC_POOL_CONN_DOWN)
+        continue;
+
+      cipc_pool_endpoint_state *ep = &pool->endpoints[conn->endpoint];
+      int64_t now = cipc_monotonic_ms ();
+
+      if (now < ep->retry_at_ms)
+        {
+          if (next < 0 || ep->retry_at_ms < next)
+            next = ep->retry_at_ms;
+
+          continue;
+        }
+
+      conn->state = CIPC_POOL_CONN_CONNECTING;
+
+      pthread_mutex_unlock (&pool->lock);
+      cipc *instance = connect_endpoint (pool, &ep->endpoint);
+      pthread_mutex_lock (&pool->lock);
+
+      if (instance)
+        {
+          mark_connected (pool, conn, instance);
+        }
+      else
+        {
+          mark_unreachable (pool, conn, cipc_monotonic_ms ());
+
+          if (next < 0 || ep->retry_at_ms < next)
+            next = ep->retry_at_ms;
+        }
+    }
+
+  return next;
+}
+
+static void *
+repair_thread (void *arg)
+{
+  cipc_pool *pool = (cipc_pool *)arg;
+
+  pthread_mutex_lock (&pool->lock);
+
+  while (!pool->stopping)
+    {
+      int64_t next = repair (pool);
+
+      if (pool->stopping)
+        break;
+
+      if (next < 0)
+        {
+          pthread_cond_wait (&pool->cond, &pool->lock);
+          continue;
+        }
+
+      struct timespec deadline = { .tv_sec = next / 1000, .tv_nsec = (next % 1000) * 1000000 };
+      pthread_cond_timedwait (&pool->cond, &pool->lock, &deadline);
+    }
+
+  pthread_mutex_unlock (&pool->lock);
+
+  return NULL;
+}
+
+static void
+pool_destroy (cipc_pool *pool)
+{
+  for (size_t i = 0; i < pool->conn_count; i++)
+    cipc_free (pool->conns[i].instance);
+
+  pthread_cond_destroy (&pool->cond);
+  pthread_cond_destroy (&pool->idle);
+  pthread_mutex_destroy (&pool->lock);
+
+  free (pool->conns);
+  free (pool->endpoints);
+  free (pool);
+}
+
+cipc_err
+cipc_pool_create (cipc_pool **pool, const cipc_pool_config *config)
+{
+  if (!pool || !config || !config->endpoints || config->endpoint_count == 0)
+    return CIPC_NULL_PTR;
+
+  cipc_pool *p = calloc (1, sizeof (cipc_pool));
+  if (!p)
+    return CIPC_BAD_ALLOC;
+
+  size_t per_endpoint = config->connections_per_endpoint ? config->connections_per_endpoint
+                                                         : CIPC_POOL_DEFAULT_CONNECTIONS;
+
+  p->endpoint_count = config->endpoint_count;
+  p->conn_count = config->endpoint_count * per_endpoint;
+  p->strategy = config->strategy;
+  p->threaded = config->threaded;
+  p->retry_interval_ms = config->retry_interval_ms > 0 ? config->retry_interval_ms
+                                                       : CIPC_POOL_DEFAULT_RETRY_INTERVAL_MS;
+  p->max_retry_interval_ms = config->max_retry_interval_ms > 0
+                                 ? config->max_retry_interval_ms
+                                 : CIPC_POOL_DEFAULT_MAX_RETRY_INTERVAL_MS;
+  p->rng = (uint64_t)cipc_monotonic_ms () | 1;
+
+  pthread_mutex_init (&p->lock, NULL);
+
+  cipc_cond_init (&p->cond);
+
+  pthread_cond_init (&p->idle, NULL);
+
+  p->endpoints = calloc (p->endpoint_count, sizeof (cipc_pool_endpoint_state));
+  p->conns = calloc (p->conn_count, sizeof (cipc_pool_conn));
+  if (!p->endpoints || !p->conns)
+    {
+      pool_destroy (p);
+      return CIPC_BAD_ALLOC;
+    }
+
+  for (size_t i = 0; i < p->endpoint_count; i++)
+    {
+      p->endpoints[i].endpoint = config->endpoints[i];
+      p->endpoints[i].backoff_ms = p->retry_interval_ms;
+    }
+
+  // The first connection to a dead endpoint ejects it; its other slots wait for the retry.
+  int64_t now = cipc_monotonic_ms ();
+
+  for (size_t i = 0; i < p->conn_count; i++)
+    {
+      cipc_pool_conn *conn = &p->conns[i];
+      conn->endpoint = i % p->endpoint_count;
+
+      cipc_pool_endpoint_state *ep = &p->endpoints[conn->endpoint];
+      if (ep->ejected)
+        continue;
+
+      cipc *instance = connect_endpoint (p, &ep->endpoint);
+      if (instance)
+        mark_connected (p, conn, instance);
+      else
+        mark_unreachable (p, conn, now);
+    }
+
+  int rc = pthread_create (&p->thread, NULL, repair_thread, p);
+  if (rc != 0)
+    {
+      fprintf (stderr, "Pool thread start failed: %s\n", strerror (rc));
+      pool_destroy (p);
+      return CIPC_BAD_THREADED_START;
+    }
+
+  *pool = p;
+
+  return CIPC_OK;
+}
+
+void
+cipc_pool_free (cipc_pool *pool)
+{
+  if (!pool)
+    return;
+
+  pthread_mutex_lock (&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_signal (&pool->cond);
+  pthread_mutex_unlock (&pool->lock);
+
+  pthread_join (pool->thread, NULL);
+
+  pool_destroy (pool);
+}
+
+static cipc_pool_conn *
+pick_round_robin (cipc_pool *pool)
+{
+  for (size_t n = 0; n < pool->conn_count; n++)
+    {
+      cipc_pool_conn *conn = &pool->conns[pool->cursor];
+      pool->cursor = (pool->cursor + 1) % pool->conn_count;
+
+      if (leasable (pool, conn))
+        return conn;
+    }
+
+  return NULL;
+}
+
+static cipc_pool_conn *
+pick_least_outstanding (cipc_pool *pool)
+{
+  cipc_pool_conn *best = NULL;
+
+  // Starting after the previous pick spreads ties.
+  for (size_t n = 0; n < pool->conn_count; n++)
+    {
+      cipc_pool_conn *conn = &pool->conns[(pool->cursor + n) % pool->conn_count];
+
+      if (leasable (pool, conn) && (!best || conn->outstanding < best->outstanding))
+        best = conn;
+    }
+
+  if (best)
+    pool->cursor = (size_t)(best - pool->conns + 1) % pool->conn_count;
+
+  return best;
+}
+
+static cipc_pool_conn *
+pick_power_of_two (cipc_pool *pool)
+{
+  cipc_pool_conn *first = NULL;
+  cipc_pool_conn *second = NULL;
+
+  // Random probes first; a mostly ejected pool falls back to a scan.
+  for (size_t n = 0; n < 2 * pool->conn_count && !second; n++)
+    {
+      cipc_pool_conn *conn = &pool->conns[next_random (pool) % pool->conn_count];
+
+      if (!leasable (pool, conn) || conn == first)
+        continue;
+
+      if (!first)
+        first = conn;
+      else
+        second = conn;
+    }
+
+  if (!first)
+    return pick_least_outstanding (pool);
+
+  if (!second)
+    return first;
+
+  return second->outstanding < first->outstanding ? second : first;
+}
+
+static cipc_pool_conn *
+pick (cipc_pool *pool)
+{
+  switch (pool->strategy)
+    {
+    case CIPC_POOL_LEAST_OUTSTANDING:
+      return pick_least_outstanding (pool);
+    case CIPC_POOL_POWER_OF_TWO:
+      return pick_power_of_two (pool);
+    case CIPC_POOL_ROUND_ROBIN:
+    default:
+      return pick_round_robin (pool);
+    }
+}
+
+static size_t
+count_in_rotation (const cipc_pool *pool)
+{
+  size_t count = 0;
+
+  for (size_t i = 0; i < pool->conn_count; i++)
+    count += in_rotation (pool, &pool->conns[i]);
+
+  return count;
+}
+
+cipc_err
+cipc_pool_acquire (cipc_pool *pool, cipc_pool_lease *lease)
+{
+  if (!pool || !lease)
+    return CIPC_NULL_PTR;
+
+  pthread_mutex_lock (&pool->lock);
+
+  cipc_pool_conn *conn = pick (pool);
+
+  // Every connection in rotation is leased; wait for one to come back.
+  while (!conn && count_in_rotation (pool) > 0)
+    {
+      pthread_cond_wait (&pool->idle, &pool->lock);
+      conn = pick (pool);
+    }
+
+  if (conn)
+    {
+      conn->outstanding++;
+
+      lease->instance = conn->instance;
+      lease->connection = conn;
+    }
+
+  pthread_mutex_unlock (&pool->lock);
+
+  return conn ? CIPC_OK : CIPC_BAD_POOL_EMPTY;
+}
+
+void
+cipc_pool_release (cipc_pool *pool, cipc_pool_lease *lease, cipc_err result)
+{
+  if (!pool || !lease || !lease->connection)
+    return;
+
+  cipc_pool_conn *conn = (cipc_pool_conn *)lease->connection;
+
+  pthread_mutex_lock (&pool->lock);
+
+  conn->outstanding--;
+
+  if (is_transport_error (result) && conn->state == CIPC_POOL_CONN_UP)
+    conn->state = CIPC_POOL_CONN_BROKEN;
+
+  if (conn->state == CIPC_POOL_CONN_BROKEN && conn->outstanding == 0)
+    pthread_cond_signal (&pool->cond);
+
+  pthread_cond_broadcast (&pool->idle);
+
+  pthread_mutex_unlock (&pool->lock);
+
+  lease->instance = NULL;
+  lease->connection = NULL;
+}
+
+cipc_err
+cipc_pool_send (cipc_pool *pool, const char *data, size_t length)
+{
+  cipc_pool_lease lease;
+
+  cipc_err err = cipc_pool_acquire (pool, &lease);
+  if (err != CIPC_OK)
+    return err;
+
+  err = lease.instance->send (lease.instance->context, data, length);
+
+  cipc_pool_release (pool, &lease, err);
+
+  return err;
+}
+
+size_t
+cipc_pool_available (cipc_pool *pool)
+{
+  if (!pool)
+    return 0;
+
+  pthread_mutex_lock (&pool->lock);
+
+  size_t count = count_in_rotation (pool);
+
+  pthread_mutex_unlock (&pool->lock);
+
+  return count;
+}
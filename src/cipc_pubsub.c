@@ -0,0 +1,651 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cipc.h"
+#include "cipc_pubsub.h"
+
+#define CIPC_PUBSUB_UNSUBSCRIBE 0
+#define CIPC_PUBSUB_SUBSCRIBE 1
+// Subscription changes applied per update, so a flood of them cannot hold up publishing.
+#define CIPC_PUBSUB_UPDATE_BUDGET 256
+
+typedef struct cipc_pubsub_node cipc_pubsub_node;
+
+// Prefix trie with one node per byte and the children of a node in a list.
+struct cipc_pubsub_node
+{
+  cipc_pubsub_node *child;
+  cipc_pubsub_node *sibling;
+  unsigned char byte;
+
+  // Peers whose prefix ends here, once per subscription.
+  cipc_peer_id *peers;
+  size_t count;
+  size_t cap;
+};
+
+typedef enum
+{
+  CIPC_PUB_UNKNOWN,
+  // Subscribers are the peers of a server instance and are matched one by one.
+  CIPC_PUB_PEERS,
+  // A single peer, or ZMQ XPUB fanning out on its own: the subscriptions of all are one set.
+  CIPC_PUB_SINGLE
+} cipc_pub_mode;
+
+struct cipc_pub
+{
+  cipc *transport;
+  cipc_pub_mode mode;
+
+  cipc_pubsub_node root;
+
+  // The message being published, shared by the sends to all its subscribers.
+  char *tx;
+  size_t tx_cap;
+
+  cipc_peer_id *targets;
+  size_t targets_cap;
+
+  // One subscription change plus the terminator recv_from appends.
+  char rx[CIPC_PUBSUB_MAX_TOPIC + 2];
+};
+
+struct cipc_sub
+{
+  cipc *transport;
+
+  cipc_pubsub_node root;
+
+  char tx[CIPC_PUBSUB_MAX_TOPIC + 1];
+};
+
+static cipc_pubsub_node *
+node_child (cipc_pubsub_node *node, unsigned char byte, int create)
+{
+  cipc_pubsub_node *child = node->child;
+
+  while (child && child->byte != byte)
+    child = child->sibling;
+
+  if (child || !create)
+    return child;
+
+  child = calloc (1, sizeof (cipc_pubsub_node));
+  if (!child)
+    return NULL;
+
+  child->byte = byte;
+  child->sibling = node->child;
+  node->child = child;
+
+  return child;
+}
+
+// Frees a node left without subscriptions or children; returns nonzero if it did.
+static int
+node_prune (cipc_pubsub_node **link)
+{
+  cipc_pubsub_node *node = *link;
+
+  if (node->count > 0 || node->child)
+    return 0;
+
+  *link = node->sibling;
+
+  free (node->peers);
+  free (node);
+
+  return 1;
+}
+
+static size_t
+peers_remove (cipc_pubsub_node *node, cipc_peer_id peer, int all)
+{
+  size_t removed = 0;
+
+  for (size_t i = 0; i < node->count;)
+    {
+      if (node->peers[i] != peer)
+        {
+          i++;
+          continue;
+        }
+
+      node->peers[i] = node->peers[--node->count];
+      removed++;
+
+      if (!all)
+        break;
+    }
+
+  return removed;
+}
+
+// Returns the node the subscription was added to, or NULL when out of memory.
+static cipc_pubsub_node *
+trie_add (cipc_pubsub_node *root, const char *prefix, size_t length, cipc_peer_id peer)
+{
+  cipc_pubsub_node *node = root;
+
+  for (size_t i = 0; i < length && node; i++)
+    node = node_child (node, (unsigned char)prefix[i], 1);
+
+  if (!node)
+    return NULL;
+
+  if (node->count == node->cap)
+    {
+      size_t cap = node->cap ? node->cap * 2 : 4;
+
+      cipc_peer_id *peers = realloc (node->peers, cap * sizeof (cipc_peer_id));
+      if (!peers)
+        return NULL;
+
+      node->peers = peers;
+      node->cap = cap;
+    }
+
+  node->peers[node->count++] = peer;
+
+  return node;
+}
+
+// Removes one subscription of peer to prefix; returns how many it still has there, or -1 when
+// it had none. Nodes left empty on the way are freed.
+static long
+trie_remove (cipc_pubsub_node *node, const char *prefix, size_t length, cipc_peer_id peer)
+{
+  if (length == 0)
+    {
+      if (!peers_remove (node, peer, 0))
+        return -1;
+
+      long left = 0;
+      for (size_t i = 0; i < node->count; i++)
+        left += node->peers[i] == peer;
+
+      return left;
+    }
+
+  cipc_pubsub_node **link = &node->child;
+
+  while (*link && (*link)->byte != (unsigned char)prefix[0])
+    link = &(*link)->sibling;
+
+  if (!*link)
+    return -1;
+
+  long left = trie_remove (*link, prefix + 1, length - 1, peer);
+
+  node_prune (link);
+
+  return left;
+}
+
+static void
+trie_remove_peer (cipc_pubsub_node *node, cipc_peer_id peer)
+{
+  peers_remove (node, peer, 1);
+
+  for (cipc_pubsub_node **link = &node->child; *link;)
+    {
+      trie_remove_peer (*link, peer);
+
+      if (!node_prune (link))
+        link = &(*link)->sibling;
+    }
+}
+
+static void
+trie_free (cipc_pubsub_node *node)
+{
+  cipc_pubsub_node *child = node->child;
+
+  while (child)
+    {
+      cipc_pubsub_node *next = child->sibling;
+
+      trie_free (child);
+      free (child);
+
+      child = next;
+    }
+
+  free (node->peers);
+}
+
+static int
+trie_matches (cipc_pubsub_node *root, const char *topic, size_t length)
+{
+  cipc_pubsub_node *node = root;
+
+  for (size_t i = 0; node; i++)
+    {
+      if (node->count > 0)
+        return 1;
+
+      if (i == length)
+        break;
+
+      node = node_child (node, (unsigned char)topic[i], 0);
+    }
+
+  return 0;
+}
+
+static int
+compare_peers (const void *a, const void *b)
+{
+  cipc_peer_id x = *(const cipc_peer_id *)a;
+  cipc_peer_id y = *(const cipc_peer_id *)b;
+
+  return (x > y) - (x < y);
+}
+
+static cipc_err
+collect_peers (cipc_pub *pub, const cipc_pubsub_node *node, size_t *count)
+{
+  if (*count + node->count > pub->targets_cap)
+    {
+      size_t cap = pub->targets_cap ? pub->targets_cap : 64;
+      while (cap < *count + node->count)
+        cap *= 2;
+
+      cipc_peer_id *targets = realloc (pub->targets, cap * sizeof (cipc_peer_id));
+      if (!targets)
+        return CIPC_BAD_ALLOC;
+
+      pub->targets = targets;
+      pub->targets_cap = cap;
+    }
+
+  if (node->count > 0)
+    memcpy (pub->targets + *count, node->peers, node->count * sizeof (cipc_peer_id));
+
+  *count += node->count;
+
+  return CIPC_OK;
+}
+
+static size_t
+unique_peers (cipc_peer_id *peers, size_t count)
+{
+  if (count < 2)
+    return count;
+
+  qsort (peers, count, sizeof (cipc_peer_id), compare_peers);
+
+  size_t unique = 1;
+  for (size_t i = 1; i < count; i++)
+    if (peers[i] != peers[unique - 1])
+      peers[unique++] = peers[i];
+
+  return unique;
+}
+
+// Leaves the distinct peers subscribed to a prefix of topic in pub->targets.
+static cipc_err
+match_topic (cipc_pub *pub, const char *topic, size_t length, size_t *matched)
+{
+  cipc_pubsub_node *node = &pub->root;
+  size_t count = 0;
+
+  for (size_t i = 0; node; i++)
+    {
+      cipc_err err = collect_peers (pub, node, &count);
+      if (err != CIPC_OK)
+        return err;
+
+      if (i == length)
+        break;
+
+      node = node_child (node, (unsigned char)topic[i], 0);
+    }
+
+  *matched = unique_peers (pub->targets, count);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+collect_all (cipc_pub *pub, const cipc_pubsub_node *node, size_t *count)
+{
+  cipc_err err = collect_peers (pub, node, count);
+
+  for (const cipc_pubsub_node *child = node->child; child && err == CIPC_OK;
+       child = child->sibling)
+    err = collect_all (pub, child, count);
+
+  return err;
+}
+
+cipc_err
+cipc_pub_create (cipc_pub **pub, cipc *transport)
+{
+  if (!pub || !transport || !transport->send || !transport->recv_msg || !transport->release_msg
+      || !transport->get_fd)
+    return CIPC_NULL_PTR;
+
+  cipc_pub *p = calloc (1, sizeof (cipc_pub));
+  if (!p)
+    return CIPC_BAD_ALLOC;
+
+  p->transport = transport;
+  p->mode = transport->recv_from && transport->send_to ? CIPC_PUB_UNKNOWN : CIPC_PUB_SINGLE;
+
+  *pub = p;
+
+  return CIPC_OK;
+}
+
+void
+cipc_pub_free (cipc_pub *pub)
+{
+  if (!pub)
+    return;
+
+  trie_free (&pub->root);
+
+  free (pub->tx);
+  free (pub->targets);
+  free (pub);
+}
+
+static cipc_err
+apply_change (cipc_pub *pub, cipc_peer_id peer, const char *data, size_t length)
+{
+  // Anything else a subscriber sends is ignored.
+  if (length == 0 || length > CIPC_PUBSUB_MAX_TOPIC + 1)
+    return CIPC_OK;
+
+  if (data[0] == CIPC_PUBSUB_SUBSCRIBE)
+    return trie_add (&pub->root, data + 1, length - 1, peer) ? CIPC_OK : CIPC_BAD_ALLOC;
+
+  if (data[0] == CIPC_PUBSUB_UNSUBSCRIBE)
+    trie_remove (&pub->root, data + 1, length - 1, peer);
+
+  return CIPC_OK;
+}
+
+static cipc_err
+recv_change_single (cipc_pub *pub)
+{
+  cipc *transport = pub->transport;
+  cipc_msg msg;
+
+  cipc_err err = transport->recv_msg (transport->context, &msg);
+  if (err != CIPC_OK)
+    return err;
+
+  err = apply_change (pub, 0, msg.data, msg.length);
+
+  transport->release_msg (transport->context, &msg);
+
+  return err;
+}
+
+static cipc_err
+recv_change_addressed (cipc_pub *pub)
+{
+  cipc *transport = pub->transport;
+  cipc_peer_id peer = 0;
+  size_t length = 0;
+
+  cipc_err err = transport->recv_from (transport->context, &peer, pub->rx, sizeof (pub->rx),
+                                       &length);
+
+  // The instance turned out to have a single peer (TCP in bind mode, ZMQ XPUB).
+  if (err == CIPC_BAD_PEER && pub->mode == CIPC_PUB_UNKNOWN)
+    {
+      pub->mode = CIPC_PUB_SINGLE;
+      return recv_change_single (pub);
+    }
+
+  // Longer than any subscription change; it stays queued until read whole and dropped.
+  if (err == CIPC_BAD_BUFFER_SIZE)
+    {
+      char *scratch = malloc (length + 1);
+      if (!scratch)
+        return CIPC_BAD_ALLOC;
+
+      err = transport->recv_from (transport->context, &peer, scratch, length + 1, &length);
+
+      free (scratch);
+
+      return err;
+    }
+
+  if (err != CIPC_OK)
+    return err;
+
+  pub->mode = CIPC_PUB_PEERS;
+
+  return apply_change (pub, peer, pub->rx, length);
+}
+
+cipc_err
+cipc_pub_update (cipc_pub *pub)
+{
+  if (!pub)
+    return CIPC_NULL_PTR;
+
+  cipc *transport = pub->transport;
+
+  for (int i = 0; i < CIPC_PUBSUB_UPDATE_BUDGET; i++)
+    {
+      int ready = 0;
+      size_t nready = 0;
+
+      cipc_err err = cipc_poll (&transport, 1, 0, &ready, &nready);
+      if (err != CIPC_OK)
+        return err;
+
+      if (nready == 0)
+        return CIPC_OK;
+
+      err = pub->mode == CIPC_PUB_SINGLE ? recv_change_single (pub) : recv_change_addressed (pub);
+      if (err != CIPC_OK)
+        return err;
+    }
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_publish (cipc_pub *pub, const char *topic, const char *data, size_t length)
+{
+  if (!pub || !topic || (!data && length > 0))
+    return CIPC_NULL_PTR;
+
+  size_t topic_length = strlen (topic);
+  if (topic_length > CIPC_PUBSUB_MAX_TOPIC)
+    return CIPC_BAD_FRAME;
+
+  cipc_err err = cipc_pub_update (pub);
+  if (err != CIPC_OK)
+    return err;
+
+  size_t matched;
+
+  err = match_topic (pub, topic, topic_length, &matched);
+  if (err != CIPC_OK || matched == 0)
+    return err;
+
+  size_t size = topic_length + 1 + length;
+
+  if (size > pub->tx_cap)
+    {
+      char *tx = realloc (pub->tx, size);
+      if (!tx)
+        return CIPC_BAD_ALLOC;
+
+      pub->tx = tx;
+      pub->tx_cap = size;
+    }
+
+  memcpy (pub->tx, topic, topic_length + 1);
+  if (length > 0)
+    memcpy (pub->tx + topic_length + 1, data, length);
+
+  cipc *transport = pub->transport;
+
+  if (pub->mode != CIPC_PUB_PEERS)
+    return transport->send (transport->context, pub->tx, size);
+
+  for (size_t i = 0; i < matched; i++)
+    {
+      cipc_peer_id peer = pub->targets[i];
+
+      // Other failures are the overflow policy at work, or a connection just lost; either way
+      // this subscriber misses the message and the rest still get it.
+      if (transport->send_to (transport->context, peer, pub->tx, size) == CIPC_BAD_PEER)
+        trie_remove_peer (&pub->root, peer);
+    }
+
+  return CIPC_OK;
+}
+
+size_t
+cipc_pub_subscribers (cipc_pub *pub)
+{
+  if (!pub)
+    return 0;
+
+  size_t count = 0;
+
+  if (collect_all (pub, &pub->root, &count) != CIPC_OK)
+    return 0;
+
+  return unique_peers (pub->targets, count);
+}
+
+cipc_err
+cipc_sub_create (cipc_sub **sub, cipc *transport)
+{
+  if (!sub || !transport || !transport->send || !transport->recv_msg || !transport->release_msg)
+    return CIPC_NULL_PTR;
+
+  cipc_sub *s = calloc (1, sizeof (cipc_sub));
+  if (!s)
+    return CIPC_BAD_ALLOC;
+
+  s->transport = transport;
+
+  *sub = s;
+
+  return CIPC_OK;
+}
+
+void
+cipc_sub_free (cipc_sub *sub)
+{
+  if (!sub)
+    return;
+
+  trie_free (&sub->root);
+
+  free (sub);
+}
+
+static cipc_err
+send_change (cipc_sub *sub, unsigned char change, const char *prefix, size_t length)
+{
+  cipc *transport = sub->transport;
+
+  sub->tx[0] = (char)change;
+  memcpy (sub->tx + 1, prefix, length);
+
+  return transport->send (transport->context, sub->tx, length + 1);
+}
+
+cipc_err
+cipc_subscribe (cipc_sub *sub, const char *prefix)
+{
+  if (!sub || !prefix)
+    return CIPC_NULL_PTR;
+
+  size_t length = strlen (prefix);
+  if (length > CIPC_PUBSUB_MAX_TOPIC)
+    return CIPC_BAD_FRAME;
+
+  cipc_pubsub_node *node = trie_add (&sub->root, prefix, length, 0);
+  if (!node)
+    return CIPC_BAD_ALLOC;
+
+  // The publisher only hears of the first subscription to a prefix and of the last one going.
+  if (node->count > 1)
+    return CIPC_OK;
+
+  cipc_err err = send_change (sub, CIPC_PUBSUB_SUBSCRIBE, prefix, length);
+  if (err != CIPC_OK)
+    trie_remove (&sub->root, prefix, length, 0);
+
+  return err;
+}
+
+cipc_err
+cipc_unsubscribe (cipc_sub *sub, const char *prefix)
+{
+  if (!sub || !prefix)
+    return CIPC_NULL_PTR;
+
+  size_t length = strlen (prefix);
+
+  if (length > CIPC_PUBSUB_MAX_TOPIC || trie_remove (&sub->root, prefix, length, 0) != 0)
+    return CIPC_OK;
+
+  return send_change (sub, CIPC_PUBSUB_UNSUBSCRIBE, prefix, length);
+}
+
+cipc_err
+cipc_sub_recv (cipc_sub *sub, cipc_pubsub_msg *msg)
+{
+  if (!sub || !msg)
+    return CIPC_NULL_PTR;
+
+  cipc *transport = sub->transport;
+
+  while (1)
+    {
+      cipc_err err = transport->recv_msg (transport->context, &msg->view);
+      if (err != CIPC_OK)
+        return err;
+
+      const char *data = msg->view.data;
+      const char *end = msg->view.length > 0 ? memchr (data, '\0', msg->view.length) : NULL;
+
+      if (!end)
+        {
+          transport->release_msg (transport->context, &msg->view);
+          return CIPC_BAD_FRAME;
+        }
+
+      size_t topic_length = (size_t)(end - data);
+
+      if (!trie_matches (&sub->root, data, topic_length))
+        {
+          transport->release_msg (transport->context, &msg->view);
+          continue;
+        }
+
+      msg->topic = data;
+      msg->topic_length = topic_length;
+      msg->data = end + 1;
+      msg->length = msg->view.length - topic_length - 1;
+
+      return CIPC_OK;
+    }
+}
+
+void
+cipc_sub_release (cipc_sub *sub, cipc_pubsub_msg *msg)
+{
+  if (!sub || !msg)
+    return;
+
+  sub->transport->release_msg (sub->transport->context, &msg->view);
+
+  memset (msg, 0, sizeof (cipc_pubsub_msg));
+}
@@ -0,0 +1,586 @@
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cipc.h"
+#include "cipc_alloc.h"
+#include "cipc_rpc.h"
+
+#define CIPC_RPC_KIND_REQUEST 1u
+#define CIPC_RPC_KIND_RESPONSE 2u
+
+#define CIPC_RPC_SERVER_BUFFER_SIZE 4096
+
+typedef enum
+{
+  CIPC_RPC_SLOT_FREE,
+  CIPC_RPC_SLOT_PENDING,
+  // The response arrived while waiting for another call and was copied aside.
+  CIPC_RPC_SLOT_DONE
+} cipc_rpc_slot_state;
+
+typedef struct
+{
+  size_t length;
+  char data[];
+} cipc_rpc_stash;
+
+typedef struct
+{
+  cipc_rpc_handle id;
+  cipc_rpc_slot_state state;
+  cipc_rpc_stash *stash;
+} cipc_rpc_slot;
+
+struct cipc_rpc_client
+{
+  cipc *transport;
+
+  // Calls live in slots[id & mask]; ids are sequential, so a busy slot means the window of
+  // max_in_flight calls is full.
+  cipc_rpc_slot *slots;
+  size_t mask;
+
+  cipc_rpc_handle next_id;
+  size_t in_flight;
+  size_t done;
+};
+
+typedef struct
+{
+  size_t capacity;
+  char data[];
+} cipc_rpc_buffer;
+
+typedef enum
+{
+  CIPC_RPC_SERVER_UNKNOWN,
+  CIPC_RPC_SERVER_PEERS,
+  CIPC_RPC_SERVER_SINGLE
+} cipc_rpc_server_mode;
+
+struct cipc_rpc_server
+{
+  cipc *transport;
+  cipc_rpc_server_mode mode;
+
+  // recv_from copies into rx, which is lent to the request until it is released.
+  cipc_rpc_buffer *rx;
+
+  // send_to takes one buffer, so responses are assembled here.
+  cipc_rpc_buffer *tx;
+};
+
+static void
+encode_header (unsigned char header[CIPC_RPC_HEADER_SIZE], uint32_t kind, uint64_t id)
+{
+  uint32_t words[4] = { htonl (kind), 0, htonl ((uint32_t)(id >> 32)), htonl ((uint32_t)id) };
+
+  memcpy (header, words, sizeof (words));
+}
+
+static cipc_err
+decode_header (const char *data, size_t length, uint32_t expected_kind, uint64_t *id)
+{
+  if (length < CIPC_RPC_HEADER_SIZE)
+    return CIPC_BAD_FRAME;
+
+  uint32_t words[4];
+  memcpy (words, data, sizeof (words));
+
+  if (ntohl (words[0]) != expected_kind)
+    return CIPC_BAD_FRAME;
+
+  *id = (uint64_t)ntohl (words[2]) << 32 | ntohl (words[3]);
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_rpc_client_create (cipc_rpc_client **client, cipc *transport, size_t max_in_flight)
+{
+  if (!client || !transport || !transport->recv_msg || !transport->sendv)
+    return CIPC_NULL_PTR;
+
+  size_t capacity = 1;
+  while (capacity < (max_in_flight ? max_in_flight : CIPC_RPC_DEFAULT_MAX_IN_FLIGHT))
+    capacity <<= 1;
+
+  cipc_rpc_client *rpc = calloc (1, sizeof (cipc_rpc_client));
+  if (!rpc)
+    return CIPC_BAD_ALLOC;
+
+  rpc->slots = calloc (capacity, sizeof (cipc_rpc_slot));
+  if (!rpc->slots)
+    {
+      free (rpc);
+      return CIPC_BAD_ALLOC;
+    }
+
+  rpc->transport = transport;
+  rpc->mask = capacity - 1;
+  rpc->next_id = 1;
+
+  *client = rpc;
+
+  return CIPC_OK;
+}
+
+void
+cipc_rpc_client_free (cipc_rpc_client *client)
+{
+  if (!client)
+    return;
+
+  for (size_t i = 0; i <= client->mask; i++)
+    cipc_dealloc (client->slots[i].stash);
+
+  free (client->slots);
+  free (client);
+}
+
+static cipc_rpc_slot *
+find_slot (cipc_rpc_client *client, cipc_rpc_handle handle)
+{
+  cipc_rpc_slot *slot = &client->slots[handle & client->mask];
+
+  return slot->state != CIPC_RPC_SLOT_FREE && slot->id == handle ? slot : NULL;
+}
+
+static void
+free_slot (cipc_rpc_client *client, cipc_rpc_slot *slot)
+{
+  if (slot->state == CIPC_RPC_SLOT_DONE)
+    client->done--;
+
+  slot->state = CIPC_RPC_SLOT_FREE;
+  slot->stash = NULL;
+
+  client->in_flight--;
+}
+
+cipc_err
+cipc_rpc_callv (cipc_rpc_client *client, const cipc_iovec *iov, size_t iovcnt,
+                cipc_rpc_handle *handle)
+{
+  if (!client || !handle || (iovcnt > 0 && !iov))
+    return CIPC_NULL_PTR;
+
+  cipc_rpc_handle id = client->next_id;
+  cipc_rpc_slot *slot = &client->slots[id & client->mask];
+
+  if (slot->state != CIPC_RPC_SLOT_FREE)
+    return CIPC_WOULD_BLOCK;
+
+  unsigned char header[CIPC_RPC_HEADER_SIZE];
+  encode_header (header, CIPC_RPC_KIND_REQUEST, id);
+
+  cipc_iovec stack_parts[8];
+  cipc_iovec *parts = stack_parts;
+
+  if (iovcnt + 1 > sizeof (stack_parts) / sizeof (stack_parts[0]))
+    {
+      parts = malloc ((iovcnt + 1) * sizeof (cipc_iovec));
+      if (!parts)
+        return CIPC_BAD_ALLOC;
+    }
+
+  parts[0].base = header;
+  parts[0].length = sizeof (header);
+  memcpy (parts + 1, iov, iovcnt * sizeof (cipc_iovec));
+
+  cipc_err err = client->transport->sendv (client->transport->context, parts, iovcnt + 1);
+
+  if (parts != stack_parts)
+    free (parts);
+
+  if (err != CIPC_OK)
+    return err;
+
+  client->next_id++;
+  client->in_flight++;
+
+  slot->id = id;
+  slot->state = CIPC_RPC_SLOT_PENDING;
+  slot->stash = NULL;
+
+  *handle = id;
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_rpc_call (cipc_rpc_client *client, const char *data, size_t length, cipc_rpc_handle *handle)
+{
+  cipc_iovec iov = { .base = data, .length = length };
+
+  return cipc_rpc_callv (client, &iov, 1, handle);
+}
+
+static void
+take_stash (cipc_rpc_client *client, cipc_rpc_slot *slot, cipc_rpc_response *response)
+{
+  response->data = slot->stash->data;
+  response->length = slot->stash->length;
+  response->copy = slot->stash;
+  memset (&response->view, 0, sizeof (response->view));
+
+  free_slot (client, slot);
+}
+
+// Receives the next response to an outstanding call, dropping those of cancelled calls.
+static cipc_err
+next_response (cipc_rpc_client *client, cipc_msg *view, cipc_rpc_slot **slot)
+{
+  cipc *transport = client->transport;
+
+  while (1)
+    {
+      cipc_err err = transport->recv_msg (transport->context, view);
+      if (err != CIPC_OK)
+        return err;
+
+      uint64_t id;
+      err = decode_header (view->data, view->length, CIPC_RPC_KIND_RESPONSE, &id);
+      if (err != CIPC_OK)
+        {
+          transport->release_msg (transport->context, view);
+          return err;
+        }
+
+      *slot = find_slot (client, id);
+      if (*slot && (*slot)->state == CIPC_RPC_SLOT_PENDING)
+        return CIPC_OK;
+
+      transport->release_msg (transport->context, view);
+    }
+}
+
+static void
+give_view (cipc_rpc_client *client, cipc_rpc_slot *slot, const cipc_msg *view,
+           cipc_rpc_response *response)
+{
+  response->view = *view;
+  response->copy = NULL;
+  response->data = view->data + CIPC_RPC_HEADER_SIZE;
+  response->length = view->length - CIPC_RPC_HEADER_SIZE;
+
+  free_slot (client, slot);
+}
+
+cipc_err
+cipc_rpc_wait (cipc_rpc_client *client, cipc_rpc_handle handle, cipc_rpc_response *response)
+{
+  if (!client || !response)
+    return CIPC_NULL_PTR;
+
+  cipc_rpc_slot *target = find_slot (client, handle);
+  if (!target)
+    return CIPC_BAD_RPC_HANDLE;
+
+  if (target->state == CIPC_RPC_SLOT_DONE)
+    {
+      take_stash (client, target, response);
+      return CIPC_OK;
+    }
+
+  cipc *transport = client->transport;
+
+  while (1)
+    {
+      cipc_msg view;
+      cipc_rpc_slot *slot;
+
+      cipc_err err = next_response (client, &view, &slot);
+      if (err != CIPC_OK)
+        return err;
+
+      if (slot == target)
+        {
+          give_view (client, slot, &view, response);
+          return CIPC_OK;
+        }
+
+      // Copied so that the transport gets its views back in order.
+      size_t length = view.length - CIPC_RPC_HEADER_SIZE;
+
+      cipc_rpc_stash *stash = cipc_alloc (sizeof (cipc_rpc_stash) + length);
+      if (!stash)
+        {
+          transport->release_msg (transport->context, &view);
+          return CIPC_BAD_ALLOC;
+        }
+
+      stash->length = length;
+      memcpy (stash->data, view.data + CIPC_RPC_HEADER_SIZE, length);
+
+      transport->release_msg (transport->context, &view);
+
+      slot->state = CIPC_RPC_SLOT_DONE;
+      slot->stash = stash;
+      client->done++;
+    }
+}
+
+cipc_err
+cipc_rpc_wait_any (cipc_rpc_client *client, cipc_rpc_handle *handle, cipc_rpc_response *response)
+{
+  if (!client || !handle || !response)
+    return CIPC_NULL_PTR;
+
+  if (client->in_flight == 0)
+    return CIPC_BAD_RPC_HANDLE;
+
+  if (client->done > 0)
+    {
+      for (size_t i = 0; i <= client->mask; i++)
+        {
+          cipc_rpc_slot *slot = &client->slots[i];
+
+          if (slot->state == CIPC_RPC_SLOT_DONE)
+            {
+              *handle = slot->id;
+              take_stash (client, slot, response);
+
+              return CIPC_OK;
+            }
+        }
+    }
+
+  cipc_msg view;
+  cipc_rpc_slot *slot;
+
+  cipc_err err = next_response (client, &view, &slot);
+  if (err != CIPC_OK)
+    return err;
+
+  *handle = slot->id;
+  give_view (client, slot, &view, response);
+
+  return CIPC_OK;
+}
+
+void
+cipc_rpc_release (cipc_rpc_client *client, cipc_rpc_response *response)
+{
+  if (!client || !response)
+    return;
+
+  if (response->view.data)
+    client->transport->release_msg (client->transport->context, &response->view);
+
+  cipc_dealloc (response->copy);
+
+  memset (response, 0, sizeof (cipc_rpc_response));
+}
+
+void
+cipc_rpc_cancel (cipc_rpc_client *client, cipc_rpc_handle handle)
+{
+  if (!client)
+    return;
+
+  cipc_rpc_slot *slot = find_slot (client, handle);
+  if (!slot)
+    return;
+
+  cipc_dealloc (slot->stash);
+  free_slot (client, slot);
+}
+
+size_t
+cipc_rpc_in_flight (const cipc_rpc_client *client)
+{
+  return client ? client->in_flight : 0;
+}
+
+cipc_err
+cipc_rpc_server_create (cipc_rpc_server **server, cipc *transport)
+{
+  if (!server || !transport || !transport->recv_msg || !transport->sendv)
+    return CIPC_NULL_PTR;
+
+  cipc_rpc_server *rpc = calloc (1, sizeof (cipc_rpc_server));
+  if (!rpc)
+    return CIPC_BAD_ALLOC;
+
+  rpc->transport = transport;
+  rpc->mode = transport->recv_from && transport->send_to ? CIPC_RPC_SERVER_UNKNOWN
+                                                         : CIPC_RPC_SERVER_SINGLE;
+
+  *server = rpc;
+
+  return CIPC_OK;
+}
+
+void
+cipc_rpc_server_free (cipc_rpc_server *server)
+{
+  if (!server)
+    return;
+
+  free (server->rx);
+  free (server->tx);
+  free (server);
+}
+
+static cipc_err
+ensure_capacity (cipc_rpc_buffer **buffer, size_t needed)
+{
+  if (*buffer && (*buffer)->capacity >= needed)
+    return CIPC_OK;
+
+  size_t capacity = *buffer ? (*buffer)->capacity : CIPC_RPC_SERVER_BUFFER_SIZE;
+  while (capacity < needed)
+    capacity *= 2;
+
+  cipc_rpc_buffer *grown = realloc (*buffer, sizeof (cipc_rpc_buffer) + capacity);
+  if (!grown)
+    return CIPC_BAD_ALLOC;
+
+  grown->capacity = capacity;
+  *buffer = grown;
+
+  return CIPC_OK;
+}
+
+static cipc_err
+recv_addressed (cipc_rpc_server *server, cipc_rpc_request *request)
+{
+  cipc *transport = server->transport;
+
+  while (1)
+    {
+      cipc_err err = ensure_capacity (&server->rx, CIPC_RPC_SERVER_BUFFER_SIZE);
+      if (err != CIPC_OK)
+        return err;
+
+      size_t length = 0;
+      err = transport->recv_from (transport->context, &request->peer, server->rx->data,
+                                  server->rx->capacity, &length);
+
+      // The instance turned out to have a single peer (e.g. TCP in bind mode).
+      if (err == CIPC_BAD_PEER && server->mode == CIPC_RPC_SERVER_UNKNOWN)
+        {
+          server->mode = CIPC_RPC_SERVER_SINGLE;
+          return CIPC_BAD_PEER;
+        }
+
+      // The message stays queued; retry with room for it and the terminator.
+      if (err == CIPC_BAD_BUFFER_SIZE)
+        {
+          err = ensure_capacity (&server->rx, length + 1);
+          if (err != CIPC_OK)
+            return err;
+
+          continue;
+        }
+
+      if (err != CIPC_OK)
+        return err;
+
+      server->mode = CIPC_RPC_SERVER_PEERS;
+
+      err = decode_header (server->rx->data, length, CIPC_RPC_KIND_REQUEST, &request->id);
+      if (err != CIPC_OK)
+        return err;
+
+      request->data = server->rx->data + CIPC_RPC_HEADER_SIZE;
+      request->length = length - CIPC_RPC_HEADER_SIZE;
+      request->copy = server->rx;
+
+      server->rx = NULL;
+
+      return CIPC_OK;
+    }
+}
+
+cipc_err
+cipc_rpc_recv_request (cipc_rpc_server *server, cipc_rpc_request *request)
+{
+  if (!server || !request)
+    return CIPC_NULL_PTR;
+
+  memset (request, 0, sizeof (cipc_rpc_request));
+
+  if (server->mode != CIPC_RPC_SERVER_SINGLE)
+    {
+      cipc_err err = recv_addressed (server, request);
+      if (server->mode != CIPC_RPC_SERVER_SINGLE)
+        return err;
+    }
+
+  cipc *transport = server->transport;
+
+  cipc_err err = transport->recv_msg (transport->context, &request->view);
+  if (err != CIPC_OK)
+    return err;
+
+  err = decode_header (request->view.data, request->view.length, CIPC_RPC_KIND_REQUEST,
+                       &request->id);
+  if (err != CIPC_OK)
+    {
+      transport->release_msg (transport->context, &request->view);
+      return err;
+    }
+
+  request->data = request->view.data + CIPC_RPC_HEADER_SIZE;
+  request->length = request->view.length - CIPC_RPC_HEADER_SIZE;
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_rpc_respond (cipc_rpc_server *server, const cipc_rpc_request *request, const char *data,
+                  size_t length)
+{
+  if (!server || !request)
+    return CIPC_NULL_PTR;
+
+  cipc *transport = server->transport;
+
+  unsigned char header[CIPC_RPC_HEADER_SIZE];
+  encode_header (header, CIPC_RPC_KIND_RESPONSE, request->id);
+
+  if (server->mode != CIPC_RPC_SERVER_PEERS)
+    {
+      cipc_iovec parts[2] = {
+        { .base = header, .length = sizeof (header) },
+        { .base = data, .length = length },
+      };
+
+      return transport->sendv (transport->context, parts, 2);
+    }
+
+  cipc_err err = ensure_capacity (&server->tx, CIPC_RPC_HEADER_SIZE + length);
+  if (err != CIPC_OK)
+    return err;
+
+  memcpy (server->tx->data, header, sizeof (header));
+  if (length > 0)
+    memcpy (server->tx->data + CIPC_RPC_HEADER_SIZE, data, length);
+
+  return transport->send_to (transport->context, request->peer, server->tx->data,
+                             CIPC_RPC_HEADER_SIZE + length);
+}
+
+void
+cipc_rpc_release_request (cipc_rpc_server *server, cipc_rpc_request *request)
+{
+  if (!server || !request)
+    return;
+
+  if (request->view.data)
+    server->transport->release_msg (server->transport->context, &request->view);
+
+  // The receive buffer goes back to the server unless it already has a new one.
+  if (request->copy && !server->rx)
+    server->rx = request->copy;
+  else
+    free (request->copy);
+
+  request->data = NULL;
+  request->length = 0;
+  request->copy = NULL;
+}
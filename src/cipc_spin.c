@@ -0,0 +1,61 @@
+#include <stdint.h>
+
+#include "cipc_internal.h"
+#include "cipc_spin.h"
+
+// A new gap counts for 1/8 of the moving average.
+#define CIPC_SPIN_GAP_WEIGHT 8
+// Longer gaps are counted as this many times the limit, so spinning resumes a few messages
+// after an idle period rather than dozens.
+#define CIPC_SPIN_GAP_CLAMP 16
+
+void
+cipc_spin_init (cipc_spin *spin, int max_us)
+{
+  spin->max_ns = max_us > 0 ? (int64_t)max_us * 1000 : 0;
+  spin->last_ns = 0;
+
+  // Spin to the limit until there are gaps to go by.
+  spin->gap_ns = spin->max_ns / 2;
+}
+
+int64_t
+cipc_spin_deadline (const cipc_spin *spin)
+{
+  if (spin->max_ns == 0 || spin->gap_ns > spin->max_ns)
+    return 0;
+
+  int64_t budget = spin->gap_ns * 2;
+  if (budget > spin->max_ns)
+    budget = spin->max_ns;
+
+  return cipc_monotonic_ns () + budget;
+}
+
+int
+cipc_spin_wait (int64_t deadline)
+{
+  cipc_cpu_relax ();
+
+  return cipc_monotonic_ns () < deadline;
+}
+
+void
+cipc_spin_arrived (cipc_spin *spin)
+{
+  if (spin->max_ns == 0)
+    return;
+
+  int64_t now = cipc_monotonic_ns ();
+
+  if (spin->last_ns != 0)
+    {
+      int64_t gap = now - spin->last_ns;
+      if (gap > spin->max_ns * CIPC_SPIN_GAP_CLAMP)
+        gap = spin->max_ns * CIPC_SPIN_GAP_CLAMP;
+
+      spin->gap_ns += (gap - spin->gap_ns) / CIPC_SPIN_GAP_WEIGHT;
+    }
+
+  spin->last_ns = now;
+}
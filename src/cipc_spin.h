@@ -0,0 +1,31 @@
+#ifndef CIPC_SPIN_H
+#define CIPC_SPIN_H
+
+#include <stdint.h>
+
+// Spinning on non-blocking reads before a blocking wait, to skip the wakeup when the next
+// message is due soon. How long to spin follows a moving average of the gaps between arrivals:
+// twice the average, up to the configured limit, and not at all while messages come further
+// apart than the limit, so an idle link costs no CPU.
+
+typedef struct
+{
+  // 0 disables spinning.
+  int64_t max_ns;
+
+  int64_t last_ns;
+  int64_t gap_ns;
+} cipc_spin;
+
+void cipc_spin_init (cipc_spin *spin, int max_us);
+
+// CLOCK_MONOTONIC time in nanoseconds to spin until, or 0 to block at once.
+int64_t cipc_spin_deadline (const cipc_spin *spin);
+
+// Pauses the CPU briefly; returns 0 once the deadline has passed.
+int cipc_spin_wait (int64_t deadline);
+
+// Records that a message arrived.
+void cipc_spin_arrived (cipc_spin *spin);
+
+#endif // CIPC_SPIN_H
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cipc.h"
+#include "cipc_counters.h"
+#include "cipc_stats.h"
+
+static uint64_t
+relaxed_load (const uint64_t *value)
+{
+  return __atomic_load_n (value, __ATOMIC_RELAXED);
+}
+
+static void
+relaxed_store (uint64_t *value, uint64_t new_value)
+{
+  __atomic_store_n (value, new_value, __ATOMIC_RELAXED);
+}
+
+void
+cipc_counters_init (cipc_counters *counters)
+{
+  memset (counters, 0, sizeof (cipc_counters));
+}
+
+void
+cipc_counters_destroy (cipc_counters *counters)
+{
+  free (atomic_load (&counters->send_latency));
+  free (atomic_load (&counters->recv_latency));
+
+  atomic_store (&counters->send_latency, NULL);
+  atomic_store (&counters->recv_latency, NULL);
+}
+
+static cipc_err
+ensure_histogram (_Atomic (cipc_histogram *) *slot)
+{
+  if (atomic_load (slot))
+    return CIPC_OK;
+
+  cipc_histogram *histogram = malloc (sizeof (cipc_histogram));
+  if (!histogram)
+    return CIPC_BAD_ALLOC;
+
+  cipc_histogram_reset (histogram);
+
+  cipc_histogram *expected = NULL;
+  if (!atomic_compare_exchange_strong (slot, &expected, histogram))
+    free (histogram);
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_counters_enable_latency (cipc_counters *counters, int enable)
+{
+  if (enable)
+    {
+      cipc_err err = ensure_histogram (&counters->send_latency);
+      if (err == CIPC_OK)
+        err = ensure_histogram (&counters->recv_latency);
+
+      if (err != CIPC_OK)
+        return err;
+    }
+
+  atomic_store (&counters->latency_enabled, enable != 0);
+
+  return CIPC_OK;
+}
+
+void
+cipc_counters_record_latency (_Atomic (cipc_histogram *) *slot, uint64_t start)
+{
+  cipc_histogram *histogram = atomic_load_explicit (slot, memory_order_acquire);
+  if (!histogram)
+    return;
+
+  uint64_t now = (uint64_t)cipc_monotonic_ns ();
+  uint64_t value = now > start ? now - start : 0;
+
+  // Single writer: the plain histogram fields are updated with relaxed stores so that
+  // concurrent snapshots never read torn values.
+  uint64_t *bucket = &histogram->buckets[cipc_histogram_bucket_index (value)];
+
+  relaxed_store (bucket, relaxed_load (bucket) + 1);
+  relaxed_store (&histogram->count, relaxed_load (&histogram->count) + 1);
+  relaxed_store (&histogram->sum, relaxed_load (&histogram->sum) + value);
+
+  if (value < relaxed_load (&histogram->min))
+    relaxed_store (&histogram->min, value);
+
+  if (value > relaxed_load (&histogram->max))
+    relaxed_store (&histogram->max, value);
+}
+
+static void
+snapshot_histogram (_Atomic (cipc_histogram *) const *slot, cipc_histogram *out)
+{
+  cipc_histogram *histogram = atomic_load_explicit ((_Atomic (cipc_histogram *) *)slot,
+                                                    memory_order_acquire);
+
+  cipc_histogram_reset (out);
+
+  if (!histogram)
+    return;
+
+  for (size_t i = 0; i < CIPC_HISTOGRAM_BUCKETS; i++)
+    out->buckets[i] = relaxed_load (&histogram->buckets[i]);
+
+  out->count = relaxed_load (&histogram->count);
+  out->sum = relaxed_load (&histogram->sum);
+  out->min = relaxed_load (&histogram->min);
+  out->max = relaxed_load (&histogram->max);
+}
+
+void
+cipc_counters_snapshot (const cipc_counters *counters, cipc_stats *out)
+{
+  out->msgs_sent = atomic_load_explicit (&counters->msgs_sent, memory_order_relaxed);
+  out->bytes_sent = atomic_load_explicit (&counters->bytes_sent, memory_order_relaxed);
+  out->send_syscalls = atomic_load_explicit (&counters->send_syscalls, memory_order_relaxed);
+  out->short_writes = atomic_load_explicit (&counters->short_writes, memory_order_relaxed);
+  out->send_timeouts = atomic_load_explicit (&counters->send_timeouts, memory_order_relaxed);
+  out->send_errors = atomic_load_explicit (&counters->send_errors, memory_order_relaxed);
+
+  out->msgs_received = atomic_load_explicit (&counters->msgs_received, memory_order_relaxed);
+  out->bytes_received = atomic_load_explicit (&counters->bytes_received, memory_order_relaxed);
+  out->recv_syscalls = atomic_load_explicit (&counters->recv_syscalls, memory_order_relaxed);
+  out->short_reads = atomic_load_explicit (&counters->short_reads, memory_order_relaxed);
+  out->recv_timeouts = atomic_load_explicit (&counters->recv_timeouts, memory_order_relaxed);
+  out->recv_errors = atomic_load_explicit (&counters->recv_errors, memory_order_relaxed);
+
+  out->reconnects = atomic_load_explicit (&counters->reconnects, memory_order_relaxed);
+  out->msgs_lost = atomic_load_explicit (&counters->msgs_lost, memory_order_relaxed);
+
+  out->latency_enabled = atomic_load_explicit (&counters->latency_enabled, memory_order_relaxed);
+  snapshot_histogram (&counters->send_latency, &out->send_latency);
+  snapshot_histogram (&counters->recv_latency, &out->recv_latency);
+}
+
+cipc_err
+cipc_stats_get (const cipc *instance, cipc_stats *out)
+{
+  if (!instance || !out || !instance->counters || !instance->context)
+    return CIPC_NULL_PTR;
+
+  cipc_counters_snapshot (instance->counters (instance->context), out);
+
+  return CIPC_OK;
+}
+
+cipc_err
+cipc_stats_enable_latency (cipc *instance, int enable)
+{
+  if (!instance || !instance->counters || !instance->context)
+    return CIPC_NULL_PTR;
+
+  return cipc_counters_enable_latency (instance->counters (instance->context), enable);
+}
@@ -1,12 +0,0 @@
-#include <stdio.h>
-#include <stdlib.h>
-
-#include "cipc.h"
-
-int
-main (int argc, char **argv)
-{
-  printf ("Hello, world!\n");
-
-  return EXIT_SUCCESS;
-}
@@ -0,0 +1,84 @@
+#ifndef CIPC_TEST_H
+#define CIPC_TEST_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Each test is a plain executable run by ctest: failed checks are reported on stderr and the
+// test exits with EXIT_FAILURE once it has run to the end.
+
+static int cipc_test_failures;
+
+#define CIPC_CHECK(cond)                                                                         \
+  do                                                                                             \
+    {                                                                                            \
+      if (!(cond))                                                                               \
+        {                                                                                        \
+          fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);              \
+          cipc_test_failures++;                                                                  \
+        }                                                                                        \
+    }                                                                                            \
+  while (0)
+
+#define CIPC_TEST_RESULT() (cipc_test_failures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+// Exit status for a test that cannot run here, e.g. without kernel support; see SKIP_RETURN_CODE
+// in tests/CMakeLists.txt.
+#define CIPC_TEST_SKIP 77
+
+// A listening TCP socket on a free loopback port, for tests that play the peer by hand.
+static inline int
+cipc_test_listen (int *port)
+{
+  int fd = socket (AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+  };
+  socklen_t addr_len = sizeof (addr);
+
+  if (bind (fd, (struct sockaddr *)&addr, sizeof (addr)) != 0 || listen (fd, 4) != 0
+      || getsockname (fd, (struct sockaddr *)&addr, &addr_len) != 0)
+    {
+      close (fd);
+      return -1;
+    }
+
+  *port = ntohs (addr.sin_port);
+
+  return fd;
+}
+
+// A loopback port that was free a moment ago, for configs that listen on it themselves.
+static inline int
+cipc_test_free_port (void)
+{
+  int port = 0;
+
+  int fd = cipc_test_listen (&port);
+  if (fd < 0)
+    return -1;
+
+  close (fd);
+
+  return port;
+}
+
+// Writes a length-prefixed frame header (cipc_tcp_frame_header) to fd.
+static inline int
+cipc_test_write_header (int fd, uint32_t length)
+{
+  uint32_t header[2] = { htonl (length), 0 };
+
+  return write (fd, header, sizeof (header)) == (ssize_t)sizeof (header) ? 0 : -1;
+}
+
+#endif // CIPC_TEST_H
@@ -0,0 +1,264 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "backend/cipc_unix.h"
+#include "cipc.h"
+#include "cipc_test.h"
+
+// send_batch and recv_batch between TCP and Unix socket pairs: every message arrives once and in
+// order whatever the batch sizes on either side, and a batch stops at a message it cannot send.
+
+#define TEST_MESSAGES 5000
+#define TEST_MAX_MESSAGE_SIZE 1024
+
+typedef struct
+{
+  cipc_protocol protocol;
+  const void *config;
+  cipc *instance;
+} test_bind;
+
+static cipc *
+start (cipc_protocol protocol, const void *config)
+{
+  cipc *instance = cipc_create (protocol);
+  if (instance && instance->init (&instance->context, config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+// Bind mode waits in init for the peer, so it starts on its own thread.
+static void *
+bind_run (void *arg)
+{
+  test_bind *pending = (test_bind *)arg;
+
+  pending->instance = start (pending->protocol, pending->config);
+
+  return NULL;
+}
+
+static int
+start_pair (cipc_protocol protocol, const void *bind_config, const void *connect_config,
+            cipc **tx, cipc **rx)
+{
+  test_bind pending = { .protocol = protocol, .config = bind_config };
+  pthread_t thread;
+
+  if (pthread_create (&thread, NULL, bind_run, &pending) != 0)
+    return 0;
+
+  *tx = start (protocol, connect_config);
+
+  pthread_join (thread, NULL);
+
+  *rx = pending.instance;
+
+  return *tx && *rx;
+}
+
+static size_t
+message_length (uint32_t seq)
+{
+  return sizeof (seq) + seq * 37 % 300;
+}
+
+static void
+fill_message (char *message, uint32_t seq)
+{
+  memcpy (message, &seq, sizeof (seq));
+  memset (message + sizeof (seq), (char)seq, message_length (seq) - sizeof (seq));
+}
+
+static int
+check_message (const cipc_msg *msg, uint32_t seq)
+{
+  char expected[TEST_MAX_MESSAGE_SIZE];
+
+  fill_message (expected, seq);
+
+  return msg->length == message_length (seq) && memcmp (msg->data, expected, msg->length) == 0;
+}
+
+static void *
+send_all (void *arg)
+{
+  cipc *tx = (cipc *)arg;
+  static char storage[64][TEST_MAX_MESSAGE_SIZE];
+  cipc_iovec msgs[64];
+
+  for (uint32_t seq = 0; seq < TEST_MESSAGES;)
+    {
+      size_t count = 1 + seq % 64;
+      if (count > TEST_MESSAGES - seq)
+        count = TEST_MESSAGES - seq;
+
+      for (size_t i = 0; i < count; i++)
+        {
+          fill_message (storage[i], seq + i);
+          msgs[i].base = storage[i];
+          msgs[i].length = message_length (seq + i);
+        }
+
+      size_t sent = 0;
+
+      if (tx->send_batch (tx->context, msgs, count, &sent) != CIPC_OK || sent != count)
+        return NULL;
+
+      seq += count;
+    }
+
+  return NULL;
+}
+
+static void
+test_round_trip (cipc *tx, cipc *rx)
+{
+  pthread_t thread;
+  CIPC_CHECK (pthread_create (&thread, NULL, send_all, tx) == 0);
+
+  uint32_t received = 0;
+  int bad = 0;
+
+  while (received < TEST_MESSAGES && !bad)
+    {
+      cipc_msg msgs[16];
+      size_t count = 0;
+
+      if (rx->recv_batch (rx->context, msgs, 1 + received % 16, &count) != CIPC_OK || count == 0)
+        break;
+
+      for (size_t i = 0; i < count; i++)
+        {
+          bad |= !check_message (&msgs[i], received++);
+          rx->release_msg (rx->context, &msgs[i]);
+        }
+    }
+
+  CIPC_CHECK (!bad);
+  CIPC_CHECK (received == TEST_MESSAGES);
+
+  pthread_join (thread, NULL);
+}
+
+static void
+test_stop_at_oversized (cipc *tx, cipc *rx)
+{
+  static char large[TEST_MAX_MESSAGE_SIZE + 1];
+  cipc_iovec msgs[3] = {
+    { .base = "first", .length = 5 },
+    { .base = large, .length = sizeof (large) },
+    { .base = "third", .length = 5 },
+  };
+  size_t sent = 99;
+
+  CIPC_CHECK (tx->send_batch (tx->context, msgs, 3, &sent) == CIPC_BAD_FRAME);
+  CIPC_CHECK (sent == 1);
+
+  CIPC_CHECK (tx->send (tx->context, "next", 4) == CIPC_OK);
+
+  cipc_msg views[2];
+  size_t count = 0;
+
+  while (count < 2)
+    {
+      size_t more = 0;
+
+      if (rx->recv_batch (rx->context, views + count, 2 - count, &more) != CIPC_OK)
+        break;
+
+      count += more;
+    }
+
+  CIPC_CHECK (count == 2);
+  CIPC_CHECK (count == 2 && views[0].length == 5 && memcmp (views[0].data, "first", 5) == 0);
+  CIPC_CHECK (count == 2 && views[1].length == 4 && memcmp (views[1].data, "next", 4) == 0);
+
+  for (size_t i = 0; i < count; i++)
+    rx->release_msg (rx->context, &views[i]);
+}
+
+static void
+test_arguments (cipc *rx)
+{
+  cipc_msg msg;
+  size_t count = 99;
+
+  CIPC_CHECK (rx->recv_batch (rx->context, NULL, 1, &count) == CIPC_NULL_PTR);
+  CIPC_CHECK (rx->recv_batch (rx->context, &msg, 1, NULL) == CIPC_NULL_PTR);
+  CIPC_CHECK (rx->recv_batch (rx->context, NULL, 0, &count) == CIPC_OK && count == 0);
+}
+
+static void
+run (const char *name, cipc *tx, cipc *rx)
+{
+  int before = cipc_test_failures;
+
+  test_arguments (rx);
+  test_round_trip (tx, rx);
+  test_stop_at_oversized (tx, rx);
+
+  if (cipc_test_failures != before)
+    fprintf (stderr, "%s: failed\n", name);
+}
+
+int
+main (void)
+{
+  cipc *tx = NULL;
+  cipc *rx = NULL;
+
+  int port = cipc_test_free_port ();
+
+  cipc_tcp_config tcp = {
+    .host = "127.0.0.1",
+    .port = port,
+    .mode = CIPC_TCP_MODE_BIND,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 50,
+    .backlog = 1,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+    .max_message_size = TEST_MAX_MESSAGE_SIZE,
+  };
+  cipc_tcp_config tcp_connect = tcp;
+  tcp_connect.mode = CIPC_TCP_MODE_CONNECT;
+
+  CIPC_CHECK (start_pair (CIPC_PROTOCOL_TCP, &tcp, &tcp_connect, &tx, &rx));
+  if (tx && rx)
+    run ("tcp", tx, rx);
+
+  cipc_free (tx);
+  cipc_free (rx);
+
+  char path[64];
+  snprintf (path, sizeof (path), "@cipc-test-batch-%d", (int)getpid ());
+
+  cipc_unix_config unix_bind = {
+    .path = path,
+    .mode = CIPC_UNIX_MODE_BIND,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 50,
+    .backlog = 1,
+    .max_message_size = TEST_MAX_MESSAGE_SIZE,
+  };
+  cipc_unix_config unix_connect = unix_bind;
+  unix_connect.mode = CIPC_UNIX_MODE_CONNECT;
+
+  tx = rx = NULL;
+
+  CIPC_CHECK (start_pair (CIPC_PROTOCOL_UNIX, &unix_bind, &unix_connect, &tx, &rx));
+  if (tx && rx)
+    run ("unix", tx, rx);
+
+  cipc_free (tx);
+  cipc_free (rx);
+
+  return CIPC_TEST_RESULT ();
+}
@@ -0,0 +1,201 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "backend/cipc_inproc.h"
+#include "backend/cipc_shm.h"
+#include "cipc.h"
+#include "cipc_alloc.h"
+#include "cipc_buf.h"
+#include "cipc_test.h"
+
+// Pooled buffers: sizes and reuse, references dropped on other threads, and round trips that
+// copy (shared memory) or hand the buffer itself over (in-process).
+
+#define TEST_HANDOFFS 10000
+
+static void *
+unref_all (void *arg)
+{
+  cipc_buf **bufs = (cipc_buf **)arg;
+
+  for (int i = 0; i < TEST_HANDOFFS; i++)
+    cipc_buf_unref (bufs[i]);
+
+  return NULL;
+}
+
+static void
+test_alloc (void)
+{
+  size_t sizes[] = { 0, 1, 100, 4096, 100000, CIPC_ALLOC_MAX_POOLED, 3 * CIPC_ALLOC_MAX_POOLED };
+
+  for (size_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      cipc_buf *buf = cipc_buf_alloc (sizes[i]);
+
+      CIPC_CHECK (buf != NULL);
+      if (!buf)
+        continue;
+
+      CIPC_CHECK (buf->length == 0 && buf->capacity >= sizes[i]);
+
+      // All of the reported capacity is usable.
+      memset (buf->data, 'c', buf->capacity);
+
+      cipc_buf_unref (buf);
+    }
+
+  // A freed buffer goes back to this thread's cache and comes out again for the same size.
+  cipc_buf *first = cipc_buf_alloc (256);
+  void *block = first;
+
+  cipc_buf_unref (first);
+
+  cipc_buf *second = cipc_buf_alloc (256);
+  CIPC_CHECK ((void *)second == block);
+
+  // Extra references keep it alive until the last one goes.
+  CIPC_CHECK (cipc_buf_ref (second) == second);
+  cipc_buf_unref (second);
+
+  memset (second->data, 'r', second->capacity);
+  cipc_buf_unref (second);
+
+  cipc_buf_unref (NULL);
+}
+
+static void
+test_cross_thread (void)
+{
+  static cipc_buf *bufs[TEST_HANDOFFS];
+
+  for (int i = 0; i < TEST_HANDOFFS; i++)
+    {
+      bufs[i] = cipc_buf_alloc (64 + i % 2000);
+      CIPC_CHECK (bufs[i] != NULL);
+
+      if (!bufs[i])
+        return;
+    }
+
+  pthread_t thread;
+  CIPC_CHECK (pthread_create (&thread, NULL, unref_all, bufs) == 0);
+  pthread_join (thread, NULL);
+
+  // The blocks freed over there are found again from here.
+  for (int i = 0; i < TEST_HANDOFFS; i++)
+    {
+      bufs[i] = cipc_buf_alloc (64 + i % 2000);
+      CIPC_CHECK (bufs[i] != NULL);
+    }
+
+  for (int i = 0; i < TEST_HANDOFFS; i++)
+    cipc_buf_unref (bufs[i]);
+
+  cipc_buf_trim ();
+}
+
+static void
+test_round_trip (cipc *tx, cipc *rx, int shared)
+{
+  size_t sizes[] = { 0, 1, 1000, 30000 };
+
+  for (size_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      cipc_buf *out = cipc_buf_alloc (sizes[i]);
+      if (!out)
+        {
+          CIPC_CHECK (out != NULL);
+          continue;
+        }
+
+      memset (out->data, 'a' + (int)i, sizes[i]);
+      out->length = sizes[i];
+
+      cipc_buf *in = NULL;
+
+      CIPC_CHECK (cipc_buf_send (tx, out) == CIPC_OK);
+      CIPC_CHECK (cipc_buf_recv (rx, &in) == CIPC_OK);
+
+      if (in)
+        {
+          CIPC_CHECK (in->length == sizes[i] && memcmp (in->data, out->data, sizes[i]) == 0);
+          CIPC_CHECK ((in == out) == shared);
+        }
+
+      cipc_buf_unref (in);
+      cipc_buf_unref (out);
+    }
+
+  CIPC_CHECK (cipc_buf_send (tx, NULL) == CIPC_NULL_PTR);
+  CIPC_CHECK (cipc_buf_recv (rx, NULL) == CIPC_NULL_PTR);
+
+  // Neither backend has peers to address.
+  cipc_buf *buf = cipc_buf_alloc (0);
+
+  CIPC_CHECK (cipc_buf_send_to (tx, 1, buf) == CIPC_BAD_PEER);
+
+  cipc_buf_unref (buf);
+}
+
+static cipc *
+start (cipc_protocol protocol, const void *config)
+{
+  cipc *instance = cipc_create (protocol);
+  if (instance && instance->init (&instance->context, config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+int
+main (void)
+{
+  test_alloc ();
+  test_cross_thread ();
+
+  char name[64];
+  snprintf (name, sizeof (name), "/cipc-test-buf-%d", (int)getpid ());
+
+  cipc_shm_config shm_config = {
+    .name = name,
+    .mode = CIPC_SHM_MODE_BIND,
+    .capacity = 64 * 1024,
+    .sockopt_sndtimeo = 1000,
+    .sockopt_rcvtimeo = 1000,
+  };
+
+  cipc *shm_tx = start (CIPC_PROTOCOL_SHM, &shm_config);
+  shm_config.mode = CIPC_SHM_MODE_CONNECT;
+  cipc *shm_rx = start (CIPC_PROTOCOL_SHM, &shm_config);
+
+  CIPC_CHECK (shm_tx && shm_rx);
+  if (shm_tx && shm_rx)
+    test_round_trip (shm_tx, shm_rx, 0);
+
+  cipc_free (shm_rx);
+  cipc_free (shm_tx);
+
+  cipc_inproc_config inproc_config = {
+    .name = "buf",
+    .mode = CIPC_INPROC_MODE_BIND,
+    .sockopt_sndtimeo = 1000,
+    .sockopt_rcvtimeo = 1000,
+  };
+
+  cipc *inproc_tx = start (CIPC_PROTOCOL_INPROC, &inproc_config);
+  inproc_config.mode = CIPC_INPROC_MODE_CONNECT;
+  cipc *inproc_rx = start (CIPC_PROTOCOL_INPROC, &inproc_config);
+
+  CIPC_CHECK (inproc_tx && inproc_rx);
+  if (inproc_tx && inproc_rx)
+    test_round_trip (inproc_tx, inproc_rx, 1);
+
+  cipc_free (inproc_rx);
+  cipc_free (inproc_tx);
+
+  return CIPC_TEST_RESULT ();
+}
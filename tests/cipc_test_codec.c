@@ -0,0 +1,263 @@
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "backend/cipc_codec.h"
+#include "backend/cipc_shm.h"
+#include "cipc.h"
+#include "cipc_stats.h"
+#include "cipc_test.h"
+
+// The codec wrapper over shared memory: payloads below the threshold, incompressible ones and
+// compressible ones all round-trip, the compressible ones shrink on the wire, a custom codec is
+// used by its id, and a receive too small for the decoded message keeps it for the next one.
+
+#define TEST_LARGE 20000
+#define TEST_FILL_ID CIPC_CODEC_FIRST_CUSTOM
+
+// A stand-in custom codec for payloads of one repeated byte, which it sends as that byte alone.
+static size_t
+fill_encode (void *arg, const char *src, size_t length, char *dst, size_t capacity)
+{
+  (void)arg;
+
+  for (size_t i = 1; i < length; i++)
+    if (src[i] != src[0])
+      return 0;
+
+  if (length == 0 || capacity == 0)
+    return 0;
+
+  dst[0] = src[0];
+
+  return 1;
+}
+
+static cipc_err
+fill_decode (void *arg, const char *src, size_t src_length, char *dst, size_t length)
+{
+  (void)arg;
+
+  if (src_length != 1)
+    return CIPC_BAD_CODEC;
+
+  memset (dst, src[0], length);
+
+  return CIPC_OK;
+}
+
+static cipc *
+start_shm (const char *name, cipc_shm_mode mode)
+{
+  cipc_shm_config config = {
+    .name = name,
+    .mode = mode,
+    .capacity = 256 * 1024,
+    .sockopt_sndtimeo = 1000,
+    .sockopt_rcvtimeo = 1000,
+  };
+
+  cipc *instance = cipc_create (CIPC_PROTOCOL_SHM);
+  if (instance && instance->init (&instance->context, &config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+static cipc *
+wrap (cipc *inner, uint32_t codec)
+{
+  cipc_codec_config config = {
+    .inner = inner,
+    .codec = codec,
+    .threshold = 64,
+  };
+
+  cipc *instance = cipc_create (CIPC_PROTOCOL_CODEC);
+  if (!instance || instance->init (&instance->context, &config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      cipc_free (inner);
+      return NULL;
+    }
+
+  return instance;
+}
+
+// Sends one message and checks what arrives, returning the bytes it took on the wire.
+static uint64_t
+round_trip (cipc *tx, cipc *rx, const char *data, size_t length)
+{
+  static char buffer[TEST_LARGE + 1];
+  cipc_stats before;
+  cipc_stats after;
+  size_t received = 0;
+
+  cipc_stats_get (tx, &before);
+
+  CIPC_CHECK (tx->send (tx->context, data, length) == CIPC_OK);
+  CIPC_CHECK (rx->recv (rx->context, buffer, sizeof (buffer), &received) == CIPC_OK);
+  CIPC_CHECK (received == length && memcmp (buffer, data, length) == 0);
+
+  cipc_stats_get (tx, &after);
+
+  return after.bytes_sent - before.bytes_sent;
+}
+
+static void
+test_payloads (cipc *tx, cipc *rx)
+{
+  static char text[TEST_LARGE];
+  static char noise[TEST_LARGE];
+  uint32_t state = 12345;
+
+  for (size_t i = 0; i < TEST_LARGE; i++)
+    {
+      text[i] = "the quick brown fox jumps over the lazy dog "[i % 44];
+
+      state = state * 1103515245 + 12345;
+      noise[i] = (char)(state >> 16);
+    }
+
+  // Below the threshold and incompressible: sent as they are, plus the header.
+  CIPC_CHECK (round_trip (tx, rx, text, 10) == 10 + sizeof (cipc_codec_header));
+  CIPC_CHECK (round_trip (tx, rx, noise, TEST_LARGE) <= TEST_LARGE + sizeof (cipc_codec_header));
+
+  CIPC_CHECK (round_trip (tx, rx, text, TEST_LARGE) < TEST_LARGE / 4);
+  CIPC_CHECK (round_trip (tx, rx, text, 0) == sizeof (cipc_codec_header));
+
+  // Gathered parts are compressed as one payload.
+  cipc_iovec iov[3] = {
+    { .base = text, .length = 5000 },
+    { .base = text + 5000, .length = 0 },
+    { .base = text + 5000, .length = 5000 },
+  };
+  char buffer[10001];
+  size_t length = 0;
+
+  CIPC_CHECK (tx->sendv (tx->context, iov, 3) == CIPC_OK);
+
+  // Too small: the decoded size comes back and the message waits for a larger buffer.
+  CIPC_CHECK (rx->recv (rx->context, buffer, 100, &length) == CIPC_BAD_BUFFER_SIZE);
+  CIPC_CHECK (length == 10000);
+  CIPC_CHECK (rx->recv (rx->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 10000 && memcmp (buffer, text, 10000) == 0);
+
+  // Batches decode each message.
+  cipc_iovec batch[3] = {
+    { .base = text, .length = 3000 },
+    { .base = noise, .length = 3000 },
+    { .base = text, .length = 20 },
+  };
+  size_t sent = 0;
+
+  CIPC_CHECK (tx->send_batch (tx->context, batch, 3, &sent) == CIPC_OK && sent == 3);
+
+  size_t got = 0;
+
+  while (got < 3)
+    {
+      cipc_msg msgs[3];
+      size_t count = 0;
+
+      if (rx->recv_batch (rx->context, msgs, 3 - got, &count) != CIPC_OK)
+        break;
+
+      for (size_t i = 0; i < count; i++, got++)
+        {
+          CIPC_CHECK (msgs[i].length == batch[got].length
+                      && memcmp (msgs[i].data, batch[got].base, msgs[i].length) == 0);
+          rx->release_msg (rx->context, &msgs[i]);
+        }
+    }
+
+  CIPC_CHECK (got == 3);
+}
+
+int
+main (void)
+{
+  static const cipc_codec fill_codec = {
+    .id = TEST_FILL_ID,
+    .encode = fill_encode,
+    .decode = fill_decode,
+  };
+
+  CIPC_CHECK (cipc_codec_register (&fill_codec) == CIPC_OK);
+  CIPC_CHECK (cipc_codec_register (&fill_codec) == CIPC_BAD_CODEC);
+
+  char name[64];
+  snprintf (name, sizeof (name), "/cipc-test-codec-%d", (int)getpid ());
+
+  cipc *tx = wrap (start_shm (name, CIPC_SHM_MODE_BIND), CIPC_CODEC_LZ);
+  cipc *rx = tx ? wrap (start_shm (name, CIPC_SHM_MODE_CONNECT), CIPC_CODEC_RAW) : NULL;
+
+  if (!tx || !rx)
+    {
+      fprintf (stderr, "Failed to set up the codec pair!\n");
+      cipc_free (tx);
+      return EXIT_FAILURE;
+    }
+
+  test_payloads (tx, rx);
+
+  cipc_free (rx);
+  cipc_free (tx);
+
+  // A custom codec, checked on the wire by a peer without the wrapper.
+  snprintf (name, sizeof (name), "/cipc-test-codec-fill-%d", (int)getpid ());
+
+  cipc *raw = start_shm (name, CIPC_SHM_MODE_BIND);
+  tx = wrap (start_shm (name, CIPC_SHM_MODE_CONNECT), TEST_FILL_ID);
+
+  char message[100];
+  memset (message, 'm', sizeof (message));
+
+  cipc_msg msg;
+
+  CIPC_CHECK (tx && raw);
+  if (tx && raw)
+    {
+      CIPC_CHECK (tx->send (tx->context, message, sizeof (message)) == CIPC_OK);
+
+      // On the wire: the header, then the one byte.
+      CIPC_CHECK (raw->recv_msg (raw->context, &msg) == CIPC_OK);
+
+      cipc_codec_header header;
+      memcpy (&header, msg.data, sizeof (header));
+
+      CIPC_CHECK (ntohl (header.length) == sizeof (message));
+      CIPC_CHECK (ntohl (header.codec) == TEST_FILL_ID);
+      CIPC_CHECK (msg.length == sizeof (header) + 1 && msg.data[sizeof (header)] == 'm');
+
+      raw->release_msg (raw->context, &msg);
+
+      // A body the codec rejects, or a message too short for a header, fails its receive
+      // without stopping the next one.
+      cipc_codec_header wire = { htonl (sizeof (message)), htonl (TEST_FILL_ID) };
+      cipc_iovec frame[2] = { { .base = &wire, .length = sizeof (wire) },
+                              { .base = message, .length = 10 } };
+
+      CIPC_CHECK (raw->sendv (raw->context, frame, 2) == CIPC_OK);
+      CIPC_CHECK (raw->send (raw->context, (const char *)&wire, 4) == CIPC_OK);
+
+      char buffer[200];
+      size_t length = 0;
+
+      CIPC_CHECK (tx->recv (tx->context, buffer, sizeof (buffer), &length) == CIPC_BAD_CODEC);
+      CIPC_CHECK (tx->recv (tx->context, buffer, sizeof (buffer), &length) == CIPC_BAD_FRAME);
+
+      frame[1].length = 1;
+
+      CIPC_CHECK (raw->sendv (raw->context, frame, 2) == CIPC_OK);
+      CIPC_CHECK (tx->recv (tx->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+      CIPC_CHECK (length == sizeof (message) && memcmp (buffer, message, length) == 0);
+    }
+
+  cipc_free (tx);
+  cipc_free (raw);
+
+  return CIPC_TEST_RESULT ();
+}
@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "backend/cipc_stream.h"
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_counters.h"
+#include "cipc_test.h"
+
+// send_file and recv_file between TCP instances: a file larger than one frame, a range from the
+// middle of it, and plain messages in between. Then recv_file on a stream that passes large
+// messages as a memfd, which it copies out of the descriptor.
+
+#define TEST_FILE_SIZE (10 * 1024 * 1024 + 123)
+
+typedef struct
+{
+  const void *config;
+  cipc *instance;
+} test_bind;
+
+typedef struct
+{
+  cipc *tx;
+  int fd;
+  int failed;
+} test_sender;
+
+static cipc *
+start (const cipc_tcp_config *config)
+{
+  cipc *instance = cipc_create (CIPC_PROTOCOL_TCP);
+  if (instance && instance->init (&instance->context, config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+static void *
+bind_run (void *arg)
+{
+  test_bind *pending = (test_bind *)arg;
+
+  pending->instance = start (pending->config);
+
+  return NULL;
+}
+
+static int
+make_file (size_t size)
+{
+  int fd = memfd_create ("cipc-test-file", MFD_CLOEXEC);
+  if (fd < 0 || ftruncate (fd, (off_t)size) < 0)
+    return -1;
+
+  char *data = mmap (NULL, size, PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    return -1;
+
+  uint32_t state = 1;
+  for (size_t i = 0; i < size; i++)
+    {
+      state = state * 1664525 + 1013904223;
+      data[i] = (char)(state >> 24);
+    }
+
+  munmap (data, size);
+
+  return fd;
+}
+
+// Whether length bytes of a at offset_a equal those of b from its start.
+static int
+same_bytes (int a, off_t offset_a, int b, size_t length)
+{
+  struct stat st;
+
+  if (fstat (b, &st) < 0 || (size_t)st.st_size != length)
+    return 0;
+
+  char *x = mmap (NULL, (size_t)offset_a + length, PROT_READ, MAP_SHARED, a, 0);
+  char *y = mmap (NULL, length, PROT_READ, MAP_SHARED, b, 0);
+
+  int same = x != MAP_FAILED && y != MAP_FAILED && memcmp (x + offset_a, y, length) == 0;
+
+  if (x != MAP_FAILED)
+    munmap (x, (size_t)offset_a + length);
+  if (y != MAP_FAILED)
+    munmap (y, length);
+
+  return same;
+}
+
+static void *
+send_files (void *arg)
+{
+  test_sender *sender = (test_sender *)arg;
+  cipc *tx = sender->tx;
+
+  sender->failed = tx->send_file (tx->context, sender->fd, 0, TEST_FILE_SIZE) != CIPC_OK
+                   || tx->send (tx->context, "between", 7) != CIPC_OK
+                   || tx->send_file (tx->context, sender->fd, 4096, 100000) != CIPC_OK
+                   || tx->send_file (tx->context, sender->fd, 0, 0) != CIPC_OK;
+
+  return NULL;
+}
+
+static void
+test_tcp (void)
+{
+  cipc_tcp_config config = {
+    .host = "127.0.0.1",
+    .port = cipc_test_free_port (),
+    .mode = CIPC_TCP_MODE_BIND,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .sockopt_retries = 50,
+    .backlog = 1,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+  };
+
+  test_bind pending = { .config = &config };
+  pthread_t thread;
+
+  CIPC_CHECK (pthread_create (&thread, NULL, bind_run, &pending) == 0);
+
+  cipc_tcp_config connect_config = config;
+  connect_config.mode = CIPC_TCP_MODE_CONNECT;
+
+  cipc *tx = start (&connect_config);
+
+  pthread_join (thread, NULL);
+
+  cipc *rx = pending.instance;
+  int source = make_file (TEST_FILE_SIZE);
+
+  CIPC_CHECK (tx && rx && source >= 0);
+  if (!tx || !rx || source < 0)
+    {
+      cipc_free (tx);
+      cipc_free (rx);
+      return;
+    }
+
+  // A range past the end is refused before anything is sent.
+  CIPC_CHECK (tx->send_file (tx->context, source, TEST_FILE_SIZE - 10, 11) == CIPC_BAD_BUFFER_SIZE);
+
+  test_sender sender = { .tx = tx, .fd = source };
+  CIPC_CHECK (pthread_create (&thread, NULL, send_files, &sender) == 0);
+
+  int copy = memfd_create ("cipc-test-copy", MFD_CLOEXEC);
+  size_t length = 0;
+
+  CIPC_CHECK (rx->recv_file (rx->context, copy, &length) == CIPC_OK);
+  CIPC_CHECK (length == TEST_FILE_SIZE && same_bytes (source, 0, copy, TEST_FILE_SIZE));
+
+  char buffer[16];
+
+  CIPC_CHECK (rx->recv (rx->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (strcmp (buffer, "between") == 0);
+
+  // recv_file writes at the file position, so a fresh file gets the range alone.
+  close (copy);
+  copy = memfd_create ("cipc-test-range", MFD_CLOEXEC);
+
+  CIPC_CHECK (rx->recv_file (rx->context, copy, &length) == CIPC_OK);
+  CIPC_CHECK (length == 100000 && same_bytes (source, 4096, copy, 100000));
+
+  CIPC_CHECK (rx->recv_file (rx->context, copy, &length) == CIPC_OK && length == 0);
+
+  pthread_join (thread, NULL);
+  CIPC_CHECK (!sender.failed);
+
+  close (copy);
+  close (source);
+
+  cipc_free (tx);
+  cipc_free (rx);
+}
+
+static void
+test_memfd_frame (void)
+{
+  int fds[2];
+  CIPC_CHECK (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+
+  cipc_counters counters[2];
+  cipc_stream streams[2];
+
+  for (int i = 0; i < 2; i++)
+    {
+      cipc_counters_init (&counters[i]);
+      cipc_stream_init (&streams[i], fds[i], 1, 64 * 1024, 64 * 1024 * 1024, CIPC_BAD_UNIX_SEND,
+                        CIPC_BAD_UNIX_RECV, &counters[i]);
+
+      streams[i].pass_fds = 1;
+      streams[i].fd_threshold = 4096;
+    }
+
+  static char message[100000];
+  memset (message, 'q', sizeof (message));
+
+  cipc_iovec small = { .base = "first part", .length = 10 };
+  cipc_iovec large = { .base = message, .length = sizeof (message) };
+
+  CIPC_CHECK (cipc_stream_sendv (&streams[0], &small, 1, 0) == CIPC_OK);
+  CIPC_CHECK (cipc_stream_sendv (&streams[0], &large, 1, 0) == CIPC_OK);
+  CIPC_CHECK (cipc_stream_sendv (&streams[0], &small, 1, 0) == CIPC_OK);
+
+  int out = memfd_create ("cipc-test-out", MFD_CLOEXEC);
+  size_t length = 0;
+
+  CIPC_CHECK (cipc_stream_recv_file (&streams[1], out, &length) == CIPC_OK && length == 10);
+
+  // The large message travelled as a memfd; its frame is consumed along with the descriptor.
+  close (out);
+  out = memfd_create ("cipc-test-out", MFD_CLOEXEC);
+
+  CIPC_CHECK (cipc_stream_recv_file (&streams[1], out, &length) == CIPC_OK);
+  CIPC_CHECK (length == sizeof (message) && streams[1].rx_fds_count == 0);
+
+  char *data = mmap (NULL, sizeof (message), PROT_READ, MAP_SHARED, out, 0);
+  CIPC_CHECK (data != MAP_FAILED && memcmp (data, message, sizeof (message)) == 0);
+
+  if (data != MAP_FAILED)
+    munmap (data, sizeof (message));
+
+  char buffer[16];
+  CIPC_CHECK (cipc_stream_recv (&streams[1], buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 10 && strcmp (buffer, "first part") == 0);
+
+  close (out);
+
+  for (int i = 0; i < 2; i++)
+    {
+      cipc_stream_destroy (&streams[i]);
+      cipc_counters_destroy (&counters[i]);
+    }
+}
+
+int
+main (void)
+{
+  test_tcp ();
+  test_memfd_frame ();
+
+  return CIPC_TEST_RESULT ();
+}
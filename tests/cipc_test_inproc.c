@@ -0,0 +1,207 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "backend/cipc_inproc.h"
+#include "cipc.h"
+#include "cipc_buf.h"
+#include "cipc_test.h"
+
+// In-process endpoints: round trips, buffers handed over without a copy, one connection per
+// name, and closing from either end, after which the other end drains its queue and fails. A
+// bound end whose peer left takes the next connect. Then a stream between threads through a
+// queue small enough to fill.
+
+#define TEST_STREAM_MESSAGES 100000
+
+static cipc *
+start (const char *name, cipc_inproc_mode mode, size_t capacity)
+{
+  cipc_inproc_config config = {
+    .name = name,
+    .mode = mode,
+    .capacity = capacity,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+  };
+
+  cipc *instance = cipc_create (CIPC_PROTOCOL_INPROC);
+  if (instance && instance->init (&instance->context, &config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+static void
+test_round_trip (cipc *server, cipc *client)
+{
+  char buffer[16];
+  size_t length = 0;
+
+  CIPC_CHECK (client->send (client->context, "ping", 4) == CIPC_OK);
+  CIPC_CHECK (server->recv (server->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 4 && strcmp (buffer, "ping") == 0);
+
+  // Too small a buffer leaves the message queued.
+  CIPC_CHECK (server->send (server->context, "pong", 4) == CIPC_OK);
+  CIPC_CHECK (client->recv (client->context, buffer, 4, &length) == CIPC_BAD_BUFFER_SIZE);
+  CIPC_CHECK (length == 4);
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 4 && strcmp (buffer, "pong") == 0);
+
+  // The receiver gets the sender's buffer itself.
+  cipc_buf *sent = cipc_buf_alloc (64);
+  CIPC_CHECK (sent != NULL);
+  if (!sent)
+    return;
+
+  memcpy (sent->data, "shared", 6);
+  sent->length = 6;
+
+  cipc_buf *received = NULL;
+
+  CIPC_CHECK (cipc_buf_send (client, sent) == CIPC_OK);
+  CIPC_CHECK (cipc_buf_recv (server, &received) == CIPC_OK);
+  CIPC_CHECK (received == sent && received->length == 6);
+
+  cipc_buf_unref (sent);
+
+  if (received)
+    cipc_buf_unref (received);
+}
+
+static void
+test_close (const char *name)
+{
+  cipc *server = start (name, CIPC_INPROC_MODE_BIND, 0);
+  cipc *client = start (name, CIPC_INPROC_MODE_CONNECT, 0);
+
+  CIPC_CHECK (server && client);
+  if (!server || !client)
+    {
+      cipc_free (client);
+      cipc_free (server);
+      return;
+    }
+
+  // One connection and one binding per name.
+  CIPC_CHECK (start (name, CIPC_INPROC_MODE_CONNECT, 0) == NULL);
+  CIPC_CHECK (start (name, CIPC_INPROC_MODE_BIND, 0) == NULL);
+
+  test_round_trip (server, client);
+
+  // The client leaves with messages queued; the server reads them, then fails.
+  CIPC_CHECK (client->send (client->context, "one", 3) == CIPC_OK);
+  CIPC_CHECK (client->send (client->context, "two", 3) == CIPC_OK);
+  CIPC_CHECK (server->send (server->context, "dropped", 7) == CIPC_OK);
+
+  cipc_free (client);
+
+  char buffer[16];
+  size_t length = 0;
+
+  CIPC_CHECK (server->recv (server->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (strcmp (buffer, "one") == 0);
+  CIPC_CHECK (server->recv (server->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (strcmp (buffer, "two") == 0);
+  CIPC_CHECK (server->recv (server->context, buffer, sizeof (buffer), &length)
+              == CIPC_BAD_INPROC_RECV);
+  CIPC_CHECK (server->send (server->context, "nobody", 6) == CIPC_BAD_INPROC_SEND);
+
+  // A new client is served as the first was, without what was queued for the old one.
+  client = start (name, CIPC_INPROC_MODE_CONNECT, 0);
+  CIPC_CHECK (client != NULL);
+  if (!client)
+    {
+      cipc_free (server);
+      return;
+    }
+
+  test_round_trip (server, client);
+
+  // Now the server leaves; the client drains its queue, then fails, and the name is free.
+  CIPC_CHECK (server->send (server->context, "last", 4) == CIPC_OK);
+
+  cipc_free (server);
+
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 4 && strcmp (buffer, "last") == 0);
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length)
+              == CIPC_BAD_INPROC_RECV);
+  CIPC_CHECK (client->send (client->context, "nobody", 6) == CIPC_BAD_INPROC_SEND);
+
+  server = start (name, CIPC_INPROC_MODE_BIND, 0);
+  CIPC_CHECK (server != NULL);
+
+  cipc_free (server);
+  cipc_free (client);
+}
+
+static void *
+produce (void *arg)
+{
+  cipc *tx = (cipc *)arg;
+
+  for (uint32_t i = 0; i < TEST_STREAM_MESSAGES; i++)
+    if (tx->send (tx->context, (const char *)&i, sizeof (i)) != CIPC_OK)
+      break;
+
+  return NULL;
+}
+
+static void
+test_stream (const char *name)
+{
+  cipc *server = start (name, CIPC_INPROC_MODE_BIND, 8);
+  cipc *client = start (name, CIPC_INPROC_MODE_CONNECT, 0);
+
+  CIPC_CHECK (server && client);
+  if (!server || !client)
+    {
+      cipc_free (client);
+      cipc_free (server);
+      return;
+    }
+
+  pthread_t thread;
+  CIPC_CHECK (pthread_create (&thread, NULL, produce, client) == 0);
+
+  uint32_t received = 0;
+
+  while (received < TEST_STREAM_MESSAGES)
+    {
+      cipc_msg msgs[16];
+      size_t count = 0;
+
+      if (server->recv_batch (server->context, msgs, 16, &count) != CIPC_OK)
+        break;
+
+      for (size_t i = 0; i < count; i++, received++)
+        {
+          uint32_t seq;
+          memcpy (&seq, msgs[i].data, sizeof (seq));
+
+          CIPC_CHECK (seq == received && msgs[i].length == sizeof (seq));
+
+          server->release_msg (server->context, &msgs[i]);
+        }
+    }
+
+  CIPC_CHECK (received == TEST_STREAM_MESSAGES);
+
+  pthread_join (thread, NULL);
+
+  cipc_free (client);
+  cipc_free (server);
+}
+
+int
+main (void)
+{
+  test_close ("test-close");
+  test_stream ("test-stream");
+
+  return CIPC_TEST_RESULT ();
+}
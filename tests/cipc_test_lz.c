@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include "cipc_lz.h"
+#include "cipc_test.h"
+
+// LZ round trips over random, repetitive and text-like inputs, a capacity too small for the
+// result, and decoding of corrupted or truncated blocks, which must fail cleanly.
+
+#define TEST_ROUNDS 4000
+#define TEST_MAX_LENGTH 5000
+
+static uint64_t rng = 0x9e3779b97f4a7c15ull;
+
+static uint32_t
+next_random (void)
+{
+  // xorshift64
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+
+  return (uint32_t)rng;
+}
+
+static void
+fill (char *data, size_t length, int kind)
+{
+  for (size_t i = 0; i < length; i++)
+    switch (kind)
+      {
+      case 0:
+        data[i] = (char)next_random ();
+        break;
+      case 1:
+        data[i] = (char)('a' + next_random () % 3);
+        break;
+      case 2:
+        data[i] = "abcdefgh"[i % 8];
+        break;
+      default:
+        // Copies of recent bytes mixed with fresh ones, as in text.
+        data[i] = i > 10 && next_random () % 4 ? data[i - 1 - next_random () % 10]
+                                               : (char)next_random ();
+        break;
+      }
+}
+
+static void
+test_round_trips (void)
+{
+  char *src = malloc (TEST_MAX_LENGTH);
+  char *dst = malloc (TEST_MAX_LENGTH * 2 + 64);
+  char *out = malloc (TEST_MAX_LENGTH);
+  int bad = 0;
+
+  if (!src || !dst || !out)
+    {
+      CIPC_CHECK (src && dst && out);
+      free (src);
+      free (dst);
+      free (out);
+      return;
+    }
+
+  for (int round = 0; round < TEST_ROUNDS && !bad; round++)
+    {
+      size_t length = next_random () % TEST_MAX_LENGTH;
+
+      fill (src, length, round % 4);
+
+      size_t compressed = cipc_lz_compress (src, length, dst, TEST_MAX_LENGTH * 2 + 64);
+
+      bad |= compressed == 0 && length > 0;
+      bad |= cipc_lz_decompress (dst, compressed, out, length) != CIPC_OK;
+      bad |= memcmp (src, out, length) != 0;
+
+      // Damaged input decodes to an error or to wrong bytes, never past the output.
+      for (int k = 0; k < 4 && compressed > 0; k++)
+        {
+          dst[next_random () % compressed] ^= (char)(1 << next_random () % 8);
+
+          cipc_lz_decompress (dst, compressed, out, length);
+          cipc_lz_decompress (dst, next_random () % (compressed + 1), out, length);
+        }
+
+      if (bad)
+        fprintf (stderr, "round %d: %zu bytes of kind %d\n", round, length, round % 4);
+    }
+
+  CIPC_CHECK (!bad);
+
+  free (src);
+  free (dst);
+  free (out);
+}
+
+static void
+test_compressible (void)
+{
+  char src[4096];
+  char dst[4096];
+  char out[4096];
+
+  fill (src, sizeof (src), 2);
+
+  size_t compressed = cipc_lz_compress (src, sizeof (src), dst, sizeof (dst));
+
+  CIPC_CHECK (compressed > 0 && compressed < sizeof (src) / 10);
+  CIPC_CHECK (cipc_lz_decompress (dst, compressed, out, sizeof (out)) == CIPC_OK);
+  CIPC_CHECK (memcmp (src, out, sizeof (src)) == 0);
+
+  // The stated length must match what the block decodes to.
+  CIPC_CHECK (cipc_lz_decompress (dst, compressed, out, sizeof (out) - 1) == CIPC_BAD_CODEC);
+}
+
+static void
+test_small_capacity (void)
+{
+  char src[1024];
+  char dst[1024];
+
+  fill (src, sizeof (src), 0);
+
+  CIPC_CHECK (cipc_lz_compress (src, sizeof (src), dst, 100) == 0);
+}
+
+int
+main (void)
+{
+  test_round_trips ();
+  test_compressible ();
+  test_small_capacity ();
+
+  return CIPC_TEST_RESULT ();
+}
@@ -0,0 +1,141 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "backend/cipc_inproc.h"
+#include "backend/cipc_shm.h"
+#include "cipc.h"
+#include "cipc_internal.h"
+#include "cipc_test.h"
+
+// cipc_poll over a backend with a descriptor to wait on (in-process) and one without (shared
+// memory): timeouts, which instances are reported ready, and a wakeup from another thread.
+
+typedef struct
+{
+  cipc *tx;
+  int delay_us;
+} test_sender;
+
+static cipc *
+start (cipc_protocol protocol, const void *config)
+{
+  cipc *instance = cipc_create (protocol);
+  if (instance && instance->init (&instance->context, config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+static void *
+send_later (void *arg)
+{
+  test_sender *sender = (test_sender *)arg;
+
+  usleep (sender->delay_us);
+  sender->tx->send (sender->tx->context, "late", 4);
+
+  return NULL;
+}
+
+static void
+check_ready (cipc *const *rx, int *ready, int expect0, int expect1)
+{
+  size_t nready = 0;
+
+  CIPC_CHECK (cipc_poll (rx, 2, -1, ready, &nready) == CIPC_OK);
+  CIPC_CHECK (nready == (size_t)(expect0 + expect1));
+  CIPC_CHECK (ready[0] == expect0 && ready[1] == expect1);
+}
+
+int
+main (void)
+{
+  char shm_name[64];
+  snprintf (shm_name, sizeof (shm_name), "/cipc-test-poll-%d", (int)getpid ());
+
+  cipc_shm_config shm_config = {
+    .name = shm_name,
+    .mode = CIPC_SHM_MODE_BIND,
+    .capacity = 4096,
+    .sockopt_sndtimeo = 1000,
+    .sockopt_rcvtimeo = 1000,
+  };
+
+  cipc_inproc_config inproc_config = {
+    .name = "poll",
+    .mode = CIPC_INPROC_MODE_BIND,
+    .capacity = 16,
+    .sockopt_sndtimeo = 1000,
+    .sockopt_rcvtimeo = 1000,
+  };
+
+  cipc *shm_tx = start (CIPC_PROTOCOL_SHM, &shm_config);
+  cipc *inproc_tx = start (CIPC_PROTOCOL_INPROC, &inproc_config);
+
+  shm_config.mode = CIPC_SHM_MODE_CONNECT;
+  inproc_config.mode = CIPC_INPROC_MODE_CONNECT;
+
+  cipc *rx[2] = { start (CIPC_PROTOCOL_SHM, &shm_config),
+                  start (CIPC_PROTOCOL_INPROC, &inproc_config) };
+
+  if (!shm_tx || !inproc_tx || !rx[0] || !rx[1])
+    {
+      fprintf (stderr, "Failed to set up the instances!\n");
+      return EXIT_FAILURE;
+    }
+
+  int ready[2] = { -1, -1 };
+  size_t nready = 1;
+  char buffer[16];
+  size_t length;
+
+  // Nothing to wait for: returns at once, whatever the timeout.
+  CIPC_CHECK (cipc_poll (rx, 0, -1, ready, &nready) == CIPC_OK && nready == 0);
+
+  CIPC_CHECK (cipc_poll (rx, 2, 0, ready, &nready) == CIPC_OK);
+  CIPC_CHECK (nready == 0 && ready[0] == 0 && ready[1] == 0);
+
+  int64_t before = cipc_monotonic_ms ();
+
+  CIPC_CHECK (cipc_poll (rx, 2, 50, ready, &nready) == CIPC_OK && nready == 0);
+  CIPC_CHECK (cipc_monotonic_ms () - before >= 45);
+
+  // Each instance is reported while its message waits, and no longer once it is received.
+  CIPC_CHECK (inproc_tx->send (inproc_tx->context, "one", 3) == CIPC_OK);
+  check_ready (rx, ready, 0, 1);
+
+  CIPC_CHECK (shm_tx->send (shm_tx->context, "two", 3) == CIPC_OK);
+  check_ready (rx, ready, 1, 1);
+
+  CIPC_CHECK (rx[1]->recv (rx[1]->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  check_ready (rx, ready, 1, 0);
+
+  CIPC_CHECK (rx[0]->recv (rx[0]->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+
+  // Messages sent while cipc_poll waits wake it, with and without a descriptor.
+  test_sender senders[2] = { { .tx = shm_tx, .delay_us = 50000 },
+                             { .tx = inproc_tx, .delay_us = 50000 } };
+
+  for (int i = 0; i < 2; i++)
+    {
+      pthread_t thread;
+      CIPC_CHECK (pthread_create (&thread, NULL, send_later, &senders[i]) == 0);
+
+      check_ready (rx, ready, i == 0, i == 1);
+
+      pthread_join (thread, NULL);
+
+      CIPC_CHECK (rx[i]->recv (rx[i]->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+      CIPC_CHECK (strcmp (buffer, "late") == 0);
+    }
+
+  cipc_free (rx[1]);
+  cipc_free (rx[0]);
+  cipc_free (inproc_tx);
+  cipc_free (shm_tx);
+
+  return CIPC_TEST_RESULT ();
+}
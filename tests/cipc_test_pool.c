@@ -0,0 +1,171 @@
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_internal.h"
+#include "cipc_pool.h"
+#include "cipc_test.h"
+
+// A pool of two connections to each of three TCP servers, one of which is down at first: sends
+// go round robin over the live ones, the missing server is picked up once it starts, and a
+// connection released with a transport error is rebuilt.
+
+#define TEST_ENDPOINTS 3
+#define TEST_CONNECTIONS 2
+
+static cipc *
+start_server (int port)
+{
+  cipc_tcp_config config = {
+    .host = "127.0.0.1",
+    .port = port,
+    .mode = CIPC_TCP_MODE_SERVER,
+    .sockopt_sndtimeo = 2000,
+    .sockopt_rcvtimeo = 2000,
+    .backlog = 16,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+  };
+
+  cipc *server = cipc_create (CIPC_PROTOCOL_TCP);
+  if (server && server->init (&server->context, &config) != CIPC_OK)
+    {
+      cipc_free (server);
+      return NULL;
+    }
+
+  return server;
+}
+
+// Waits up to timeout_ms for the pool to have count connections in rotation.
+static int
+wait_available (cipc_pool *pool, size_t count, int timeout_ms)
+{
+  int64_t deadline = cipc_monotonic_ms () + timeout_ms;
+
+  while (cipc_pool_available (pool) != count)
+    {
+      if (cipc_monotonic_ms () > deadline)
+        return 0;
+
+      usleep (5000);
+    }
+
+  return 1;
+}
+
+static int
+drain (cipc *server, int count)
+{
+  char buffer[64];
+  size_t length;
+  cipc_peer_id peer;
+  int received = 0;
+
+  while (received < count
+         && server->recv_from (server->context, &peer, buffer, sizeof (buffer), &length)
+                == CIPC_OK)
+    received++;
+
+  return received;
+}
+
+int
+main (void)
+{
+  int ports[TEST_ENDPOINTS];
+  cipc_tcp_config configs[TEST_ENDPOINTS];
+  cipc_pool_endpoint endpoints[TEST_ENDPOINTS];
+  cipc *servers[TEST_ENDPOINTS] = { NULL };
+
+  for (int i = 0; i < TEST_ENDPOINTS; i++)
+    {
+      ports[i] = cipc_test_free_port ();
+
+      configs[i] = (cipc_tcp_config){
+        .host = "127.0.0.1",
+        .port = ports[i],
+        .mode = CIPC_TCP_MODE_CONNECT,
+        .sockopt_sndtimeo = 2000,
+        .sockopt_rcvtimeo = 2000,
+        .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+      };
+
+      endpoints[i] = (cipc_pool_endpoint){ .protocol = CIPC_PROTOCOL_TCP, .config = &configs[i] };
+    }
+
+  // The last server stays down for now.
+  for (int i = 0; i < TEST_ENDPOINTS - 1; i++)
+    {
+      servers[i] = start_server (ports[i]);
+      CIPC_CHECK (servers[i] != NULL);
+    }
+
+  cipc_pool_config config = {
+    .endpoints = endpoints,
+    .endpoint_count = TEST_ENDPOINTS,
+    .connections_per_endpoint = TEST_CONNECTIONS,
+    .strategy = CIPC_POOL_ROUND_ROBIN,
+    .retry_interval_ms = 20,
+    .max_retry_interval_ms = 100,
+  };
+
+  cipc_pool *pool = NULL;
+
+  CIPC_CHECK (cipc_pool_create (&pool, &config) == CIPC_OK);
+  if (!pool)
+    return CIPC_TEST_RESULT ();
+
+  CIPC_CHECK (cipc_pool_available (pool) == 2 * TEST_CONNECTIONS);
+
+  // Round robin spreads the sends evenly over the servers that are up.
+  for (int i = 0; i < 8; i++)
+    CIPC_CHECK (cipc_pool_send (pool, "spread", 6) == CIPC_OK);
+
+  CIPC_CHECK (drain (servers[0], 4) == 4);
+  CIPC_CHECK (drain (servers[1], 4) == 4);
+
+  // A lease is a plain instance: a request and its reply.
+  cipc_pool_lease lease;
+  char buffer[64];
+  size_t length;
+  cipc_peer_id peer;
+
+  CIPC_CHECK (cipc_pool_acquire (pool, &lease) == CIPC_OK);
+  CIPC_CHECK (lease.instance->send (lease.instance->context, "ping", 4) == CIPC_OK);
+
+  int answered = 0;
+
+  for (int i = 0; i < 2 && !answered; i++)
+    if (servers[i]->recv_from (servers[i]->context, &peer, buffer, sizeof (buffer), &length)
+        == CIPC_OK)
+      {
+        CIPC_CHECK (strcmp (buffer, "ping") == 0);
+        CIPC_CHECK (servers[i]->send_to (servers[i]->context, peer, "pong", 4) == CIPC_OK);
+        answered = 1;
+      }
+
+  CIPC_CHECK (answered);
+  CIPC_CHECK (lease.instance->recv (lease.instance->context, buffer, sizeof (buffer), &length)
+              == CIPC_OK);
+  CIPC_CHECK (strcmp (buffer, "pong") == 0);
+
+  cipc_pool_release (pool, &lease, CIPC_OK);
+
+  // The ejected endpoint comes back into rotation once its server is up.
+  servers[2] = start_server (ports[2]);
+  CIPC_CHECK (servers[2] != NULL);
+  CIPC_CHECK (wait_available (pool, TEST_ENDPOINTS * TEST_CONNECTIONS, 5000));
+
+  // A transport error retires the connection; it is rebuilt in the background.
+  CIPC_CHECK (cipc_pool_acquire (pool, &lease) == CIPC_OK);
+  cipc_pool_release (pool, &lease, CIPC_BAD_TCP_SEND);
+
+  CIPC_CHECK (wait_available (pool, TEST_ENDPOINTS * TEST_CONNECTIONS, 5000));
+
+  cipc_pool_free (pool);
+
+  for (int i = 0; i < TEST_ENDPOINTS; i++)
+    cipc_free (servers[i]);
+
+  return CIPC_TEST_RESULT ();
+}
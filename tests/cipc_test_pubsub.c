@@ -0,0 +1,191 @@
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_internal.h"
+#include "cipc_pubsub.h"
+#include "cipc_test.h"
+
+// A TCP server publisher with one subscriber that keeps up and one that never reads until the
+// end, once per overflow policy. The fast subscriber gets every message whatever happens to the
+// slow one; the slow one misses messages under REJECT, still gets the latest under CONFLATE, and
+// is dropped under DISCONNECT.
+
+#define TEST_MESSAGES 4000
+#define TEST_PAYLOAD 1024
+
+static cipc *
+start (cipc_tcp_mode mode, int port, cipc_tcp_overflow overflow)
+{
+  cipc_tcp_config config = {
+    .host = "127.0.0.1",
+    .port = port,
+    .mode = mode,
+    .sockopt_sndtimeo = 2000,
+    .sockopt_rcvtimeo = mode == CIPC_TCP_MODE_SERVER ? 0 : 300,
+    .backlog = 4,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+    .max_pending_bytes = 16 * 1024,
+    .overflow = overflow,
+    // Small kernel buffers, so that a subscriber that does not read backs up quickly.
+    .socket_sndbuf = 4096,
+    .socket_rcvbuf = 4096,
+  };
+
+  cipc *instance = cipc_create (CIPC_PROTOCOL_TCP);
+  if (instance && instance->init (&instance->context, &config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+static int
+wait_subscribers (cipc_pub *pub, size_t count)
+{
+  int64_t deadline = cipc_monotonic_ms () + 2000;
+
+  while (cipc_pub_update (pub) == CIPC_OK && cipc_pub_subscribers (pub) != count)
+    {
+      if (cipc_monotonic_ms () > deadline)
+        return 0;
+
+      usleep (1000);
+    }
+
+  return cipc_pub_subscribers (pub) == count;
+}
+
+static uint32_t
+payload_seq (const cipc_pubsub_msg *msg)
+{
+  uint32_t seq = UINT32_MAX;
+
+  if (msg->length == TEST_PAYLOAD)
+    memcpy (&seq, msg->data, sizeof (seq));
+
+  return seq;
+}
+
+static void
+run (cipc_tcp_overflow overflow)
+{
+  int port = cipc_test_free_port ();
+
+  cipc *server = start (CIPC_TCP_MODE_SERVER, port, overflow);
+  cipc *fast_transport = server ? start (CIPC_TCP_MODE_CONNECT, port, overflow) : NULL;
+  cipc *slow_transport = server ? start (CIPC_TCP_MODE_CONNECT, port, overflow) : NULL;
+
+  cipc_pub *pub = NULL;
+  cipc_sub *fast = NULL;
+  cipc_sub *slow = NULL;
+
+  CIPC_CHECK (server && fast_transport && slow_transport);
+  if (!server || !fast_transport || !slow_transport)
+    goto out;
+
+  CIPC_CHECK (cipc_pub_create (&pub, server) == CIPC_OK);
+  CIPC_CHECK (cipc_sub_create (&fast, fast_transport) == CIPC_OK);
+  CIPC_CHECK (cipc_sub_create (&slow, slow_transport) == CIPC_OK);
+
+  if (!pub || !fast || !slow)
+    goto out;
+
+  CIPC_CHECK (cipc_subscribe (fast, "ticks") == CIPC_OK);
+  CIPC_CHECK (cipc_subscribe (slow, "ticks/") == CIPC_OK);
+  CIPC_CHECK (wait_subscribers (pub, 2));
+
+  cipc_pubsub_msg msg;
+  char payload[TEST_PAYLOAD] = { 0 };
+  int bad = 0;
+
+  for (uint32_t seq = 0; seq < TEST_MESSAGES && !bad; seq++)
+    {
+      // Topics outside every prefix go nowhere.
+      if (seq % 100 == 0)
+        bad |= cipc_publish (pub, "news", "skipped", 7) != CIPC_OK;
+
+      memcpy (payload, &seq, sizeof (seq));
+      bad |= cipc_publish (pub, "ticks/a", payload, sizeof (payload)) != CIPC_OK;
+
+      bad |= cipc_sub_recv (fast, &msg) != CIPC_OK;
+      if (!bad)
+        {
+          bad |= payload_seq (&msg) != seq;
+          bad |= msg.topic_length != 7 || memcmp (msg.topic, "ticks/a", 7) != 0;
+
+          cipc_sub_release (fast, &msg);
+        }
+    }
+
+  CIPC_CHECK (!bad);
+
+  // The slow subscriber reads what reached it, in order, until nothing more comes. The
+  // publisher's updates keep writing out what its server still holds for it.
+  uint32_t received = 0;
+  uint32_t last = 0;
+  int ordered = 1;
+  int first = 1;
+
+  while (cipc_pub_update (pub) == CIPC_OK && cipc_sub_recv (slow, &msg) == CIPC_OK)
+    {
+      uint32_t seq = payload_seq (&msg);
+
+      ordered &= first || seq > last;
+      first = 0;
+      last = seq;
+      received++;
+
+      cipc_sub_release (slow, &msg);
+    }
+
+  CIPC_CHECK (ordered);
+  CIPC_CHECK (received > 0 && received < TEST_MESSAGES);
+
+  switch (overflow)
+    {
+    case CIPC_TCP_OVERFLOW_CONFLATE:
+      CIPC_CHECK (last == TEST_MESSAGES - 1);
+      break;
+    case CIPC_TCP_OVERFLOW_DISCONNECT:
+      CIPC_CHECK (last < TEST_MESSAGES - 1);
+      CIPC_CHECK (wait_subscribers (pub, 1));
+      break;
+    case CIPC_TCP_OVERFLOW_REJECT:
+    default:
+      CIPC_CHECK (last < TEST_MESSAGES - 1);
+      CIPC_CHECK (cipc_pub_subscribers (pub) == 2);
+      break;
+    }
+
+out:
+  cipc_sub_free (slow);
+  cipc_sub_free (fast);
+  cipc_pub_free (pub);
+
+  cipc_free (slow_transport);
+  cipc_free (fast_transport);
+  cipc_free (server);
+}
+
+int
+main (void)
+{
+  cipc_tcp_overflow policies[] = { CIPC_TCP_OVERFLOW_REJECT, CIPC_TCP_OVERFLOW_CONFLATE,
+                                   CIPC_TCP_OVERFLOW_DISCONNECT };
+  const char *names[] = { "reject", "conflate", "disconnect" };
+
+  for (int i = 0; i < 3; i++)
+    {
+      int before = cipc_test_failures;
+
+      run (policies[i]);
+
+      if (cipc_test_failures != before)
+        fprintf (stderr, "%s: failed\n", names[i]);
+    }
+
+  return CIPC_TEST_RESULT ();
+}
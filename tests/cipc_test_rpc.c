@@ -0,0 +1,197 @@
+#include <string.h>
+
+#include "backend/cipc_shm.h"
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_rpc.h"
+#include "cipc_test.h"
+
+// Pipelined calls over a shared memory pair and over a TCP server: responses answered out of
+// order reach the call they belong to, the in-flight limit holds, and a cancelled call's
+// response is dropped.
+
+#define TEST_IN_FLIGHT 8
+
+static cipc *
+start (cipc_protocol protocol, const void *config)
+{
+  cipc *instance = cipc_create (protocol);
+  if (instance && instance->init (&instance->context, config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+static int
+is_response_to (const cipc_rpc_response *response, int index)
+{
+  char expected[32];
+  snprintf (expected, sizeof (expected), "response %d", index);
+
+  return response->length == strlen (expected)
+         && memcmp (response->data, expected, response->length) == 0;
+}
+
+// Answers count requests, last first.
+static void
+serve_reversed (cipc_rpc_server *server, int count)
+{
+  cipc_rpc_request requests[TEST_IN_FLIGHT];
+  int indexes[TEST_IN_FLIGHT];
+
+  for (int i = 0; i < count; i++)
+    {
+      char text[32] = { 0 };
+
+      CIPC_CHECK (cipc_rpc_recv_request (server, &requests[i]) == CIPC_OK);
+      CIPC_CHECK (requests[i].length < sizeof (text));
+
+      // Request data is not NUL-terminated.
+      memcpy (text, requests[i].data, requests[i].length < sizeof (text) ? requests[i].length : 0);
+      CIPC_CHECK (sscanf (text, "request %d", &indexes[i]) == 1);
+    }
+
+  for (int i = count - 1; i >= 0; i--)
+    {
+      char response[32];
+      snprintf (response, sizeof (response), "response %d", indexes[i]);
+
+      CIPC_CHECK (cipc_rpc_respond (server, &requests[i], response, strlen (response))
+                  == CIPC_OK);
+
+      cipc_rpc_release_request (server, &requests[i]);
+    }
+}
+
+static void
+test_pipeline (cipc *client_transport, cipc *server_transport)
+{
+  cipc_rpc_client *client = NULL;
+  cipc_rpc_server *server = NULL;
+
+  CIPC_CHECK (cipc_rpc_client_create (&client, client_transport, TEST_IN_FLIGHT) == CIPC_OK);
+  CIPC_CHECK (cipc_rpc_server_create (&server, server_transport) == CIPC_OK);
+
+  if (!client || !server)
+    return;
+
+  cipc_rpc_handle handles[TEST_IN_FLIGHT];
+  cipc_rpc_handle handle;
+  cipc_rpc_response response;
+
+  for (int i = 0; i < TEST_IN_FLIGHT; i++)
+    {
+      char request[32];
+      snprintf (request, sizeof (request), "request %d", i);
+
+      CIPC_CHECK (cipc_rpc_call (client, request, strlen (request), &handles[i]) == CIPC_OK);
+    }
+
+  CIPC_CHECK (cipc_rpc_in_flight (client) == TEST_IN_FLIGHT);
+  CIPC_CHECK (cipc_rpc_call (client, "one too many", 12, &handle) == CIPC_WOULD_BLOCK);
+
+  serve_reversed (server, TEST_IN_FLIGHT);
+
+  // Waiting for the first call reads past all the others, which are kept for later.
+  CIPC_CHECK (cipc_rpc_wait (client, handles[0], &response) == CIPC_OK);
+  CIPC_CHECK (is_response_to (&response, 0));
+  cipc_rpc_release (client, &response);
+
+  CIPC_CHECK (cipc_rpc_wait (client, handles[0], &response) == CIPC_BAD_RPC_HANDLE);
+
+  CIPC_CHECK (cipc_rpc_wait (client, handles[5], &response) == CIPC_OK);
+  CIPC_CHECK (is_response_to (&response, 5));
+  cipc_rpc_release (client, &response);
+
+  int seen = (1 << 0) | (1 << 5);
+
+  while (cipc_rpc_in_flight (client) > 0)
+    {
+      CIPC_CHECK (cipc_rpc_wait_any (client, &handle, &response) == CIPC_OK);
+
+      for (int i = 0; i < TEST_IN_FLIGHT; i++)
+        if (handles[i] == handle)
+          {
+            CIPC_CHECK (is_response_to (&response, i) && !(seen & (1 << i)));
+            seen |= 1 << i;
+          }
+
+      cipc_rpc_release (client, &response);
+    }
+
+  CIPC_CHECK (seen == (1 << TEST_IN_FLIGHT) - 1);
+
+  // A cancelled call's response is skipped by the wait for the next call.
+  cipc_rpc_handle cancelled;
+
+  CIPC_CHECK (cipc_rpc_call (client, "request 100", 11, &cancelled) == CIPC_OK);
+  CIPC_CHECK (cipc_rpc_call (client, "request 101", 11, &handle) == CIPC_OK);
+
+  cipc_rpc_cancel (client, cancelled);
+  CIPC_CHECK (cipc_rpc_in_flight (client) == 1);
+
+  serve_reversed (server, 2);
+
+  CIPC_CHECK (cipc_rpc_wait (client, handle, &response) == CIPC_OK);
+  CIPC_CHECK (is_response_to (&response, 101));
+  cipc_rpc_release (client, &response);
+
+  CIPC_CHECK (cipc_rpc_in_flight (client) == 0);
+  CIPC_CHECK (cipc_rpc_wait_any (client, &handle, &response) == CIPC_BAD_RPC_HANDLE);
+
+  cipc_rpc_server_free (server);
+  cipc_rpc_client_free (client);
+}
+
+int
+main (void)
+{
+  char name[64];
+  snprintf (name, sizeof (name), "/cipc-test-rpc-%d", (int)getpid ());
+
+  cipc_shm_config shm_config = {
+    .name = name,
+    .mode = CIPC_SHM_MODE_BIND,
+    .capacity = 64 * 1024,
+    .sockopt_sndtimeo = 2000,
+    .sockopt_rcvtimeo = 2000,
+  };
+
+  cipc *shm_client = start (CIPC_PROTOCOL_SHM, &shm_config);
+  shm_config.mode = CIPC_SHM_MODE_CONNECT;
+  cipc *shm_server = start (CIPC_PROTOCOL_SHM, &shm_config);
+
+  CIPC_CHECK (shm_client && shm_server);
+  if (shm_client && shm_server)
+    test_pipeline (shm_client, shm_server);
+
+  cipc_free (shm_server);
+  cipc_free (shm_client);
+
+  // Through a server with peers, the responses go back with send_to.
+  cipc_tcp_config tcp_config = {
+    .host = "127.0.0.1",
+    .port = cipc_test_free_port (),
+    .mode = CIPC_TCP_MODE_SERVER,
+    .sockopt_sndtimeo = 2000,
+    .sockopt_rcvtimeo = 2000,
+    .backlog = 4,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+  };
+
+  cipc *tcp_server = start (CIPC_PROTOCOL_TCP, &tcp_config);
+  tcp_config.mode = CIPC_TCP_MODE_CONNECT;
+  cipc *tcp_client = tcp_server ? start (CIPC_PROTOCOL_TCP, &tcp_config) : NULL;
+
+  CIPC_CHECK (tcp_client && tcp_server);
+  if (tcp_client && tcp_server)
+    test_pipeline (tcp_client, tcp_server);
+
+  cipc_free (tcp_client);
+  cipc_free (tcp_server);
+
+  return CIPC_TEST_RESULT ();
+}
@@ -0,0 +1,272 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "backend/cipc_shm.h"
+#include "cipc.h"
+#include "cipc_test.h"
+
+// The shared memory ring: records of varying size across many wraparounds, a full ring, and
+// borrowed views that keep their bytes until released, in any order.
+
+#define TEST_CAPACITY 4096
+#define TEST_STREAM_MESSAGES 100000
+
+static char
+fill_byte (int round, int index)
+{
+  return (char)('A' + (round + index) % 26);
+}
+
+static int
+check_fill (const char *data, size_t length, char byte)
+{
+  for (size_t i = 0; i < length; i++)
+    if (data[i] != byte)
+      return 0;
+
+  return 1;
+}
+
+static void
+test_wraparound (cipc *tx, cipc *rx)
+{
+  char message[TEST_CAPACITY / 2];
+  char buffer[TEST_CAPACITY / 2 + 1];
+  int bad = 0;
+
+  for (int round = 0; round < 2000 && !bad; round++)
+    {
+      int count = 1 + round % 3;
+
+      for (int i = 0; i < count; i++)
+        {
+          size_t length = 1 + (size_t)(round * 7 + i * 13) % 600;
+
+          memset (message, fill_byte (round, i), length);
+          bad |= tx->send (tx->context, message, length) != CIPC_OK;
+        }
+
+      for (int i = 0; i < count && !bad; i++)
+        {
+          size_t length = 0;
+
+          bad |= rx->recv (rx->context, buffer, sizeof (buffer), &length) != CIPC_OK;
+          bad |= length != 1 + (size_t)(round * 7 + i * 13) % 600;
+          bad |= !check_fill (buffer, length, fill_byte (round, i)) || buffer[length] != '\0';
+        }
+    }
+
+  CIPC_CHECK (!bad);
+}
+
+static void
+test_full_ring (cipc *tx, cipc *rx)
+{
+  char message[512];
+  memset (message, 'f', sizeof (message));
+
+  int sent = 0;
+  while (sent < 64 && tx->send (tx->context, message, sizeof (message)) == CIPC_OK)
+    sent++;
+
+  // The send timeout ends the loop well before 64 records of 512 bytes.
+  CIPC_CHECK (sent > 0 && sent < 64);
+
+  for (int i = 0; i < sent; i++)
+    {
+      cipc_msg msg;
+
+      CIPC_CHECK (rx->recv_msg (rx->context, &msg) == CIPC_OK);
+      CIPC_CHECK (msg.length == sizeof (message));
+
+      rx->release_msg (rx->context, &msg);
+    }
+
+  CIPC_CHECK (tx->send (tx->context, message, sizeof (message)) == CIPC_OK);
+
+  cipc_msg msg;
+  CIPC_CHECK (rx->recv_msg (rx->context, &msg) == CIPC_OK);
+  rx->release_msg (rx->context, &msg);
+}
+
+static void
+test_release_out_of_order (cipc *tx, cipc *rx)
+{
+  char message[1000];
+  cipc_msg views[3];
+
+  for (int i = 0; i < 3; i++)
+    {
+      memset (message, 'a' + i, sizeof (message));
+      CIPC_CHECK (tx->send (tx->context, message, sizeof (message)) == CIPC_OK);
+    }
+
+  for (int i = 0; i < 3; i++)
+    CIPC_CHECK (rx->recv_msg (rx->context, &views[i]) == CIPC_OK);
+
+  // Releasing the later views frees nothing while the first is held, so its bytes survive the
+  // sends that follow.
+  rx->release_msg (rx->context, &views[1]);
+  rx->release_msg (rx->context, &views[2]);
+
+  memset (message, 'x', sizeof (message));
+  while (tx->send (tx->context, message, sizeof (message)) == CIPC_OK)
+    ;
+
+  CIPC_CHECK (check_fill (views[0].data, views[0].length, 'a'));
+
+  rx->release_msg (rx->context, &views[0]);
+
+  // Everything sent while the view was held is still delivered, and room is back.
+  cipc_msg msg;
+  while (rx->recv_msg (rx->context, &msg) == CIPC_OK)
+    {
+      CIPC_CHECK (check_fill (msg.data, msg.length, 'x'));
+      rx->release_msg (rx->context, &msg);
+    }
+
+  CIPC_CHECK (tx->send (tx->context, message, sizeof (message)) == CIPC_OK);
+  CIPC_CHECK (rx->recv_msg (rx->context, &msg) == CIPC_OK);
+  rx->release_msg (rx->context, &msg);
+
+  // Views released newest first, across wraparounds.
+  int bad = 0;
+
+  for (int round = 0; round < 2000 && !bad; round++)
+    {
+      int count = 1 + round % 3;
+
+      for (int i = 0; i < count; i++)
+        {
+          size_t length = 100 + (size_t)(round * 7 + i * 13) % 600;
+
+          memset (message, fill_byte (round, i), length);
+          bad |= tx->send (tx->context, message, length) != CIPC_OK;
+        }
+
+      for (int i = 0; i < count; i++)
+        bad |= rx->recv_msg (rx->context, &views[i]) != CIPC_OK;
+
+      for (int i = count - 1; i >= 0 && !bad; i--)
+        {
+          bad |= !check_fill (views[i].data, views[i].length, fill_byte (round, i));
+          rx->release_msg (rx->context, &views[i]);
+        }
+    }
+
+  CIPC_CHECK (!bad);
+}
+
+static void *
+produce (void *arg)
+{
+  cipc *tx = (cipc *)arg;
+
+  for (uint32_t i = 0; i < TEST_STREAM_MESSAGES; i++)
+    {
+      char message[64];
+      size_t length = sizeof (i) + i % 48;
+
+      memcpy (message, &i, sizeof (i));
+      memset (message + sizeof (i), (char)i, length - sizeof (i));
+
+      if (tx->send (tx->context, message, length) != CIPC_OK)
+        break;
+    }
+
+  return NULL;
+}
+
+static void
+test_concurrent (cipc *tx, cipc *rx)
+{
+  pthread_t thread;
+  CIPC_CHECK (pthread_create (&thread, NULL, produce, tx) == 0);
+
+  uint32_t received = 0;
+
+  while (received < TEST_STREAM_MESSAGES)
+    {
+      cipc_msg msgs[16];
+      size_t count = 0;
+
+      if (rx->recv_batch (rx->context, msgs, 16, &count) != CIPC_OK)
+        break;
+
+      for (size_t i = 0; i < count; i++)
+        {
+          uint32_t seq;
+          memcpy (&seq, msgs[i].data, sizeof (seq));
+
+          CIPC_CHECK (seq == received && msgs[i].length == sizeof (seq) + seq % 48);
+
+          rx->release_msg (rx->context, &msgs[i]);
+          received++;
+        }
+    }
+
+  CIPC_CHECK (received == TEST_STREAM_MESSAGES);
+
+  pthread_join (thread, NULL);
+}
+
+int
+main (void)
+{
+  char name[64];
+  snprintf (name, sizeof (name), "/cipc-test-ring-%d", (int)getpid ());
+
+  cipc_shm_config config = {
+    .name = name,
+    .mode = CIPC_SHM_MODE_BIND,
+    .capacity = TEST_CAPACITY,
+    .sockopt_sndtimeo = 50,
+    .sockopt_rcvtimeo = 50,
+  };
+
+  cipc *server = cipc_create (CIPC_PROTOCOL_SHM);
+  if (!server || server->init (&server->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to bind %s!\n", name);
+      return EXIT_FAILURE;
+    }
+
+  config.mode = CIPC_SHM_MODE_CONNECT;
+
+  cipc *client = cipc_create (CIPC_PROTOCOL_SHM);
+  if (!client || client->init (&client->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to connect to %s!\n", name);
+      cipc_free (server);
+      return EXIT_FAILURE;
+    }
+
+  test_wraparound (server, client);
+  test_wraparound (client, server);
+  test_full_ring (server, client);
+  test_release_out_of_order (server, client);
+
+  cipc_free (client);
+  cipc_free (server);
+
+  // A second pair with room for the producer to run ahead.
+  config.capacity = 64 * 1024;
+  config.sockopt_sndtimeo = 5000;
+  config.sockopt_rcvtimeo = 5000;
+
+  server = cipc_create (CIPC_PROTOCOL_SHM);
+  client = cipc_create (CIPC_PROTOCOL_SHM);
+
+  config.mode = CIPC_SHM_MODE_BIND;
+  CIPC_CHECK (server->init (&server->context, &config) == CIPC_OK);
+  config.mode = CIPC_SHM_MODE_CONNECT;
+  CIPC_CHECK (client->init (&client->context, &config) == CIPC_OK);
+
+  if (!cipc_test_failures)
+    test_concurrent (server, client);
+
+  cipc_free (client);
+  cipc_free (server);
+
+  return CIPC_TEST_RESULT ();
+}
@@ -0,0 +1,159 @@
+#include <string.h>
+
+#include "backend/cipc_shm.h"
+#include "cipc.h"
+#include "cipc_histogram.h"
+#include "cipc_stats.h"
+#include "cipc_test.h"
+
+// The histogram on known values, then the counters and latency histograms of a shared memory
+// pair as messages go through it.
+
+#define TEST_MESSAGES 1000
+
+static void
+test_histogram (void)
+{
+  cipc_histogram histogram;
+  cipc_histogram_reset (&histogram);
+
+  CIPC_CHECK (histogram.count == 0 && cipc_histogram_percentile (&histogram, 50.0) == 0);
+
+  for (uint64_t value = 1; value <= 10000; value++)
+    cipc_histogram_record (&histogram, value);
+
+  CIPC_CHECK (histogram.count == 10000 && histogram.min == 1 && histogram.max == 10000);
+  CIPC_CHECK (histogram.sum == 10000ull * 10001 / 2);
+
+  double mean = cipc_histogram_mean (&histogram);
+  CIPC_CHECK (mean > 5000.0 && mean < 5001.0);
+
+  // Each percentile is the top of its bucket: never below the exact value, and within the
+  // bucket width (1/32 of the power of two) above it.
+  double percentiles[] = { 1.0, 50.0, 90.0, 99.0, 99.9 };
+
+  for (size_t i = 0; i < sizeof (percentiles) / sizeof (percentiles[0]); i++)
+    {
+      uint64_t exact = (uint64_t)(percentiles[i] * 100.0);
+      uint64_t value = cipc_histogram_percentile (&histogram, percentiles[i]);
+
+      CIPC_CHECK (value >= exact && value <= exact + exact / 16 + 1);
+    }
+
+  CIPC_CHECK (cipc_histogram_percentile (&histogram, 100.0) == 10000);
+  CIPC_CHECK (cipc_histogram_percentile (&histogram, 0.0) == 1);
+
+  // Values below the first power of two split get a bucket each, and the top bucket holds the
+  // largest value.
+  for (uint64_t value = 0; value < 32; value++)
+    CIPC_CHECK (cipc_histogram_bucket_upper (cipc_histogram_bucket_index (value)) == value);
+
+  CIPC_CHECK (cipc_histogram_bucket_index (UINT64_MAX) == CIPC_HISTOGRAM_BUCKETS - 1);
+  CIPC_CHECK (cipc_histogram_bucket_upper (CIPC_HISTOGRAM_BUCKETS - 1) == UINT64_MAX);
+
+  cipc_histogram other;
+  cipc_histogram_reset (&other);
+  cipc_histogram_record (&other, 1000000);
+
+  cipc_histogram_merge (&histogram, &other);
+
+  CIPC_CHECK (histogram.count == 10001 && histogram.min == 1 && histogram.max == 1000000);
+}
+
+static void
+test_counters (cipc *tx, cipc *rx)
+{
+  char message[100];
+  char buffer[sizeof (message) + 1];
+  size_t length;
+  cipc_stats stats;
+
+  memset (message, 's', sizeof (message));
+
+  for (int i = 0; i < TEST_MESSAGES / 2; i++)
+    {
+      CIPC_CHECK (tx->send (tx->context, message, sizeof (message)) == CIPC_OK);
+      CIPC_CHECK (rx->recv (rx->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+    }
+
+  // Latency is off by default.
+  CIPC_CHECK (cipc_stats_get (tx, &stats) == CIPC_OK);
+  CIPC_CHECK (stats.msgs_sent == TEST_MESSAGES / 2);
+  CIPC_CHECK (stats.bytes_sent == TEST_MESSAGES / 2 * sizeof (message));
+  CIPC_CHECK (stats.send_errors == 0 && stats.msgs_received == 0);
+  CIPC_CHECK (!stats.latency_enabled && stats.send_latency.count == 0);
+
+  CIPC_CHECK (cipc_stats_enable_latency (tx, 1) == CIPC_OK);
+  CIPC_CHECK (cipc_stats_enable_latency (rx, 1) == CIPC_OK);
+
+  for (int i = 0; i < TEST_MESSAGES / 2; i++)
+    {
+      CIPC_CHECK (tx->send (tx->context, message, sizeof (message)) == CIPC_OK);
+      CIPC_CHECK (rx->recv (rx->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+    }
+
+  CIPC_CHECK (cipc_stats_get (tx, &stats) == CIPC_OK);
+  CIPC_CHECK (stats.msgs_sent == TEST_MESSAGES);
+  CIPC_CHECK (stats.latency_enabled && stats.send_latency.count == TEST_MESSAGES / 2);
+  CIPC_CHECK (stats.send_latency.min <= stats.send_latency.max && stats.send_latency.max > 0);
+
+  // A receive that times out counts as a timeout and as an error, with a latency sample.
+  CIPC_CHECK (rx->recv (rx->context, buffer, sizeof (buffer), &length) != CIPC_OK);
+
+  CIPC_CHECK (cipc_stats_get (rx, &stats) == CIPC_OK);
+  CIPC_CHECK (stats.msgs_received == TEST_MESSAGES);
+  CIPC_CHECK (stats.bytes_received == TEST_MESSAGES * sizeof (message));
+  CIPC_CHECK (stats.recv_timeouts == 1 && stats.recv_errors == 1);
+  CIPC_CHECK (stats.recv_latency.count == TEST_MESSAGES / 2 + 1);
+
+  // Turning latency off keeps the counters going but stops the samples.
+  CIPC_CHECK (cipc_stats_enable_latency (tx, 0) == CIPC_OK);
+  CIPC_CHECK (tx->send (tx->context, message, sizeof (message)) == CIPC_OK);
+
+  CIPC_CHECK (cipc_stats_get (tx, &stats) == CIPC_OK);
+  CIPC_CHECK (stats.msgs_sent == TEST_MESSAGES + 1 && !stats.latency_enabled);
+
+  CIPC_CHECK (cipc_stats_get (NULL, &stats) == CIPC_NULL_PTR);
+  CIPC_CHECK (cipc_stats_get (tx, NULL) == CIPC_NULL_PTR);
+}
+
+int
+main (void)
+{
+  test_histogram ();
+
+  char name[64];
+  snprintf (name, sizeof (name), "/cipc-test-stats-%d", (int)getpid ());
+
+  cipc_shm_config config = {
+    .name = name,
+    .mode = CIPC_SHM_MODE_BIND,
+    .capacity = 64 * 1024,
+    .sockopt_sndtimeo = 1000,
+    .sockopt_rcvtimeo = 20,
+  };
+
+  cipc *tx = cipc_create (CIPC_PROTOCOL_SHM);
+  if (!tx || tx->init (&tx->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to bind %s!\n", name);
+      return EXIT_FAILURE;
+    }
+
+  config.mode = CIPC_SHM_MODE_CONNECT;
+
+  cipc *rx = cipc_create (CIPC_PROTOCOL_SHM);
+  if (!rx || rx->init (&rx->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to connect to %s!\n", name);
+      cipc_free (tx);
+      return EXIT_FAILURE;
+    }
+
+  test_counters (tx, rx);
+
+  cipc_free (rx);
+  cipc_free (tx);
+
+  return CIPC_TEST_RESULT ();
+}
@@ -0,0 +1,257 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_test.h"
+
+// Length-prefixed framing over TCP, against a peer socket driven by hand: frames split across
+// reads, several frames in one read, buffers too small, and the frames cipc writes.
+
+#define TEST_MAX_MESSAGE_SIZE (2 * 1024 * 1024)
+#define TEST_LARGE_FRAME (1024 * 1024)
+
+typedef struct
+{
+  int fd;
+  char *data;
+  size_t length;
+} test_writer;
+
+static int
+read_full (int fd, char *buffer, size_t length)
+{
+  size_t done = 0;
+
+  while (done < length)
+    {
+      ssize_t n = read (fd, buffer + done, length - done);
+      if (n <= 0)
+        return -1;
+
+      done += (size_t)n;
+    }
+
+  return 0;
+}
+
+static void *
+write_frame (void *arg)
+{
+  test_writer *writer = (test_writer *)arg;
+
+  if (cipc_test_write_header (writer->fd, writer->length) == 0)
+    {
+      size_t done = 0;
+
+      while (done < writer->length)
+        {
+          ssize_t n = write (writer->fd, writer->data + done, writer->length - done);
+          if (n <= 0)
+            break;
+
+          done += (size_t)n;
+        }
+    }
+
+  return NULL;
+}
+
+static void
+test_split_frame (cipc *client, int peer)
+{
+  uint32_t header[2] = { htonl (5), 0 };
+  char buffer[16];
+  size_t length = 0;
+
+  // Header and payload each arrive in two reads.
+  CIPC_CHECK (write (peer, header, 3) == 3);
+  usleep (20000);
+  CIPC_CHECK (write (peer, (char *)header + 3, sizeof (header) - 3) == sizeof (header) - 3);
+  usleep (20000);
+  CIPC_CHECK (write (peer, "hel", 3) == 3);
+  usleep (20000);
+  CIPC_CHECK (write (peer, "lo", 2) == 2);
+
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 5 && strcmp (buffer, "hello") == 0);
+}
+
+static void
+test_coalesced_frames (cipc *client, int peer)
+{
+  const char *payloads[] = { "one", "two", "three" };
+  char wire[64];
+  size_t wire_length = 0;
+
+  for (size_t i = 0; i < 3; i++)
+    {
+      uint32_t header[2] = { htonl (strlen (payloads[i])), 0 };
+
+      memcpy (wire + wire_length, header, sizeof (header));
+      memcpy (wire + wire_length + sizeof (header), payloads[i], strlen (payloads[i]));
+      wire_length += sizeof (header) + strlen (payloads[i]);
+    }
+
+  CIPC_CHECK (write (peer, wire, wire_length) == (ssize_t)wire_length);
+
+  for (size_t i = 0; i < 3; i++)
+    {
+      char buffer[16];
+      size_t length = 0;
+
+      CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+      CIPC_CHECK (length == strlen (payloads[i]) && strcmp (buffer, payloads[i]) == 0);
+    }
+}
+
+static void
+test_empty_frame (cipc *client, int peer)
+{
+  char buffer[4] = "xyz";
+  size_t length = 1;
+
+  CIPC_CHECK (cipc_test_write_header (peer, 0) == 0);
+
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 0 && buffer[0] == '\0');
+}
+
+static void
+test_buffer_too_small (cipc *client, int peer)
+{
+  char payload[1000];
+  memset (payload, 'p', sizeof (payload));
+
+  CIPC_CHECK (cipc_test_write_header (peer, sizeof (payload)) == 0);
+  CIPC_CHECK (write (peer, payload, sizeof (payload)) == sizeof (payload));
+
+  char buffer[sizeof (payload) + 1];
+  size_t length = 0;
+
+  // The frame stays queued and reports its size; the buffer needs room for the terminator too.
+  CIPC_CHECK (client->recv (client->context, buffer, 100, &length) == CIPC_BAD_BUFFER_SIZE);
+  CIPC_CHECK (length == sizeof (payload));
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (payload), &length)
+              == CIPC_BAD_BUFFER_SIZE);
+  CIPC_CHECK (client->recv (client->context, buffer, 0, &length) == CIPC_BAD_BUFFER_SIZE);
+
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == sizeof (payload) && memcmp (buffer, payload, sizeof (payload)) == 0);
+  CIPC_CHECK (buffer[sizeof (payload)] == '\0');
+}
+
+static void
+test_large_frame (cipc *client, int peer)
+{
+  test_writer writer = { .fd = peer, .length = TEST_LARGE_FRAME };
+
+  writer.data = malloc (writer.length);
+  if (!writer.data)
+    {
+      CIPC_CHECK (writer.data != NULL);
+      return;
+    }
+
+  for (size_t i = 0; i < writer.length; i++)
+    writer.data[i] = (char)(i * 31);
+
+  // Larger than the socket buffers, so it is written while it is read.
+  pthread_t thread;
+  CIPC_CHECK (pthread_create (&thread, NULL, write_frame, &writer) == 0);
+
+  cipc_msg msg;
+
+  CIPC_CHECK (client->recv_msg (client->context, &msg) == CIPC_OK);
+  CIPC_CHECK (msg.length == writer.length && memcmp (msg.data, writer.data, msg.length) == 0);
+
+  client->release_msg (client->context, &msg);
+
+  pthread_join (thread, NULL);
+  free (writer.data);
+}
+
+static void
+test_sent_frames (cipc *client, int peer)
+{
+  cipc_iovec iov[] = { { .base = "ab", .length = 2 }, { .base = "cdef", .length = 4 } };
+
+  CIPC_CHECK (client->send (client->context, "abc", 3) == CIPC_OK);
+  CIPC_CHECK (client->sendv (client->context, iov, 2) == CIPC_OK);
+
+  // The two parts of sendv form a single frame.
+  char wire[2 * sizeof (cipc_tcp_frame_header) + 9];
+  CIPC_CHECK (read_full (peer, wire, sizeof (wire)) == 0);
+
+  uint32_t header[2];
+
+  memcpy (header, wire, sizeof (header));
+  CIPC_CHECK (ntohl (header[0]) == 3 && ntohl (header[1]) == 0);
+  CIPC_CHECK (memcmp (wire + 8, "abc", 3) == 0);
+
+  memcpy (header, wire + 11, sizeof (header));
+  CIPC_CHECK (ntohl (header[0]) == 6 && ntohl (header[1]) == 0);
+  CIPC_CHECK (memcmp (wire + 19, "abcdef", 6) == 0);
+}
+
+static void
+test_oversized_frame (cipc *client, int peer)
+{
+  char buffer[16];
+  size_t length = 0;
+
+  CIPC_CHECK (cipc_test_write_header (peer, TEST_MAX_MESSAGE_SIZE + 1) == 0);
+
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_BAD_FRAME);
+}
+
+int
+main (void)
+{
+  int port = 0;
+
+  int listener = cipc_test_listen (&port);
+  if (listener < 0)
+    {
+      perror ("listen");
+      return EXIT_FAILURE;
+    }
+
+  cipc_tcp_config config = {
+    .host = "127.0.0.1",
+    .port = port,
+    .mode = CIPC_TCP_MODE_CONNECT,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+    .max_message_size = TEST_MAX_MESSAGE_SIZE,
+  };
+
+  cipc *client = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!client || client->init (&client->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to connect the client!\n");
+      return EXIT_FAILURE;
+    }
+
+  int peer = accept (listener, NULL, NULL);
+  if (peer < 0)
+    {
+      perror ("accept");
+      return EXIT_FAILURE;
+    }
+
+  test_split_frame (client, peer);
+  test_coalesced_frames (client, peer);
+  test_empty_frame (client, peer);
+  test_buffer_too_small (client, peer);
+  test_large_frame (client, peer);
+  test_sent_frames (client, peer);
+  test_oversized_frame (client, peer);
+
+  cipc_free (client);
+  close (peer);
+  close (listener);
+
+  return CIPC_TEST_RESULT ();
+}
@@ -0,0 +1,147 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_test.h"
+
+// An asynchronous TCP connector whose server drops the connection in the middle of a frame while
+// another thread keeps sending. The broken frame fails the receive in progress; the next receive
+// gets a whole frame from the new connection, with nothing left over from the old one.
+
+typedef struct
+{
+  int listener;
+  atomic_int accepted;
+} test_server;
+
+typedef struct
+{
+  cipc *client;
+  atomic_int stop;
+  long sent;
+} test_sender;
+
+static void *
+serve (void *arg)
+{
+  test_server *server = (test_server *)arg;
+
+  // First connection: announces 100 bytes, sends 20, then goes away.
+  int fd = accept (server->listener, NULL, NULL);
+  if (fd < 0)
+    return NULL;
+
+  char partial[20] = { 0 };
+
+  cipc_test_write_header (fd, 100);
+  if (write (fd, partial, sizeof (partial)) < 0)
+    perror ("write");
+
+  usleep (50000);
+  close (fd);
+
+  // Second connection: one whole frame, then reads until the client leaves.
+  fd = accept (server->listener, NULL, NULL);
+  if (fd < 0)
+    return NULL;
+
+  atomic_store (&server->accepted, 2);
+
+  cipc_test_write_header (fd, 5);
+  if (write (fd, "hello", 5) < 0)
+    perror ("write");
+
+  char buffer[4096];
+  while (read (fd, buffer, sizeof (buffer)) > 0)
+    ;
+
+  close (fd);
+
+  return NULL;
+}
+
+static void *
+send_loop (void *arg)
+{
+  test_sender *sender = (test_sender *)arg;
+
+  while (!atomic_load (&sender->stop))
+    {
+      sender->client->send (sender->client->context, "ping", 4);
+      sender->sent++;
+
+      usleep (100);
+    }
+
+  return NULL;
+}
+
+int
+main (void)
+{
+  test_server server;
+  int port = 0;
+
+  atomic_init (&server.accepted, 1);
+
+  server.listener = cipc_test_listen (&port);
+  if (server.listener < 0)
+    {
+      perror ("listen");
+      return EXIT_FAILURE;
+    }
+
+  pthread_t server_thread;
+  if (pthread_create (&server_thread, NULL, serve, &server) != 0)
+    return EXIT_FAILURE;
+
+  cipc_tcp_config config = {
+    .host = "127.0.0.1",
+    .port = port,
+    .mode = CIPC_TCP_MODE_CONNECT,
+    .sockopt_sndtimeo = 2000,
+    .sockopt_rcvtimeo = 2000,
+    .sockopt_retries = 10,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+    .connect_async = 1,
+    .max_queued_bytes = 64 * 1024,
+  };
+
+  cipc *client = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!client || client->init (&client->context, &config) != CIPC_OK)
+    {
+      fprintf (stderr, "Failed to start the connector!\n");
+      return EXIT_FAILURE;
+    }
+
+  test_sender sender = { .client = client, .sent = 0 };
+  atomic_init (&sender.stop, 0);
+
+  pthread_t sender_thread;
+  CIPC_CHECK (pthread_create (&sender_thread, NULL, send_loop, &sender) == 0);
+
+  char buffer[256];
+  size_t length = 0;
+
+  // The frame cut short fails this receive...
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) != CIPC_OK);
+
+  // ...and the next one is read from the start of the new connection.
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 5 && strcmp (buffer, "hello") == 0);
+
+  atomic_store (&sender.stop, 1);
+  pthread_join (sender_thread, NULL);
+
+  CIPC_CHECK (atomic_load (&server.accepted) == 2);
+  CIPC_CHECK (sender.sent > 0);
+
+  cipc_free (client);
+
+  pthread_join (server_thread, NULL);
+  close (server.listener);
+
+  return CIPC_TEST_RESULT ();
+}
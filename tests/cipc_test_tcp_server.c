@@ -0,0 +1,142 @@
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_test.h"
+
+// A TCP server in epoll mode with several clients: each request comes with the id of its
+// connection, each reply goes back to that client only, and the id of a client that left is
+// never handed out again.
+
+#define TEST_CLIENTS 3
+
+static cipc *
+start (cipc_tcp_mode mode, int port)
+{
+  cipc_tcp_config config = {
+    .host = "127.0.0.1",
+    .port = port,
+    .mode = mode,
+    .sockopt_sndtimeo = 2000,
+    .sockopt_rcvtimeo = 2000,
+    .backlog = 16,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+    .engine = CIPC_TCP_ENGINE_EPOLL,
+  };
+
+  cipc *instance = cipc_create (CIPC_PROTOCOL_TCP);
+  if (instance && instance->init (&instance->context, &config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+static int
+send_text (cipc *client, const char *text)
+{
+  return client->send (client->context, text, strlen (text)) == CIPC_OK;
+}
+
+int
+main (void)
+{
+  int port = cipc_test_free_port ();
+
+  cipc *server = start (CIPC_TCP_MODE_SERVER, port);
+  if (!server)
+    {
+      fprintf (stderr, "Failed to start the server on port %d!\n", port);
+      return EXIT_FAILURE;
+    }
+
+  cipc *clients[TEST_CLIENTS];
+  cipc_peer_id peers[TEST_CLIENTS] = { 0 };
+  char buffer[64];
+  size_t length = 0;
+
+  for (int i = 0; i < TEST_CLIENTS; i++)
+    {
+      clients[i] = start (CIPC_TCP_MODE_CONNECT, port);
+      CIPC_CHECK (clients[i] != NULL);
+
+      if (!clients[i])
+        return CIPC_TEST_RESULT ();
+
+      snprintf (buffer, sizeof (buffer), "client %d", i);
+      CIPC_CHECK (send_text (clients[i], buffer));
+    }
+
+  // Requests arrive in any order; the text says which client each came from.
+  for (int i = 0; i < TEST_CLIENTS; i++)
+    {
+      cipc_peer_id peer = 0;
+      int index = -1;
+
+      CIPC_CHECK (server->recv_from (server->context, &peer, buffer, sizeof (buffer), &length)
+                  == CIPC_OK);
+      CIPC_CHECK (sscanf (buffer, "client %d", &index) == 1 && index >= 0
+                  && index < TEST_CLIENTS);
+      CIPC_CHECK (peer != 0);
+
+      if (index >= 0 && index < TEST_CLIENTS)
+        peers[index] = peer;
+    }
+
+  for (int i = 0; i < TEST_CLIENTS; i++)
+    for (int j = 0; j < i; j++)
+      CIPC_CHECK (peers[i] != peers[j]);
+
+  // Replies in reverse order still reach the right client.
+  for (int i = TEST_CLIENTS - 1; i >= 0; i--)
+    {
+      snprintf (buffer, sizeof (buffer), "reply %d", i);
+      CIPC_CHECK (server->send_to (server->context, peers[i], buffer, strlen (buffer))
+                  == CIPC_OK);
+    }
+
+  for (int i = 0; i < TEST_CLIENTS; i++)
+    {
+      char expected[16];
+      snprintf (expected, sizeof (expected), "reply %d", i);
+
+      CIPC_CHECK (clients[i]->recv (clients[i]->context, buffer, sizeof (buffer), &length)
+                  == CIPC_OK);
+      CIPC_CHECK (length == strlen (expected) && strcmp (buffer, expected) == 0);
+    }
+
+  // A request too large for the buffer stays queued until a larger buffer comes.
+  CIPC_CHECK (send_text (clients[1], "a longer request"));
+
+  cipc_peer_id peer = 0;
+
+  CIPC_CHECK (server->recv_from (server->context, &peer, buffer, 8, &length)
+              == CIPC_BAD_BUFFER_SIZE);
+  CIPC_CHECK (length == strlen ("a longer request"));
+  CIPC_CHECK (server->recv_from (server->context, &peer, buffer, sizeof (buffer), &length)
+              == CIPC_OK);
+  CIPC_CHECK (peer == peers[1] && strcmp (buffer, "a longer request") == 0);
+
+  // A client that leaves takes its id with it, even once a new client reuses its slot.
+  cipc_free (clients[0]);
+  usleep (50000);
+
+  clients[0] = start (CIPC_TCP_MODE_CONNECT, port);
+  CIPC_CHECK (clients[0] != NULL && send_text (clients[0], "newcomer"));
+
+  CIPC_CHECK (server->recv_from (server->context, &peer, buffer, sizeof (buffer), &length)
+              == CIPC_OK);
+  CIPC_CHECK (strcmp (buffer, "newcomer") == 0);
+  CIPC_CHECK (peer != 0 && peer != peers[0] && peer != peers[1] && peer != peers[2]);
+  CIPC_CHECK (server->send_to (server->context, peers[0], "gone", 4) == CIPC_BAD_PEER);
+
+  for (int i = 0; i < TEST_CLIENTS; i++)
+    if (clients[i])
+      cipc_free (clients[i]);
+
+  cipc_free (server);
+
+  return CIPC_TEST_RESULT ();
+}
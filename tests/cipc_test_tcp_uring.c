@@ -0,0 +1,190 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "backend/cipc_tcp.h"
+#include "cipc.h"
+#include "cipc_test.h"
+
+// A TCP server on the io_uring engine: pipelined requests from several clients, many of them
+// larger than one provided buffer, arrive whole and in order per connection, and each client gets
+// its own replies back in order. Skipped where io_uring cannot be set up.
+
+#define TEST_CLIENTS 3
+#define TEST_REQUESTS 200
+#define TEST_MAX_REQUEST (40 * 1024)
+
+typedef struct
+{
+  cipc *client;
+  uint32_t id;
+  int failed;
+} test_client;
+
+typedef struct
+{
+  uint32_t client;
+  uint32_t seq;
+} test_header;
+
+static cipc *
+start (cipc_tcp_mode mode, int port)
+{
+  cipc_tcp_config config = {
+    .host = "127.0.0.1",
+    .port = port,
+    .mode = mode,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+    .backlog = 16,
+    .framing = CIPC_TCP_FRAMING_LENGTH_PREFIX,
+    .engine = CIPC_TCP_ENGINE_IO_URING,
+  };
+
+  cipc *instance = cipc_create (CIPC_PROTOCOL_TCP);
+  if (!instance)
+    return NULL;
+
+  cipc_err err = instance->init (&instance->context, &config);
+  if (err != CIPC_OK)
+    {
+      cipc_free (instance);
+
+      if (err == CIPC_BAD_TCP_URING)
+        exit (CIPC_TEST_SKIP);
+
+      return NULL;
+    }
+
+  return instance;
+}
+
+static size_t
+request_length (uint32_t seq)
+{
+  return sizeof (test_header) + (size_t)seq * 7919 % (TEST_MAX_REQUEST - sizeof (test_header));
+}
+
+static void
+fill_request (char *request, uint32_t client, uint32_t seq)
+{
+  test_header header = { client, seq };
+
+  memcpy (request, &header, sizeof (header));
+  memset (request + sizeof (header), (char)(client * 31 + seq),
+          request_length (seq) - sizeof (header));
+}
+
+static void *
+client_run (void *arg)
+{
+  test_client *tc = (test_client *)arg;
+  static _Thread_local char request[TEST_MAX_REQUEST];
+
+  for (uint32_t seq = 0; seq < TEST_REQUESTS && !tc->failed; seq++)
+    {
+      fill_request (request, tc->id, seq);
+
+      tc->failed = tc->client->send (tc->client->context, request, request_length (seq))
+                   != CIPC_OK;
+    }
+
+  for (uint32_t seq = 0; seq < TEST_REQUESTS && !tc->failed; seq++)
+    {
+      char reply[32];
+      char expected[32];
+      size_t length = 0;
+
+      snprintf (expected, sizeof (expected), "ack %u", (unsigned)seq);
+
+      tc->failed = tc->client->recv (tc->client->context, reply, sizeof (reply), &length)
+                       != CIPC_OK
+                   || strcmp (reply, expected) != 0;
+    }
+
+  return NULL;
+}
+
+int
+main (void)
+{
+  int port = cipc_test_free_port ();
+
+  cipc *server = start (CIPC_TCP_MODE_SERVER, port);
+  if (!server)
+    {
+      fprintf (stderr, "Failed to start the server on port %d!\n", port);
+      return EXIT_FAILURE;
+    }
+
+  test_client clients[TEST_CLIENTS];
+  pthread_t threads[TEST_CLIENTS];
+
+  for (uint32_t i = 0; i < TEST_CLIENTS; i++)
+    {
+      clients[i] = (test_client){ .client = start (CIPC_TCP_MODE_CONNECT, port), .id = i };
+      CIPC_CHECK (clients[i].client != NULL);
+    }
+
+  for (uint32_t i = 0; i < TEST_CLIENTS; i++)
+    if (clients[i].client)
+      CIPC_CHECK (pthread_create (&threads[i], NULL, client_run, &clients[i]) == 0);
+
+  static char buffer[TEST_MAX_REQUEST + 1];
+  static char expected[TEST_MAX_REQUEST];
+  uint32_t next[TEST_CLIENTS] = { 0 };
+  cipc_peer_id peers[TEST_CLIENTS] = { 0 };
+  int bad = 0;
+
+  for (int i = 0; i < TEST_CLIENTS * TEST_REQUESTS && !bad; i++)
+    {
+      cipc_peer_id peer = 0;
+      size_t length = 0;
+      test_header header;
+
+      if (server->recv_from (server->context, &peer, buffer, sizeof (buffer), &length) != CIPC_OK
+          || length < sizeof (header))
+        {
+          bad = 1;
+          break;
+        }
+
+      memcpy (&header, buffer, sizeof (header));
+
+      // The first request of each client ties its id to the connection.
+      if (header.client >= TEST_CLIENTS || header.seq != next[header.client]
+          || (peers[header.client] != 0 && peers[header.client] != peer))
+        {
+          bad = 1;
+          break;
+        }
+
+      peers[header.client] = peer;
+
+      fill_request (expected, header.client, header.seq);
+      bad = length != request_length (header.seq) || memcmp (buffer, expected, length) != 0;
+
+      char reply[32];
+      snprintf (reply, sizeof (reply), "ack %u", (unsigned)next[header.client]++);
+
+      bad |= server->send_to (server->context, peer, reply, strlen (reply)) != CIPC_OK;
+    }
+
+  CIPC_CHECK (!bad);
+
+  for (uint32_t i = 0; i < TEST_CLIENTS; i++)
+    {
+      if (!clients[i].client)
+        continue;
+
+      pthread_join (threads[i], NULL);
+
+      CIPC_CHECK (!clients[i].failed);
+      CIPC_CHECK (next[i] == TEST_REQUESTS);
+
+      cipc_free (clients[i].client);
+    }
+
+  cipc_free (server);
+
+  return CIPC_TEST_RESULT ();
+}
@@ -0,0 +1,246 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "backend/cipc_shm.h"
+#include "backend/cipc_threaded.h"
+#include "cipc.h"
+#include "cipc_test.h"
+
+// Threaded wrappers on both ends of a shared memory pair: several producers share one sending
+// instance through send, sendv and send_batch, and every message arrives once, in each
+// producer's order, through recv, recv_msg and recv_batch. A reply then travels the other way.
+
+#define TEST_PRODUCERS 4
+#define TEST_PER_PRODUCER 5000
+
+typedef struct
+{
+  uint32_t producer;
+  uint32_t seq;
+} test_header;
+
+typedef struct
+{
+  cipc *tx;
+  uint32_t id;
+  int failed;
+} test_producer;
+
+static cipc *
+start (cipc_shm_mode mode, const char *name)
+{
+  cipc_shm_config shm_config = {
+    .name = name,
+    .mode = mode,
+    .capacity = 64 * 1024,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+  };
+
+  cipc *shm = cipc_create (CIPC_PROTOCOL_SHM);
+  if (!shm || shm->init (&shm->context, &shm_config) != CIPC_OK)
+    {
+      cipc_free (shm);
+      return NULL;
+    }
+
+  cipc_threaded_config config = {
+    .inner = shm,
+    .max_queued_bytes = 256 * 1024,
+    .sockopt_sndtimeo = 5000,
+    .sockopt_rcvtimeo = 5000,
+  };
+
+  cipc *instance = cipc_create (CIPC_PROTOCOL_THREADED);
+  if (!instance || instance->init (&instance->context, &config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      cipc_free (shm);
+      return NULL;
+    }
+
+  return instance;
+}
+
+static size_t
+padding (uint32_t seq)
+{
+  return seq * 13 % 200;
+}
+
+static void *
+produce (void *arg)
+{
+  test_producer *producer = (test_producer *)arg;
+  cipc *tx = producer->tx;
+  char pad[256];
+
+  memset (pad, (char)producer->id, sizeof (pad));
+
+  for (uint32_t seq = 0; seq < TEST_PER_PRODUCER && !producer->failed;)
+    {
+      test_header headers[4];
+      cipc_iovec msgs[4];
+      size_t count = 1;
+
+      headers[0] = (test_header){ producer->id, seq };
+
+      if (seq % 3 == 0)
+        {
+          cipc_iovec iov[2] = {
+            { .base = &headers[0], .length = sizeof (headers[0]) },
+            { .base = pad, .length = padding (seq) },
+          };
+
+          producer->failed = tx->sendv (tx->context, iov, 2) != CIPC_OK;
+        }
+      else if (seq % 3 == 1)
+        producer->failed = tx->send (tx->context, (const char *)&headers[0], sizeof (headers[0]))
+                           != CIPC_OK;
+      else
+        {
+          count = TEST_PER_PRODUCER - seq < 4 ? TEST_PER_PRODUCER - seq : 4;
+
+          for (size_t i = 0; i < count; i++)
+            {
+              headers[i] = (test_header){ producer->id, seq + (uint32_t)i };
+              msgs[i] = (cipc_iovec){ .base = &headers[i], .length = sizeof (headers[i]) };
+            }
+
+          size_t sent = 0;
+
+          producer->failed = tx->send_batch (tx->context, msgs, count, &sent) != CIPC_OK
+                             || sent != count;
+        }
+
+      seq += (uint32_t)count;
+    }
+
+  return NULL;
+}
+
+// Checks one message against the next sequence number expected from its producer.
+static int
+accept_message (const char *data, size_t length, uint32_t *next)
+{
+  test_header header;
+
+  if (length < sizeof (header))
+    return 0;
+
+  memcpy (&header, data, sizeof (header));
+
+  if (header.producer >= TEST_PRODUCERS || header.seq != next[header.producer])
+    return 0;
+
+  next[header.producer]++;
+
+  return 1;
+}
+
+static void
+consume (cipc *rx)
+{
+  uint32_t next[TEST_PRODUCERS] = { 0 };
+  size_t received = 0;
+  int bad = 0;
+
+  while (received < TEST_PRODUCERS * TEST_PER_PRODUCER && !bad)
+    {
+      if (received % 3 == 0)
+        {
+          char buffer[512];
+          size_t length = 0;
+
+          bad = rx->recv (rx->context, buffer, sizeof (buffer), &length) != CIPC_OK
+                || !accept_message (buffer, length, next);
+          received++;
+        }
+      else if (received % 3 == 1)
+        {
+          cipc_msg msg;
+
+          bad = rx->recv_msg (rx->context, &msg) != CIPC_OK;
+          if (!bad)
+            {
+              bad = !accept_message (msg.data, msg.length, next);
+              rx->release_msg (rx->context, &msg);
+            }
+
+          received++;
+        }
+      else
+        {
+          cipc_msg msgs[8];
+          size_t count = 0;
+
+          bad = rx->recv_batch (rx->context, msgs, 8, &count) != CIPC_OK;
+
+          for (size_t i = 0; i < count; i++)
+            {
+              bad |= !accept_message (msgs[i].data, msgs[i].length, next);
+              rx->release_msg (rx->context, &msgs[i]);
+            }
+
+          received += count;
+        }
+    }
+
+  CIPC_CHECK (!bad);
+
+  for (int i = 0; i < TEST_PRODUCERS; i++)
+    CIPC_CHECK (next[i] == TEST_PER_PRODUCER);
+}
+
+int
+main (void)
+{
+  char name[64];
+  snprintf (name, sizeof (name), "/cipc-test-threaded-%d", (int)getpid ());
+
+  cipc *tx = start (CIPC_SHM_MODE_BIND, name);
+  cipc *rx = tx ? start (CIPC_SHM_MODE_CONNECT, name) : NULL;
+
+  if (!tx || !rx)
+    {
+      fprintf (stderr, "Failed to set up the threaded pair!\n");
+      cipc_free (tx);
+      return EXIT_FAILURE;
+    }
+
+  test_producer producers[TEST_PRODUCERS];
+  pthread_t threads[TEST_PRODUCERS];
+
+  for (uint32_t i = 0; i < TEST_PRODUCERS; i++)
+    {
+      producers[i] = (test_producer){ .tx = tx, .id = i };
+      CIPC_CHECK (pthread_create (&threads[i], NULL, produce, &producers[i]) == 0);
+    }
+
+  consume (rx);
+
+  for (int i = 0; i < TEST_PRODUCERS; i++)
+    {
+      pthread_join (threads[i], NULL);
+      CIPC_CHECK (!producers[i].failed);
+    }
+
+  // The other direction goes through the sending end's I/O thread.
+  char buffer[16];
+  size_t length = 0;
+
+  CIPC_CHECK (rx->send (rx->context, "done", 4) == CIPC_OK);
+  CIPC_CHECK (tx->recv (tx->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 4 && strcmp (buffer, "done") == 0);
+
+  cipc_msg msg;
+  size_t count = 99;
+
+  CIPC_CHECK (rx->recv_batch (rx->context, NULL, 1, &count) == CIPC_NULL_PTR);
+  CIPC_CHECK (rx->recv_batch (rx->context, &msg, 1, NULL) == CIPC_NULL_PTR);
+
+  cipc_free (rx);
+  cipc_free (tx);
+
+  return CIPC_TEST_RESULT ();
+}
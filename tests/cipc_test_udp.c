@@ -0,0 +1,178 @@
+#include <endian.h>
+#include <string.h>
+
+#include "backend/cipc_udp.h"
+#include "cipc.h"
+#include "cipc_stats.h"
+#include "cipc_test.h"
+
+// UDP with sequence numbers over loopback: replies by peer id, a batch sent in one go, gaps in
+// a sender's numbering counted as msgs_lost, and datagrams that do not belong skipped.
+
+static cipc *
+start (const cipc_udp_config *config)
+{
+  cipc *instance = cipc_create (CIPC_PROTOCOL_UDP);
+  if (instance && instance->init (&instance->context, config) != CIPC_OK)
+    {
+      cipc_free (instance);
+      return NULL;
+    }
+
+  return instance;
+}
+
+// A datagram carrying seq and text, as a cipc sender with sequence numbers would send it.
+static void
+send_raw (int fd, int port, uint64_t seq, const char *text)
+{
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port = htons (port),
+    .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+  };
+  char datagram[64];
+  uint64_t header = htobe64 (seq);
+
+  memcpy (datagram, &header, sizeof (header));
+  memcpy (datagram + sizeof (header), text, strlen (text));
+
+  CIPC_CHECK (sendto (fd, datagram, sizeof (header) + strlen (text), 0, (struct sockaddr *)&addr,
+                      sizeof (addr))
+              == (ssize_t)(sizeof (header) + strlen (text)));
+}
+
+static void
+test_round_trip (cipc *server, cipc *client)
+{
+  char buffer[64];
+  size_t length = 0;
+  cipc_peer_id peer = 0;
+
+  CIPC_CHECK (client->send (client->context, "ping", 4) == CIPC_OK);
+  CIPC_CHECK (server->recv_from (server->context, &peer, buffer, sizeof (buffer), &length)
+              == CIPC_OK);
+  CIPC_CHECK (length == 4 && strcmp (buffer, "ping") == 0 && peer != 0);
+
+  // send goes back to the last sender, send_to to the one named.
+  CIPC_CHECK (server->send (server->context, "pong", 4) == CIPC_OK);
+  CIPC_CHECK (server->send_to (server->context, peer, "again", 5) == CIPC_OK);
+
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 4 && strcmp (buffer, "pong") == 0);
+  CIPC_CHECK (client->recv (client->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 5 && strcmp (buffer, "again") == 0);
+
+  // Equal sizes, so one UDP_SEGMENT send where the kernel has it; the datagrams arrive apart.
+  char messages[8][16];
+  cipc_iovec iov[8];
+
+  for (int i = 0; i < 8; i++)
+    {
+      memset (messages[i], 'a' + i, sizeof (messages[i]));
+      iov[i].base = messages[i];
+      iov[i].length = sizeof (messages[i]);
+    }
+
+  size_t sent = 0;
+  CIPC_CHECK (client->send_batch (client->context, iov, 8, &sent) == CIPC_OK && sent == 8);
+
+  size_t received = 0;
+  while (received < 8)
+    {
+      cipc_msg msgs[8];
+      size_t count = 0;
+
+      if (server->recv_batch (server->context, msgs, 8, &count) != CIPC_OK)
+        break;
+
+      for (size_t i = 0; i < count; i++, received++)
+        {
+          CIPC_CHECK (msgs[i].length == sizeof (messages[0]));
+          CIPC_CHECK (memcmp (msgs[i].data, messages[received], sizeof (messages[0])) == 0);
+
+          server->release_msg (server->context, &msgs[i]);
+        }
+    }
+
+  CIPC_CHECK (received == 8);
+
+  cipc_stats stats;
+  CIPC_CHECK (cipc_stats_get (server, &stats) == CIPC_OK);
+  CIPC_CHECK (stats.msgs_received == 9 && stats.msgs_lost == 0);
+}
+
+static void
+test_gaps (cipc *server, int port)
+{
+  int fd = socket (AF_INET, SOCK_DGRAM, 0);
+  CIPC_CHECK (fd >= 0);
+
+  char buffer[64];
+  size_t length = 0;
+
+  send_raw (fd, port, 0, "first");
+  send_raw (fd, port, 5, "sixth");
+
+  // Shorter than a sequence number, so dropped on the way.
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port = htons (port),
+    .sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+  };
+  CIPC_CHECK (sendto (fd, "abc", 3, 0, (struct sockaddr *)&addr, sizeof (addr)) == 3);
+
+  send_raw (fd, port, 6, "seventh");
+
+  CIPC_CHECK (server->recv (server->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 5 && strcmp (buffer, "first") == 0);
+  CIPC_CHECK (server->recv (server->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 5 && strcmp (buffer, "sixth") == 0);
+
+  // Too small a buffer leaves the datagram for the next receive.
+  CIPC_CHECK (server->recv (server->context, buffer, 7, &length) == CIPC_BAD_BUFFER_SIZE);
+  CIPC_CHECK (length == 7);
+  CIPC_CHECK (server->recv (server->context, buffer, sizeof (buffer), &length) == CIPC_OK);
+  CIPC_CHECK (length == 7 && strcmp (buffer, "seventh") == 0);
+
+  cipc_stats stats;
+  CIPC_CHECK (cipc_stats_get (server, &stats) == CIPC_OK);
+  CIPC_CHECK (stats.msgs_lost == 4);
+
+  close (fd);
+}
+
+int
+main (void)
+{
+  cipc_udp_config config = {
+    .host = "127.0.0.1",
+    .port = cipc_test_free_port (),
+    .mode = CIPC_UDP_MODE_BIND,
+    .sockopt_sndtimeo = 2000,
+    .sockopt_rcvtimeo = 2000,
+    .sequence = 1,
+  };
+
+  cipc *server = start (&config);
+
+  config.mode = CIPC_UDP_MODE_CONNECT;
+
+  cipc *client = start (&config);
+
+  if (!server || !client)
+    {
+      fprintf (stderr, "Failed to start the UDP pair!\n");
+      cipc_free (client);
+      cipc_free (server);
+      return EXIT_FAILURE;
+    }
+
+  test_round_trip (server, client);
+  test_gaps (server, config.port);
+
+  cipc_free (client);
+  cipc_free (server);
+
+  return CIPC_TEST_RESULT ();
+}